@@ -136,6 +136,13 @@ extern int nvram_unset(const char *name);
  */
 extern int nvram_commit(void);
 
+/*
+ * Schedule a commit without waiting for the flash write. Requests made
+ * close together are merged into a single write by the driver.
+ * @return	0 on success and errno on failure
+ */
+extern int nvram_commit_async(void);
+
 /*
  * Get all NVRAM variables (format name=value\0 ... \0\0).
  * @param	buf	buffer to store variables
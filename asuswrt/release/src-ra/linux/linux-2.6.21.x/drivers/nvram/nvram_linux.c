@@ -22,6 +22,9 @@
 #include <linux/spinlock.h>
 #include <linux/slab.h>
 #include <linux/bootmem.h>
+#include <linux/workqueue.h>
+#include <linux/reboot.h>
+#include <linux/notifier.h>
 
 #ifdef ASUS_NVRAM
 #	include <linux/mm.h>
@@ -433,6 +436,26 @@ static struct proc_dir_entry *g_pdentry = NULL;
 
 static struct mtd_info *nvram_mtd = NULL;
 
+/* Deferred commit: a burst of async commit requests is coalesced into a
+ * single erase/write once the requests go quiet for NVRAM_COMMIT_DELAY,
+ * but never later than NVRAM_COMMIT_MAX_DELAY after the first of them.
+ */
+#define NVRAM_IOCTL_COMMIT_ASYNC	0x0002
+#define NVRAM_COMMIT_DELAY		(2 * HZ)
+#define NVRAM_COMMIT_MAX_DELAY		(10 * HZ)
+
+static unsigned long nvram_gen = 0;		/* bumped by every set/unset */
+static unsigned long nvram_commit_gen = 0;	/* generation last written to flash */
+static unsigned long nvram_commit_first = 0;	/* jiffies of oldest pending request */
+static unsigned int nvram_commit_written = 0;
+static unsigned int nvram_commit_skipped = 0;
+static unsigned int nvram_commit_requests = 0;
+
+static void nvram_commit_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(nvram_commit_dwork, nvram_commit_work);
+/* Own queue, so a flash erase does not hold up the shared keventd */
+static struct workqueue_struct *nvram_commit_wq = NULL;
+
 
 #ifdef ASUS_NVRAM
 // from src/shared/bcmutils.c
@@ -525,6 +548,11 @@ nvram_proc_version_read(char *buf, char **start, off_t offset, int count, int *e
    	len += snprintf (buf+len, count-len, "  flags      : 0x%x\n", nvram_mtd->flags);
    	len += snprintf (buf+len, count-len, "  size       : 0x%x\n", nvram_mtd->size);
    	len += snprintf (buf+len, count-len, "  erasesize  : 0x%x\n", nvram_mtd->erasesize);
+	len += snprintf (buf+len, count-len, "commit         \n");
+	len += snprintf (buf+len, count-len, "  written    : %u\n", nvram_commit_written);
+	len += snprintf (buf+len, count-len, "  skipped    : %u\n", nvram_commit_skipped);
+	len += snprintf (buf+len, count-len, "  async req  : %u\n", nvram_commit_requests);
+	len += snprintf (buf+len, count-len, "  pending    : %s\n", nvram_commit_first ? "yes" : "no");
 
     *eof = 1;
     return len;
@@ -592,7 +620,7 @@ int
 nvram_set(const char *name, const char *value)
 {
 	unsigned long flags;
-	int ret;
+	int ret = 0;
 	struct nvram_header *header;
 
 	spin_lock_irqsave(&nvram_lock, flags);
@@ -625,6 +653,8 @@ nvram_set(const char *name, const char *value)
 			kfree(header);
 		}
 	}
+	if (ret == 0)
+		nvram_gen++;
 	spin_unlock_irqrestore(&nvram_lock, flags);
 
 	return ret;
@@ -664,6 +694,8 @@ nvram_unset(const char *name)
 
 	spin_lock_irqsave(&nvram_lock, flags);
 	ret = _nvram_unset(name);
+	if (ret == 0)
+		nvram_gen++;
 	spin_unlock_irqrestore(&nvram_lock, flags);
 
 	return ret;
@@ -676,15 +708,15 @@ erase_callback(struct erase_info *done)
 	wake_up(wait_q);
 }
 
-int
-nvram_commit(void)
+static int
+__nvram_commit(void)
 {
 	char *buf;
 	size_t erasesize, len;
 	unsigned int i;
 	int ret;
 	struct nvram_header *header;
-	unsigned long flags;
+	unsigned long flags, gen;
 	u_int32_t offset;
 	DECLARE_WAITQUEUE(wait, current);
 	wait_queue_head_t wait_q;
@@ -724,8 +756,15 @@ nvram_commit(void)
 		header = (struct nvram_header *)buf;
 	}
 
-	/* Regenerate NVRAM */
+	/* Regenerate NVRAM, unless flash already holds the current contents */
 	spin_lock_irqsave(&nvram_lock, flags);
+	gen = nvram_gen;
+	if (gen == nvram_commit_gen) {
+		spin_unlock_irqrestore(&nvram_lock, flags);
+		nvram_commit_skipped++;
+		ret = 0;
+		goto done;
+	}
 	ret = _nvram_commit(header);
 	spin_unlock_irqrestore(&nvram_lock, flags);
 	if (ret)
@@ -771,6 +810,10 @@ nvram_commit(void)
 
 	offset = nvram_mtd->size - erasesize;
 	ret = MTD_READ(nvram_mtd, offset, 4, &len, buf);
+	if (ret == 0) {
+		nvram_commit_gen = gen;
+		nvram_commit_written++;
+	}
 
  done:
 	up(&nvram_sem);
@@ -778,6 +821,104 @@ nvram_commit(void)
 	return ret;
 }
 
+/* Synchronous commit: supersedes any pending deferred commit */
+int
+nvram_commit(void)
+{
+	unsigned long flags;
+
+	if (cancel_delayed_work(&nvram_commit_dwork)) {
+		spin_lock_irqsave(&nvram_lock, flags);
+		nvram_commit_first = 0;
+		spin_unlock_irqrestore(&nvram_lock, flags);
+	}
+
+	return __nvram_commit();
+}
+
+/* Set by rc before it erases the nvram partition (factory default) */
+#define NVRAM_STOP_COMMIT	"asus_stop_commit"
+
+static void
+nvram_commit_work(struct work_struct *work)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&nvram_lock, flags);
+	nvram_commit_first = 0;
+	spin_unlock_irqrestore(&nvram_lock, flags);
+
+	if (nvram_get(NVRAM_STOP_COMMIT)) {
+		printk("nvram_commit: commits stopped, deferred commit dropped\n");
+		return;
+	}
+	if (__nvram_commit())
+		printk("nvram_commit: deferred commit failed\n");
+}
+
+/* Schedule a commit and return at once; repeated requests push the
+ * write out until NVRAM_COMMIT_MAX_DELAY has passed since the first one.
+ */
+static int
+nvram_commit_async(void)
+{
+	unsigned long flags, now, deadline, delay = NVRAM_COMMIT_DELAY;
+
+	if (!nvram_mtd || !nvram_commit_wq)
+		return -ENODEV;
+
+	spin_lock_irqsave(&nvram_lock, flags);
+	nvram_commit_requests++;
+	if (nvram_gen == nvram_commit_gen && !nvram_commit_first) {
+		spin_unlock_irqrestore(&nvram_lock, flags);
+		return 0;
+	}
+	now = jiffies;
+	if (!nvram_commit_first)
+		nvram_commit_first = now ? : 1;
+	deadline = nvram_commit_first + NVRAM_COMMIT_MAX_DELAY;
+	if (time_after_eq(now, deadline))
+		delay = 0;
+	else if (time_after(now + delay, deadline))
+		delay = deadline - now;
+	spin_unlock_irqrestore(&nvram_lock, flags);
+
+	cancel_delayed_work(&nvram_commit_dwork);
+	queue_delayed_work(nvram_commit_wq, &nvram_commit_dwork, delay);
+
+	return 0;
+}
+
+/* Write out a deferred commit that is still queued before the flash goes
+ * away. Nothing else is committed here: a reboot after a factory default
+ * must not put back the nvram that was just erased.
+ */
+static int
+nvram_reboot_notify(struct notifier_block *nb, unsigned long code, void *unused)
+{
+	unsigned long flags;
+
+	if (!nvram_commit_wq)
+		return NOTIFY_DONE;
+	if (!cancel_delayed_work(&nvram_commit_dwork)) {
+		/* Let a commit already in progress finish its write */
+		flush_workqueue(nvram_commit_wq);
+		return NOTIFY_DONE;
+	}
+
+	spin_lock_irqsave(&nvram_lock, flags);
+	nvram_commit_first = 0;
+	spin_unlock_irqrestore(&nvram_lock, flags);
+
+	if (!nvram_get(NVRAM_STOP_COMMIT))
+		__nvram_commit();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nvram_reboot_notifier = {
+	.notifier_call = nvram_reboot_notify,
+};
+
 int
 nvram_getall(char *buf, int count)
 {
@@ -925,6 +1066,8 @@ done:
 static int
 dev_nvram_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg)
 {
+	if (cmd == NVRAM_IOCTL_COMMIT_ASYNC)
+		return nvram_commit_async();
 	if (cmd != NVRAM_MAGIC)
 		return -EINVAL;
 	if(arg==0)
@@ -1037,6 +1180,14 @@ dev_nvram_exit(void)
 	int order = 0;
 	struct page *page, *end;
 
+	unregister_reboot_notifier(&nvram_reboot_notifier);
+	if (nvram_major >= 0)
+		nvram_commit();
+	if (nvram_commit_wq) {
+		destroy_workqueue(nvram_commit_wq);
+		nvram_commit_wq = NULL;
+	}
+
 #ifdef ASUS_NVRAM
 	if (nvram_major >= 0)
 		unregister_chrdev(nvram_major, MTD_NVRAM_NAME);
@@ -1161,6 +1312,10 @@ dev_nvram_init(void)
 	g_pdentry->owner = THIS_MODULE;
 #endif	// ASUS_NVRAM
 
+	/* Without it, async commit requests fall back to synchronous ones */
+	nvram_commit_wq = create_singlethread_workqueue("nvram_commit");
+	register_reboot_notifier(&nvram_reboot_notifier);
+
 //	extern int (*nvram_set_p)(char *, char *);
 //	nvram_set_p = nvram_set;
 
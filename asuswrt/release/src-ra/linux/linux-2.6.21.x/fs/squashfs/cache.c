@@ -42,6 +42,11 @@
  * have been packed with it, these because of locality-of-reference may be read
  * in the near future. Temporarily caching them ensures they are available for
  * near future access without requiring an additional read and decompress.
+ *
+ * The datablock cache is sized by CONFIG_SQUASHFS_DATA_CACHE_SIZE, so that
+ * pages dropped from the page-cache under memory pressure can be refilled
+ * without decompressing the block again.  Hits, misses and the time spent
+ * reading and decompressing of every cache are shown in /proc/fs/squashfs.
  */
 
 #include <linux/fs.h>
@@ -52,11 +57,16 @@
 #include <linux/spinlock.h>
 #include <linux/wait.h>
 #include <linux/pagemap.h>
+#include <linux/proc_fs.h>
+#include <linux/time.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
 #include "squashfs.h"
 
+static LIST_HEAD(cache_list);
+static DEFINE_SPINLOCK(cache_list_lock);
+
 /*
  * Look-up block in cache, and increment usage count.  If not in cache, read
  * and decompress it from disk.
@@ -66,6 +76,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 {
 	int i, n;
 	struct squashfs_cache_entry *entry;
+	struct timeval start, end;
 
 	spin_lock(&cache->lock);
 
@@ -117,14 +128,20 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			entry->pending = 1;
 			entry->num_waiters = 0;
 			entry->error = 0;
+			cache->misses++;
 			spin_unlock(&cache->lock);
 
+			do_gettimeofday(&start);
 			entry->length = squashfs_read_data(sb, entry->data,
 				block, length, &entry->next_index,
 				cache->block_size, cache->pages);
+			do_gettimeofday(&end);
 
 			spin_lock(&cache->lock);
 
+			cache->read_usecs += (end.tv_sec - start.tv_sec) *
+				USEC_PER_SEC + end.tv_usec - start.tv_usec;
+
 			if (entry->length < 0)
 				entry->error = entry->length;
 
@@ -154,6 +171,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		if (entry->refcount == 0)
 			cache->unused--;
 		entry->refcount++;
+		cache->hits++;
 
 		/*
 		 * If the entry is currently being filled in by another process
@@ -214,6 +232,11 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 	if (cache == NULL)
 		return;
 
+	spin_lock(&cache_list_lock);
+	if (cache->list.next)
+		list_del(&cache->list);
+	spin_unlock(&cache_list_lock);
+
 	for (i = 0; i < cache->entries; i++) {
 		if (cache->entry[i].data) {
 			for (j = 0; j < cache->pages; j++)
@@ -282,6 +305,10 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		}
 	}
 
+	spin_lock(&cache_list_lock);
+	list_add_tail(&cache->list, &cache_list);
+	spin_unlock(&cache_list_lock);
+
 	return cache;
 
 cleanup:
@@ -402,6 +429,24 @@ struct squashfs_cache_entry *squashfs_get_datablock(struct super_block *sb,
 }
 
 
+/*
+ * As squashfs_get_datablock(), for a block decompressed ahead of a
+ * sequential reader.  Only counted separately.
+ */
+struct squashfs_cache_entry *squashfs_readahead_datablock(
+	struct super_block *sb, u64 start_block, int length)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct squashfs_cache *cache = msblk->read_page;
+
+	spin_lock(&cache->lock);
+	cache->readahead++;
+	spin_unlock(&cache->lock);
+
+	return squashfs_cache_get(sb, cache, start_block, length);
+}
+
+
 /*
  * Read a filesystem table (uncompressed sequence of bytes) from disk
  */
@@ -438,3 +483,57 @@ failed:
 	kfree(table);
 	return ERR_PTR(res);
 }
+
+
+/*
+ * /proc/fs/squashfs, one line per cache of every mounted filesystem
+ */
+static int squashfs_cache_read_proc(char *page, char **start, off_t off,
+	int count, int *eof, void *data)
+{
+	struct squashfs_cache *cache;
+	int len;
+
+	len = sprintf(page, "%-10s %7s %10s %10s %10s %14s\n", "cache",
+		"entries", "hits", "misses", "readahead", "read_usecs");
+
+	spin_lock(&cache_list_lock);
+	list_for_each_entry(cache, &cache_list, list) {
+		if (len > PAGE_SIZE - 80)
+			break;
+		spin_lock(&cache->lock);
+		len += sprintf(page + len, "%-10s %7d %10lu %10lu %10lu %14llu\n",
+			cache->name, cache->entries, cache->hits,
+			cache->misses, cache->readahead,
+			(unsigned long long) cache->read_usecs);
+		spin_unlock(&cache->lock);
+	}
+	spin_unlock(&cache_list_lock);
+
+	if (off >= len) {
+		*eof = 1;
+		return 0;
+	}
+
+	*start = page + off;
+	len -= off;
+	if (len > count)
+		len = count;
+	else
+		*eof = 1;
+
+	return len;
+}
+
+
+void squashfs_cache_proc_init(void)
+{
+	create_proc_read_entry("fs/squashfs", 0, NULL,
+		squashfs_cache_read_proc, NULL);
+}
+
+
+void squashfs_cache_proc_exit(void)
+{
+	remove_proc_entry("fs/squashfs", NULL);
+}
@@ -38,6 +38,10 @@
  * Larger files use multiple slots, with 1.75 TiB files using all 8 slots.
  * The index cache is designed to be memory efficient, and by default uses
  * 16 KiB.
+ *
+ * When the datablock cache has more than one entry, a file read block after
+ * block also has the next datablock decompressed and pushed into the
+ * page-cache ahead of the reader.
  */
 
 #include <linux/fs.h>
@@ -371,11 +375,95 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Loop copying datablock into pages.  As the datablock likely covers
+ * many PAGE_CACHE_SIZE pages (default block size is 128 KiB) explicitly
+ * grab the pages from the page cache, except for the page that we've
+ * been called to fill (if any).
+ */
+static void push_pages(struct address_space *mapping, struct page *page,
+	int start_index, int end_index, struct squashfs_cache_entry *buffer,
+	int offset, int bytes, int sparse)
+{
+	void *pageaddr;
+	int i;
+
+	for (i = start_index; i <= end_index && bytes > 0; i++,
+			bytes -= PAGE_CACHE_SIZE, offset += PAGE_CACHE_SIZE) {
+		struct page *push_page;
+		int avail = sparse ? 0 : min_t(int, bytes, PAGE_CACHE_SIZE);
+
+		TRACE("bytes %d, i %d, available_bytes %d\n", bytes, i, avail);
+
+		push_page = (page && i == page->index) ? page :
+			grab_cache_page_nowait(mapping, i);
+
+		if (!push_page)
+			continue;
+
+		if (PageUptodate(push_page))
+			goto skip_page;
+
+		pageaddr = kmap_atomic(push_page, KM_USER0);
+		squashfs_copy_data(pageaddr, buffer, offset, avail);
+		memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
+		kunmap_atomic(pageaddr, KM_USER0);
+		flush_dcache_page(push_page);
+		SetPageUptodate(push_page);
+skip_page:
+		unlock_page(push_page);
+		if (push_page != page)
+			page_cache_release(push_page);
+	}
+}
+
+
+/*
+ * Called after datablock index has been read.  If the previous datablock
+ * read from this file was index - 1, decompress datablock index + 1 into
+ * the datablock cache and page-cache now, unless its first page is already
+ * there.  Fragments and holes are left to squashfs_readpage().
+ */
+static void readahead_block(struct inode *inode, int index)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	struct squashfs_cache_entry *buffer;
+	struct page *page;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	int next = index + 1, sequential, bsize;
+	u64 block = 0;
+
+	sequential = squashfs_i(inode)->next_block == index;
+	squashfs_i(inode)->next_block = next;
+
+	if (!sequential || msblk->read_page->entries < 2 || next >= file_end)
+		return;
+
+	page = find_get_page(inode->i_mapping, next << shift);
+	if (page) {
+		page_cache_release(page);
+		return;
+	}
+
+	bsize = read_blocklist(inode, next, &block);
+	if (bsize <= 0)
+		return;
+
+	buffer = squashfs_readahead_datablock(inode->i_sb, block, bsize);
+	if (!buffer->error)
+		push_pages(inode->i_mapping, NULL, next << shift,
+			((next + 1) << shift) - 1, buffer, 0, buffer->length,
+			0);
+	squashfs_cache_put(buffer);
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
 	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
-	int bytes, i, offset = 0, sparse = 0;
+	int bytes, offset = 0, sparse = 0;
 	struct squashfs_cache_entry *buffer = NULL;
 	void *pageaddr;
 
@@ -442,43 +530,15 @@ static int squashfs_readpage(struct file *file, struct page *page)
 		offset = squashfs_i(inode)->fragment_offset;
 	}
 
-	/*
-	 * Loop copying datablock into pages.  As the datablock likely covers
-	 * many PAGE_CACHE_SIZE pages (default block size is 128 KiB) explicitly
-	 * grab the pages from the page cache, except for the page that we've
-	 * been called to fill.
-	 */
-	for (i = start_index; i <= end_index && bytes > 0; i++,
-			bytes -= PAGE_CACHE_SIZE, offset += PAGE_CACHE_SIZE) {
-		struct page *push_page;
-		int avail = sparse ? 0 : min_t(int, bytes, PAGE_CACHE_SIZE);
-
-		TRACE("bytes %d, i %d, available_bytes %d\n", bytes, i, avail);
-
-		push_page = (i == page->index) ? page :
-			grab_cache_page_nowait(page->mapping, i);
-
-		if (!push_page)
-			continue;
-
-		if (PageUptodate(push_page))
-			goto skip_page;
-
-		pageaddr = kmap_atomic(push_page, KM_USER0);
-		squashfs_copy_data(pageaddr, buffer, offset, avail);
-		memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
-		kunmap_atomic(pageaddr, KM_USER0);
-		flush_dcache_page(push_page);
-		SetPageUptodate(push_page);
-skip_page:
-		unlock_page(push_page);
-		if (i != page->index)
-			page_cache_release(push_page);
-	}
+	push_pages(page->mapping, page, start_index, end_index, buffer,
+		offset, bytes, sparse);
 
 	if (!sparse)
 		squashfs_cache_put(buffer);
 
+	if (index < file_end)
+		readahead_block(inode, index);
+
 	return 0;
 
 error_out:
@@ -180,6 +180,7 @@ int squashfs_read_inode(struct inode *inode, long long ino)
 		squashfs_i(inode)->fragment_offset = frag_offset;
 		squashfs_i(inode)->start = le32_to_cpu(sqsh_ino->start_block);
 		squashfs_i(inode)->block_list_start = block;
+		squashfs_i(inode)->next_block = -1;
 		squashfs_i(inode)->offset = offset;
 		inode->i_data.a_ops = &squashfs_aops;
 
@@ -231,6 +232,7 @@ int squashfs_read_inode(struct inode *inode, long long ino)
 		squashfs_i(inode)->fragment_offset = frag_offset;
 		squashfs_i(inode)->start = le64_to_cpu(sqsh_ino->start_block);
 		squashfs_i(inode)->block_list_start = block;
+		squashfs_i(inode)->next_block = -1;
 		squashfs_i(inode)->offset = offset;
 		inode->i_data.a_ops = &squashfs_aops;
 
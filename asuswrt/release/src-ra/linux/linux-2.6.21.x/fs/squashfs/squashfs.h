@@ -57,12 +57,16 @@ extern struct squashfs_cache_entry *squashfs_cache_get(struct super_block *,
 				struct squashfs_cache *, u64, int);
 extern void squashfs_cache_put(struct squashfs_cache_entry *);
 extern int squashfs_copy_data(void *, struct squashfs_cache_entry *, int, int);
+extern void squashfs_cache_proc_init(void);
+extern void squashfs_cache_proc_exit(void);
 extern int squashfs_read_metadata(struct super_block *, void *, u64 *,
 				int *, int);
 extern struct squashfs_cache_entry *squashfs_get_fragment(struct super_block *,
 				u64, int);
 extern struct squashfs_cache_entry *squashfs_get_datablock(struct super_block *,
 				u64, int);
+extern struct squashfs_cache_entry *squashfs_readahead_datablock(
+				struct super_block *, u64, int);
 extern void *squashfs_read_table(struct super_block *, u64, int);
 
 /* decompressor.c */
@@ -24,6 +24,11 @@
  */
 
 #define SQUASHFS_CACHED_FRAGMENTS	CONFIG_SQUASHFS_FRAGMENT_CACHE_SIZE
+#if defined(CONFIG_SQUASHFS_DATA_CACHE_SIZE) && CONFIG_SQUASHFS_DATA_CACHE_SIZE > 1
+#define SQUASHFS_CACHED_DATA		CONFIG_SQUASHFS_DATA_CACHE_SIZE
+#else
+#define SQUASHFS_CACHED_DATA		1
+#endif
 #define SQUASHFS_MAJOR			4
 #define SQUASHFS_MINOR			0
 #define SQUASHFS_MAGIC			0x73717368
@@ -37,6 +37,7 @@ struct squashfs_inode_info {
 			int		fragment_size;
 			int		fragment_offset;
 			u64		block_list_start;
+			int		next_block;
 		};
 		struct {
 			u64		dir_idx_start;
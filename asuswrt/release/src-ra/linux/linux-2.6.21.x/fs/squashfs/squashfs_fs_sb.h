@@ -37,6 +37,11 @@ struct squashfs_cache {
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
+	struct list_head	list;
+	unsigned long		hits;
+	unsigned long		misses;
+	unsigned long		readahead;
+	u64			read_usecs;
 };
 
 struct squashfs_cache_entry {
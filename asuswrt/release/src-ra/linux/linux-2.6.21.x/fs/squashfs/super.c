@@ -202,7 +202,8 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto failed_mount;
 
 	/* Allocate read_page block */
-	msblk->read_page = squashfs_cache_init("data", 1, msblk->block_size);
+	msblk->read_page = squashfs_cache_init("data", SQUASHFS_CACHED_DATA,
+		msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -467,6 +468,8 @@ static int __init init_squashfs_fs(void)
 		return err;
 	}
 
+	squashfs_cache_proc_init();
+
 	printk(KERN_INFO "squashfs: version 4.0 (2009/01/31) "
 		"Phillip Lougher\n");
 
@@ -476,6 +479,7 @@ static int __init init_squashfs_fs(void)
 
 static void __exit exit_squashfs_fs(void)
 {
+	squashfs_cache_proc_exit();
 	unregister_filesystem(&squashfs_fs_type);
 	destroy_inodecache();
 }
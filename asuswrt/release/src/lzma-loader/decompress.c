@@ -81,32 +81,47 @@ static __inline__ void blast_dcache(unsigned long size, unsigned long lsize)
 /* beyound the image end, size not known in advance */
 extern unsigned char workspace[];
 
-static unsigned int offset;
 static unsigned char *data;
 
-/* flash access should be aligned, so wrapper is used */
-/* read byte from the flash, all accesses are 32-bit aligned */
+/* input window; the decoder is handed all of it at once instead of
+ * calling back for every byte */
+#define INBUF_SIZE		4096
+
+static unsigned int inbuf[INBUF_SIZE / 4];
+static unsigned int inpos = INBUF_SIZE;
+
+/* flash access should be aligned, so words are copied to the window */
+static void fill(void)
+{
+	unsigned int *src = (unsigned int *)data;
+	unsigned int i;
+
+	for (i = 0; i < INBUF_SIZE / 4; i++)
+		inbuf[i] = src[i];
+
+	data += INBUF_SIZE;
+	inpos = 0;
+}
+
+/* hand the unread rest of the window to the decoder */
 static int read_byte(void *object, const unsigned char **buffer, UInt32 *bufferSize)
 {
-	static unsigned int val;
+	if (inpos >= INBUF_SIZE)
+		fill();
+
+	*bufferSize = INBUF_SIZE - inpos;
+	*buffer = (unsigned char *)inbuf + inpos;
+	inpos = INBUF_SIZE;
 
-	if (((unsigned int)offset % 4) == 0) {
-		val = *(unsigned int *)data;
-		data += 4;
-	}
-	
-	*bufferSize = 1;
-	*buffer = ((unsigned char *)&val) + (offset++ & 3);
-	
 	return LZMA_RESULT_OK;
 }
 
 static __inline__ unsigned char get_byte(void)
 {
-	const unsigned char *buffer;
-	UInt32 fake;
-	
-	return read_byte(NULL, &buffer, &fake), *buffer;
+	if (inpos >= INBUF_SIZE)
+		fill();
+
+	return ((unsigned char *)inbuf)[inpos++];
 }
 
 /* should be the first function */
@@ -128,7 +143,7 @@ void entry(unsigned long icache_size, unsigned long icache_lsize,
 	
 	/* compressed kernel is in the partition 1 */
 	data += ((struct trx_header *)data)->offsets[1];
-	offset = 0;
+	inpos = INBUF_SIZE;
 
 	/* lzma args */
 	i = get_byte();
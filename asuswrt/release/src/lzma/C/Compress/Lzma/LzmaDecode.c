@@ -307,16 +307,22 @@ int LzmaDecode(CLzmaDecoderState *vs,
         #else
         matchByte = outStream[nowPos - rep0];
         #endif
-        do
+        /* offs drops to 0 at the first mismatch with matchByte, after
+           which prob + offs + bit + symbol selects the plain literal
+           probabilities, so the loop runs to the end without a break */
         {
-          int bit;
-          CProb *probLit;
-          matchByte <<= 1;
-          bit = (matchByte & 0x100);
-          probLit = prob + 0x100 + bit + symbol;
-          RC_GET_BIT2(probLit, symbol, if (bit != 0) break, if (bit == 0) break)
+          int offs = 0x100;
+          do
+          {
+            int bit;
+            CProb *probLit;
+            matchByte <<= 1;
+            bit = (matchByte & offs);
+            probLit = prob + offs + bit + symbol;
+            RC_GET_BIT2(probLit, symbol, offs &= ~bit, offs &= bit)
+          }
+          while (symbol < 0x100);
         }
-        while (symbol < 0x100);
       }
       while (symbol < 0x100)
       {
@@ -269,6 +269,7 @@ int main(int argc, char* const argv[])
 	signal(SIGCHLD, wait_child);
 
 	// Main loop
+	relayd_flush_routes();
 	while (!do_stop) {
 		struct epoll_event ev[16];
 		int len = epoll_wait(epoll, ev, 16, -1);
@@ -279,6 +280,9 @@ int main(int argc, char* const argv[])
 			else if (event->handle_dgram)
 				relayd_receive_packets(event);
 		}
+
+		// Route changes made while handling these events
+		relayd_flush_routes();
 	}
 
 	syslog(LOG_WARNING, "Termination requested by signal.");
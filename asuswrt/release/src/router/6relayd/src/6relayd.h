@@ -44,6 +44,7 @@
 
 
 struct relayd_interface;
+struct assignment;
 
 struct relayd_event {
 	int socket;
@@ -72,8 +73,12 @@ struct relayd_interface {
 
 	// IPv6 PD
 	struct list_head pd_assignments;
+	struct assignment *pd_border;
+	struct list_head *pd_hash;
+	uint32_t *pd_na_used;
 	struct relayd_ipaddr pd_addr[8];
 	size_t pd_addr_len;
+	time_t pd_update;
 	bool pd_reconf;
 };
 
@@ -129,6 +134,7 @@ void relayd_urandom(void *data, size_t len);
 void relayd_setup_route(const struct in6_addr *addr, int prefixlen,
 		const struct relayd_interface *iface, const struct in6_addr *gw,
 		int metric, bool add);
+void relayd_flush_routes(void);
 time_t relayd_monotonic_time(void);
 
 
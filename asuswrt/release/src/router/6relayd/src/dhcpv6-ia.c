@@ -29,9 +29,17 @@
 #include <sys/syscall.h>
 #include <sys/timerfd.h>
 
+#define IA_HASH_SIZE 64		// Buckets of the per-interface DUID hash
+#define IA_NA_FIRST 0x100	// Dynamic IA_NA host IDs: [IA_NA_FIRST, IA_NA_LAST)
+#define IA_NA_LAST 0x0fff
+#define IA_NA_WORDS ((IA_NA_LAST + 32) / 32)
+#define IA_REFRESH 10		// Reread interface addresses at least every 10s
+#define STATEFILE_SLACK 64	// Appended records tolerated on top of the live ones
+
 
 struct assignment {
 	struct list_head head;
+	struct list_head hash;
 	struct sockaddr_in6 peer;
 	time_t valid_until;
 	time_t reconf_sent;
@@ -53,6 +61,64 @@ static void reconf_timer(struct relayd_event *event);
 static struct relayd_event reconf_event = {-1, reconf_timer, NULL};
 static int socket_fd = -1;
 static uint32_t serial = 0;
+static size_t state_bindings = 0;
+static size_t state_appended = 0;
+static bool state_rewrite = true;
+
+
+static struct list_head* ia_bucket(struct relayd_interface *iface,
+		const uint8_t *clid_data, size_t clid_len)
+{
+	uint32_t hash = 2166136261U;
+	for (size_t i = 0; i < clid_len; ++i)
+		hash = (hash ^ clid_data[i]) * 16777619U;
+	return &iface->pd_hash[hash % IA_HASH_SIZE];
+}
+
+
+static void ia_hash_add(struct relayd_interface *iface, struct assignment *a)
+{
+	list_add_tail(&a->hash, ia_bucket(iface, a->clid_data, a->clid_len));
+	++state_bindings;
+}
+
+
+static void ia_hash_del(struct assignment *a)
+{
+	if (!list_empty(&a->hash)) {
+		list_del_init(&a->hash);
+		--state_bindings;
+	}
+}
+
+
+static bool na_used(struct relayd_interface *iface, uint32_t id)
+{
+	return id < IA_NA_WORDS * 32 && (iface->pd_na_used[id / 32] & (1U << (id % 32)));
+}
+
+
+static void na_mark(struct relayd_interface *iface, uint32_t id, bool used)
+{
+	if (id >= IA_NA_WORDS * 32)
+		return;
+
+	if (used)
+		iface->pd_na_used[id / 32] |= 1U << (id % 32);
+	else
+		iface->pd_na_used[id / 32] &= ~(1U << (id % 32));
+}
+
+
+static void free_assignment(struct relayd_interface *iface, struct assignment *a)
+{
+	list_del(&a->head);
+	ia_hash_del(a);
+	if (a->length == 128)
+		na_mark(iface, a->assigned, false);
+	free(a->hostname);
+	free(a);
+}
 
 
 
@@ -81,9 +147,22 @@ int dhcpv6_init_ia(const struct relayd_config *relayd_config, int dhcpv6_socket)
 		struct relayd_interface *iface = &config->slaves[i];
 
 		INIT_LIST_HEAD(&iface->pd_assignments);
+		iface->pd_hash = malloc(IA_HASH_SIZE * sizeof(*iface->pd_hash));
+		iface->pd_na_used = calloc(IA_NA_WORDS, sizeof(*iface->pd_na_used));
+		if (!iface->pd_hash || !iface->pd_na_used) {
+			syslog(LOG_ERR, "Failed to allocate assignment pool: %s", strerror(errno));
+			return -1;
+		}
+
+		for (size_t j = 0; j < IA_HASH_SIZE; ++j)
+			INIT_LIST_HEAD(&iface->pd_hash[j]);
+
+		// PD assignments are kept sorted in front of the border, NAs behind it
 		struct assignment *border = calloc(1, sizeof(*border));
 		border->length = 64;
+		INIT_LIST_HEAD(&border->hash);
 		list_add(&border->head, &iface->pd_assignments);
+		iface->pd_border = border;
 	}
 
 	for (size_t i = 0; i < config->slavecount; ++i)
@@ -116,16 +195,21 @@ int dhcpv6_init_ia(const struct relayd_config *relayd_config, int dhcpv6_socket)
 		struct assignment *c;
 		for (size_t j = 0; j < config->slavecount; ++j) {
 			struct relayd_interface *iface = &config->slaves[j];
-			list_for_each_entry(c, &iface->pd_assignments, head) {
-				if (c->length != 128 || c->assigned > a->assigned) {
-					struct assignment *n = malloc(sizeof(*a) + duidlen);
-					memcpy(n, a, sizeof(*a) + duidlen);
-					list_add_tail(&n->head, &c->head);
-				} else if (c->assigned == a->assigned) {
-					// Already an assignment with that number
-					break;
-				}
-			}
+			bool taken = na_used(iface, a->assigned);
+			if (a->assigned >= IA_NA_WORDS * 32)
+				list_for_each_entry(c, &iface->pd_assignments, head)
+					if (c->length == 128 && c->assigned == a->assigned)
+						taken = true;
+
+			// Already an assignment with that number
+			if (taken)
+				continue;
+
+			struct assignment *n = malloc(sizeof(*a) + duidlen);
+			memcpy(n, a, sizeof(*a) + duidlen);
+			list_add_tail(&n->head, &iface->pd_assignments);
+			ia_hash_add(iface, n);
+			na_mark(iface, n->assigned, true);
 		}
 
 
@@ -200,73 +284,97 @@ static int send_reconf(struct relayd_interface *iface, struct assignment *assign
 }
 
 
-static void write_statefile(void)
+static void write_assignment(FILE *fp, struct relayd_interface *iface,
+		struct assignment *c, time_t now, time_t wall_time)
+{
+	char ipbuf[INET6_ADDRSTRLEN];
+	char leasebuf[512];
+	char duidbuf[264];
+	const char hex[] = "0123456789abcdef";
+
+	for (size_t i = 0; i < c->clid_len; ++i) {
+		duidbuf[2 * i] = hex[(c->clid_data[i] >> 4) & 0x0f];
+		duidbuf[2 * i + 1] = hex[c->clid_data[i] & 0x0f];
+	}
+	duidbuf[c->clid_len * 2] = 0;
+
+	// iface DUID iaid hostname lifetime assigned length [addrs...]
+	int l = snprintf(leasebuf, sizeof(leasebuf), "# %s %s %x %s %u %x %u ",
+			iface->ifname, duidbuf, ntohl(c->iaid),
+			(c->hostname ? c->hostname : "-"),
+			(unsigned)(c->valid_until > now ?
+					(c->valid_until - now + wall_time) : 0),
+			c->assigned, (unsigned)c->length);
+
+	struct in6_addr addr;
+	for (size_t i = 0; i < iface->pd_addr_len; ++i) {
+		if (iface->pd_addr[i].prefix > 64)
+			continue;
+
+		addr = iface->pd_addr[i].addr;
+		if (c->length == 128)
+			addr.s6_addr32[3] = htonl(c->assigned);
+		else
+			addr.s6_addr32[1] |= htonl(c->assigned);
+		inet_ntop(AF_INET6, &addr, ipbuf, sizeof(ipbuf) - 1);
+
+		if (c->length == 128 && c->hostname && i == 0)
+			fprintf(fp, "%s\t%s\n", ipbuf, c->hostname);
+
+		l += snprintf(leasebuf + l, sizeof(leasebuf) - l, "%s/%hhu ", ipbuf, c->length);
+	}
+	leasebuf[l - 1] = '\n';
+	fwrite(leasebuf, 1, l, fp);
+}
+
+
+// Append records for the changed assignments of iface to the statefile.
+// A later record for the same interface, DUID, IAID and length supersedes
+// earlier ones. The file is rewritten from scratch instead if changed is
+// NULL or once the appended records outnumber the live ones.
+static void write_statefile(struct relayd_interface *iface,
+		struct assignment **changed, size_t changed_len)
 {
 	if (config->dhcpv6_statefile) {
 		time_t now = relayd_monotonic_time(), wall_time = time(NULL);
-		int fd = open(config->dhcpv6_statefile, O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+		bool rewrite = !changed || state_rewrite ||
+				state_appended + changed_len > state_bindings + STATEFILE_SLACK;
+		int fd = open(config->dhcpv6_statefile, O_CREAT | O_WRONLY | O_CLOEXEC |
+				(rewrite ? 0 : O_APPEND), 0644);
 		if (fd < 0) {
 			return;
 		}
 		lockf(fd, F_LOCK, 0);
-		ftruncate(fd, 0);
+		if (rewrite)
+			ftruncate(fd, 0);
 
-		FILE *fp = fdopen(fd, "w");
+		FILE *fp = fdopen(fd, (rewrite) ? "w" : "a");
 		if (!fp) {
 			close(fd);
 			return;
 		}
 
-		for (size_t i = 0; i < config->slavecount; ++i) {
-			struct relayd_interface *iface = &config->slaves[i];
-
-			struct assignment *c;
-			list_for_each_entry(c, &iface->pd_assignments, head) {
-				if (c->clid_len == 0)
-					continue;
-
-				char ipbuf[INET6_ADDRSTRLEN];
-				char leasebuf[512];
-				char duidbuf[264];
-				const char hex[] = "0123456789abcdef";
-
-				for (size_t i = 0; i < c->clid_len; ++i) {
-					duidbuf[2 * i] = hex[(c->clid_data[i] >> 4) & 0x0f];
-					duidbuf[2 * i + 1] = hex[c->clid_data[i] & 0x0f];
-				}
-				duidbuf[c->clid_len * 2] = 0;
-
-				// iface DUID iaid hostname lifetime assigned length [addrs...]
-				int l = snprintf(leasebuf, sizeof(leasebuf), "# %s %s %x %s %u %x %u ",
-						iface->ifname, duidbuf, ntohl(c->iaid),
-						(c->hostname ? c->hostname : "-"),
-						(unsigned)(c->valid_until > now ?
-								(c->valid_until - now + wall_time) : 0),
-						c->assigned, (unsigned)c->length);
-
-				struct in6_addr addr;
-				for (size_t i = 0; i < iface->pd_addr_len; ++i) {
-					if (iface->pd_addr[i].prefix > 64)
-						continue;
+		if (rewrite) {
+			for (size_t i = 0; i < config->slavecount; ++i) {
+				struct relayd_interface *iface = &config->slaves[i];
 
-					addr = iface->pd_addr[i].addr;
-					if (c->length == 128)
-						addr.s6_addr32[3] = htonl(c->assigned);
-					else
-						addr.s6_addr32[1] |= htonl(c->assigned);
-					inet_ntop(AF_INET6, &addr, ipbuf, sizeof(ipbuf) - 1);
+				struct assignment *c;
+				list_for_each_entry(c, &iface->pd_assignments, head)
+					if (c->clid_len > 0)
+						write_assignment(fp, iface, c, now, wall_time);
+			}
 
-					if (c->length == 128 && c->hostname && i == 0)
-						fprintf(fp, "%s\t%s\n", ipbuf, c->hostname);
+			state_appended = 0;
+			state_rewrite = false;
+		} else {
+			for (size_t i = 0; i < changed_len; ++i)
+				write_assignment(fp, iface, changed[i], now, wall_time);
 
-					l += snprintf(leasebuf + l, sizeof(leasebuf) - l, "%s/%hhu ", ipbuf, c->length);
-				}
-				leasebuf[l - 1] = '\n';
-				fwrite(leasebuf, 1, l, fp);
-			}
+			state_appended += changed_len;
 		}
 
-		fclose(fp);
+		if (fclose(fp))
+			state_rewrite = true;
 	}
 
 	if (config->dhcpv6_cb) {
@@ -298,19 +406,19 @@ static bool assign_pd(struct relayd_interface *iface, struct assignment *assign)
 	if (iface->pd_addr_len < 1)
 		return false;
 
-	// Try honoring the hint first
+	// Try honoring the hint first, only the PDs up to the border matter
 	uint32_t current = 1, asize = (1 << (64 - assign->length)) - 1;
 	if (assign->assigned) {
 		list_for_each_entry(c, &iface->pd_assignments, head) {
-			if (c->length == 128)
-				continue;
-
 			if (assign->assigned >= current && assign->assigned + asize < c->assigned) {
 				list_add_tail(&assign->head, &c->head);
 				apply_lease(iface, assign, true);
 				return true;
 			}
 
+			if (c == iface->pd_border)
+				break;
+
 			if (c->assigned != 0)
 				current = (c->assigned + (1 << (64 - c->length)));
 		}
@@ -319,9 +427,6 @@ static bool assign_pd(struct relayd_interface *iface, struct assignment *assign)
 	// Fallback to a variable assignment
 	current = 1;
 	list_for_each_entry(c, &iface->pd_assignments, head) {
-		if (c->length == 128)
-			continue;
-
 		current = (current + asize) & (~asize);
 		if (current + asize < c->assigned) {
 			assign->assigned = current;
@@ -330,6 +435,9 @@ static bool assign_pd(struct relayd_interface *iface, struct assignment *assign)
 			return true;
 		}
 
+		if (c == iface->pd_border)
+			break;
+
 		if (c->assigned != 0)
 			current = (c->assigned + (1 << (64 - c->length)));
 	}
@@ -350,23 +458,28 @@ static bool assign_na(struct relayd_interface *iface, struct assignment *assign)
 	srand(seed);
 
 	// Try to assign up to 100x
-	for (size_t i = 0; i < 100; ++i) {
-		uint32_t try;
-		do try = ((uint32_t)rand()) % 0x0fff; while (try < 0x100);
+	uint32_t try = 0;
+	for (size_t i = 0; i < 100 && !try; ++i) {
+		do try = ((uint32_t)rand()) % IA_NA_LAST; while (try < IA_NA_FIRST);
+		if (na_used(iface, try))
+			try = 0;
+	}
 
-		struct assignment *c;
-		list_for_each_entry(c, &iface->pd_assignments, head) {
-			if (c->assigned > try || c->length != 128) {
-				assign->assigned = try;
-				list_add_tail(&assign->head, &c->head);
-				return true;
-			} else if (c->assigned == try) {
-				break;
-			}
-		}
+	// Pool is crowded, take the first free host ID
+	for (uint32_t id = IA_NA_FIRST; id < IA_NA_LAST && !try; ++id) {
+		if (iface->pd_na_used[id / 32] == UINT32_MAX)
+			id |= 31;
+		else if (!na_used(iface, id))
+			try = id;
 	}
 
-	return false;
+	if (!try)
+		return false;
+
+	assign->assigned = try;
+	list_add_tail(&assign->head, &iface->pd_assignments);
+	na_mark(iface, try, true);
+	return true;
 }
 
 
@@ -392,6 +505,7 @@ static void update(struct relayd_interface *iface)
 
 	time_t now = relayd_monotonic_time();
 	int minprefix = -1;
+	iface->pd_update = now;
 
 	for (int i = 0; i < len; ++i) {
 		if (addr[i].prefix > minprefix)
@@ -407,7 +521,7 @@ static void update(struct relayd_interface *iface)
 			addr[i].valid += now;
 	}
 
-	struct assignment *border = list_last_entry(&iface->pd_assignments, struct assignment, head);
+	struct assignment *border = iface->pd_border;
 	border->assigned = 1 << (64 - minprefix);
 
 	bool change = len != (int)iface->pd_addr_len;
@@ -448,7 +562,7 @@ static void update(struct relayd_interface *iface)
 
 				// Leave all other assignments of that client alone
 				struct assignment *a;
-				list_for_each_entry(a, &iface->pd_assignments, head)
+				list_for_each_entry(a, ia_bucket(iface, c->clid_data, c->clid_len), hash)
 					if (a != c && a->clid_len == c->clid_len &&
 							!memcmp(a->clid_data, c->clid_data, a->clid_len))
 						c->reconf_cnt = INT_MAX;
@@ -464,7 +578,7 @@ static void update(struct relayd_interface *iface)
 			}
 		}
 
-		write_statefile();
+		write_statefile(NULL, NULL, 0);
 	}
 }
 
@@ -486,11 +600,8 @@ static void reconf_timer(struct relayd_event *event)
 		list_for_each_entry_safe(a, n, &iface->pd_assignments, head) {
 			if (a->valid_until < now) {
 				if ((a->length < 128 && a->clid_len > 0) ||
-						(a->length == 128 && a->clid_len == 0)) {
-					list_del(&a->head);
-					free(a->hostname);
-					free(a);
-				}
+						(a->length == 128 && a->clid_len == 0))
+					free_assignment(iface, a);
 			} else if (a->reconf_cnt > 0 && a->reconf_cnt < 8 &&
 					now > a->reconf_sent + (1 << a->reconf_cnt)) {
 				++a->reconf_cnt;
@@ -719,7 +830,12 @@ size_t dhcpv6_handle_ia(uint8_t *buf, size_t buflen, struct relayd_interface *if
 	if (!clid_data || !clid_len || clid_len > 130)
 		goto out;
 
-	update(iface);
+	if (iface->pd_reconf || now - iface->pd_update >= IA_REFRESH)
+		update(iface);
+
+	// Assignments to be appended to the statefile, if too many rewrite it
+	struct assignment *changed[8];
+	size_t changed_len = 0;
 	bool update_state = false;
 
 	struct assignment *first = NULL;
@@ -757,7 +873,7 @@ size_t dhcpv6_handle_ia(uint8_t *buf, size_t buflen, struct relayd_interface *if
 
 		// Find assignment
 		struct assignment *c, *a = NULL;
-		list_for_each_entry(c, &iface->pd_assignments, head) {
+		list_for_each_entry(c, ia_bucket(iface, clid_data, clid_len), hash) {
 			if (c->clid_len == clid_len && !memcmp(c->clid_data, clid_data, clid_len) &&
 					(c->iaid == ia->iaid || c->valid_until < now) &&
 					((is_pd && c->length <= 64) || (is_na && c->length == 128))) {
@@ -790,11 +906,15 @@ size_t dhcpv6_handle_ia(uint8_t *buf, size_t buflen, struct relayd_interface *if
 				else
 					relayd_urandom(a->key, sizeof(a->key));
 				memcpy(a->clid_data, clid_data, clid_len);
+				INIT_LIST_HEAD(&a->hash);
 
 				if (is_pd)
 					while (!(assigned = assign_pd(iface, a)) && ++a->length <= 64);
 				else
 					assigned = assign_na(iface, a);
+
+				if (assigned)
+					ia_hash_add(iface, a);
 			}
 
 			if (!assigned || iface->pd_addr_len == 0) { // Set error status
@@ -840,7 +960,10 @@ size_t dhcpv6_handle_ia(uint8_t *buf, size_t buflen, struct relayd_interface *if
 				}
 				a->accept_reconf = accept_reconf;
 				apply_lease(iface, a, true);
-				update_state = true;
+				if (changed_len < ARRAY_SIZE(changed))
+					changed[changed_len++] = a;
+				else
+					update_state = true;
 			} else if (!assigned && a) { // Cleanup failed assignment
 				free(a->hostname);
 				free(a);
@@ -860,8 +983,12 @@ size_t dhcpv6_handle_ia(uint8_t *buf, size_t buflen, struct relayd_interface *if
 			} else if (hdr->msg_type == DHCPV6_MSG_RELEASE) {
 				a->valid_until = 0;
 				apply_lease(iface, a, false);
-				update_state = true;
+				if (changed_len < ARRAY_SIZE(changed))
+					changed[changed_len++] = a;
+				else
+					update_state = true;
 			} else if (hdr->msg_type == DHCPV6_MSG_DECLINE && a->length == 128) {
+				ia_hash_del(a);
 				a->clid_len = 0;
 				a->valid_until = now + 3600; // Block address for 1h
 				update_state = true;
@@ -888,7 +1015,9 @@ size_t dhcpv6_handle_ia(uint8_t *buf, size_t buflen, struct relayd_interface *if
 	}
 
 	if (update_state)
-		write_statefile();
+		write_statefile(NULL, NULL, 0);
+	else if (changed_len > 0)
+		write_statefile(iface, changed, changed_len);
 
 out:
 	return response_len;
@@ -43,6 +43,8 @@ static void handle_rtnetlink(void *addr, void *data, size_t len,
 		struct relayd_interface *iface);
 static struct ndp_neighbor* find_neighbor(struct in6_addr *addr,
 		struct relayd_interface *iface, uint8_t strict);
+static struct list_head* neighbor_bucket(const struct in6_addr *addr);
+static void free_neighbor(struct ndp_neighbor *n);
 static void modify_neighbor(struct in6_addr *addr, struct relayd_interface *iface,
 		bool add, bool is_addr);
 static ssize_t send_solicit(struct in6_addr *addr,
@@ -52,11 +54,18 @@ static ssize_t send_advert(struct in6_addr *addr, struct in6_addr *source,
 static ssize_t ping6(struct in6_addr *addr,
 		const struct relayd_interface *iface);
 
-static struct list_head neighbors = LIST_HEAD_INIT(neighbors);
-static struct list_head addresses = LIST_HEAD_INIT(addresses);
+// Neighbors and own addresses by address, static prefixes in a list
+static struct list_head neighbor_hash[NDP_HASH_SIZE];
+static struct list_head prefixes = LIST_HEAD_INIT(prefixes);
+// Pending neighbors, oldest first
+static struct list_head pending = LIST_HEAD_INIT(pending);
 static size_t neighbor_count = 0;
 static uint32_t rtnl_seqid = 0;
 
+// Route changes to be sent to the kernel in one go
+static uint8_t rtnl_batch[RELAYD_BUFFER_SIZE];
+static size_t rtnl_batch_len = 0;
+
 static int ping_socket = -1;
 static struct relayd_event ndp_event_solicit = {-1, NULL, handle_neighbor};
 static struct relayd_event rtnl_event = {-1, NULL, handle_rtnetlink};
@@ -82,6 +91,9 @@ static const struct sock_fprog bpf_prog = {sizeof(bpf) / sizeof(*bpf), bpf};
 int init_ndp_proxy(const struct relayd_config *relayd_config)
 {
 	config = relayd_config;
+	for (size_t i = 0; i < NDP_HASH_SIZE; ++i)
+		INIT_LIST_HEAD(&neighbor_hash[i]);
+
 	if (config->slavecount < 1)
 		return 0;
 
@@ -119,6 +131,8 @@ int init_ndp_proxy(const struct relayd_config *relayd_config)
 	for (size_t i = 0; i < config->static_ndp_len; ++i) {
 		struct ndp_neighbor *n = malloc(sizeof(*n));
 		n->timeout = 0;
+		n->is_addr = false;
+		INIT_LIST_HEAD(&n->pending);
 
 		char ipbuf[INET6_ADDRSTRLEN];
 		char iface[16];
@@ -130,7 +144,9 @@ int init_ndp_proxy(const struct relayd_config *relayd_config)
 			return -1;
 		}
 
-		list_add(&n->head, &neighbors);
+		list_add(&n->head, (n->len == 128) ?
+				neighbor_bucket(&n->addr) : &prefixes);
+		++neighbor_count;
 	}
 
 #if defined(SOCK_CLOEXEC) && defined(SOCK_NONBLOCK)
@@ -213,6 +229,7 @@ int init_ndp_proxy(const struct relayd_config *relayd_config)
 	send(rtnl_event.socket, &req, sizeof(req), MSG_DONTWAIT);
 
 	relayd_receive_packets(&rtnl_event);
+	relayd_flush_routes();
 
 	return 0;
 }
@@ -221,16 +238,16 @@ int init_ndp_proxy(const struct relayd_config *relayd_config)
 // Deinitialize NDP proxy
 void deinit_ndp_proxy()
 {
-	while (!list_empty(&neighbors)) {
-		struct ndp_neighbor *c = list_first_entry(&neighbors,
-				struct ndp_neighbor, head);
-		modify_neighbor(&c->addr, c->iface, false, c->is_addr);
-	}
-	while (!list_empty(&addresses)) {
-		struct ndp_neighbor *c = list_first_entry(&addresses,
-				struct ndp_neighbor, head);
-		modify_neighbor(&c->addr, c->iface, false, c->is_addr);
-	}
+	for (size_t i = 0; i < NDP_HASH_SIZE; ++i)
+		while (!list_empty(&neighbor_hash[i]))
+			free_neighbor(list_first_entry(&neighbor_hash[i],
+					struct ndp_neighbor, head));
+
+	while (!list_empty(&prefixes))
+		free_neighbor(list_first_entry(&prefixes,
+				struct ndp_neighbor, head));
+
+	relayd_flush_routes();
 }
 
 
@@ -371,7 +388,7 @@ static void handle_solicit(void *addr, void *data, size_t len,
 	time_t now = relayd_monotonic_time();
 
 	struct ndp_neighbor *n = find_neighbor(&req->nd_ns_target, iface, 0);
-	if (n && (n->iface || abs(n->timeout - now) < 5)) {
+	if (n && (n->iface || now - n->timeout < NDP_PENDING_TIMEOUT)) {
 		syslog(LOG_NOTICE, "%s is on %s", ipbuf,
 				(n->iface) ? n->iface->ifname : "<pending>");
 		if (!n->iface || n->iface == iface ||
@@ -506,7 +523,23 @@ void relayd_setup_route(const struct in6_addr *addr, int prefixlen,
 	}
 
 	req.nh.nlmsg_len = (gw) ? sizeof(req) : offsetof(struct req, rta_gw);
-	send(rtnl_event.socket, &req, req.nh.nlmsg_len, MSG_DONTWAIT);
+
+	// Queue it, the kernel handles all messages of a batch in order
+	if (rtnl_batch_len + NLMSG_ALIGN(req.nh.nlmsg_len) > sizeof(rtnl_batch))
+		relayd_flush_routes();
+
+	memcpy(&rtnl_batch[rtnl_batch_len], &req, req.nh.nlmsg_len);
+	rtnl_batch_len += NLMSG_ALIGN(req.nh.nlmsg_len);
+}
+
+
+// Send queued route changes
+void relayd_flush_routes(void)
+{
+	if (rtnl_batch_len > 0)
+		send(rtnl_event.socket, rtnl_batch, rtnl_batch_len, MSG_DONTWAIT);
+
+	rtnl_batch_len = 0;
 }
 
 // Use rtnetlink to modify kernel routes
@@ -528,11 +561,38 @@ static void free_neighbor(struct ndp_neighbor *n)
 {
 	setup_route(&n->addr, n->iface, false, n->is_addr);
 	list_del(&n->head);
+	list_del(&n->pending);
 	free(n);
 	--neighbor_count;
 }
 
 
+static struct list_head* neighbor_bucket(const struct in6_addr *addr)
+{
+	// Privacy addresses of a host only differ in the interface-ID
+	uint32_t h = addr->s6_addr32[0] ^ addr->s6_addr32[1] ^
+			addr->s6_addr32[2] ^ addr->s6_addr32[3];
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+	return &neighbor_hash[h & (NDP_HASH_SIZE - 1)];
+}
+
+
+// Drop pending neighbors that did not show up in time
+static void expire_pending(time_t now)
+{
+	while (!list_empty(&pending)) {
+		struct ndp_neighbor *n = list_first_entry(&pending,
+				struct ndp_neighbor, pending);
+		if (now - n->timeout < NDP_PENDING_TIMEOUT)
+			break;
+
+		free_neighbor(n);
+	}
+}
+
+
 static bool match_neighbor(struct ndp_neighbor *n, struct in6_addr *addr)
 {
 	if (n->len <= 32)
@@ -564,12 +624,14 @@ static bool match_neighbor(struct ndp_neighbor *n, struct in6_addr *addr)
 static struct ndp_neighbor* find_neighbor(struct in6_addr *addr,
 		struct relayd_interface *iface, uint8_t strict)
 {
-	time_t now = relayd_monotonic_time();
+	struct list_head *bucket = neighbor_bucket(addr);
 	struct ndp_neighbor *n, *e = NULL;
 
+	expire_pending(relayd_monotonic_time());
+
 	if (!strict || (strict & NDP_F_ADDR))
-	list_for_each_entry(n, &addresses, head) {
-		if (n->len == 128 && IN6_ARE_ADDR_EQUAL(&n->addr, addr)) {
+	list_for_each_entry(n, bucket, head) {
+		if (n->is_addr && IN6_ARE_ADDR_EQUAL(&n->addr, addr)) {
 			if (n->iface == iface)
 				return n;
 			else if (!e)
@@ -579,14 +641,15 @@ static struct ndp_neighbor* find_neighbor(struct in6_addr *addr,
 	if (e)
 		return e;
 
-	if (!strict || (strict & NDP_F_NEIGH))
-	list_for_each_entry_safe(n, e, &neighbors, head) {
-		if ((!strict && match_neighbor(n, addr)) ||
-				(n->len == 128 && IN6_ARE_ADDR_EQUAL(&n->addr, addr)))
-			return n;
+	if (!strict || (strict & NDP_F_NEIGH)) {
+		list_for_each_entry(n, bucket, head)
+			if (!n->is_addr && IN6_ARE_ADDR_EQUAL(&n->addr, addr))
+				return n;
 
-		if (!n->iface && abs(n->timeout - now) >= 5)
-			free_neighbor(n);
+		if (!strict)
+			list_for_each_entry(n, &prefixes, head)
+				if (match_neighbor(n, addr))
+					return n;
 	}
 	return NULL;
 }
@@ -606,6 +669,11 @@ static void modify_neighbor(struct in6_addr *addr,
 			free_neighbor(n);
 	} else if (!n || // No entry yet, add one if possible
 			(n->is_addr && is_addr && n->iface != iface)) {
+		// Make room by dropping the oldest pending neighbor
+		if (neighbor_count >= NDP_MAX_NEIGHBORS && !list_empty(&pending))
+			free_neighbor(list_first_entry(&pending,
+					struct ndp_neighbor, pending));
+
 		if (neighbor_count >= NDP_MAX_NEIGHBORS ||
 				!(n = malloc(sizeof(*n))))
 			return;
@@ -613,18 +681,24 @@ static void modify_neighbor(struct in6_addr *addr,
 		n->len = 128;
 		n->addr = *addr;
 		n->iface = iface;
-		if (!n->iface)
+		INIT_LIST_HEAD(&n->pending);
+		if (!n->iface) {
 			n->timeout = relayd_monotonic_time();
+			list_add_tail(&n->pending, &pending);
+		}
 		n->is_addr = is_addr;
-		list_add(&n->head, is_addr ? &addresses : &neighbors);
+		list_add(&n->head, neighbor_bucket(addr));
 		++neighbor_count;
 		setup_route(addr, n->iface, add, n->is_addr);
 	} else if (n->iface == iface) {
-		if (!n->iface)
+		if (!n->iface) {
 			n->timeout = relayd_monotonic_time();
+			list_move_tail(&n->pending, &pending);
+		}
 	} else if (iface && (!n->iface ||
 			(!iface->external && n->iface->external))) {
 		setup_route(addr, n->iface, false, n->is_addr);
+		list_del_init(&n->pending);
 		n->iface = iface;
 		n->is_addr = is_addr;
 		setup_route(addr, n->iface, add, n->is_addr);
@@ -21,13 +21,16 @@
 #define SOL_NETLINK 270
 #endif
 
-#define NDP_MAX_NEIGHBORS 1000
+#define NDP_MAX_NEIGHBORS 4096
+#define NDP_HASH_SIZE 512 // Buckets, power of 2
+#define NDP_PENDING_TIMEOUT 5 // Seconds to wait for a neighbor to show up
 
 #define NDP_F_NEIGH (1U << 0)
 #define NDP_F_ADDR  (1U << 1)
 
 struct ndp_neighbor {
-	struct list_head head;
+	struct list_head head; // Hash bucket or prefix list
+	struct list_head pending; // Expiry queue while iface is NULL
 	struct relayd_interface *iface;
 	struct in6_addr addr;
 	uint8_t len;
@@ -28,6 +28,9 @@
 #include <netinet/if_ether.h>
 #include <linux/filter.h>
 #include <linux/if_packet.h>
+#if ENABLE_FEATURE_UDHCPC_SCRIPT_SOCKET
+# include <sys/un.h>
+#endif
 
 #ifndef PACKET_AUXDATA
 # define PACKET_AUXDATA 8
@@ -556,6 +559,69 @@ static char **fill_envp(struct dhcp_packet *packet)
 	return envp;
 }
 
+#if ENABLE_FEATURE_UDHCPC_SCRIPT_SOCKET
+/* Hand the event to a server listening on "SCRIPT.sock" and wait
+ * until it has been handled. The message is the event name followed
+ * by the variables, all NUL terminated. The server answers 0 when done,
+ * anything else if the script has to run instead. Returns 0 if handled.
+ * Once the event is sent, EOF counts as handled: the server may have
+ * been killed after passing it on, and running the script as well
+ * would apply the event twice.
+ */
+static int udhcp_send_script(char **envp, const char *name)
+{
+	struct sockaddr_un sun;
+	struct msghdr msg;
+	struct iovec *iov;
+	int fd, n, i;
+	char c;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (snprintf(sun.sun_path, sizeof(sun.sun_path), "%s.sock",
+			client_config.script) >= (int) sizeof(sun.sun_path))
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	for (n = 0; envp[n]; n++)
+		continue;
+	iov = xzalloc((n + 1) * sizeof(iov[0]));
+	iov[0].iov_base = (char*) name;
+	iov[0].iov_len = strlen(name) + 1;
+	for (i = 0; i < n; i++) {
+		iov[i + 1].iov_base = envp[i];
+		iov[i + 1].iov_len = strlen(envp[i]) + 1;
+	}
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = n + 1;
+
+	log1("Sending %s to %s", name, sun.sun_path);
+	n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+	free(iov);
+	if (n <= 0) {
+		close(fd);
+		return -1;
+	}
+	/* signals are queued to the signal pipe meanwhile */
+	c = 0;
+	while ((n = recv(fd, &c, 1, 0)) < 0 && errno == EINTR)
+		continue;
+	close(fd);
+	if (n == 0)
+		log1("%s closed before %s was answered", sun.sun_path, name);
+
+	return (n < 0 || c != 0) ? -1 : 0;
+}
+#endif
+
 /* Call a script with a par file and env vars */
 static void udhcp_run_script(struct dhcp_packet *packet, const char *name)
 {
@@ -564,12 +630,17 @@ static void udhcp_run_script(struct dhcp_packet *packet, const char *name)
 
 	envp = fill_envp(packet);
 
-	/* call script */
-	log1("Executing %s %s", client_config.script, name);
-	argv[0] = (char*) client_config.script;
-	argv[1] = (char*) name;
-	argv[2] = NULL;
-	spawn_and_wait(argv);
+#if ENABLE_FEATURE_UDHCPC_SCRIPT_SOCKET
+	if (udhcp_send_script(envp, name) != 0)
+#endif
+	{
+		/* call script */
+		log1("Executing %s %s", client_config.script, name);
+		argv[0] = (char*) client_config.script;
+		argv[1] = (char*) name;
+		argv[2] = NULL;
+		spawn_and_wait(argv);
+	}
 
 	for (curr = envp; *curr; curr++) {
 		log2(" %s", *curr);
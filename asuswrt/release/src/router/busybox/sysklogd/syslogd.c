@@ -57,6 +57,33 @@ struct shbuf_ds {
 	char data[1];   /* data/messages */
 };
 
+/* Indexed ring (must be in sync with router/shared/syslog_ring.h).
+ * There is a single writer, readers never lock: a record is valid
+ * while its slot still carries its seq and its text has not been
+ * overrun, i.e. (wpos - pos) <= size after the text was copied. */
+struct logidx_rec {
+	uint32_t seq;   /* record number, 0 while the slot is rewritten */
+	uint32_t time;
+	uint32_t pos;   /* wpos when the text was stored */
+	uint32_t off;   /* offset of the text in data[] */
+	uint16_t len;   /* text length including the '\n' */
+	uint8_t fac;    /* LOG_FAC(pri) */
+	uint8_t pri;    /* LOG_PRI(pri) */
+};
+
+struct logidx_ds {
+	uint32_t magic;
+	uint32_t stamp;     /* creation time, tells syslogd restarts apart */
+	uint32_t nrec;      /* slots in rec[] */
+	uint32_t size;      /* bytes in data[] */
+	uint32_t seq;       /* last record stored */
+	uint32_t wpos;      /* bytes stored so far */
+	uint32_t clear_seq; /* set by readers to hide older records */
+	uint32_t reserved;
+	struct logidx_rec rec[0];
+	/* char data[size] follows rec[nrec] */
+};
+
 #if ENABLE_FEATURE_REMOTE_LOG
 typedef struct {
 	int remoteFD;
@@ -88,6 +115,9 @@ IF_FEATURE_IPC_SYSLOG( \
 	int shm_size;                           \
 	struct sembuf SMwup[1];                 \
 	struct sembuf SMwdn[3];                 \
+) \
+IF_FEATURE_IPC_SYSLOG_INDEX( \
+	int idx_shmid;                          \
 )
 
 struct init_globals {
@@ -102,6 +132,10 @@ struct globals {
 #endif
 #if ENABLE_FEATURE_IPC_SYSLOG
 	struct shbuf_ds *shbuf;
+#endif
+#if ENABLE_FEATURE_IPC_SYSLOG_INDEX
+	struct logidx_ds *logidx;
+	char *logidx_data;
 #endif
 	time_t last_log_time;
 	/* localhost's name. We print only first 64 chars */
@@ -136,6 +170,9 @@ static const struct init_globals init_data = {
 	.SMwup = { {1, -1, IPC_NOWAIT} },
 	.SMwdn = { {0, 0}, {1, 0}, {1, +1} },
 #endif
+#if ENABLE_FEATURE_IPC_SYSLOG_INDEX
+	.idx_shmid = -1,
+#endif
 };
 
 #define G (*ptr_to_globals)
@@ -288,9 +325,102 @@ void ipcsyslog_init(void);
 void log_to_shmem(const char *msg);
 #endif /* FEATURE_IPC_SYSLOG */
 
+#if ENABLE_FEATURE_IPC_SYSLOG_INDEX
+enum {
+	IDX_KEY_ID = 0x414e4548,        /* "HENA" */
+	IDX_MAGIC = 0x4c494458,         /* "LIDX" */
+	IDX_AVG_LINE = 64,              /* bytes per slot when sizing rec[] */
+};
+
+static void logidx_cleanup(void)
+{
+	if (G.idx_shmid != -1) {
+		shmdt(G.logidx);
+		shmctl(G.idx_shmid, IPC_RMID, NULL);
+	}
+}
+
+/* size: bytes of text to keep */
+static void logidx_init(unsigned size)
+{
+	struct shmid_ds ds;
+	unsigned nrec = size / IDX_AVG_LINE;
+	unsigned total = sizeof(struct logidx_ds) + nrec * sizeof(struct logidx_rec) + size;
+
+	/* a segment left by a previous syslogd may be too small */
+	G.idx_shmid = shmget(IDX_KEY_ID, 0, 0);
+	if (G.idx_shmid != -1
+	 && (shmctl(G.idx_shmid, IPC_STAT, &ds) != 0 || ds.shm_segsz < total)
+	) {
+		shmctl(G.idx_shmid, IPC_RMID, NULL);
+	}
+	G.idx_shmid = shmget(IDX_KEY_ID, total, IPC_CREAT | 0644);
+	if (G.idx_shmid == -1) {
+		bb_perror_msg("shmget");
+		return;
+	}
+	G.logidx = shmat(G.idx_shmid, NULL, 0);
+	if (G.logidx == (void*) -1L) {
+		bb_perror_msg("shmat");
+		G.logidx = NULL;
+		shmctl(G.idx_shmid, IPC_RMID, NULL);
+		G.idx_shmid = -1;
+		return;
+	}
+
+	G.logidx->magic = 0;
+	memset(G.logidx + 1, 0, total - sizeof(struct logidx_ds));
+	G.logidx->stamp = time(NULL);
+	G.logidx->nrec = nrec;
+	G.logidx->size = size;
+	G.logidx->seq = 0;
+	G.logidx->wpos = 0;
+	G.logidx->clear_seq = 0;
+	G.logidx_data = (char *) &G.logidx->rec[nrec];
+	__sync_synchronize();
+	G.logidx->magic = IDX_MAGIC;
+}
+
+static void log_to_logidx(time_t now, int pri, const char *msg, int len)
+{
+	struct logidx_ds *li = G.logidx;
+	struct logidx_rec *r;
+	uint32_t seq, off, k;
+
+	if ((unsigned) len > li->size || len > 0xffff)
+		return;
+
+	/* claim the bytes first, readers then see what gets overrun */
+	off = li->wpos % li->size;
+	li->wpos += len;
+	__sync_synchronize();
+	k = li->size - off;
+	if (k >= len) {
+		memcpy(G.logidx_data + off, msg, len);
+	} else {
+		memcpy(G.logidx_data + off, msg, k);
+		memcpy(G.logidx_data, msg + k, len - k);
+	}
+
+	seq = li->seq + 1;
+	r = &li->rec[seq % li->nrec];
+	r->seq = 0;
+	__sync_synchronize();
+	r->time = now;
+	r->pos = li->wpos - len;
+	r->off = off;
+	r->len = len;
+	r->fac = LOG_FAC(pri);
+	r->pri = LOG_PRI(pri);
+	__sync_synchronize();
+	r->seq = seq;
+	li->seq = seq;
+}
+#endif /* FEATURE_IPC_SYSLOG_INDEX */
+
 
 /* Print a message to the log file. */
-static void log_locally(time_t now, char *msg)
+static void log_locally(time_t now, int pri, char *msg)
 {
 #ifdef SYSLOGD_WRLOCK
 	struct flock fl;
@@ -298,6 +428,11 @@ static void log_locally(time_t now, char *msg)
 	int len = strlen(msg);
 	const char *sav_logFilePath = G.logFilePath;
 
+#if ENABLE_FEATURE_IPC_SYSLOG_INDEX
+	if (G.logidx)
+		log_to_logidx(now ? now : time(NULL), pri, msg, len);
+#endif
+
 #if ENABLE_FEATURE_IPC_SYSLOG
 	if ((option_mask32 & OPT_circularlog) && G.shbuf) {
 		log_to_shmem(msg, len);
@@ -446,7 +581,7 @@ static void timestamp_and_log(int pri, char *msg, int len)
 	}
 
 	/* Log message locally (to file or shared mem) */
-	log_locally(now, G.printbuf);
+	log_locally(now, pri, G.printbuf);
 }
 
 static void timestamp_and_log_internal(const char *msg)
@@ -581,6 +716,15 @@ static void do_syslogd(void)
 	if (ENABLE_FEATURE_IPC_SYSLOG && (option_mask32 & OPT_circularlog)) {
 		ipcsyslog_init();
 	}
+#if ENABLE_FEATURE_IPC_SYSLOG_INDEX
+	/* as much as the log file and its rotated copy hold */
+# if ENABLE_FEATURE_ROTATE_LOGFILE
+	if (G.logFileSize)
+		logidx_init(G.logFileSize * (1 + G.logFileRotate));
+	else
+# endif
+		logidx_init(G.shm_size);
+#endif
 
 	timestamp_and_log_internal("syslogd started: BusyBox v" BB_VER);
 
@@ -669,6 +813,9 @@ static void do_syslogd(void)
 	puts("syslogd exiting");
 	if (ENABLE_FEATURE_IPC_SYSLOG)
 		ipcsyslog_cleanup();
+#if ENABLE_FEATURE_IPC_SYSLOG_INDEX
+	logidx_cleanup();
+#endif
 	kill_myself_with_sig(bb_got_signal);
 #undef recvbuf
 }
@@ -29,24 +29,54 @@ void ebt_early_init_once();
 
 #define OPT_KERNELDATA  0x800 /* Also defined in ebtables.c */
 
+static const char *table_names[3] = { "filter", "nat", "broute" };
+
 static void copy_table_names()
 {
-	strcpy(replace[0].name, "filter");
-	strcpy(replace[1].name, "nat");
-	strcpy(replace[2].name, "broute");
+	int i;
+
+	for (i = 0; i < 3; i++)
+		strcpy(replace[i].name, table_names[i]);
 }
 
 #define ebtrest_print_error(format, args...) do {fprintf(stderr, "ebtables-restore: "\
                                              "line %d: "format".\n", line, ##args); exit(-1);} while (0)
+
+/* With ebt_silent set, a failed replace only leaves a message behind */
+static void deliver_table(int table_nr)
+{
+	ebt_deliver_table(&replace[table_nr]);
+	if (ebt_errormsg[0] == '\0')
+		ebt_deliver_counters(&replace[table_nr]);
+	if (ebt_errormsg[0] != '\0') {
+		fprintf(stderr, "ebtables-restore: table %s: %s.\n", replace[table_nr].name, ebt_errormsg);
+		exit(-1);
+	}
+}
+
 int main(int argc_, char *argv_[])
 {
 	char *argv[EBTD_ARGC_MAX], cmdline[EBTD_CMDLINE_MAXLN];
 	int i, offset, quotemode = 0, argc, table_nr = -1, line = 0, whitespace;
+	int noflush = 0, flush;
 	char ebtables_str[] = "ebtables";
 
-	if (argc_ != 1)
-		ebtrest_print_error("options are not supported");
-	ebt_silent = 0;
+	/* With --noflush the commands apply on top of the kernel's current
+	 * tables, like single ebtables calls, instead of on empty ones.
+	 * An optional file argument replaces stdin, so callers need no shell */
+	for (i = 1; i < argc_ && *argv_[i] == '-'; i++) {
+		if (!strcmp(argv_[i], "-n") || !strcmp(argv_[i], "--noflush"))
+			noflush = 1;
+		else
+			ebtrest_print_error("option %s is not supported", argv_[i]);
+	}
+	if (i < argc_ - 1)
+		ebtrest_print_error("too many arguments");
+	if (i == argc_ - 1 && !freopen(argv_[i], "r", stdin))
+		ebtrest_print_error("can't open %s: %s", argv_[i], strerror(errno));
+	/* A bad rule is reported and skipped, like a failing ebtables call,
+	 * instead of throwing away the rest of its table */
+	ebt_silent = 1;
 	copy_table_names();
 	ebt_early_init_once();
 	argv[0] = ebtables_str;
@@ -57,18 +87,25 @@ int main(int argc_, char *argv_[])
 			continue;
 		*strchr(cmdline, '\n') = '\0';
 		if (*cmdline == '*') {
-			if (table_nr != -1) {
-				ebt_deliver_table(&replace[table_nr]);
-				ebt_deliver_counters(&replace[table_nr]);
-			}
+			if (table_nr != -1)
+				deliver_table(table_nr);
 			for (i = 0; i < 3; i++)
 				if (!strcmp(replace[i].name, cmdline+1))
 					break;
 			if (i == 3)
 				ebtrest_print_error("table '%s' was not recognized", cmdline+1);
 			table_nr = i;
+			/* Only the first section of a table starts from the empty one,
+			 * a table seen before is read back with what was delivered */
+			flush = !noflush;
+			if (replace[table_nr].flags & OPT_KERNELDATA) {
+				ebt_cleanup_replace(&replace[table_nr]);
+				strcpy(replace[table_nr].name, table_names[table_nr]);
+				flush = 0;
+			}
 			replace[table_nr].command = 11;
-			ebt_get_kernel_table(&replace[table_nr], 1);
+			if (ebt_get_kernel_table(&replace[table_nr], flush))
+				ebtrest_print_error("%s", ebt_errormsg);
 			replace[table_nr].command = 0;
 			replace[table_nr].flags = OPT_KERNELDATA; /* Prevent do_command from initialising replace */
 			continue;
@@ -124,12 +161,14 @@ int main(int argc_, char *argv_[])
 			ebtrest_print_error("wrong use of '\"'");
 		optind = 0; /* Setting optind = 1 causes serious annoyances */
 		do_command(argc, argv, EXEC_STYLE_DAEMON, &replace[table_nr]);
+		if (ebt_errormsg[0] != '\0') {
+			fprintf(stderr, "ebtables-restore: line %d: %s.\n", line, ebt_errormsg);
+			ebt_errormsg[0] = '\0';
+		}
 		ebt_reinit_extensions();
 	}
 
-	if (table_nr != -1) {
-		ebt_deliver_table(&replace[table_nr]);
-		ebt_deliver_counters(&replace[table_nr]);
-	}
+	if (table_nr != -1)
+		deliver_table(table_nr);
 	return 0;
 }
@@ -0,0 +1,180 @@
+/*
+ * fakekernel.c: LD_PRELOAD stand-in for the kernel side of ebtables
+ *
+ * Answers the EBT_SO_* socket options from table images kept as files in
+ * $EBT_FAKE_DIR, so ebtables and ebtables-restore can be tested on a host
+ * without bridge netfilter. An image is stored as delivered (jumps are
+ * already offsets), the same way --atomic-file keeps it. Counters always
+ * read back as zero.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "../include/ebtables_u.h"
+
+struct image {
+	unsigned int valid_hooks;
+	unsigned int nentries;
+	unsigned int entries_size;
+	char *entries;
+};
+
+static const char *hook_names[NF_BR_NUMHOOKS] = {
+	"PREROUTING", "INPUT", "FORWARD", "OUTPUT", "POSTROUTING", "BROUTING"
+};
+
+static unsigned int table_hooks(const char *name)
+{
+	if (!strcmp(name, "filter"))
+		return (1 << NF_BR_LOCAL_IN) | (1 << NF_BR_FORWARD) | (1 << NF_BR_LOCAL_OUT);
+	if (!strcmp(name, "nat"))
+		return (1 << NF_BR_PRE_ROUTING) | (1 << NF_BR_LOCAL_OUT) | (1 << NF_BR_POST_ROUTING);
+	if (!strcmp(name, "broute"))
+		return 1 << NF_BR_BROUTING;
+	return 0;
+}
+
+/* The table as registered: every base chain empty, policy ACCEPT */
+static int init_image(const char *name, struct image *img)
+{
+	struct ebt_entries *chain;
+	int i;
+
+	if (!(img->valid_hooks = table_hooks(name)))
+		return -1;
+	img->nentries = 0;
+	img->entries_size = 0;
+	for (i = 0; i < NF_BR_NUMHOOKS; i++)
+		if (img->valid_hooks & (1 << i))
+			img->entries_size += sizeof(struct ebt_entries);
+	img->entries = calloc(1, img->entries_size);
+	chain = (struct ebt_entries *)img->entries;
+	for (i = 0; i < NF_BR_NUMHOOKS; i++) {
+		if (!(img->valid_hooks & (1 << i)))
+			continue;
+		strcpy(chain->name, hook_names[i]);
+		chain->policy = EBT_ACCEPT;
+		chain++;
+	}
+	return 0;
+}
+
+static FILE *open_image(const char *name, const char *mode)
+{
+	char path[256];
+	const char *dir = getenv("EBT_FAKE_DIR");
+
+	snprintf(path, sizeof(path), "%s/%s", dir ? dir : ".", name);
+	return fopen(path, mode);
+}
+
+static int load_image(const char *name, struct image *img, int init)
+{
+	FILE *fp;
+
+	if (init || !(fp = open_image(name, "r")))
+		return init_image(name, img);
+	if (fread(img, sizeof(unsigned int), 3, fp) != 3) {
+		fclose(fp);
+		return -1;
+	}
+	img->entries = malloc(img->entries_size);
+	if (fread(img->entries, 1, img->entries_size, fp) != img->entries_size) {
+		fclose(fp);
+		free(img->entries);
+		return -1;
+	}
+	fclose(fp);
+	return 0;
+}
+
+static int store_image(const char *name, struct image *img)
+{
+	FILE *fp;
+
+	if (!(fp = open_image(name, "w")))
+		return -1;
+	fwrite(img, sizeof(unsigned int), 3, fp);
+	fwrite(img->entries, 1, img->entries_size, fp);
+	fclose(fp);
+	return 0;
+}
+
+int getsockopt(int fd, int level, int optname, void *optval, socklen_t *optlen)
+{
+	static int (*real)(int, int, int, void *, socklen_t *);
+	struct ebt_replace *repl = optval;
+	struct image img;
+	int init = 0;
+
+	switch (optname) {
+	case EBT_SO_GET_INIT_INFO:
+	case EBT_SO_GET_INIT_ENTRIES:
+		init = 1;
+	case EBT_SO_GET_INFO:
+	case EBT_SO_GET_ENTRIES:
+		if (level != IPPROTO_IP)
+			break;
+		if (load_image(repl->name, &img, init)) {
+			errno = ENOENT;
+			return -1;
+		}
+		if (optname == EBT_SO_GET_INFO || optname == EBT_SO_GET_INIT_INFO) {
+			repl->valid_hooks = img.valid_hooks;
+			repl->nentries = img.nentries;
+			repl->entries_size = img.entries_size;
+		} else {
+			if (repl->entries_size != img.entries_size) {
+				free(img.entries);
+				errno = EINVAL;
+				return -1;
+			}
+			memcpy(repl->entries, img.entries, img.entries_size);
+			if (repl->num_counters)
+				memset(repl->counters, 0, repl->num_counters * sizeof(struct ebt_counter));
+		}
+		free(img.entries);
+		return 0;
+	}
+
+	if (!real)
+		real = dlsym(RTLD_NEXT, "getsockopt");
+	return real(fd, level, optname, optval, optlen);
+}
+
+int setsockopt(int fd, int level, int optname, const void *optval, socklen_t optlen)
+{
+	static int (*real)(int, int, int, const void *, socklen_t);
+	const struct ebt_replace *repl = optval;
+	struct image img;
+
+	if (level == IPPROTO_IP && optname == EBT_SO_SET_ENTRIES) {
+		if (repl->valid_hooks != table_hooks(repl->name)) {
+			errno = EINVAL;
+			return -1;
+		}
+		img.valid_hooks = repl->valid_hooks;
+		img.nentries = repl->nentries;
+		img.entries_size = repl->entries_size;
+		img.entries = repl->entries;
+		if (repl->num_counters)
+			memset((void *)repl->counters, 0, repl->num_counters * sizeof(struct ebt_counter));
+		return store_image(repl->name, &img);
+	}
+	if (level == IPPROTO_IP && optname == EBT_SO_SET_COUNTERS)
+		return 0;
+
+	if (!real)
+		real = dlsym(RTLD_NEXT, "setsockopt");
+	return real(fd, level, optname, optval, optlen);
+}
@@ -0,0 +1,54 @@
+#!/bin/sh
+# ebtables-restore --noflush must apply a batch on top of the rules already
+# loaded; without it the batch replaces them. Runs against test/fakekernel.so
+# from the build directory.
+
+EBT_FAKE_DIR=$(mktemp -d)
+LD_PRELOAD=$PWD/test/fakekernel.so
+LD_LIBRARY_PATH=.:extensions
+export EBT_FAKE_DIR LD_PRELOAD LD_LIBRARY_PATH
+trap 'rm -rf $EBT_FAKE_DIR' EXIT
+
+fail()
+{
+	echo "FAIL: $*"
+	./ebtables -t filter -L
+	./ebtables -t broute -L
+	exit 1
+}
+
+has()
+{
+	./ebtables -t $1 -L | grep -q -- "$2"
+}
+
+./ebtables -t filter -A INPUT -p ARP -j DROP || fail "ebtables -A"
+./ebtables -t broute -A BROUTING -p IPv4 --ip-proto udp --ip-dport 53 -j DROP || fail "ebtables -A"
+
+cat > $EBT_FAKE_DIR/batch <<EOT
+*filter
+-N guest
+-A guest -p IPv6 -j DROP
+-A FORWARD -j guest
+*broute
+-A BROUTING -p IPv4 --ip-proto tcp --ip-dport 80 -j DROP
+*filter
+-A OUTPUT -p ARP -j ACCEPT
+EOT
+
+./ebtables-restore --noflush $EBT_FAKE_DIR/batch || fail "ebtables-restore --noflush"
+has filter "INPUT, entries: 1" || fail "filter rule lost"
+has filter "-p IPv6 -j DROP" || fail "user chain missing"
+has filter "-j guest" || fail "jump missing"
+has filter "OUTPUT, entries: 1" || fail "second filter section lost"
+has broute "--ip-dport 53" || fail "broute rule lost"
+has broute "--ip-dport 80" || fail "broute rule missing"
+
+./ebtables-restore $EBT_FAKE_DIR/batch || fail "ebtables-restore"
+has filter "INPUT, entries: 0" || fail "flush kept filter rule"
+has filter "-j guest" || fail "second filter section flushed the first"
+has filter "OUTPUT, entries: 1" || fail "second filter section lost"
+has broute "--ip-dport 53" && fail "flush kept broute rule"
+has broute "--ip-dport 80" || fail "broute rule missing after flush"
+
+echo "PASS: restore_noflush"
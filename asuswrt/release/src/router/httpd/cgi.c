@@ -39,7 +39,7 @@
 #define assert(a)
 #endif
 
-#include <json.h>
+#include <httpd.h>
 
 #if defined(linux)
 /* Use SVID search */
@@ -86,9 +86,255 @@ get_cgi(char *name)
 	return ep ? ep->data : NULL;
 }
 
+/*
+ * JSON post bodies from the apps. Only top-level members are ever looked
+ * up, so they are unescaped in place in a private copy of the body and
+ * indexed by a small hash: a request costs one malloc() and one free().
+ * Bodies over CGI_JSON_MAX_LEN, with more than CGI_JSON_MAX_KEYS members
+ * or nested deeper than CGI_JSON_MAX_DEPTH are refused like malformed
+ * ones, and the caller falls back to the form variables.
+ */
+static unsigned int
+cgi_json_hash(const char *s)
+{
+	unsigned int h = 5381;
+
+	while (*s)
+		h = h * 33 + (unsigned char) *s++;
+
+	return h & (CGI_JSON_HASH - 1);
+}
+
+static char *
+cgi_json_ws(char *p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+	return p;
+}
+
+static int
+cgi_json_hex4(const char *p, unsigned int *u)
+{
+	int i;
+
+	*u = 0;
+	for (i = 0; i < 4; i++, p++) {
+		*u <<= 4;
+		if (*p >= '0' && *p <= '9')
+			*u |= *p - '0';
+		else if (*p >= 'a' && *p <= 'f')
+			*u |= *p - 'a' + 10;
+		else if (*p >= 'A' && *p <= 'F')
+			*u |= *p - 'A' + 10;
+		else
+			return -1;
+	}
+	return 0;
+}
+
+/* Unescape the string at the opening quote p in place, return the end */
+static char *
+cgi_json_string(char *p, char **out)
+{
+	unsigned int u, lo;
+	char *w;
+
+	*out = w = ++p;
+	while (*p != '"') {
+		if ((unsigned char) *p < ' ')
+			return NULL;
+		if (*p != '\\') {
+			*w++ = *p++;
+			continue;
+		}
+
+		switch (*++p) {
+		case '"':
+		case '\\':
+		case '/': *w++ = *p; break;
+		case 'b': *w++ = '\b'; break;
+		case 'f': *w++ = '\f'; break;
+		case 'n': *w++ = '\n'; break;
+		case 'r': *w++ = '\r'; break;
+		case 't': *w++ = '\t'; break;
+		case 'u':
+			if (cgi_json_hex4(p + 1, &u) < 0)
+				return NULL;
+			p += 4;
+			if (u >= 0xd800 && u < 0xdc00 && p[1] == '\\' && p[2] == 'u' &&
+			    cgi_json_hex4(p + 3, &lo) == 0 && lo >= 0xdc00 && lo < 0xe000) {
+				u = 0x10000 + ((u - 0xd800) << 10) + (lo - 0xdc00);
+				p += 6;
+			}
+			/* never longer than the escape it replaces */
+			if (u < 0x80)
+				*w++ = u;
+			else if (u < 0x800) {
+				*w++ = 0xc0 | (u >> 6);
+				*w++ = 0x80 | (u & 0x3f);
+			} else if (u < 0x10000) {
+				*w++ = 0xe0 | (u >> 12);
+				*w++ = 0x80 | ((u >> 6) & 0x3f);
+				*w++ = 0x80 | (u & 0x3f);
+			} else {
+				*w++ = 0xf0 | (u >> 18);
+				*w++ = 0x80 | ((u >> 12) & 0x3f);
+				*w++ = 0x80 | ((u >> 6) & 0x3f);
+				*w++ = 0x80 | (u & 0x3f);
+			}
+			break;
+		default:
+			return NULL;
+		}
+		p++;
+	}
+	*w = '\0';
+
+	return p + 1;
+}
+
+/* Any other value is left as source text; the caller terminates it */
+static char *
+cgi_json_value(char *p, char **out)
+{
+	char stack[CGI_JSON_MAX_DEPTH];
+	int depth = 0;
+
+	if (*p == '"')
+		return cgi_json_string(p, out);
+
+	*out = p;
+	if (*p != '{' && *p != '[') {
+		/* number, true, false or null */
+		while (*p && !strchr(",}] \t\r\n", *p))
+			p++;
+		return (p == *out) ? NULL : p;
+	}
+
+	do {
+		switch (*p) {
+		case '"':
+			for (p++; *p != '"'; p++) {
+				if (!*p || (*p == '\\' && !*++p))
+					return NULL;
+			}
+			break;
+		case '{':
+		case '[':
+			if (depth == CGI_JSON_MAX_DEPTH - 1)
+				return NULL;
+			stack[depth++] = (*p == '{') ? '}' : ']';
+			break;
+		case '}':
+		case ']':
+			if (stack[--depth] != *p)
+				return NULL;
+			break;
+		case '\0':
+			return NULL;
+		}
+		p++;
+	} while (depth > 0);
+
+	return p;
+}
+
+static int
+cgi_json_set(cgi_json_t *root, char *name, char *value)
+{
+	unsigned int h = cgi_json_hash(name);
+	int i;
+
+	/* a repeated name keeps its last value */
+	while ((i = root->slot[h]) != 0) {
+		if (!strcmp(root->name[i - 1], name)) {
+			root->value[i - 1] = value;
+			return 0;
+		}
+		h = (h + 1) & (CGI_JSON_HASH - 1);
+	}
+
+	if (root->count == CGI_JSON_MAX_KEYS)
+		return -1;
+
+	root->name[root->count] = name;
+	root->value[root->count] = value;
+	root->slot[h] = ++root->count;
+
+	return 0;
+}
+
+cgi_json_t *
+cgi_json_parse(const char *text)
+{
+	cgi_json_t *root;
+	char *p, *name, *value, c;
+	size_t len;
+	int quoted;
+
+	if (!text || (len = strlen(text)) > CGI_JSON_MAX_LEN)
+		return NULL;
+	if ((root = malloc(sizeof(*root) + len + 1)) == NULL)
+		return NULL;
+	root->count = 0;
+	memset(root->slot, 0, sizeof(root->slot));
+	memcpy(root->text, text, len + 1);
+
+	p = cgi_json_ws(root->text);
+	if (*p++ != '{')
+		goto err;
+	p = cgi_json_ws(p);
+	if (*p == '}')
+		return root;
+
+	for (;;) {
+		if (*p != '"' || (p = cgi_json_string(p, &name)) == NULL)
+			goto err;
+		p = cgi_json_ws(p);
+		if (*p++ != ':')
+			goto err;
+		p = cgi_json_ws(p);
+		quoted = (*p == '"');
+		if ((p = cgi_json_value(p, &value)) == NULL)
+			goto err;
+
+		/* terminate the value, keeping the character it ended at */
+		c = *p;
+		*p++ = '\0';
+		if (!quoted && !strcmp(value, "null"))
+			value = NULL;
+		if (cgi_json_set(root, name, value) < 0)
+			goto err;
+
+		while (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+			c = *p++;
+		if (c == '}')
+			break;
+		if (c != ',')
+			goto err;
+		p = cgi_json_ws(p);
+	}
+
+	return root;
+
+err:
+	free(root);
+	return NULL;
+}
+
+void
+cgi_json_free(cgi_json_t *root)
+{
+	free(root);
+}
+
 char *
-get_cgi_json(char *name, json_object *root)
+get_cgi_json(char *name, cgi_json_t *root)
 {
+	unsigned int h;
+	int i;
+
 	if(root == NULL){
 		ENTRY e, *ep;
 
@@ -99,11 +345,14 @@ get_cgi_json(char *name, json_object *root)
 	hsearch_r(e, FIND, &ep, &htab);
 
 	return ep ? ep->data : NULL;
-	}else{
-		struct json_object *json_value;
-		json_value = json_object_object_get(root, name);
-		return (char *)json_object_get_string(json_value);
 	}
+
+	for (h = cgi_json_hash(name); (i = root->slot[h]) != 0; h = (h + 1) & (CGI_JSON_HASH - 1)) {
+		if (!strcmp(root->name[i - 1], name))
+			return root->value[i - 1];
+	}
+
+	return NULL;
 }
 
 void
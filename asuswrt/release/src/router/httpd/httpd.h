@@ -246,6 +246,27 @@ extern void do_f(char *path, webs_t wp);
 extern int web_read(void *buffer, int len);
 extern void set_cgi(char *name, char *value);
 
+/*
+ * Top-level members of a JSON post body, parsed into one allocation.
+ * Nested objects/arrays are kept as their source text.
+ */
+#define CGI_JSON_MAX_LEN	65535
+#define CGI_JSON_MAX_KEYS	256
+#define CGI_JSON_MAX_DEPTH	16
+#define CGI_JSON_HASH		512	/* power of 2, > 2 * CGI_JSON_MAX_KEYS */
+
+typedef struct cgi_json {
+	int count;
+	unsigned short slot[CGI_JSON_HASH];	/* member index + 1, 0 = free */
+	char *name[CGI_JSON_MAX_KEYS];
+	char *value[CGI_JSON_MAX_KEYS];
+	char text[0];
+} cgi_json_t;
+
+extern cgi_json_t *cgi_json_parse(const char *text);
+extern void cgi_json_free(cgi_json_t *root);
+extern char *get_cgi_json(char *name, cgi_json_t *root);
+
 /* httpd.c */
 extern void start_ssl(void);
 extern char *gethost(void);
@@ -0,0 +1,166 @@
+/*
+ * Streaming JSON writer, see json_writer.h.
+ *
+ * Strings are escaped exactly as json-c does it (including "\/"), so a
+ * handler moved over from json_object_to_json_string() sends the same
+ * bytes minus json-c's cosmetic spaces.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <httpd.h>
+
+#include "json_writer.h"
+
+static const char jw_hex[] = "0123456789abcdef";
+
+void jw_init(json_writer_t *jw, webs_t wp)
+{
+	jw->wp = wp;
+	jw->len = 0;
+	jw->depth = 0;
+	jw->after_key = 0;
+	jw->used = 0;
+}
+
+void jw_flush(json_writer_t *jw)
+{
+	if (jw->len > 0)
+		websWriteData(jw->wp, jw->buf, jw->len);
+	jw->len = 0;
+}
+
+static void jw_put(json_writer_t *jw, const char *s, int n)
+{
+	if (jw->len + n > JW_BUFSIZE) {
+		jw_flush(jw);
+		if (n > JW_BUFSIZE) {
+			websWriteData(jw->wp, s, n);
+			return;
+		}
+	}
+	memcpy(jw->buf + jw->len, s, n);
+	jw->len += n;
+}
+
+static inline void jw_putc(json_writer_t *jw, char c)
+{
+	if (jw->len == JW_BUFSIZE)
+		jw_flush(jw);
+	jw->buf[jw->len++] = c;
+}
+
+/* Comma before every member but the first of its level */
+static void jw_sep(json_writer_t *jw)
+{
+	unsigned int bit = 1U << (jw->depth % JW_MAX_DEPTH);
+
+	if (jw->after_key) {
+		jw->after_key = 0;
+		return;
+	}
+	if (jw->used & bit)
+		jw_putc(jw, ',');
+	jw->used |= bit;
+}
+
+static void jw_open(json_writer_t *jw, char c)
+{
+	jw_sep(jw);
+	jw_putc(jw, c);
+	jw->depth++;
+	jw->used &= ~(1U << (jw->depth % JW_MAX_DEPTH));
+}
+
+static void jw_close(json_writer_t *jw, char c)
+{
+	if (jw->depth > 0)
+		jw->depth--;
+	jw_putc(jw, c);
+	if (jw->depth == 0)
+		jw_flush(jw);
+}
+
+void jw_begin_object(json_writer_t *jw)
+{
+	jw_open(jw, '{');
+}
+
+void jw_end_object(json_writer_t *jw)
+{
+	jw_close(jw, '}');
+}
+
+void jw_begin_array(json_writer_t *jw)
+{
+	jw_open(jw, '[');
+}
+
+void jw_end_array(json_writer_t *jw)
+{
+	jw_close(jw, ']');
+}
+
+static void jw_escape(json_writer_t *jw, const char *str)
+{
+	const unsigned char *p, *start;
+	char esc[6];
+
+	jw_putc(jw, '"');
+	for (p = start = (const unsigned char *) str; *p; p++) {
+		switch (*p) {
+		case '\b': esc[1] = 'b'; break;
+		case '\n': esc[1] = 'n'; break;
+		case '\r': esc[1] = 'r'; break;
+		case '\t': esc[1] = 't'; break;
+		case '\f': esc[1] = 'f'; break;
+		case '"':
+		case '\\':
+		case '/': esc[1] = *p; break;
+		default:
+			if (*p >= ' ')
+				continue;
+			esc[1] = 0;
+		}
+
+		if (p > start)
+			jw_put(jw, (const char *) start, p - start);
+		start = p + 1;
+
+		esc[0] = '\\';
+		if (esc[1]) {
+			jw_put(jw, esc, 2);
+		} else {
+			esc[1] = 'u';
+			esc[2] = esc[3] = '0';
+			esc[4] = jw_hex[*p >> 4];
+			esc[5] = jw_hex[*p & 0xf];
+			jw_put(jw, esc, 6);
+		}
+	}
+	if (p > start)
+		jw_put(jw, (const char *) start, p - start);
+	jw_putc(jw, '"');
+}
+
+void jw_key(json_writer_t *jw, const char *key)
+{
+	jw_sep(jw);
+	jw_escape(jw, key);
+	jw_putc(jw, ':');
+	jw->after_key = 1;
+}
+
+void jw_string(json_writer_t *jw, const char *str)
+{
+	jw_sep(jw);
+	jw_escape(jw, str ? : "");
+}
+
+void jw_int(json_writer_t *jw, long long val)
+{
+	char num[24];
+
+	jw_sep(jw);
+	jw_put(jw, num, snprintf(num, sizeof(num), "%lld", val));
+}
@@ -0,0 +1,47 @@
+#ifndef __JSON_WRITER_H__
+#define __JSON_WRITER_H__
+
+/*
+ * Push-style JSON output for ej_ handlers.
+ *
+ * Values are escaped into a fixed buffer and handed to the connection in
+ * JW_BUFSIZE chunks, so a response costs no allocation however long the
+ * list is. Members and elements are separated automatically; a value
+ * directly after jw_key() belongs to that key.
+ */
+
+#define JW_BUFSIZE	1024
+#define JW_MAX_DEPTH	32
+
+typedef struct json_writer {
+	webs_t wp;
+	int len;
+	int depth;
+	int after_key;
+	unsigned int used;	/* bit n: level n already has a member */
+	char buf[JW_BUFSIZE];
+} json_writer_t;
+
+extern void jw_init(json_writer_t *jw, webs_t wp);
+extern void jw_flush(json_writer_t *jw);
+extern void jw_begin_object(json_writer_t *jw);
+extern void jw_end_object(json_writer_t *jw);
+extern void jw_begin_array(json_writer_t *jw);
+extern void jw_end_array(json_writer_t *jw);
+extern void jw_key(json_writer_t *jw, const char *key);
+extern void jw_string(json_writer_t *jw, const char *str);
+extern void jw_int(json_writer_t *jw, long long val);
+
+static inline void jw_kv_string(json_writer_t *jw, const char *key, const char *str)
+{
+	jw_key(jw, key);
+	jw_string(jw, str);
+}
+
+static inline void jw_kv_int(json_writer_t *jw, const char *key, long long val)
+{
+	jw_key(jw, key);
+	jw_int(jw, val);
+}
+
+#endif
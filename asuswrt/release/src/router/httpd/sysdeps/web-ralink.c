@@ -1290,42 +1290,14 @@ static int wl_scan(int eid, webs_t wp, int argc, char_t **argv, int unit)
 	struct iwreq wrq;
 	SSA *ssap;
 	char tmp[128], prefix[] = "wlXXXXXXXXXX_";
-	int lock;
 
 	snprintf(prefix, sizeof(prefix), "wl%d_", unit);
-	memset(data, 0x00, 255);
-	strcpy(data, "SiteSurvey=1");
-	wrq.u.data.length = strlen(data)+1;
+	memset(&wrq, 0, sizeof(wrq));
 	wrq.u.data.pointer = data;
-	wrq.u.data.flags = 0;
-
-	lock = file_lock("nvramcommit");
-	if (wl_ioctl(nvram_safe_get(strcat_r(prefix, "ifname", tmp)), RTPRIV_IOCTL_SET, &wrq) < 0)
-	{
-		file_unlock(lock);
-		dbg("Site Survey fails\n");
+	if ((retval = wl_site_survey(nvram_safe_get(strcat_r(prefix, "ifname", tmp)), data, sizeof(data) - 1, WLSCAN_MAX_AGE)) < 0)
 		return 0;
-	}
-	file_unlock(lock);
-	dbg("Please wait");
-	sleep(1);
-	dbg(".");
-	sleep(1);
-	dbg(".");
-	sleep(1);
-	dbg(".");
-	sleep(1);
-	dbg(".\n\n");
-	memset(data, 0, 8192);
-	strcpy(data, "");
-	wrq.u.data.length = 8192;
-	wrq.u.data.pointer = data;
-	wrq.u.data.flags = 0;
-	if (wl_ioctl(nvram_safe_get(strcat_r(prefix, "ifname", tmp)), RTPRIV_IOCTL_GSITESURVEY, &wrq) < 0)
-	{
-		dbg("errors in getting site survey result\n");
-		return 0;
-	}
+	wrq.u.data.length = retval;
+	retval = 0;
 	memset(header, 0, sizeof(header));
 	//sprintf(header, "%-3s%-33s%-18s%-8s%-15s%-9s%-8s%-2s\n", "Ch", "SSID", "BSSID", "Enc", "Auth", "Siganl(%)", "W-Mode", "NT");
 #if 0// defined(RTN14U)
@@ -125,6 +125,8 @@ typedef unsigned long long u64;
 #endif
 
 #include <json.h>
+#include "json_writer.h"
+#include <syslog_ring.h>
 
 #ifdef RTCONFIG_QCA_PLC_UTILS
 #include <plc_utils.h>
@@ -197,8 +199,6 @@ static int b64_decode( const char* str, unsigned char* space, int size );
 extern void send_login_page(int fromapp_flag, int error_status, char* url, char* file, int lock_time);
 extern void __send_login_page(int fromapp_flag, int error_status, char* url, int lock_time);
 
-extern char *get_cgi_json(char *name, json_object *root);
-
 extern int ej_generate_region(int eid, webs_t wp, int argc, char_t **argv);
 
 void add_asus_token(char *token);
@@ -1165,6 +1165,62 @@ static int dump_file(webs_t wp, char *filename)
 	return (ret);
 }
 
+static int syslog_record_json(struct syslog_rec *rec, void *arg)
+{
+	json_writer_t *jw = arg;
+
+	/* the log file line without its '\n' */
+	rec->text[rec->len - 1] = '\0';
+
+	jw_begin_object(jw);
+	jw_kv_int(jw, "seq", rec->seq);
+	jw_kv_int(jw, "time", rec->time);
+	jw_kv_int(jw, "facility", rec->fac);
+	jw_kv_int(jw, "level", rec->pri);
+	jw_kv_string(jw, "msg", rec->text);
+	jw_end_object(jw);
+
+	return 0;
+}
+
+/*
+ * One page of the syslogd log ring as JSON, without touching the log file.
+ * from: last seq the page already has, empty for the newest records
+ * count: records per page, facility / level: LOG_FAC() and maximal LOG_PRI()
+ */
+static int
+ej_syslog_records(int eid, webs_t wp, int argc, char_t **argv)
+{
+	json_writer_t jw;
+	unsigned int stamp, first, last, from;
+	char *from_s = websGetVar(wp, "from", "");
+	char *fac_s = websGetVar(wp, "facility", "");
+	char *level_s = websGetVar(wp, "level", "");
+	int count = atoi(websGetVar(wp, "count", "")) ? : 100;
+
+	jw_init(&jw, wp);
+	jw_begin_object(&jw);
+	if (syslog_ring_info(&stamp, &first, &last) == 0) {
+		if (*from_s)
+			from = strtoul(from_s, NULL, 10);
+		else
+			from = (last > (unsigned int) count) ? last - count : 0;
+
+		jw_kv_int(&jw, "stamp", stamp);
+		jw_kv_int(&jw, "first", first);
+		jw_kv_int(&jw, "last", last);
+		jw_key(&jw, "records");
+		jw_begin_array(&jw);
+		syslog_ring_read(from, *fac_s ? atoi(fac_s) : SYSLOG_ANY_FAC,
+				 *level_s ? atoi(level_s) : SYSLOG_ANY_PRI,
+				 count, syslog_record_json, &jw);
+		jw_end_array(&jw);
+	}
+	jw_end_object(&jw);
+
+	return 0;
+}
+
 extern int wl_wps_info(int eid, webs_t wp, int argc, char_t **argv, int unit);
 
 static int
@@ -1966,7 +2022,7 @@ void del_upload_icon(char *value) {
 #define NVRAM_MODIFIED_DUALWAN_REBOOT		32	/* Other cases */
 #define NVRAM_MODIFIED_DUALWAN_MODE			64  /* ex: FO => LB  or LB => FO */
 
-int validate_instance(webs_t wp, char *name, json_object *root)
+int validate_instance(webs_t wp, char *name, cgi_json_t *root)
 {
 	char prefix[32], word[100], tmp[100], *next, *value;
 	char prefix1[32], word1[100], *next1;
@@ -2094,7 +2150,7 @@ int validate_instance(webs_t wp, char *name, json_object *root)
 	return found;
 }
 
-static int validate_apply(webs_t wp, json_object *root) {
+static int validate_apply(webs_t wp, cgi_json_t *root) {
 	struct nvram_tuple *t;
 	char *value;
 	char name[64];
@@ -2462,7 +2518,7 @@ static int validate_apply(webs_t wp, json_object *root) {
 
 		if (nvram_modified_wl)
 			nvram_set("w_Setting", "1");
-		nvram_commit();
+		nvram_commit_async();
 	}
 
 	return nvram_modified;
@@ -2594,7 +2650,7 @@ static int ej_set_variables(int eid, webs_t wp, int argc, char_t **argv) {
 					strcat(nvramTmp, nvram_safe_get("custom_clientlist"));
 
 					nvram_set("custom_clientlist", nvramTmp);
-					nvram_commit();
+					nvram_commit_async();
 				}
 			}
 		}
@@ -2634,7 +2690,7 @@ static int ej_set_variables(int eid, webs_t wp, int argc, char_t **argv) {
 
 				if(retStatus == 0){
 					nvram_set("custom_clientlist", nvramTmp);
-					nvram_commit();
+					nvram_commit_async();
 				}
 			}
 		}
@@ -2674,14 +2730,14 @@ static int ej_set_variables(int eid, webs_t wp, int argc, char_t **argv) {
 		if(!strcmp(apiAction, "enable")){
 			if(nvram_match("vts_enable_x", "0")){
 				nvram_set("vts_enable_x", "1");
-				nvram_commit();
+				nvram_commit_async();
 				notify_rc("restart_firewall");
 			}
 		}
 		else if(!strcmp(apiAction, "disable")){
 			if(nvram_match("vts_enable_x", "1")){
 				nvram_set("vts_enable_x", "0");
-				nvram_commit();
+				nvram_commit_async();
 				notify_rc("restart_firewall");
 			}
 		}
@@ -2755,7 +2811,7 @@ static int ej_set_variables(int eid, webs_t wp, int argc, char_t **argv) {
 					strcat(nvramTmp, nvram_safe_get("vts_rulelist"));
 
 					nvram_set("vts_rulelist", nvramTmp);
-					nvram_commit();
+					nvram_commit_async();
 					notify_rc("restart_firewall"); // need to reboot if ctf is enabled.
 				}
 			}
@@ -2808,7 +2864,7 @@ static int ej_set_variables(int eid, webs_t wp, int argc, char_t **argv) {
 
 				if(retStatus == 0){
 					nvram_set("vts_rulelist", nvramTmp);
-					nvram_commit();
+					nvram_commit_async();
 					notify_rc("restart_firewall");
 				}
 			}
@@ -2863,7 +2919,7 @@ static int ej_set_variables(int eid, webs_t wp, int argc, char_t **argv) {
 				nvram_set("qos_obw", webVar_1);
 				nvram_set("qos_ibw", webVar_2);
 				if(nvram_match("qos_enable", "1")){
-					nvram_commit();
+					nvram_commit_async();
 					notify_rc("restart_qos");
 				}
 				else{
@@ -2949,7 +3005,7 @@ static int ej_set_variables(int eid, webs_t wp, int argc, char_t **argv) {
 					strcat(nvramTmp, nvram_safe_get("qos_rulelist"));
 
 					nvram_set("qos_rulelist", nvramTmp);
-					nvram_commit();
+					nvram_commit_async();
 					notify_rc("restart_qos"); // need to reboot if ctf is enabled.
 				}
 			}
@@ -2999,7 +3055,7 @@ static int ej_set_variables(int eid, webs_t wp, int argc, char_t **argv) {
 
 				if(retStatus == 0){
 					nvram_set("qos_rulelist", nvramTmp);
-					nvram_commit();
+					nvram_commit_async();
 					notify_rc("restart_qos"); // need to reboot if ctf is enabled.
 				}
 			}
@@ -6112,157 +6168,7 @@ static int ej_get_usb_info(int eid, webs_t wp, int argc, char_t **argv){
 	}
 
 	char disk_size[16], disk_use[16], partNumber[16], mountNumber[16], part_disk_size[16], part_disk_use[16], error_code_s[16], usb_path_tmp[16];
-	struct json_object *item = NULL;
-	struct json_object *part_item = NULL;
-	struct json_object *part_array_obj = NULL;
-	struct json_object *part_array_obj_size = NULL;
-	struct json_object *part_array_obj_use = NULL;
-
-	json_object *jarray = json_object_new_array();
-	json_object *part_jarray = NULL;
-
-	for (follow_disk = disks_info; follow_disk != NULL; follow_disk = follow_disk->next){
-
-		item = json_object_new_object();
-		part_jarray = json_object_new_array();
-
-		/* tmpdisk.deviceIndex */
-		json_object_object_add(item,"deviceIndex", json_object_new_int(disk_num));
-
-		/* tmpdisk.deviceName */
-		memset(ascii_tag, 0, PATH_MAX);
-		char_to_ascii_safe(ascii_tag, follow_disk->tag, PATH_MAX);
-		json_object_object_add(item,"deviceName", json_object_new_string(ascii_tag));
-
-		/* tmpdisk.usbPath */
-		memset(usb_path_tmp, 0, 16);
-		sprintf(usb_path_tmp, "%c", follow_disk->port[0]);
-		json_object_object_add(item,"usbPath", json_object_new_string(usb_path_tmp));
-
-		/* tmpdisk.node */
-		json_object_object_add(item,"node", json_object_new_string(follow_disk->port));
-
-		/* tmpdisk.deviceType */
-		json_object_object_add(item,"deviceType", json_object_new_string("storage"));
-
-		/* tmpdisk.mountNumber */
-		memset(mountNumber, 0, 16);
-		sprintf(mountNumber, "%u", follow_disk->mounted_number);
-		json_object_object_add(item,"mountNumber", json_object_new_string(mountNumber));
-
-		/* tmpdisk.partNumber */
-		memset(partNumber, 0, 16);
-		sprintf(partNumber, "%u", follow_disk->partition_number);
-		json_object_object_add(item,"partNumber", json_object_new_string(partNumber));
-
-		for (follow_partition = follow_disk->partitions; follow_partition != NULL; follow_partition = follow_partition->next){
-			part_item = json_object_new_object();
-
-			/* tmpParts.partName tmpParts.format tmpParts.status */
-			if (follow_partition->mount_point == NULL){
-				json_object_object_add(part_item,"partName", json_object_new_string(follow_partition->device));
-				json_object_object_add(part_item,"format", json_object_new_string("unknown"));
-				json_object_object_add(part_item,"status", json_object_new_string("unmounted"));
-			}else{
-				Ptr = rindex(follow_partition->mount_point, '/');
-				if (Ptr == NULL)
-					json_object_object_add(part_item,"partName", json_object_new_string("unknown"));
-				else{
-					++Ptr;
-					json_object_object_add(part_item,"partName", json_object_new_string(Ptr));
-				}
-
-				json_object_object_add(part_item,"format", json_object_new_string(follow_partition->file_system));
-				json_object_object_add(part_item,"status", json_object_new_string("rw"));
-			}
-
-			/* tmpParts.mountPoint */
-			json_object_object_add(part_item,"mountPoint", json_object_new_string(follow_partition->device));
-
-			/* tmpParts.isAppDev tmpdisk.hasAppDev */
-			if(nvram_match("apps_dev", follow_partition->device)){
-				json_object_object_add(part_item,"isAppDev", json_object_new_int(1));
-				json_object_object_add(item,"hasAppDev", json_object_new_int(1));
-			}else{
-				json_object_object_add(part_item,"isAppDev", json_object_new_int(0));
-				json_object_object_add(item,"hasAppDev", json_object_new_int(0));
-			}
-
-			/* tmpParts.isTM tmpdisk.hasTM */
-			if(nvram_match("tm_device_name", follow_partition->device)){
-
-				json_object_object_add(part_item,"isTM", json_object_new_int(1));
-				json_object_object_add(item,"hasTM", json_object_new_int(1));
-			}else{
-				json_object_object_add(part_item,"isTM", json_object_new_int(0));
-				json_object_object_add(item,"hasTM", json_object_new_int(0));
-			}
-
-			/* tmpParts.size */
-			memset(part_disk_size, 0, 16);
-			sprintf(part_disk_size, "%llu", follow_partition->size_in_kilobytes);
-			json_object_object_add(part_item,"size", json_object_new_string(part_disk_size));
-			json_object_object_add(part_item,"size_int", json_object_new_int(follow_partition->size_in_kilobytes));
-
-			/* tmpParts.used */
-			memset(part_disk_use, 0, 16);
-			sprintf(part_disk_use, "%llu", follow_partition->used_kilobytes);
-			json_object_object_add(part_item,"used", json_object_new_string(part_disk_use));
-			json_object_object_add(part_item,"used_int", json_object_new_int(follow_partition->used_kilobytes));
-
-			/* tmpParts.fsck */
-#define MAX_ERROR_CODE 3
-			int error_code, got_code;
-			char file_name[32];
-			FILE *fp;
-			for(error_code = 0, got_code = 0; error_code <= MAX_ERROR_CODE; ++error_code){
-				memset(file_name, 0, 32);
-				sprintf(file_name, "/tmp/fsck_ret/%s.%d", follow_partition->device, error_code);
-
-				if((fp = fopen(file_name, "r")) != NULL){
-					fclose(fp);
-					memset(error_code_s, 0, 16);
-					sprintf(error_code_s, "%d", error_code);
-					json_object_object_add(part_item,"fsck", json_object_new_string(error_code_s));
-					got_code = 1;
-					break;
-				}
-			}
-			if(!got_code)
-				json_object_object_add(part_item,"fsck", json_object_new_string(""));
-
-			/* tmpDisk.hasErrPart */
-			if(error_code == 1)
-				json_object_object_add(item,"hasErrPart", json_object_new_int(1));
-			else
-				json_object_object_add(item,"hasErrPart", json_object_new_int(0));
-
-			json_object_array_add(part_jarray,part_item);
-		}
-
-		json_object_object_add(item,"partition", part_jarray);	//add Partition to item
-
-		/* tmpdisk.totalSize tmpdisk.totalUsed */
-		int i, arraylen = 0, total_size = 0, total_use = 0;
-		arraylen = json_object_array_length(part_jarray);
-		for (i = 0; i < arraylen; i++){
-			part_array_obj = json_object_array_get_idx(part_jarray, i);
-			part_array_obj_size = json_object_object_get(part_array_obj, "size_int");
-			part_array_obj_use = json_object_object_get(part_array_obj, "used_int");
-			total_size += json_object_get_int(part_array_obj_size);
-			total_use += json_object_get_int(part_array_obj_use);
-		}
-		memset(disk_size, 0, 16);
-		sprintf(disk_size, "%d", total_size);
-		memset(disk_use, 0, 16);
-		sprintf(disk_use, "%d", total_use);
-		json_object_object_add(item,"totalSize", json_object_new_string(disk_size));
-		json_object_object_add(item,"totalUsed", json_object_new_string(disk_use));
-
-		json_object_array_add(jarray,item);
-
-		disk_num++;
-	}
+	json_writer_t jw;
 
 	/*** show_usb_path ***/
 	DIR *bus_usb;
@@ -6272,8 +6178,10 @@ static int ej_get_usb_info(int eid, webs_t wp, int argc, char_t **argv){
 	char all_usb_path[MAX_USB_PORT][MAX_USB_HUB_PORT][3][16]; // MAX USB hub port number is 6.
 	char prefix[] = "usb_pathXXXXXXXXXXXXXXXXX_", tmp[100];
 
-	if((bus_usb = opendir(USB_DEVICE_PATH)) == NULL)
+	if((bus_usb = opendir(USB_DEVICE_PATH)) == NULL){
+		free_disk_data(&disks_info);
 		return -1;
+	}
 
 	memset(all_usb_path, 0, MAX_USB_PORT*MAX_USB_HUB_PORT*3*16);
 
@@ -6422,103 +6330,218 @@ _dprintf("httpd: run modem_status.sh.\n");
 	}
 	/* end get_modem_info */
 
+	/* Everything is gathered, so the list goes out as it is produced */
+	jw_init(&jw, wp);
+	jw_begin_array(&jw);
+
+	/* generate storage json data */
+	for (follow_disk = disks_info; follow_disk != NULL; follow_disk = follow_disk->next){
+		/* tmpdisk.totalSize tmpdisk.totalUsed, summed as the json-c ints were */
+		int total_size = 0, total_use = 0;
+		int has_app_dev = 0, has_tm = 0, has_err_part = 0;
+
+		jw_begin_object(&jw);
+
+		/* tmpdisk.deviceIndex */
+		jw_kv_int(&jw, "deviceIndex", disk_num);
+
+		/* tmpdisk.deviceName */
+		memset(ascii_tag, 0, PATH_MAX);
+		char_to_ascii_safe(ascii_tag, follow_disk->tag, PATH_MAX);
+		jw_kv_string(&jw, "deviceName", ascii_tag);
+
+		/* tmpdisk.usbPath */
+		memset(usb_path_tmp, 0, 16);
+		sprintf(usb_path_tmp, "%c", follow_disk->port[0]);
+		jw_kv_string(&jw, "usbPath", usb_path_tmp);
+
+		/* tmpdisk.node */
+		jw_kv_string(&jw, "node", follow_disk->port);
+
+		/* tmpdisk.deviceType */
+		jw_kv_string(&jw, "deviceType", "storage");
+
+		/* tmpdisk.mountNumber */
+		memset(mountNumber, 0, 16);
+		sprintf(mountNumber, "%u", follow_disk->mounted_number);
+		jw_kv_string(&jw, "mountNumber", mountNumber);
+
+		/* tmpdisk.partNumber */
+		memset(partNumber, 0, 16);
+		sprintf(partNumber, "%u", follow_disk->partition_number);
+		jw_kv_string(&jw, "partNumber", partNumber);
+
+		jw_key(&jw, "partition");
+		jw_begin_array(&jw);
+		for (follow_partition = follow_disk->partitions; follow_partition != NULL; follow_partition = follow_partition->next){
+			jw_begin_object(&jw);
+
+			/* tmpParts.partName tmpParts.format tmpParts.status */
+			if (follow_partition->mount_point == NULL){
+				jw_kv_string(&jw, "partName", follow_partition->device);
+				jw_kv_string(&jw, "format", "unknown");
+				jw_kv_string(&jw, "status", "unmounted");
+			}else{
+				Ptr = rindex(follow_partition->mount_point, '/');
+				if (Ptr == NULL)
+					jw_kv_string(&jw, "partName", "unknown");
+				else{
+					++Ptr;
+					jw_kv_string(&jw, "partName", Ptr);
+				}
+
+				jw_kv_string(&jw, "format", follow_partition->file_system);
+				jw_kv_string(&jw, "status", "rw");
+			}
+
+			/* tmpParts.mountPoint */
+			jw_kv_string(&jw, "mountPoint", follow_partition->device);
+
+			/* tmpParts.isAppDev tmpdisk.hasAppDev */
+			has_app_dev = nvram_match("apps_dev", follow_partition->device) ? 1 : 0;
+			jw_kv_int(&jw, "isAppDev", has_app_dev);
+
+			/* tmpParts.isTM tmpdisk.hasTM */
+			has_tm = nvram_match("tm_device_name", follow_partition->device) ? 1 : 0;
+			jw_kv_int(&jw, "isTM", has_tm);
+
+			/* tmpParts.size */
+			memset(part_disk_size, 0, 16);
+			sprintf(part_disk_size, "%llu", follow_partition->size_in_kilobytes);
+			jw_kv_string(&jw, "size", part_disk_size);
+			jw_kv_int(&jw, "size_int", (int) follow_partition->size_in_kilobytes);
+			total_size += (int) follow_partition->size_in_kilobytes;
+
+			/* tmpParts.used */
+			memset(part_disk_use, 0, 16);
+			sprintf(part_disk_use, "%llu", follow_partition->used_kilobytes);
+			jw_kv_string(&jw, "used", part_disk_use);
+			jw_kv_int(&jw, "used_int", (int) follow_partition->used_kilobytes);
+			total_use += (int) follow_partition->used_kilobytes;
+
+			/* tmpParts.fsck */
+#define MAX_ERROR_CODE 3
+			int error_code, got_code;
+			char file_name[32];
+			FILE *fp;
+			for(error_code = 0, got_code = 0; error_code <= MAX_ERROR_CODE; ++error_code){
+				memset(file_name, 0, 32);
+				sprintf(file_name, "/tmp/fsck_ret/%s.%d", follow_partition->device, error_code);
+
+				if((fp = fopen(file_name, "r")) != NULL){
+					fclose(fp);
+					memset(error_code_s, 0, 16);
+					sprintf(error_code_s, "%d", error_code);
+					jw_kv_string(&jw, "fsck", error_code_s);
+					got_code = 1;
+					break;
+				}
+			}
+			if(!got_code)
+				jw_kv_string(&jw, "fsck", "");
+
+			/* tmpDisk.hasErrPart */
+			has_err_part = (error_code == 1) ? 1 : 0;
+
+			jw_end_object(&jw);
+		}
+		jw_end_array(&jw);
+
+		/* The disk flags follow the last partition, as they always have */
+		if (follow_disk->partitions != NULL){
+			jw_kv_int(&jw, "hasAppDev", has_app_dev);
+			jw_kv_int(&jw, "hasTM", has_tm);
+			jw_kv_int(&jw, "hasErrPart", has_err_part);
+		}
+
+		memset(disk_size, 0, 16);
+		sprintf(disk_size, "%d", total_size);
+		memset(disk_use, 0, 16);
+		sprintf(disk_use, "%d", total_use);
+		jw_kv_string(&jw, "totalSize", disk_size);
+		jw_kv_string(&jw, "totalUsed", disk_use);
+
+		jw_end_object(&jw);
+
+		disk_num++;
+	}
+
 	/* generate printer/modem json data */
 	char manuf_device_name[128];
+	char (*dev)[64];
 	for(port_order = 0; port_order < MAX_USB_PORT; ++port_order){
 	   for(hub_order = 0; hub_order < MAX_USB_HUB_PORT; ++hub_order){
 	     if(strlen(all_usb_path[port_order][hub_order][1]) > 0){
 	        if(all_usb_path[port_order][hub_order][1] != NULL && !strstr(all_usb_path[port_order][hub_order][1],"storage")){
-		   item = json_object_new_object();
+		   jw_begin_object(&jw);
+
+		   /* the last printer/modem on this path, as json-c kept it */
+		   dev = NULL;
 		   if(strcmp(all_usb_path[port_order][hub_order][1], "printer") == 0){
 		      for(printer_num = 0; printer_num < got_printer; ++printer_num){
 		         if(strlen(printer_array[printer_num][3]) > 0
 			    && (strlen(all_usb_path[port_order][hub_order][0]) == strlen(printer_array[printer_num][3]))
-			    && strcmp(all_usb_path[port_order][hub_order][0], printer_array[printer_num][3]) == 0){
-				/* tmpDisk.manufacturer */
-				if(strlen(printer_array[printer_num][0]) > 0){
-				   json_object_object_add(item,"manufacturer", json_object_new_string(printer_array[printer_num][0]));
-				}else
-				   json_object_object_add(item,"manufacturer", json_object_new_string(""));
-
-				/* tmpDisk.deviceName */
-				if(strlen(printer_array[printer_num][0]) > 0 && strlen(printer_array[printer_num][1]) > 0 && !strstr(printer_array[printer_num][1],printer_array[printer_num][0])){
-					memset(manuf_device_name, 0, 128);
-					sprintf(manuf_device_name, "%s %s", printer_array[printer_num][0], printer_array[printer_num][1]);
-					json_object_object_add(item,"deviceName", json_object_new_string(manuf_device_name));
-				}else
-					json_object_object_add(item,"deviceName", json_object_new_string(printer_array[printer_num][1]));
-
-				/* tmpDisk.serialNum */
-				if(strlen(printer_array[printer_num][2]) > 0)
-					json_object_object_add(item,"serialNum", json_object_new_string(printer_array[printer_num][2]));
-				else
-					json_object_object_add(item,"serialNum", json_object_new_string(""));
-			 } // end strlen(printer_array[printer_num][3]) > 0
+			    && strcmp(all_usb_path[port_order][hub_order][0], printer_array[printer_num][3]) == 0)
+				dev = printer_array[printer_num];
 		      } //end printer_num for loop
 		   }else if(strcmp(all_usb_path[port_order][hub_order][1], "modem") == 0){
 		      for(i = 0; i < got_modem; ++i){
 		         if(strlen(modem_array[i][3]) > 0
 			    && (strlen(all_usb_path[port_order][hub_order][0]) == strlen(modem_array[i][3]))
-			    && strcmp(all_usb_path[port_order][hub_order][0], modem_array[i][3]) == 0){
-				if(strlen(modem_array[i][0]) > 0){
-				   json_object_object_add(item,"manufacturer", json_object_new_string(modem_array[i][0]));
-				}else
-				   json_object_object_add(item,"manufacturer", json_object_new_string(""));
-
-				/* tmpDisk.deviceName */
-				if(strlen(modem_array[i][0]) > 0 && strlen(modem_array[i][1]) > 0 && !strstr(modem_array[i][1],modem_array[i][0])){
-					memset(manuf_device_name, 0, 128);
-					sprintf(manuf_device_name, "%s %s", modem_array[i][0], modem_array[i][1]);
-					json_object_object_add(item,"deviceName", json_object_new_string(manuf_device_name));
-				}else
-					json_object_object_add(item,"deviceName", json_object_new_string(modem_array[i][1]));
-
-				/* tmpDisk.serialNum */
-				if(strlen(modem_array[i][2]) > 0)
-					json_object_object_add(item,"serialNum", json_object_new_string(modem_array[i][2]));
-				else
-					json_object_object_add(item,"serialNum", json_object_new_string(""));
-			 }
+			    && strcmp(all_usb_path[port_order][hub_order][0], modem_array[i][3]) == 0)
+				dev = modem_array[i];
 		      }
 		   }//find printer/medom
 
+		   if(dev != NULL){
+			/* tmpDisk.manufacturer */
+			jw_kv_string(&jw, "manufacturer", dev[0]);
+
+			/* tmpDisk.deviceName */
+			if(strlen(dev[0]) > 0 && strlen(dev[1]) > 0 && !strstr(dev[1], dev[0])){
+				memset(manuf_device_name, 0, 128);
+				sprintf(manuf_device_name, "%s %s", dev[0], dev[1]);
+				jw_kv_string(&jw, "deviceName", manuf_device_name);
+			}else
+				jw_kv_string(&jw, "deviceName", dev[1]);
+
+			/* tmpDisk.serialNum */
+			jw_kv_string(&jw, "serialNum", dev[2]);
+		   }
+
 		   /* tmpdisk.usbPath */
 		   if(strlen(all_usb_path[port_order][hub_order][0]) > 0){
 		   memset(usb_path_tmp, 0, 16);
 		   sprintf(usb_path_tmp, "%c", all_usb_path[port_order][hub_order][0][0]);
-		   json_object_object_add(item,"usbPath", json_object_new_string(usb_path_tmp));
+		   jw_kv_string(&jw, "usbPath", usb_path_tmp);
 		   }
 
 		   /* tmpdisk.deviceIndex */
-		   json_object_object_add(item,"deviceIndex", json_object_new_int(disk_num));
+		   jw_kv_int(&jw, "deviceIndex", disk_num);
 
 		   /* tmpdisk.node */
-		   json_object_object_add(item,"node", json_object_new_string(all_usb_path[port_order][hub_order][0]));
+		   jw_kv_string(&jw, "node", all_usb_path[port_order][hub_order][0]);
 
 		   /* tmpdisk.deviceType */
-		   json_object_object_add(item,"deviceType", json_object_new_string(all_usb_path[port_order][hub_order][1]));
+		   jw_kv_string(&jw, "deviceType", all_usb_path[port_order][hub_order][1]);
 
 		   /* tmpdisk.hasAppDev */
-		   json_object_object_add(item,"hasAppDev", json_object_new_int(0));
+		   jw_kv_int(&jw, "hasAppDev", 0);
 
 		   /* tmpdisk.hasTM */
-		   json_object_object_add(item,"hasTM", json_object_new_int(0));
+		   jw_kv_int(&jw, "hasTM", 0);
 
 		   /* tmpdisk.hasErrPart */
-		   json_object_object_add(item,"hasErrPart", json_object_new_int(0));
+		   jw_kv_int(&jw, "hasErrPart", 0);
 
 		   disk_num++;
-		   json_object_array_add(jarray,item);
+		   jw_end_object(&jw);
 		} // end not storage device
 	      }	//end all_usb_path[port_order][hub_order][1] if
 	   }	//end hub_order for loop
 	} //end port_order for loop
 
-	//_dprintf ("The json object created: %s\n",json_object_to_json_string(jarray));
-
-	websWrite(wp, "%s", json_object_to_json_string(jarray));
-
-	json_object_put(jarray);
+	jw_end_array(&jw);
 
 	free_disk_data(&disks_info);
 
@@ -7312,11 +7335,11 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 	char command[32];
 	int i=0, j=0, len=0;
 
-	struct json_object *root=NULL;
+	cgi_json_t *root=NULL;
 
 	if(!strcmp(url, "applyapp.cgi")){
 		decode_json_buffer(post_json_buf);
-		root = json_tokener_parse(post_json_buf);
+		root = cgi_json_parse(post_json_buf);
 		if (!root) {
 			//return 0; /* Aicloud app can not use JSON format */
 		}
@@ -7328,7 +7351,7 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 
 	if(!action_mode){
 		_dprintf("action_mode get null\n");
-		json_object_put(root);
+		cgi_json_free(root);
 		return 1;
 	}
 
@@ -7353,7 +7376,7 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 		system_cmd = get_cgi_json("SystemCmd",root);
 
 		if(check_xxs_blacklist(system_cmd, 0)){
-			json_object_put(root);
+			cgi_json_free(root);
 			websRedirect_iframe(wp, current_url);
 			return 0;
 		}
@@ -7367,7 +7390,7 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 				_dprintf("[httpd] Invalid SystemCmd!\n");
 				strcpy(SystemCmd, "");
 
-				json_object_put(root);
+				cgi_json_free(root);
 				websRedirect_iframe(wp, current_url);
 
 				return 0;
@@ -7376,7 +7399,7 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 		if(strstr(system_cmd,"\n") != NULL || strstr(system_cmd,"\r") != NULL){
 			_dprintf("[httpd] Invalid SystemCmd!\n");
 			strcpy(SystemCmd, "");
-			json_object_put(root);
+			cgi_json_free(root);
 			websRedirect_iframe(wp, current_url);
 
 			return 0;
@@ -7415,7 +7438,7 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 			_dprintf("[httpd] Invalid SystemCmd!\n");
 			strcpy(SystemCmd, "");
 		}
-		json_object_put(root);
+		cgi_json_free(root);
 		websRedirect_iframe(wp, current_url);
 		return 0;
 	}
@@ -7423,8 +7446,17 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 	{
 		unlink(get_syslog_fname(1));
 		unlink(get_syslog_fname(0));
+		syslog_ring_clear();
+#if defined(RTCONFIG_JFFS2LOG) && (defined(RTCONFIG_JFFS2)||defined(RTCONFIG_BRCM_NAND_JFFS2))
+		/* The watchdog only appends to the saved copy, and it is
+		 * restored at boot. Without it, the next commit starts over
+		 * from the cleared log.
+		 */
+		unlink("/jffs/syslog.log-1");
+		unlink("/jffs/syslog.log");
+#endif
 		websRedirect(wp, current_url);
-		json_object_put(root);
+		cgi_json_free(root);
 		return 0;
 	}
 	else if (!strcmp(action_mode, " Restart ")||!strcmp(action_mode, "reboot"))
@@ -7433,7 +7465,7 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 		nvram_set("freeze_duck", "15");
 		shutdown(fileno(wp), SHUT_RDWR);
 		sys_reboot();
-		json_object_put(root);
+		cgi_json_free(root);
 		return (0);
 	}
 	else if (!strcmp(action_mode, "Restore")||!strcmp(action_mode, "restore"))
@@ -7462,13 +7494,13 @@ apply_cgi(webs_t wp, char_t *urlPrefix, char_t *webDir, int arg,
 		nvram_set("restore_defaults", "1");
 		nvram_set("freeze_duck", "15");
 		sys_default();
-		json_object_put(root);
+		cgi_json_free(root);
 		return (0);
 	}
 	else if (!strcmp(action_mode, "logout")) // but, every one can reset it by this call
 	{
 		websRedirect(wp, "Logout.asp");
-		json_object_put(root);
+		cgi_json_free(root);
 		return (0);
 	}
 	else if (!strcmp(action_mode, "change_wl_unit"))
@@ -7740,7 +7772,7 @@ wps_finish:
 
 		snprintf(act_node, 32, "%s", nvram_safe_get("usb_modem_act_path"));
 		if(strlen(act_node) <= 0 || get_path_by_node(act_node, act_port_path, 8) == NULL){
-			json_object_put(root);
+			cgi_json_free(root);
 			return 0;
 		}
 
@@ -7755,7 +7787,7 @@ wps_finish:
 
 		snprintf(act_node, 32, "%s", nvram_safe_get("usb_modem_act_path"));
 		if(strlen(act_node) <= 0 || get_path_by_node(act_node, act_port_path, 8) == NULL){
-			json_object_put(root);
+			cgi_json_free(root);
 			return 0;
 		}
 
@@ -7772,7 +7804,7 @@ wps_finish:
 
 		snprintf(act_node, 32, "%s", nvram_safe_get("usb_modem_act_path"));
 		if(strlen(act_node) <= 0 || get_path_by_node(act_node, act_port_path, 8) == NULL){
-			json_object_put(root);
+			cgi_json_free(root);
 			return 0;
 		}
 
@@ -7792,7 +7824,7 @@ wps_finish:
 
 		snprintf(act_node, 32, "%s", nvram_safe_get("usb_modem_act_path"));
 		if(strlen(act_node) <= 0 || get_path_by_node(act_node, act_port_path, 8) == NULL){
-			json_object_put(root);
+			cgi_json_free(root);
 			return 0;
 		}
 
@@ -7825,7 +7857,7 @@ wps_finish:
 
 		snprintf(act_node, 32, "%s", nvram_safe_get("usb_modem_act_path"));
 		if(strlen(act_node) <= 0 || get_path_by_node(act_node, act_port_path, 8) == NULL){
-			json_object_put(root);
+			cgi_json_free(root);
 			return 0;
 		}
 
@@ -7840,7 +7872,7 @@ wps_finish:
 
 		snprintf(act_node, 32, "%s", nvram_safe_get("usb_modem_act_path"));
 		if(strlen(act_node) <= 0 || get_path_by_node(act_node, act_port_path, 8) == NULL){
-			json_object_put(root);
+			cgi_json_free(root);
 			return 0;
 		}
 
@@ -7857,7 +7889,7 @@ wps_finish:
 		nvram_set("freeze_duck", "15");
 		shutdown(fileno(wp), SHUT_RDWR);
 		sys_reboot();
-		json_object_put(root);
+		cgi_json_free(root);
 		return 0;
 	}
 	else if(!strcmp(action_mode, "update_lte_fw")){
@@ -7975,7 +8007,7 @@ wps_finish:
 			nvram_set("diskmon_usbport", action_para);
 	}
 #endif
-	json_object_put(root);
+	cgi_json_free(root);
 	return 1;
 }
 
@@ -9106,11 +9138,11 @@ static void GetPhyRate(FILE *stream)
 static void
 do_plc_cgi(char *url, FILE *stream)
 {
-	struct json_object *root=NULL;
+	cgi_json_t *root=NULL;
 
 	if(check_user_agent(user_agent) != 0){
 		decode_json_buffer(post_json_buf);
-		root = json_tokener_parse(post_json_buf);
+		root = cgi_json_parse(post_json_buf);
 		if (!root) {
 			//return 0; /* Aicloud app can not use JSON format */
 		}
@@ -9132,7 +9164,7 @@ do_plc_cgi(char *url, FILE *stream)
 	else if (!strcmp(action_mode, "GetPhyRate")) {
 		GetPhyRate(stream);
 	}
-	json_object_put(root);
+	cgi_json_free(root);
 }
 #endif
 
@@ -10337,11 +10369,11 @@ int ej_usb_port_stor_act(int eid, webs_t wp, int argc, char **argv)
 static int ej_safely_remove_disk(int eid, webs_t wp, int argc, char_t **argv){
 
 	int result;
-	struct json_object *root=NULL;
+	cgi_json_t *root=NULL;
 
 	if(check_user_agent(user_agent) != 0){
 		decode_json_buffer(post_json_buf);
-		root = json_tokener_parse(post_json_buf);
+		root = cgi_json_parse(post_json_buf);
 	}
 
 	char *disk_port = get_cgi_json("disk", root);
@@ -10364,7 +10396,7 @@ static int ej_safely_remove_disk(int eid, webs_t wp, int argc, char_t **argv){
 
 	if (result != 0){
 		insert_hook_func(wp, fn, "alert_msg.Action9");
-		json_object_put(root);
+		cgi_json_free(root);
 		return -1;
 	}
 
@@ -10392,7 +10424,7 @@ static int ej_safely_remove_disk(int eid, webs_t wp, int argc, char_t **argv){
 
 	insert_hook_func(wp, "safely_remove_disk_success", "");
 
-	json_object_put(root);
+	cgi_json_free(root);
 	return 0;
 }
 
@@ -10818,8 +10850,8 @@ int ej_initial_folder_var_file(int eid, webs_t wp, int argc, char **argv)
 
 int ej_set_share_mode(int eid, webs_t wp, int argc, char **argv){
 
-	struct json_object *root=NULL;
-	root = json_tokener_parse(post_buf);
+	cgi_json_t *root=NULL;
+	root = cgi_json_parse(post_buf);
 
 	int samba_mode = nvram_get_int("st_samba_mode");
 	int samba_force_mode = nvram_get_int("st_samba_force_mode");
@@ -10842,12 +10874,12 @@ int ej_set_share_mode(int eid, webs_t wp, int argc, char **argv){
 
 	if (strlen(protocol) <= 0){
 		insert_hook_func(wp, fn, "alert_msg.Input1");
-		json_object_put(root);
+		cgi_json_free(root);
 		return -1;
 	}
 	if (strlen(mode) <= 0){
 		insert_hook_func(wp, fn, "alert_msg.Input3");
-		json_object_put(root);
+		cgi_json_free(root);
 		return -1;
 	}
 	if (!strcmp(mode, "share")){
@@ -10873,7 +10905,7 @@ int ej_set_share_mode(int eid, webs_t wp, int argc, char **argv){
 #endif
 		else{
 			insert_hook_func(wp, fn, "alert_msg.Input2");
-			json_object_put(root);
+			cgi_json_free(root);
 			return -1;
 		}
 	}
@@ -10900,13 +10932,13 @@ int ej_set_share_mode(int eid, webs_t wp, int argc, char **argv){
 #endif
 		else {
 			insert_hook_func(wp, fn, "alert_msg.Input2");
-			json_object_put(root);
+			cgi_json_free(root);
 			return -1;
 		}
 	}
 	else{
 		insert_hook_func(wp, fn, "alert_msg.Input4");
-		json_object_put(root);
+		cgi_json_free(root);
 		return -1;
 	}
 
@@ -10927,19 +10959,19 @@ int ej_set_share_mode(int eid, webs_t wp, int argc, char **argv){
 #endif
 	else {
 		insert_hook_func(wp, fn, "alert_msg.Input2");
-		json_object_put(root);
+		cgi_json_free(root);
 		return -1;
 	}
 
 	if (result != 0){
 		insert_hook_func(wp, fn, "alert_msg.Action8");
-		json_object_put(root);
+		cgi_json_free(root);
 		return -1;
 	}
 
 SET_SHARE_MODE_SUCCESS:
 	insert_hook_func(wp, "set_share_mode_success", "");
-	json_object_put(root);
+	cgi_json_free(root);
 	return 0;
 }
 
@@ -11738,6 +11770,7 @@ int ej_apps_info(int eid, webs_t wp, int argc, char **argv)
 {
 	apps_info_t *follow_apps_info, *apps_info_list;
 	char *name;
+	json_writer_t jw;
 
 	if (ejArgs(argc, argv, "%s", &name) < 1)
 		name = APP_OWNER_ALL;
@@ -11749,27 +11782,28 @@ int ej_apps_info(int eid, webs_t wp, int argc, char **argv)
 	}
 
 	apps_info_list = follow_apps_info = get_apps_list(name);
-	websWrite(wp, "[");
+	jw_init(&jw, wp);
+	jw_begin_array(&jw);
 	while (follow_apps_info != NULL) {
-		websWrite(wp, "[");
-		websWrite(wp, "\"%s\", ", follow_apps_info->name ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->version ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->new_version ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->installed ? : "" /* Why not FIELD_NO? */);
-		websWrite(wp, "\"%s\", ", follow_apps_info->enabled ? : FIELD_YES);
-		websWrite(wp, "\"%s\", ", follow_apps_info->source ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->url ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->description ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->depends ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->optional_utility ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->new_optional_utility ? : "");
-		websWrite(wp, "\"%s\", ", follow_apps_info->help_path ? : "");
-		websWrite(wp, "\"%s\"",   follow_apps_info->new_file_name ? : "");
+		jw_begin_array(&jw);
+		jw_string(&jw, follow_apps_info->name);
+		jw_string(&jw, follow_apps_info->version);
+		jw_string(&jw, follow_apps_info->new_version);
+		jw_string(&jw, follow_apps_info->installed /* Why not FIELD_NO? */);
+		jw_string(&jw, follow_apps_info->enabled ? : FIELD_YES);
+		jw_string(&jw, follow_apps_info->source);
+		jw_string(&jw, follow_apps_info->url);
+		jw_string(&jw, follow_apps_info->description);
+		jw_string(&jw, follow_apps_info->depends);
+		jw_string(&jw, follow_apps_info->optional_utility);
+		jw_string(&jw, follow_apps_info->new_optional_utility);
+		jw_string(&jw, follow_apps_info->help_path);
+		jw_string(&jw, follow_apps_info->new_file_name);
+		jw_end_array(&jw);
 
 		follow_apps_info = follow_apps_info->next;
-		websWrite(wp, "]%s\n", follow_apps_info ? "," : "");
 	}
-	websWrite(wp, "]");
+	jw_end_array(&jw);
 	free_apps_list(&apps_info_list);
 
 	return 0;
@@ -11804,11 +11838,11 @@ int ej_apps_state_info(int eid, webs_t wp, int argc, char **argv){
 }
 
 int ej_apps_action(int eid, webs_t wp, int argc, char **argv){
-	struct json_object *root=NULL;
+	cgi_json_t *root=NULL;
 
 	if(check_user_agent(user_agent) != 0){
 		decode_json_buffer(post_json_buf);
-		root = json_tokener_parse(post_json_buf);
+		root = cgi_json_parse(post_json_buf);
 		if (!root) {
 			//return 0; /* Aicloud app can not use JSON format */
 		}
@@ -11875,7 +11909,7 @@ int ej_apps_action(int eid, webs_t wp, int argc, char **argv){
 	goto SET_APPS_ACTION_FINISH;
 
 SET_APPS_ACTION_FINISH:
-	json_object_put(root);
+	cgi_json_free(root);
  	return 0;
 
 }
@@ -14286,34 +14320,19 @@ ej_check_wireless_encryption(int eid, webs_t wp, int argc, char **argv){
 	return websWrite(wp, "\"1\"");
 }
 
-static int
-check_macrepeat(char *maclist,char *mac){
-	int total=0;
-	while ( strstr(maclist,mac) != NULL )
-   	{
-		maclist += strlen(maclist);
-		total++;
-	}
-	return total;
-}
-
 static int
 ej_get_clientlist(int eid, webs_t wp, int argc, char **argv){
 
 	int i, shm_client_info_id;
 	void *shared_client_info=(void *) 0;
-	char output_buf[2048];
-	char maclist_buf[4096]=",\"maclist\":";
-	char mac_buf[32], dev_name[32];
-	char *brackets_h = "[";
-	char *brackets_d = "]";
-	char *dot = ",";
+	char mac_buf[18], dev_name[32], num[12];
 	char ipaddr[16];
+	char *lan_ipaddr;
 	P_CLIENT_DETAIL_INFO_TABLE p_client_info_tab;
 	int lock;
 	char devname[LINE_SIZE], character;
 	int j, len;
-	int first_mac=1, first_info=1;
+	json_writer_t jw;
 
 	lock = file_lock("networkmap");
 	shm_client_info_id = shmget((key_t)1001, sizeof(CLIENT_DETAIL_INFO_TABLE), 0666|IPC_CREAT);
@@ -14331,20 +14350,22 @@ ej_get_clientlist(int eid, webs_t wp, int argc, char **argv){
 	}
 
 	p_client_info_tab = (P_CLIENT_DETAIL_INFO_TABLE)shared_client_info;
+	lan_ipaddr = nvram_safe_get("lan_ipaddr");
+	jw_init(&jw, wp);
+
+	/* "<mac>":{...} members, then "maclist":[...] from a second pass */
 	for(i=0; i<p_client_info_tab->ip_mac_num; i++) {
+		if(p_client_info_tab->exist[i]!=1)
+			continue;
 
 		memset(dev_name, 0, 32);
-		memset(output_buf, 0, 2048);
-		memset(ipaddr, 0, 16);
-		memset(mac_buf, 0, 32);
 		memset(devname, 0, LINE_SIZE);
 
 		if(strcmp((const char *)p_client_info_tab->user_define[i], ""))
-			strcpy(dev_name, (const char *)p_client_info_tab->user_define[i]);
+			strlcpy(dev_name, (const char *)p_client_info_tab->user_define[i], sizeof(dev_name));
 		else
-			strcpy(dev_name, (const char *)p_client_info_tab->device_name[i]);
+			strlcpy(dev_name, (const char *)p_client_info_tab->device_name[i], sizeof(dev_name));
 
-	    if(p_client_info_tab->exist[i]==1) {
 		len = strlen(dev_name);
 		for (j=0; (j < len) && (j < LINE_SIZE-1); j++) {
 			character = dev_name[j];
@@ -14357,45 +14378,50 @@ ej_get_clientlist(int eid, webs_t wp, int argc, char **argv){
 		sprintf(ipaddr, "%d.%d.%d.%d", p_client_info_tab->ip_addr[i][0],p_client_info_tab->ip_addr[i][1],
 		p_client_info_tab->ip_addr[i][2],p_client_info_tab->ip_addr[i][3]);
 
-		sprintf(mac_buf, "\"%02X:%02X:%02X:%02X:%02X:%02X\"",
+		sprintf(mac_buf, "%02X:%02X:%02X:%02X:%02X:%02X",
 		p_client_info_tab->mac_addr[i][0],p_client_info_tab->mac_addr[i][1],
 		p_client_info_tab->mac_addr[i][2],p_client_info_tab->mac_addr[i][3],
 		p_client_info_tab->mac_addr[i][4],p_client_info_tab->mac_addr[i][5]
 		);
-		if(first_mac == 1){
-			first_mac = 0;
-			strcat(maclist_buf,brackets_h);
-		}else{
-			strcat(maclist_buf,dot);
-		}
-		strcat(maclist_buf,mac_buf);
 
-		if(first_info == 1){
-			first_info = 0;
-		}else{
-			websWrite(wp, ",\n");
-		}
+		jw_key(&jw, mac_buf);
+		jw_begin_object(&jw);
+		sprintf(num, "%d", p_client_info_tab->type[i]);
+		jw_kv_string(&jw, "type", num);
+		jw_kv_string(&jw, "name", devname);
+		jw_kv_string(&jw, "ip", ipaddr);
+		jw_kv_string(&jw, "mac", mac_buf);
+		jw_kv_string(&jw, "from", "networkmapd");
+		/* the old maclist scan always found the entry just appended */
+		jw_kv_string(&jw, "macRepeat", "1");
+		jw_kv_string(&jw, "isGateway", !strcmp(lan_ipaddr, ipaddr) ? "true" : "false");
+		sprintf(num, "%d", p_client_info_tab->http[i]);
+		jw_kv_string(&jw, "isWebServer", num);
+		sprintf(num, "%d", p_client_info_tab->printer[i]);
+		jw_kv_string(&jw, "isPrinter", num);
+		sprintf(num, "%d", p_client_info_tab->itune[i]);
+		jw_kv_string(&jw, "isITunes", num);
+		jw_kv_string(&jw, "isOnline", "true");
+		jw_end_object(&jw);
+	}
+
+	jw_key(&jw, "maclist");
+	jw_begin_array(&jw);
+	for(i=0; i<p_client_info_tab->ip_mac_num; i++) {
+		if(p_client_info_tab->exist[i]!=1)
+			continue;
 
-		sprintf(output_buf, "%s:{\"type\":\"%d\",\"name\":\"%s\",\"ip\":\"%s\",\"mac\":%s,\"from\":\"networkmapd\",\"macRepeat\":\"%d\",\"isGateway\":\"%s\",\"isWebServer\":\"%d\",\"isPrinter\":\"%d\",\"isITunes\":\"%d\",\"isOnline\":\"true\"}",
-		mac_buf,
-		p_client_info_tab->type[i],
-		devname,
-		ipaddr,
-		mac_buf,
-		check_macrepeat(maclist_buf, mac_buf),
-		!strcmp(nvram_safe_get("lan_ipaddr"), ipaddr) ? "true" : "false",
-		p_client_info_tab->http[i],
-		p_client_info_tab->printer[i],
-		p_client_info_tab->itune[i]
+		sprintf(mac_buf, "%02X:%02X:%02X:%02X:%02X:%02X",
+		p_client_info_tab->mac_addr[i][0],p_client_info_tab->mac_addr[i][1],
+		p_client_info_tab->mac_addr[i][2],p_client_info_tab->mac_addr[i][3],
+		p_client_info_tab->mac_addr[i][4],p_client_info_tab->mac_addr[i][5]
 		);
-		websWrite(wp, output_buf);
-
-	    }
+		jw_string(&jw, mac_buf);
 	}
+	jw_end_array(&jw);
+
 	shmdt(shared_client_info);
 	file_unlock(lock);
-	strcat(maclist_buf,brackets_d);
-	websWrite(wp, maclist_buf);
 	return 0;
 }
 
@@ -14710,6 +14736,7 @@ struct ej_handler ej_handlers[] = {
 	{ "uptime", ej_uptime},
 	{ "sysuptime", ej_sysuptime},
 	{ "nvram_dump", ej_dump},
+	{ "syslog_records", ej_syslog_records},
 	{ "load_script", ej_load},
 	{ "select_list", ej_select_list},
 	{ "dhcpLeaseInfo", ej_dhcpLeaseInfo},
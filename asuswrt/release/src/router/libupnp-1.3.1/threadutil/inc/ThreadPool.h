@@ -169,6 +169,9 @@ typedef struct TPOOLSTATS
   double totalTimeLQ; //total time spent by all jobs in low priority Q
   int totalJobsLQ;    //total jobs in LQ run so far
   double avgWaitLQ;	//average wait in LQ	
+  double maxWaitHQ;   //longest wait in HQ
+  double maxWaitMQ;   //longest wait in MQ
+  double maxWaitLQ;   //longest wait in LQ
   double totalWorkTime; //total time spent working for all threads
   double totalIdleTime; //total time spent idle for all threads
   int workerThreads; //number of current workerThreads
@@ -57,16 +57,20 @@ typedef enum timeoutType {ABS_SEC,REL_SEC} TimeoutType;
  *     the scheduling of a job to run at a specified time in the future
  *     Because the timer thread uses the thread pool there is no 
  *     gurantee of timing, only approximate timing.
+ *     Events are kept in a binary heap ordered by time (then id),
+ *     so scheduling and firing are O(log n) in the number of events.
  *     Uses ThreadPool, Mutex, Condition, Thread
  *    
  * 
  *****************************************************************************/
 typedef struct TIMERTHREAD
 {
-  ithread_mutex_t mutex; //mutex to protect eventQ
+  ithread_mutex_t mutex; //mutex to protect eventHeap
   ithread_cond_t condition; //condition variable
   int lastEventId;	//last event id
-  LinkedList eventQ; //event q
+  struct TIMEREVENT **eventHeap; //binary min-heap, next event first
+  int eventCount;    //events in heap
+  int eventMax;      //allocated heap slots
   int shutdown;      //whether or not we are shutdown  
   FreeList freeEvents; //FreeList for events
   ThreadPool *tp;	 //ThreadPool to use
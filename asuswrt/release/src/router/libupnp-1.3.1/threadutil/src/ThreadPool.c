@@ -217,6 +217,8 @@ BumpPriority( ThreadPool * tp )
                      );
                 STATSONLY( tp->stats.totalTimeMQ += diffTime;
                      );
+                STATSONLY( if( diffTime > tp->stats.maxWaitMQ )
+                           tp->stats.maxWaitMQ = diffTime; );
 
                 ListDelNode( &tp->medJobQ, tp->medJobQ.head.next, 0 );
                 ListAddTail( &tp->highJobQ, tempJob );
@@ -238,6 +240,8 @@ BumpPriority( ThreadPool * tp )
                      );
                 STATSONLY( tp->stats.totalTimeLQ += diffTime;
                      );
+                STATSONLY( if( diffTime > tp->stats.maxWaitLQ )
+                           tp->stats.maxWaitLQ = diffTime; );
 
                 ListDelNode( &tp->lowJobQ, tp->lowJobQ.head.next, 0 );
                 ListAddTail( &tp->medJobQ, tempJob );
@@ -289,6 +293,9 @@ STATSONLY( static void StatsInit( ThreadPoolStats * stats ) {
            assert( stats != NULL ); stats->totalIdleTime = 0; stats->totalJobsHQ = 0; stats->totalJobsLQ = 0; stats->totalJobsMQ = 0; stats->totalTimeHQ = 0; stats->totalTimeMQ = 0; stats->totalTimeLQ = 0; stats->totalWorkTime = 0; stats->totalIdleTime = 0; stats->avgWaitHQ = 0; //average wait in HQ
            stats->avgWaitMQ = 0;    //average wait in MQ
            stats->avgWaitLQ = 0;
+           stats->maxWaitHQ = 0;
+           stats->maxWaitMQ = 0;
+           stats->maxWaitLQ = 0;
            stats->workerThreads = 0;
            stats->idleThreads = 0;
            stats->persistentThreads = 0;
@@ -319,9 +326,12 @@ STATSONLY( static void CalcWaitTime( ThreadPool * tp,
            ftime( &now );
            diff = DiffMillis( &now, &job->requestTime ); switch ( p ) {
 case HIGH_PRIORITY:
-tp->stats.totalJobsHQ++; tp->stats.totalTimeHQ += diff; break; case MED_PRIORITY:
-tp->stats.totalJobsMQ++; tp->stats.totalTimeMQ += diff; break; case LOW_PRIORITY:
-tp->stats.totalJobsLQ++; tp->stats.totalTimeLQ += diff; break; default:
+tp->stats.totalJobsHQ++; tp->stats.totalTimeHQ += diff;
+if( diff > tp->stats.maxWaitHQ ) tp->stats.maxWaitHQ = diff; break; case MED_PRIORITY:
+tp->stats.totalJobsMQ++; tp->stats.totalTimeMQ += diff;
+if( diff > tp->stats.maxWaitMQ ) tp->stats.maxWaitMQ = diff; break; case LOW_PRIORITY:
+tp->stats.totalJobsLQ++; tp->stats.totalTimeLQ += diff;
+if( diff > tp->stats.maxWaitLQ ) tp->stats.maxWaitLQ = diff; break; default:
            assert( 0 );}
            }
 
@@ -1476,6 +1486,9 @@ tp->stats.totalJobsLQ++; tp->stats.totalTimeLQ += diff; break; default:
                printf
                ( "Averate Wait in Low Priority Q in milliseconds: %lf\n",
                  stats->avgWaitLQ );
+               printf
+               ( "Max Wait in High/Med/Low Priority Q in milliseconds: %lf %lf %lf\n",
+                 stats->maxWaitHQ, stats->maxWaitMQ, stats->maxWaitLQ );
                printf( "Max Threads Active: %d\n", stats->maxThreads );
                printf( "Current Worker Threads: %d\n",
                        stats->workerThreads );
@@ -31,6 +31,9 @@
 
 #include "TimerThread.h"
 #include <assert.h>
+#include <stdlib.h>
+
+#define TIMER_HEAP_INIT 32
 
 /****************************************************************************
  * Function: FreeTimerEvent
@@ -50,6 +53,133 @@ FreeTimerEvent( TimerThread * timer,
     FreeListFree( &timer->freeEvents, event );
 }
 
+/****************************************************************************
+ * Function: EventBefore
+ *
+ *  Description:
+ *      Heap order: earlier time first, equal times in scheduling order.
+ *      Internal Only.
+ *****************************************************************************/
+static int
+EventBefore( TimerEvent * a,
+             TimerEvent * b )
+{
+    if( a->eventTime != b->eventTime )
+        return a->eventTime < b->eventTime;
+
+    return a->id < b->id;
+}
+
+/****************************************************************************
+ * Function: HeapUp / HeapDown
+ *
+ *  Description:
+ *      Restore heap order for the event at index i by moving it
+ *      towards the root or the leaves. Return its final index.
+ *      timer->mutex must be locked.
+ *      Internal Only.
+ *****************************************************************************/
+static int
+HeapUp( TimerThread * timer,
+        int i )
+{
+    TimerEvent **heap = timer->eventHeap;
+    TimerEvent *event = heap[i];
+    int parent;
+
+    while( i > 0 ) {
+        parent = ( i - 1 ) / 2;
+        if( !EventBefore( event, heap[parent] ) )
+            break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = event;
+
+    return i;
+}
+
+static int
+HeapDown( TimerThread * timer,
+          int i )
+{
+    TimerEvent **heap = timer->eventHeap;
+    TimerEvent *event = heap[i];
+    int child;
+
+    while( ( child = 2 * i + 1 ) < timer->eventCount ) {
+        if( ( child + 1 < timer->eventCount )
+            && EventBefore( heap[child + 1], heap[child] ) )
+            child++;
+        if( !EventBefore( heap[child], event ) )
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = event;
+
+    return i;
+}
+
+/****************************************************************************
+ * Function: HeapPush
+ *
+ *  Description:
+ *      Adds an event to the heap, growing it if needed.
+ *      timer->mutex must be locked.
+ *      Internal Only.
+ *  Returns:
+ *      index of the event in the heap (0 if it is now the next
+ *      event), -1 if out of memory.
+ *****************************************************************************/
+static int
+HeapPush( TimerThread * timer,
+          TimerEvent * event )
+{
+    TimerEvent **heap;
+    int max;
+
+    if( timer->eventCount == timer->eventMax ) {
+        max = timer->eventMax ? timer->eventMax * 2 : TIMER_HEAP_INIT;
+        heap = ( TimerEvent ** ) realloc( timer->eventHeap,
+                                          max * sizeof( TimerEvent * ) );
+        if( heap == NULL )
+            return -1;
+        timer->eventHeap = heap;
+        timer->eventMax = max;
+    }
+
+    timer->eventHeap[timer->eventCount] = event;
+
+    return HeapUp( timer, timer->eventCount++ );
+}
+
+/****************************************************************************
+ * Function: HeapRemove
+ *
+ *  Description:
+ *      Takes the event at index i out of the heap.
+ *      timer->mutex must be locked.
+ *      Internal Only.
+ *****************************************************************************/
+static TimerEvent *
+HeapRemove( TimerThread * timer,
+            int i )
+{
+    TimerEvent **heap = timer->eventHeap;
+    TimerEvent *event = heap[i];
+
+    if( --timer->eventCount > i ) {
+        heap[i] = heap[timer->eventCount];
+        if( ( i > 0 ) && EventBefore( heap[i], heap[( i - 1 ) / 2] ) )
+            HeapUp( timer, i );
+        else
+            HeapDown( timer, i );
+    }
+
+    return event;
+}
+
 /****************************************************************************
  * Function: TimerThreadWorker
  *
@@ -65,7 +195,6 @@ static void *
 TimerThreadWorker( void *arg )
 {
     TimerThread *timer = ( TimerThread * ) arg;
-    ListNode *head = NULL;
 
     TimerEvent *nextEvent = NULL;
 
@@ -99,11 +228,9 @@ TimerThreadWorker( void *arg )
         nextEvent = NULL;
 
         //Get the next event if possible
-        if( timer->eventQ.size > 0 )
+        if( timer->eventCount > 0 )
         {
-            head = ListHead( &timer->eventQ );
-
-            nextEvent = ( TimerEvent * ) head->item;
+            nextEvent = timer->eventHeap[0];
             nextEventTime = nextEvent->eventTime;
         }
 
@@ -123,7 +250,7 @@ TimerThreadWorker( void *arg )
                 ThreadPoolAdd( timer->tp, &nextEvent->job, &tempId );
             }
 
-            ListDelNode( &timer->eventQ, head, 0 );
+            HeapRemove( timer, 0 );
             FreeTimerEvent( timer, nextEvent );
 
             continue;
@@ -263,9 +390,9 @@ TimerThreadInit( TimerThread * timer,
     timer->shutdown = 0;
     timer->tp = tp;
     timer->lastEventId = 0;
-    rc += ListInit( &timer->eventQ, NULL, NULL );
-
-    assert( rc == 0 );
+    timer->eventHeap = NULL;
+    timer->eventCount = 0;
+    timer->eventMax = 0;
 
     if( rc != 0 ) {
         rc = EAGAIN;
@@ -283,7 +410,6 @@ TimerThreadInit( TimerThread * timer,
         ithread_cond_destroy( &timer->condition );
         ithread_mutex_destroy( &timer->mutex );
         FreeListDestroy( &timer->freeEvents );
-        ListDestroy( &timer->eventQ, 0 );
     }
 
     return rc;
@@ -324,11 +450,9 @@ TimerThreadSchedule( TimerThread * timer,
 {
 
     int rc = EOUTOFMEM;
-    int found = 0;
     int tempId = 0;
+    int index;
 
-    ListNode *tempNode = NULL;
-    TimerEvent *temp = NULL;
     TimerEvent *newEvent = NULL;
 
     assert( timer != NULL );
@@ -354,37 +478,15 @@ TimerThreadSchedule( TimerThread * timer,
         return rc;
     }
 
-    tempNode = ListHead( &timer->eventQ );
-    //add job to Q
-    //Q is ordered by eventTime
-    //with the head of the Q being the next event
-
-    while( tempNode != NULL ) {
-        temp = ( TimerEvent * ) tempNode->item;
-        if( temp->eventTime >= timeout )
-        {
-
-            if( ListAddBefore( &timer->eventQ, newEvent, tempNode ) !=
-                NULL )
-                rc = 0;
-            found = 1;
-            break;
-
-        }
-        tempNode = ListNext( &timer->eventQ, tempNode );
-    }
-
-    //add to the end of Q
-    if( !found ) {
+    //add job to heap, ordered by eventTime
+    //with the root being the next event
+    index = HeapPush( timer, newEvent );
 
-        if( ListAddTail( &timer->eventQ, newEvent ) != NULL )
-            rc = 0;
-
-    }
-    //signal change in Q
-    if( rc == 0 ) {
-
-        ithread_cond_signal( &timer->condition );
+    if( index >= 0 ) {
+        rc = 0;
+        //only an earlier next event changes what the timer waits for
+        if( index == 0 )
+            ithread_cond_signal( &timer->condition );
     } else {
         FreeTimerEvent( timer, newEvent );
     }
@@ -418,8 +520,8 @@ TimerThreadRemove( TimerThread * timer,
                    ThreadPoolJob * out )
 {
     int rc = INVALID_EVENT_ID;
-    ListNode *tempNode = NULL;
     TimerEvent *temp = NULL;
+    int i;
 
     assert( timer != NULL );
 
@@ -429,21 +531,16 @@ TimerThreadRemove( TimerThread * timer,
 
     ithread_mutex_lock( &timer->mutex );
 
-    tempNode = ListHead( &timer->eventQ );
-
-    while( tempNode != NULL ) {
-        temp = ( TimerEvent * ) tempNode->item;
-        if( temp->id == id )
+    for( i = 0; i < timer->eventCount; i++ ) {
+        if( timer->eventHeap[i]->id == id )
         {
-
-            ListDelNode( &timer->eventQ, tempNode, 0 );
+            temp = HeapRemove( timer, i );
             if( out != NULL )
                 ( *out ) = temp->job;
             FreeTimerEvent( timer, temp );
             rc = 0;
             break;
         }
-        tempNode = ListNext( &timer->eventQ, tempNode );
     }
 
     ithread_mutex_unlock( &timer->mutex );
@@ -466,8 +563,7 @@ TimerThreadRemove( TimerThread * timer,
 int
 TimerThreadShutdown( TimerThread * timer )
 {
-    ListNode *tempNode2 = NULL;
-    ListNode *tempNode = NULL;
+    int i;
 
     assert( timer != NULL );
 
@@ -478,24 +574,23 @@ TimerThreadShutdown( TimerThread * timer )
     ithread_mutex_lock( &timer->mutex );
 
     timer->shutdown = 1;
-    tempNode = ListHead( &timer->eventQ );
 
-    //Delete nodes in Q
+    //Delete events in heap
     //call registered free function 
     //on argument
-    while( tempNode != NULL ) {
-        TimerEvent *temp = ( TimerEvent * ) tempNode->item;
+    for( i = 0; i < timer->eventCount; i++ ) {
+        TimerEvent *temp = timer->eventHeap[i];
 
-        tempNode2 = ListNext( &timer->eventQ, tempNode );
-        ListDelNode( &timer->eventQ, tempNode, 0 );
         if( temp->job.free_func ) {
             temp->job.free_func( temp->job.arg );
         }
         FreeTimerEvent( timer, temp );
-        tempNode = tempNode2;
     }
 
-    ListDestroy( &timer->eventQ, 0 );
+    free( timer->eventHeap );
+    timer->eventHeap = NULL;
+    timer->eventCount = 0;
+    timer->eventMax = 0;
     FreeListDestroy( &timer->freeEvents );
 
     ithread_cond_broadcast( &timer->condition );
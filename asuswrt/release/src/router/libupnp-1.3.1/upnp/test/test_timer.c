@@ -0,0 +1,113 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ * In-process stress test for the thread pool and the timer thread:
+ * schedules a few thousand timers at random times in the next seconds,
+ * cancels part of them, and checks that every other one fires exactly
+ * once and never early.
+ */
+
+#include "ThreadPool.h"
+#include "TimerThread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_EVENTS	4000
+#define MAX_DELAY	3
+
+static ithread_mutex_t	lock;
+static int		fired[NUM_EVENTS];
+static time_t		due[NUM_EVENTS];
+static int		early;
+
+
+static void *
+timer_job (void *arg)
+{
+	int i = (int) (long) arg;
+
+	ithread_mutex_lock (&lock);
+	fired[i]++;
+	if (time (NULL) < due[i])
+		early++;
+	ithread_mutex_unlock (&lock);
+
+	return NULL;
+}
+
+
+int
+main (int argc, char* argv[])
+{
+	ThreadPool tp;
+	ThreadPoolAttr attr;
+	ThreadPoolJob job;
+#ifdef STATS
+	ThreadPoolStats stats;
+#endif
+	TimerThread timer;
+	int id[NUM_EVENTS], removed[NUM_EVENTS];
+	int i, n_removed = 0, errors = 0;
+	time_t now;
+
+	ithread_mutex_init (&lock, NULL);
+	srand (time (NULL));
+
+	TPAttrInit (&attr);
+	TPAttrSetMaxThreads (&attr, 8);
+	if (ThreadPoolInit (&tp, &attr) != 0 ||
+	    TimerThreadInit (&timer, &tp) != 0) {
+		printf ("** ERROR init\n");
+		return 1;
+	}
+
+	now = time (NULL);
+	for (i = 0; i < NUM_EVENTS; i++) {
+		TPJobInit (&job, timer_job, (void *) (long) i);
+		due[i] = now + rand () % (MAX_DELAY + 1);
+		removed[i] = 0;
+		if (TimerThreadSchedule (&timer, due[i], ABS_SEC, &job,
+					 SHORT_TERM, &id[i]) != 0) {
+			printf ("** ERROR schedule %d\n", i);
+			return 1;
+		}
+	}
+
+	/* cancel every third event that has not been handed to the pool */
+	for (i = 0; i < NUM_EVENTS; i += 3) {
+		if (TimerThreadRemove (&timer, id[i], NULL) == 0) {
+			removed[i] = 1;
+			n_removed++;
+		}
+	}
+
+	sleep (MAX_DELAY + 2);
+
+	ithread_mutex_lock (&lock);
+	for (i = 0; i < NUM_EVENTS; i++) {
+		if (fired[i] != !removed[i]) {
+			printf ("** ERROR event %d fired %d times\n", i, fired[i]);
+			errors++;
+		}
+	}
+	ithread_mutex_unlock (&lock);
+	if (early) {
+		printf ("** ERROR %d events fired early\n", early);
+		errors++;
+	}
+
+	printf ("%d events, %d removed, %d errors\n",
+		NUM_EVENTS, n_removed, errors);
+
+#ifdef STATS
+	ThreadPoolGetStats (&tp, &stats);
+	ThreadPoolPrintStats (&stats);
+#endif
+
+	TimerThreadShutdown (&timer);
+	ThreadPoolShutdown (&tp);
+
+	return errors ? 1 : 0;
+}
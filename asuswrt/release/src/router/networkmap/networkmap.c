@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <time.h>
 #include "../shared/shutils.h"    // for eval()
 #include "../shared/rtstate.h"
 #include <bcmnvram.h>
@@ -772,9 +773,62 @@ static int QuerymUPnPCInfo(P_CLIENT_DETAIL_INFO_TABLE p_client_detail_info_tab,
 #endif
 
 #ifdef RTCONFIG_BONJOUR
+/*
+ * mDNSNetMonitor keeps rewriting its shm table, so it is copied out under
+ * its lock at most once per MDNS_SNAP_INTERVAL and looked up by address
+ * through a small hash index, instead of being walked for every client.
+ * Names are then never read half-written, and the shm is never modified.
+ */
+#define MDNS_SNAP_INTERVAL	1
+#define MDNS_HASH_SIZE		512	/* power of 2, > 255 */
+
+static mDNSClientList mdns_snap;
+static unsigned char mdns_hash[MDNS_HASH_SIZE];	/* entry index + 1, 0 = empty */
+static time_t mdns_snap_time;
+
+static unsigned int mdns_hash_ip(const unsigned char *ip)
+{
+	unsigned int h = (ip[0] << 24) | (ip[1] << 16) | (ip[2] << 8) | ip[3];
+
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+	return h & (MDNS_HASH_SIZE - 1);
+}
+
+static void mdns_snapshot(void)
+{
+	time_t now = time(NULL);
+	unsigned int h;
+	int i;
+
+	if (mdns_snap_time && now >= mdns_snap_time && now - mdns_snap_time < MDNS_SNAP_INTERVAL)
+		return;
+	mdns_snap_time = now;
+
+	mdns_lock = file_lock("mDNSNetMonitor");
+	memcpy(&mdns_snap, shmClientList, sizeof(mdns_snap));
+	file_unlock(mdns_lock);
+
+	memset(mdns_hash, 0, sizeof(mdns_hash));
+	for (i = 0; i < 255 && mdns_snap.IPaddr[i][0]; i++) {
+		mdns_snap.Name[i][sizeof(mdns_snap.Name[i]) - 1] = '\0';
+		mdns_snap.Model[i][sizeof(mdns_snap.Model[i]) - 1] = '\0';
+		toLowerCase(mdns_snap.Model[i]);
+
+		/* first entry of an address wins, as with the linear walk */
+		for (h = mdns_hash_ip(mdns_snap.IPaddr[i]); mdns_hash[h]; h = (h + 1) & (MDNS_HASH_SIZE - 1))
+			if (!memcmp(mdns_snap.IPaddr[mdns_hash[h] - 1], mdns_snap.IPaddr[i], 4))
+				break;
+		if (!mdns_hash[h])
+			mdns_hash[h] = i + 1;
+	}
+}
+
 static int QuerymDNSInfo(P_CLIENT_DETAIL_INFO_TABLE p_client_detail_info_tab, int x)
 {
-	unsigned char *a;
+	unsigned char *ip, *a;
+	unsigned int h;
 	int i;
 
 /*
@@ -786,29 +840,26 @@ p_client_detail_info_tab->ip_addr[x][2],
 p_client_detail_info_tab->ip_addr[x][3]
 );
 */
-	mdns_lock = file_lock("mDNSNetMonitor");
-
-	i = 0;
-	while(shmClientList->IPaddr[i][0]!=NULL && i<255 ) {
-		a = shmClientList->IPaddr[i];
-		if(!memcmp(a,p_client_detail_info_tab->ip_addr[p_client_detail_info_tab->ip_mac_num],4)) {
-			NMP_DEBUG_M("Query mDNS get: %d, %d.%d.%d.%d/%s/%s_\n", i,
-                        a[0],a[1],a[2],a[3], shmClientList->Name[i], shmClientList->Model[i]);
-			if(shmClientList->Name[i]!=NULL && strcmp(shmClientList->Name[i],p_client_detail_info_tab->device_name[x]))
-				strlcpy(p_client_detail_info_tab->device_name[x], shmClientList->Name[i], sizeof(p_client_detail_info_tab->device_name[x]));
-                        if(shmClientList->Model[i]!=NULL && strcmp(shmClientList->Name[i],p_client_detail_info_tab->apple_model[x]))
-				toLowerCase(shmClientList->Model[i]);
-                                AppleModelCheck(p_client_detail_info_tab->apple_model[x],
-						p_client_detail_info_tab->device_name[x],
-						&p_client_detail_info_tab->type[x],
-						shmClientList->Model[i]);
-			break;
-		}
-		i++;
+	mdns_snapshot();
+
+	ip = p_client_detail_info_tab->ip_addr[p_client_detail_info_tab->ip_mac_num];
+	for (h = mdns_hash_ip(ip); mdns_hash[h]; h = (h + 1) & (MDNS_HASH_SIZE - 1)) {
+		i = mdns_hash[h] - 1;
+		a = mdns_snap.IPaddr[i];
+		if (memcmp(a, ip, 4))
+			continue;
+
+		NMP_DEBUG_M("Query mDNS get: %d, %d.%d.%d.%d/%s/%s_\n", i,
+			a[0],a[1],a[2],a[3], mdns_snap.Name[i], mdns_snap.Model[i]);
+		if (*mdns_snap.Name[i] && strcmp(mdns_snap.Name[i], p_client_detail_info_tab->device_name[x]))
+			strlcpy(p_client_detail_info_tab->device_name[x], mdns_snap.Name[i], sizeof(p_client_detail_info_tab->device_name[x]));
+		AppleModelCheck(p_client_detail_info_tab->apple_model[x],
+				p_client_detail_info_tab->device_name[x],
+				&p_client_detail_info_tab->type[x],
+				mdns_snap.Model[i]);
+		break;
 	}
 
-	file_unlock(mdns_lock);
-
 	return 0;
 }
 #endif
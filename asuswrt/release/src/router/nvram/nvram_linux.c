@@ -34,6 +34,7 @@
 #define PATH_DEV_NVRAM "/dev/nvram"
 
 #define NVRAM_IOCTL_GET_SPACE	0x0001
+#define NVRAM_IOCTL_COMMIT_ASYNC	0x0002
 
 /* Globals */
 static int nvram_fd = -1;
@@ -239,6 +240,31 @@ finish:
 	return r;
 }
 
+/*
+ * Ask the driver to commit in the background. Bursts of requests are
+ * coalesced into one flash write; nvram_commit() still waits for it.
+ * Falls back to a synchronous commit on drivers without deferred commit.
+ */
+int nvram_commit_async(void)
+{
+	int r;
+
+	if (nvram_get(ASUS_STOP_COMMIT) != NULL)
+	{
+		cprintf("# skip nvram commit #\n");
+		return 0;
+	}
+
+	if (nvram_fd < 0) {
+		if ((r = nvram_init(NULL)) != 0) return r;
+	}
+
+	if ((r = ioctl(nvram_fd, NVRAM_IOCTL_COMMIT_ASYNC, NULL)) < 0)
+		return nvram_commit();
+
+	return r;
+}
+
 /*
  * Write a file to an NVRAM variable.
  * @param	name	name of variable to get
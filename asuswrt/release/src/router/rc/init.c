@@ -1321,6 +1321,53 @@ misc_defaults(int restore_defaults)
 	nvram_unset("reload_svc_radio");
 }
 
+static int
+nvram_name_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/*
+ * Take a sorted snapshot of the names currently in nvram, so that checking
+ * each of the router_defaults[] entries costs a lookup instead of a read()
+ * on /dev/nvram. The names point into *buf; both are freed by the caller.
+ */
+static int
+nvram_names_snapshot(char **buf, char ***names)
+{
+	char *name, *next, *p;
+	int count = 0;
+
+	*names = NULL;
+	if ((*buf = malloc(MAX_NVRAM_SPACE)) == NULL)
+		return -1;
+
+	if (nvram_getall(*buf, MAX_NVRAM_SPACE) != 0)
+		goto err;
+
+	for (name = *buf; *name; name += strlen(name) + 1)
+		count++;
+
+	if ((*names = malloc((count + 1) * sizeof(char *))) == NULL)
+		goto err;
+
+	count = 0;
+	for (name = *buf; *name; name = next) {
+		next = name + strlen(name) + 1;
+		if ((p = strchr(name, '=')) != NULL)
+			*p = '\0';
+		(*names)[count++] = name;
+	}
+	qsort(*names, count, sizeof(char *), nvram_name_cmp);
+
+	return count;
+
+err:
+	free(*buf);
+	*buf = NULL;
+	return -1;
+}
+
 /* ASUS use erase nvram to reset default only */
 static void
 restore_defaults(void)
@@ -1329,6 +1376,8 @@ restore_defaults(void)
 	int restore_defaults;
 	char prefix[] = "usb_pathXXXXXXXXXXXXXXXXX_", tmp[100];
 	int unit;
+	char *nvbuf = NULL, **names = NULL;
+	int count = -1;
 #ifdef RTCONFIG_DHDAP
 	int i;
 #endif
@@ -1372,6 +1421,9 @@ restore_defaults(void)
 #endif
 
 	/* Restore defaults */
+	if (!restore_defaults)
+		count = nvram_names_snapshot(&nvbuf, &names);
+
 	for (t = router_defaults; t->name; t++) {
 		// TODO: define RTCONFIG_XXX for this
 #if 1
@@ -1379,7 +1431,12 @@ restore_defaults(void)
 			continue;
 #endif
 
-		if (restore_defaults || !nvram_get(t->name)) {
+		/* Names missing from the snapshot are re-checked, since an
+		 * earlier duplicate entry of the table may have set them.
+		 */
+		if (restore_defaults ||
+		    (!(count > 0 && bsearch(&t->name, names, count, sizeof(char *), nvram_name_cmp)) &&
+		     !nvram_get(t->name))) {
 #if 0
 			// add special default value handle here
 			if (!strcmp(t->name, "computer_name") ||
@@ -1395,6 +1452,9 @@ restore_defaults(void)
 		}
 	}
 
+	free(names);
+	free(nvbuf);
+
 	wl_defaults();
 	lan_defaults();
 
@@ -6909,6 +6969,7 @@ dbg("boot/continue fail= %d/%d\n", nvram_get_int("Ate_boot_fail"),nvram_get_int(
 			start_dsl();
 #endif
 			start_lan();
+			boot_trace_mark("lan_ready");
 #ifdef RTCONFIG_QTN
 			start_qtn();
 			sleep(5);
@@ -6916,6 +6977,7 @@ dbg("boot/continue fail= %d/%d\n", nvram_get_int("Ate_boot_fail"),nvram_get_int(
 			misc_ioctrl();
 
 			start_services();
+			boot_trace_mark("services_ready");
 #ifdef CONFIG_BCMWL5
 			if (restore_defaults_g)
 			{
@@ -2140,27 +2140,60 @@ gmac3_no_swbr:
 
 void do_static_routes(int add)
 {
-	char *buf;
+	char *buf, *list;
 	char *p, *q;
 	char *dest, *mask, *gateway, *metric, *ifname;
-	int r;
+	struct rtnl_routes routes = { 0 }, retry;
+	int r, i, fails;
 
 	if ((buf = strdup(nvram_safe_get(add ? "routes_static" : "routes_static_saved"))) == NULL) return;
 	if (add) nvram_set("routes_static_saved", buf);
 		else nvram_unset("routes_static_saved");
-	p = buf;
+	if ((list = strdup(buf)) == NULL) {
+		free(buf);
+		return;
+	}
+	p = list;
 	while ((q = strsep(&p, ">")) != NULL) {
 		if (vstrsep(q, "<", &dest, &gateway, &mask, &metric, &ifname) != 5) continue;
 		ifname = nvram_safe_get((*ifname == 'L') ? "lan_ifname" :
 					((*ifname == 'W') ? "wan_iface" : "wan_ifname"));
-		if (add) {
-			for (r = 3; r >= 0; --r) {
-				if (route_add(ifname, atoi(metric) + 1, dest, gateway, mask) == 0) break;
-				sleep(1);
-			}
+		rtnl_route_queue(&routes, add ? RTNL_REPLACE : RTNL_DELETE, ifname, atoi(metric) + 1, dest, gateway, mask);
+	}
+	free(list);
+
+	/* send them all at once, then retry only the ones that failed */
+	for (r = 3; (fails = rtnl_route_batch(&routes)) > 0 && add && r > 0; --r) {
+		sleep(1);
+		memset(&retry, 0, sizeof(retry));
+		for (i = 0; i < routes.count; i++) {
+			struct rtnl_route *rt;
+
+			if (routes.rt[i].err && (rt = rtnl_route_new(&retry)) != NULL)
+				*rt = routes.rt[i];
 		}
-		else {
-			route_del(ifname, atoi(metric) + 1, dest, gateway, mask);
+		rtnl_routes_free(&routes);
+		routes = retry;
+	}
+	rtnl_routes_free(&routes);
+
+	if (fails < 0) {
+		/* no netlink socket, fall back to one ioctl per route */
+		logmessage("static routes", "netlink batch failed, %s routes one by one", add ? "adding" : "deleting");
+		p = buf;
+		while ((q = strsep(&p, ">")) != NULL) {
+			if (vstrsep(q, "<", &dest, &gateway, &mask, &metric, &ifname) != 5) continue;
+			ifname = nvram_safe_get((*ifname == 'L') ? "lan_ifname" :
+						((*ifname == 'W') ? "wan_iface" : "wan_ifname"));
+			if (add) {
+				for (r = 3; r >= 0; --r) {
+					if (route_add(ifname, atoi(metric) + 1, dest, gateway, mask) == 0) break;
+					sleep(1);
+				}
+			}
+			else {
+				route_del(ifname, atoi(metric) + 1, dest, gateway, mask);
+			}
 		}
 	}
 	free(buf);
@@ -3848,10 +3881,8 @@ void restart_wireless(void)
 
 #ifdef CONFIG_BCMWL5
 	/* for MultiSSID */
-	if(nvram_get_int("qos_enable") == 1) {
-		del_EbtablesRules(); // flush ebtables nat table
-		add_EbtablesRules();
-	}
+	if(nvram_get_int("qos_enable") == 1)
+		reload_EbtablesRules(); // rebuild ebtables nat table
 #endif
 
 #ifdef RTCONFIG_WIRELESSREPEATER
@@ -47,6 +47,119 @@ static int ovpn_waitfor(const char *name)
 	return (pid >= 0);
 }
 
+/* Set while start_vpn*() only rewrites the files of a running instance */
+static int ovpn_regen = 0;
+
+static unsigned int ovpn_file_hash(const char *path, const char *name)
+{
+	unsigned char buf[512];
+	unsigned int h = 2166136261U;	/* FNV-1a */
+	const char *p;
+	FILE *fp;
+	size_t n, i;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return 0;
+	for (p = name; *p; p++)
+		h = (h ^ (unsigned char)*p) * 16777619U;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		for (i = 0; i < n; i++)
+			h = (h ^ buf[i]) * 16777619U;
+	fclose(fp);
+
+	return h;
+}
+
+/*
+ * Hash of the files generated for one instance ("server" or "client"):
+ * config, certs/keys as written from /jffs or nvram and ccd entries. The
+ * status file the daemon writes is left out, and files are summed so the
+ * order readdir() returns them in does not matter.
+ */
+static unsigned int ovpn_settings_hash(const char *type, int unit)
+{
+	char dir[64], path[128];
+	struct dirent *de;
+	struct stat st;
+	unsigned int sum = 0;
+	DIR *d;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		snprintf(dir, sizeof(dir), "/etc/openvpn/%s%d%s", type, unit, i ? "/ccd" : "");
+		if ((d = opendir(dir)) == NULL)
+			continue;
+		while ((de = readdir(d)) != NULL) {
+			if (!strcmp(de->d_name, "status") || !strcmp(de->d_name, "generation"))
+				continue;
+			snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+			if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+				continue;
+			sum += ovpn_file_hash(path, de->d_name);
+		}
+		closedir(d);
+	}
+
+	return sum;
+}
+
+static void ovpn_settings_save(const char *type, int unit)
+{
+	char path[64], gen[16];
+
+	snprintf(path, sizeof(path), "/etc/openvpn/%s%d/generation", type, unit);
+	snprintf(gen, sizeof(gen), "%08x", ovpn_settings_hash(type, unit));
+	f_write_string(path, gen, 0, 0);
+}
+
+/*
+ * A restart of an instance that is running with files generated from the
+ * current settings would only drop and renegotiate every tunnel, so the
+ * service handlers skip it when this returns 1.
+ */
+static int ovpn_settings_unchanged(const char *type, int unit)
+{
+	char path[64], gen[16], cur[16];
+
+	snprintf(path, sizeof(path), "vpn%s%d", type, unit);
+	if (pidof(path) < 0)
+		return 0;
+
+	snprintf(path, sizeof(path), "/etc/openvpn/%s%d/generation", type, unit);
+	if (f_read_string(path, gen, sizeof(gen)) <= 0)
+		return 0;
+
+	/* Rewrite the files from the current settings, leaving the
+	 * interface and the daemon alone. ccd entries are only ever
+	 * added, so start that directory over.
+	 */
+	snprintf(path, sizeof(path), "/etc/openvpn/%s%d/ccd", type, unit);
+	eval("rm", "-rf", path);
+	ovpn_regen = 1;
+	if (!strcmp(type, "server"))
+		start_vpnserver(unit);
+	else
+		start_vpnclient(unit);
+	ovpn_regen = 0;
+
+	snprintf(cur, sizeof(cur), "%08x", ovpn_settings_hash(type, unit));
+	if (strcmp(gen, cur) != 0)
+		return 0;
+
+	vpnlog(VPN_LOG_NOTE, "VPN %s %d settings unchanged, keeping tunnels up", type, unit);
+	return 1;
+}
+
+int vpnclient_unchanged(int clientNum)
+{
+	return ovpn_settings_unchanged("client", clientNum);
+}
+
+int vpnserver_unchanged(int serverNum)
+{
+	return ovpn_settings_unchanged("server", serverNum);
+}
+
 void start_vpnclient(int clientNum)
 {
 	FILE *fp;
@@ -75,17 +188,20 @@ void start_vpnclient(int clientNum)
 
 	vpnlog(VPN_LOG_INFO,"VPN GUI client backend starting...");
 
-	if ( (pid = pidof(&buffer[6])) >= 0 )
+	if ( !ovpn_regen && (pid = pidof(&buffer[6])) >= 0 )
 	{
 		vpnlog(VPN_LOG_NOTE, "VPN Client %d already running...", clientNum);
 		vpnlog(VPN_LOG_INFO,"PID: %d", pid);
 		return;
 	}
 
-	sprintf(&buffer[0], "vpn_client%d_state", clientNum);
-	nvram_set(&buffer[0], "1");	//initializing
-	sprintf(&buffer[0], "vpn_client%d_errno", clientNum);
-	nvram_set(&buffer[0], "0");
+	if ( !ovpn_regen )
+	{
+		sprintf(&buffer[0], "vpn_client%d_state", clientNum);
+		nvram_set(&buffer[0], "1");	//initializing
+		sprintf(&buffer[0], "vpn_client%d_errno", clientNum);
+		nvram_set(&buffer[0], "0");
+	}
 
 	// Determine interface
 	sprintf(&buffer[0], "vpn_client%d_if", clientNum);
@@ -130,6 +246,8 @@ void start_vpnclient(int clientNum)
 	mkdir("/etc/openvpn", 0700);
 	sprintf(&buffer[0], "/etc/openvpn/client%d", clientNum);
 	mkdir(&buffer[0], 0700);
+	if ( ovpn_regen )
+		goto write_files;
 
 	// Make sure symbolic link exists
 	sprintf(&buffer[0], "/etc/openvpn/vpnclient%d", clientNum);
@@ -180,6 +298,7 @@ void start_vpnclient(int clientNum)
 		}
 	}
 
+write_files:
 	sprintf(&buffer[0], "vpn_client%d_userauth", clientNum);
 	userauth = nvram_get_int(&buffer[0]);
 	sprintf(&buffer[0], "vpn_client%d_useronly", clientNum);
@@ -400,6 +519,8 @@ void start_vpnclient(int clientNum)
 		}
 	}
 	vpnlog(VPN_LOG_EXTRA,"Done writing certs/keys");
+	if ( ovpn_regen )
+		return;
 
 	// Start the VPN client
 #if 0
@@ -473,6 +594,8 @@ void start_vpnclient(int clientNum)
 //	try_enabling_fastnat();
 #endif
 
+	ovpn_settings_save("client", clientNum);
+
 	vpnlog(VPN_LOG_INFO,"VPN GUI client backend complete.");
 }
 
@@ -594,17 +717,20 @@ void start_vpnserver(int serverNum)
 
 	vpnlog(VPN_LOG_INFO,"VPN GUI server backend starting...");
 
-	if ( (pid = pidof(&buffer[6])) >= 0 )
+	if ( !ovpn_regen && (pid = pidof(&buffer[6])) >= 0 )
 	{
 		vpnlog(VPN_LOG_NOTE, "VPN Server %d already running...", serverNum);
 		vpnlog(VPN_LOG_INFO,"PID: %d", pid);
 		return;
 	}
 
-	sprintf(&buffer[0], "vpn_server%d_state", serverNum);
-	nvram_set(&buffer[0], "1");	//initializing
-	sprintf(&buffer[0], "vpn_server%d_errno", serverNum);
-	nvram_set(&buffer[0], "0");
+	if ( !ovpn_regen )
+	{
+		sprintf(&buffer[0], "vpn_server%d_state", serverNum);
+		nvram_set(&buffer[0], "1");	//initializing
+		sprintf(&buffer[0], "vpn_server%d_errno", serverNum);
+		nvram_set(&buffer[0], "0");
+	}
 
 	// Determine interface type
 	sprintf(&buffer[0], "vpn_server%d_if", serverNum);
@@ -622,7 +748,7 @@ void start_vpnserver(int serverNum)
 	snprintf(&iface[0], IF_SIZE, "%s%d", nvram_safe_get(&buffer[0]), serverNum+SERVER_IF_START);
 
 	//
-	if(is_intf_up(&iface[0]) && ifType == TAP) {
+	if(!ovpn_regen && is_intf_up(&iface[0]) && ifType == TAP) {
 		eval("brctl", "delif", nvram_safe_get("lan_ifname"), &iface[0]);
 	}
 
@@ -644,6 +770,8 @@ void start_vpnserver(int serverNum)
 	mkdir("/etc/openvpn", 0700);
 	sprintf(&buffer[0], "/etc/openvpn/server%d", serverNum);
 	mkdir(&buffer[0], 0700);
+	if ( ovpn_regen )
+		goto write_files;
 
 	// Make sure symbolic link exists
 	sprintf(&buffer[0], "/etc/openvpn/vpnserver%d", serverNum);
@@ -692,6 +820,7 @@ void start_vpnserver(int serverNum)
 		return;
 	}
 
+write_files:
 	// Build and write config files
 	vpnlog(VPN_LOG_EXTRA,"Writing config file");
 	sprintf(&buffer[0], "/etc/openvpn/server%d/config.ovpn", serverNum);
@@ -1277,6 +1406,8 @@ void start_vpnserver(int serverNum)
 	fprintf(fp_client, "nobind\n");
 	fclose(fp_client);
 	vpnlog(VPN_LOG_EXTRA,"Done writing client config file");
+	if ( ovpn_regen )
+		return;
 
 #if 0
         if (cpu_num > 1)
@@ -1365,6 +1496,8 @@ void start_vpnserver(int serverNum)
 //	try_enabling_fastnat();
 #endif
 
+	ovpn_settings_save("server", serverNum);
+
 	vpnlog(VPN_LOG_INFO,"VPN GUI server backend complete.");
 }
 
@@ -404,16 +404,136 @@ pc_s *match_daytime_pc_list(pc_s *pc_list, pc_s **target_list, int target_day, i
 	return *target_list;
 }
 
+/*
+ * Weekly schedule as one hour bitmap per day: bit h of days[d] is set
+ * when the device may go out during hour h of day d (0 is Sunday).
+ * An event covers the same hours its old per-slot time rules did.
+ */
+static unsigned int hour_range(int start, int end)
+{
+	return ((end >= 24) ? PC_ALL_HOURS : ((1U << end)-1)) & ~((1U << start)-1);
+}
+
+void get_event_hours(pc_event_s *e, unsigned int days[7]){
+	int start_day = e->start_day, end_day = e->end_day, i;
+
+	if(start_day < 0 || start_day > 6 || end_day < 0 || end_day > 6)
+		return;
+
+	if(start_day == end_day){
+		if(e->start_hour == e->end_hour){ // whole week.
+			for(i = 0; i < 7; ++i)
+				days[i] = PC_ALL_HOURS;
+		}
+		else if(e->start_hour < e->end_hour)
+			days[start_day] |= hour_range(e->start_hour, e->end_hour);
+		else // the time match wraps over midnight.
+			days[start_day] |= hour_range(0, e->end_hour)|hour_range(e->start_hour, 24);
+	}
+	else if(start_day < end_day || end_day == 0){
+		if(end_day == 0)
+			end_day += 7;
+
+		days[start_day] |= hour_range(e->start_hour, 24);
+		for(i = start_day+1; i < end_day; ++i)
+			days[i] = PC_ALL_HOURS;
+		if(e->end_hour > 0)
+			days[end_day%7] |= hour_range(0, e->end_hour);
+	}
+	// Don't care "start_day > end_day".
+}
+
+void get_pc_hours(pc_s *pc, unsigned int days[7]){
+	pc_event_s *follow_e;
+
+	memset(days, 0, 7*sizeof(unsigned int));
+	for(follow_e = pc->events; follow_e != NULL; follow_e = follow_e->next)
+		get_event_hours(follow_e, days);
+}
+
+int is_pc_whole_week(unsigned int days[7]){
+	int i;
+
+	for(i = 0; i < 7; ++i)
+		if(days[i] != PC_ALL_HOURS)
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Print the rules sending the hours of days[] to target: days with the
+ * same hours share a rule, a run of hours takes a single time match.
+ * lan_if and mac may be NULL. Returns the number of rules.
+ */
+int print_pc_hour_rules(FILE *fp, char *chain, char *lan_if, char *mac, unsigned int days[7], char *target){
+	char *datestr[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	unsigned int hours, done = 0;
+	int day, i, start, end, count = 0;
+
+	if(is_pc_whole_week(days)){
+		fprintf(fp, "-A %s", chain);
+		if(lan_if)
+			fprintf(fp, " -i %s", lan_if);
+		if(mac)
+			fprintf(fp, " -m mac --mac-source %s", mac);
+		fprintf(fp, " -j %s\n", target);
+		return 1;
+	}
+
+	for(day = 0; day < 7; ++day){
+		hours = days[day];
+		if((done & (1 << day)) || hours == 0)
+			continue;
+
+		for(i = day; i < 7; ++i)
+			if(days[i] == hours)
+				done |= 1 << i;
+
+		for(start = 0; start < 24; start = end){
+			while(start < 24 && !(hours & (1U << start)))
+				++start;
+			if(start == 24)
+				break;
+			for(end = start; end < 24 && (hours & (1U << end)); ++end)
+				;
+
+			fprintf(fp, "-A %s", chain);
+			if(lan_if)
+				fprintf(fp, " -i %s", lan_if);
+			fprintf(fp, " -m time");
+			if(start > 0)
+				fprintf(fp, " --timestart %d:0", start);
+			if(end < 24)
+				fprintf(fp, " --timestop %d:0", end);
+			fprintf(fp, DAYS_PARAM);
+			for(i = day; i < 7; ++i)
+				if(days[i] == hours)
+					fprintf(fp, "%s%s", (i == day)?"":",", datestr[i]);
+			if(mac)
+				fprintf(fp, " -m mac --mac-source %s", mac);
+			fprintf(fp, " -j %s\n", target);
+			++count;
+		}
+	}
+
+	return count;
+}
+
 // Parental Control:
 // MAC address not in list -> ACCEPT.
 // MAC address in list and in time period -> ACCEPT.
 // MAC address in list and not in time period -> DROP.
+//
+// Every device gets one MAC rule in FORWARD jumping to its own chain,
+// which holds the merged time rules of its schedule. Traffic of other
+// devices never goes through any time match.
 void config_daytime_string(FILE *fp, char *logaccept, char *logdrop)
 {
 	pc_s *pc_list = NULL, *enabled_list = NULL, *follow_pc;
-	pc_event_s *follow_e;
 	char *lan_if = nvram_safe_get("lan_ifname");
-	char *datestr[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	unsigned int days[7];
+	char chain[32];
 	int i;
 	char *default_policy, *ftype, *fftype;
 
@@ -434,88 +554,27 @@ void config_daytime_string(FILE *fp, char *logaccept, char *logdrop)
 		return;
 	}
 
-	for(follow_pc = enabled_list; follow_pc != NULL; follow_pc = follow_pc->next){
-		for(follow_e = follow_pc->events; follow_e != NULL; follow_e = follow_e->next){
-			if(follow_e->start_day == follow_e->end_day){
-				if(follow_e->start_hour == follow_e->end_hour){ // whole week.
-#ifdef BLOCKLOCAL
-					fprintf(fp, "-A FORWARD -i %s -m mac --mac-source %s -j %s\n", lan_if, follow_pc->mac, ftype);
-#endif
-					fprintf(fp, "-A FORWARD -i %s -m mac --mac-source %s -j %s\n", lan_if, follow_pc->mac, fftype);
-				}
-				else{
-#ifdef BLOCKLOCAL
-					fprintf(fp, "-A INPUT -i %s -m time", lan_if);
-					if(follow_e->start_hour > 0)
-						fprintf(fp, " --timestart %d:0", follow_e->start_hour);
-					if(follow_e->end_hour < 24)
-						fprintf(fp, " --timestop %d:0", follow_e->end_hour);
-					fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j %s\n", datestr[follow_e->start_day], follow_pc->mac, ftype);
-#endif
-					fprintf(fp, "-A FORWARD -i %s -m time", lan_if);
-					if(follow_e->start_hour > 0)
-						fprintf(fp, " --timestart %d:0", follow_e->start_hour);
-					if(follow_e->end_hour < 24)
-						fprintf(fp, " --timestop %d:0", follow_e->end_hour);
-					fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j %s\n", datestr[follow_e->start_day], follow_pc->mac, fftype);
-				}
-			}
-			else if(follow_e->start_day < follow_e->end_day
-					|| follow_e->end_day == 0
-					){ // start_day < end_day.
-				if(follow_e->end_day == 0)
-					follow_e->end_day += 7;
+	for(i = 0, follow_pc = enabled_list; follow_pc != NULL; ++i, follow_pc = follow_pc->next){
+		get_pc_hours(follow_pc, days);
 
-				// first interval.
 #ifdef BLOCKLOCAL
-				fprintf(fp, "-A INPUT -i %s -m time", lan_if);
-				if(follow_e->start_hour > 0)
-					fprintf(fp, " --timestart %d:0", follow_e->start_hour);
-				fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j %s\n", datestr[follow_e->start_day], follow_pc->mac, ftype);
+		print_pc_hour_rules(fp, "INPUT", lan_if, follow_pc->mac, days, ftype);
+		fprintf(fp, "-A INPUT -i %s -m mac --mac-source %s -j DROP\n", lan_if, follow_pc->mac);
 #endif
-				fprintf(fp, "-A FORWARD -i %s -m time", lan_if);
-				if(follow_e->start_hour > 0)
-					fprintf(fp, " --timestart %d:0", follow_e->start_hour);
-				fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j %s\n", datestr[follow_e->start_day], follow_pc->mac, fftype);
+		if(is_pc_whole_week(days)){
+			fprintf(fp, "-A FORWARD -i %s -m mac --mac-source %s -j %s\n", lan_if, follow_pc->mac, fftype);
+			continue;
+		}
 
-				// middle interval.
-				if(follow_e->end_day-follow_e->start_day > 1){
-#ifdef BLOCKLOCAL
-					fprintf(fp, "-A INPUT -i %s -m time" DAYS_PARAM, lan_if);
-					for(i = follow_e->start_day+1; i < follow_e->end_day; ++i)
-						fprintf(fp, "%s%s", (i == follow_e->start_day+1)?"":",", datestr[i]);
-					fprintf(fp, " -m mac --mac-source %s -j %s\n", follow_pc->mac, ftype);
-#endif
+		snprintf(chain, sizeof(chain), "PControls%d", i);
+		fprintf(fp, ":%s - [0:0]\n", chain);
+		fprintf(fp, "-A FORWARD -i %s -m mac --mac-source %s -j %s\n", lan_if, follow_pc->mac, chain);
 
-					fprintf(fp, "-A FORWARD -i %s -m time" DAYS_PARAM, lan_if);
-					for(i = follow_e->start_day+1; i < follow_e->end_day; ++i)
-						fprintf(fp, "%s%s", (i == follow_e->start_day+1)?"":",", datestr[i]);
-					fprintf(fp, " -m mac --mac-source %s -j %s\n", follow_pc->mac, fftype);
-				}
-
-				// end interval.
-				if(follow_e->end_hour > 0){
-#ifdef BLOCKLOCAL
-					fprintf(fp, "-A INPUT -i %s -m time", lan_if);
-					if(follow_e->end_hour < 24)
-						fprintf(fp, " --timestop %d:0", follow_e->end_hour);
-					fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j %s\n", datestr[follow_e->end_day], follow_pc->mac, ftype);
-#endif
-					fprintf(fp, "-A FORWARD -i %s -m time", lan_if);
-					if(follow_e->end_hour < 24)
-						fprintf(fp, " --timestop %d:0", follow_e->end_hour);
-					fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j %s\n", datestr[follow_e->end_day], follow_pc->mac, fftype);
-				}
-			}
-			else
-				; // Don't care "start_day > end_day".
-		}
+		// MAC address in list and in time period -> ACCEPT.
+		print_pc_hour_rules(fp, chain, NULL, NULL, days, fftype);
 
 		// MAC address in list and not in time period -> DROP.
-#ifdef BLOCKLOCAL
-		fprintf(fp, "-A INPUT -i %s -m mac --mac-source %s -j DROP\n", lan_if, follow_pc->mac);
-#endif
-		fprintf(fp, "-A FORWARD -i %s -m mac --mac-source %s -j DROP\n", lan_if, follow_pc->mac);
+		fprintf(fp, "-A %s -j DROP\n", chain);
 	}
 
 	free_pc_list(&enabled_list);
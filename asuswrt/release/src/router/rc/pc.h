@@ -23,3 +23,10 @@ struct pc{
 	pc_s *next;
 };
 
+#define PC_ALL_HOURS 0xffffff
+
+extern void get_event_hours(pc_event_s *e, unsigned int days[7]);
+extern void get_pc_hours(pc_s *pc, unsigned int days[7]);
+extern int is_pc_whole_week(unsigned int days[7]);
+extern int print_pc_hour_rules(FILE *fp, char *chain, char *lan_if, char *mac, unsigned int days[7], char *target);
+
@@ -4,13 +4,11 @@
 void config_blocking_redirect(FILE *fp){
 
 	pc_s *pc_list = NULL, *enabled_list = NULL, *follow_pc;
-	pc_event_s *follow_e;
 	char *lan_if = nvram_safe_get("lan_ifname");
 	char *lan_ip = nvram_safe_get("lan_ipaddr");
 	char *lan_mask = nvram_safe_get("lan_netmask");
-	char *datestr[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	unsigned int days[7];
 	char *fftype;
-	int i;
 
 	fftype = "PCREDIRECT";
 
@@ -29,52 +27,8 @@ void config_blocking_redirect(FILE *fp){
 
 	for(follow_pc = enabled_list; follow_pc != NULL; follow_pc = follow_pc->next){
 		fprintf(fp, "-A PREROUTING -i %s -m mac --mac-source %s -j %s\n", lan_if, follow_pc->mac, fftype);	
-                for(follow_e = follow_pc->events; follow_e != NULL; follow_e = follow_e->next){
-                        if(follow_e->start_day == follow_e->end_day){
-                                if(follow_e->start_hour == follow_e->end_hour){ // whole week.
-					fprintf(fp, "-A %s -i %s -m mac --mac-source %s -j ACCEPT\n", fftype, lan_if, follow_pc->mac);
-                                }
-                                else{
-					fprintf(fp, "-A %s -i %s -m time", fftype, lan_if);
-                                        if(follow_e->start_hour > 0)
-                                                fprintf(fp, " --timestart %d:0", follow_e->start_hour);
-                                        if(follow_e->end_hour < 24)
-                                                fprintf(fp, " --timestop %d:0", follow_e->end_hour);
-					fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j ACCEPT\n", datestr[follow_e->start_day], follow_pc->mac);
-                                }
-                        }
-                        else if(follow_e->start_day < follow_e->end_day
-                                        || follow_e->end_day == 0
-                                        ){ // start_day < end_day.
-                                if(follow_e->end_day == 0)
-                                        follow_e->end_day += 7;
-
-				// first interval.
-				fprintf(fp, "-A %s -i %s -m time", fftype, lan_if);
-                                if(follow_e->start_hour > 0)
-                                        fprintf(fp, " --timestart %d:0", follow_e->start_hour);
-				fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j ACCEPT\n", datestr[follow_e->start_day], follow_pc->mac);
-
-                                // middle interval.
-                                if(follow_e->end_day-follow_e->start_day > 1){
-
-					fprintf(fp, "-A %s -i %s -m time" DAYS_PARAM, fftype, lan_if);
-                                        for(i = follow_e->start_day+1; i < follow_e->end_day; ++i)
-                                                fprintf(fp, "%s%s", (i == follow_e->start_day+1)?"":",", datestr[i]);
-					fprintf(fp, " -m mac --mac-source %s -j ACCEPT\n", follow_pc->mac);
-                                }
-
-                                // end interval.
-                                if(follow_e->end_hour > 0){
-                                        fprintf(fp, "-A %s -i %s -m time", fftype, lan_if);
-					if(follow_e->end_hour < 24)
-                                                fprintf(fp, " --timestop %d:0", follow_e->end_hour);
-					fprintf(fp, DAYS_PARAM "%s -m mac --mac-source %s -j ACCEPT\n", datestr[follow_e->end_day], follow_pc->mac);
-                                }
-                        }
-                        else
-                                ; // Don't care "start_day > end_day".
-                }
+		get_pc_hours(follow_pc, days);
+		print_pc_hour_rules(fp, fftype, lan_if, follow_pc->mac, days, "ACCEPT");
 
                 // MAC address in list and not in time period -> Redirect to blocking page.
 		fprintf(fp, "-A %s -i %s ! -d %s/%s -p tcp --dport 80 -m mac --mac-source %s -j DNAT --to-destination %s:%s\n", fftype, lan_if,lan_ip, lan_mask, follow_pc->mac, lan_ip, DFT_SERV_PORT);
@@ -0,0 +1,526 @@
+/*
+	probe.c - internet reachability probes
+
+	DNS queries, TCP connects to the DNS servers and an ICMP echo are all
+	non-blocking and driven by one poll() loop under a single deadline, so
+	a check costs at most one timeout and never forks. Each probe kind
+	succeeds when any of its attempts does, and the round ends early once
+	the requested quorum of kinds got through.
+*/
+
+#include <rc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <arpa/inet.h>
+#include <sys/syscall.h>
+
+#define PROBE_MAX_SERVERS	4
+#define PROBE_MAX_TASKS		(3 * PROBE_MAX_SERVERS)
+#define PROBE_PKT_SIZE		512
+#define PROBE_ICMP_DATA		32
+
+enum {
+	TASK_DNS = 0,		/* answer checked against dns_content */
+	TASK_RESOLVE,		/* icmp_target lookup, becomes TASK_ICMP */
+	TASK_TCP,
+	TASK_ICMP,
+	TASK_DONE
+};
+
+struct probe_task {
+	int kind;		/* PROBE_xxx it reports to */
+	int state;		/* TASK_xxx */
+	int fd;
+	int answers;		/* DNS replies still expected */
+	unsigned short id;
+	struct in_addr addr;	/* server, or ICMP target */
+};
+
+struct dns_addr {
+	int family;
+	unsigned char addr[16];
+};
+
+static int probe_debug;
+
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC 1
+#endif
+
+/* Milliseconds on the monotonic clock. libshared's clock_gettime() is
+ * gettimeofday() whatever the clock asked for, so go to the kernel.
+ */
+static long long probe_now_ms(void)
+{
+	struct timespec ts;
+
+	if (syscall(__NR_clock_gettime, CLOCK_MONOTONIC, &ts) < 0)
+		return time(NULL) * 1000LL;
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static int probe_socket(int type, int proto)
+{
+	int fd;
+
+	if ((fd = socket(AF_INET, type, proto)) < 0)
+		return -1;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	return fd;
+}
+
+static void task_done(struct probe_task *t)
+{
+	if (t->fd >= 0)
+		close(t->fd);
+	t->fd = -1;
+	t->state = TASK_DONE;
+}
+
+/* Standard query with recursion desired; returns its length or -1 */
+static int dns_build(unsigned char *buf, int size, unsigned short id, const char *name, int type)
+{
+	unsigned char *p = buf + 12;
+	const char *dot;
+	int len;
+
+	memset(buf, 0, 12);
+	buf[0] = id >> 8;
+	buf[1] = id & 0xff;
+	buf[2] = 0x01;		/* RD */
+	buf[5] = 1;		/* QDCOUNT */
+
+	while (*name) {
+		dot = strchr(name, '.') ? : name + strlen(name);
+		len = dot - name;
+		if (len == 0 || len > 63 || p + len + 6 > buf + size)
+			return -1;
+		*p++ = len;
+		memcpy(p, name, len);
+		p += len;
+		name = *dot ? dot + 1 : dot;
+	}
+	*p++ = 0;
+	*p++ = 0;
+	*p++ = type;
+	*p++ = 0;
+	*p++ = 1;		/* IN */
+
+	return p - buf;
+}
+
+static unsigned char *dns_skip_name(unsigned char *p, unsigned char *end)
+{
+	while (p < end) {
+		if ((*p & 0xc0) == 0xc0)
+			return p + 2;
+		if (*p == 0)
+			return p + 1;
+		p += *p + 1;
+	}
+
+	return NULL;
+}
+
+/* Addresses of the answer to query id; returns their number or -1 */
+static int dns_parse(unsigned char *buf, int len, unsigned short id, struct dns_addr *out, int max)
+{
+	unsigned char *p, *end = buf + len;
+	int qd, an, type, rdlen, n = 0;
+
+	if (len < 12 || ((buf[0] << 8) | buf[1]) != id || !(buf[2] & 0x80) || (buf[3] & 0x0f))
+		return -1;
+
+	qd = (buf[4] << 8) | buf[5];
+	an = (buf[6] << 8) | buf[7];
+	p = buf + 12;
+	while (qd-- > 0) {
+		if ((p = dns_skip_name(p, end)) == NULL || (p += 4) > end)
+			return -1;
+	}
+
+	while (an-- > 0 && n < max) {
+		if ((p = dns_skip_name(p, end)) == NULL || p + 10 > end)
+			return -1;
+		type = (p[0] << 8) | p[1];
+		rdlen = (p[8] << 8) | p[9];
+		p += 10;
+		if (p + rdlen > end)
+			return -1;
+
+		if (type == 1 && rdlen == 4) {
+			out[n].family = AF_INET;
+			memcpy(out[n++].addr, p, 4);
+		}
+#ifdef RTCONFIG_IPV6
+		else if (type == 28 && rdlen == 16) {
+			out[n].family = AF_INET6;
+			memcpy(out[n++].addr, p, 16);
+		}
+#endif
+		p += rdlen;
+	}
+
+	return n;
+}
+
+/* "*" accepts any address, as the old getaddrinfo() probe did */
+static int dns_content_match(struct dns_addr *a, char *content)
+{
+	unsigned char target[16];
+	char word[64], *next;
+
+	foreach (word, content, next) {
+		if (strcmp(word, "*") == 0)
+			return 1;
+		if (inet_pton(a->family, word, target) > 0 &&
+		    memcmp(a->addr, target, (a->family == AF_INET) ? 4 : 16) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int dns_send(struct probe_task *t, const char *name, int type)
+{
+	unsigned char pkt[PROBE_PKT_SIZE];
+	struct sockaddr_in sin;
+	int len;
+
+	if ((len = dns_build(pkt, sizeof(pkt), t->id + (type != 1), name, type)) < 0)
+		return -1;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(53);
+	sin.sin_addr = t->addr;
+
+	return sendto(t->fd, pkt, len, 0, (struct sockaddr *) &sin, sizeof(sin));
+}
+
+static unsigned short probe_cksum(unsigned short *w, int len)
+{
+	unsigned int sum = 0;
+
+	for (; len > 1; len -= 2)
+		sum += *w++;
+	if (len == 1)
+		sum += *(unsigned char *) w;
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum += (sum >> 16);
+
+	return ~sum;
+}
+
+static int icmp_send(struct probe_task *t, int ttl)
+{
+	unsigned char pkt[sizeof(struct icmphdr) + PROBE_ICMP_DATA];
+	struct icmphdr *icmp = (struct icmphdr *) pkt;
+	struct sockaddr_in sin;
+	int pmtu = IP_PMTUDISC_DONT;
+
+	if ((t->fd = probe_socket(SOCK_RAW, IPPROTO_ICMP)) < 0)
+		return -1;
+	setsockopt(t->fd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+	if (ttl > 0)
+		setsockopt(t->fd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+
+	memset(pkt, 0, sizeof(pkt));
+	icmp->type = ICMP_ECHO;
+	icmp->un.echo.id = htons(t->id);
+	icmp->un.echo.sequence = htons(1);
+	icmp->checksum = probe_cksum((unsigned short *) pkt, sizeof(pkt));
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr = t->addr;
+
+	t->state = TASK_ICMP;
+	return sendto(t->fd, pkt, sizeof(pkt), 0, (struct sockaddr *) &sin, sizeof(sin));
+}
+
+/* 1 on a matching echo reply, 0 if none yet */
+static int icmp_recv(struct probe_task *t)
+{
+	unsigned char pkt[PROBE_PKT_SIZE];
+	struct sockaddr_in from;
+	socklen_t fromlen;
+	struct icmphdr *icmp;
+	int len, hlen;
+
+	for (;;) {
+		fromlen = sizeof(from);
+		if ((len = recvfrom(t->fd, pkt, sizeof(pkt), 0, (struct sockaddr *) &from, &fromlen)) < 0)
+			return 0;
+
+		/* raw sockets see every ICMP packet, with the IP header */
+		hlen = (pkt[0] & 0x0f) << 2;
+		if (len < hlen + (int) sizeof(struct icmphdr) || from.sin_addr.s_addr != t->addr.s_addr)
+			continue;
+		icmp = (struct icmphdr *) (pkt + hlen);
+		if (icmp->type == ICMP_ECHOREPLY && ntohs(icmp->un.echo.id) == t->id)
+			return 1;
+	}
+}
+
+static int tcp_start(struct probe_task *t)
+{
+	struct sockaddr_in sin;
+
+	if ((t->fd = probe_socket(SOCK_STREAM, 0)) < 0)
+		return -1;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(53);
+	sin.sin_addr = t->addr;
+
+	if (connect(t->fd, (struct sockaddr *) &sin, sizeof(sin)) == 0)
+		return 1;
+
+	return (errno == EINPROGRESS) ? 0 : -1;
+}
+
+/* IPv4 servers from the list, or from resolv.conf if it is empty */
+static int probe_servers(char *list, struct in_addr *addr, int max)
+{
+	char word[64], line[128], *next;
+	int n = 0;
+	FILE *fp;
+
+	if (list && *list) {
+		foreach (word, list, next) {
+			if (n < max && inet_aton(word, &addr[n]))
+				n++;
+		}
+		return n;
+	}
+
+	if ((fp = fopen("/etc/resolv.conf", "r")) == NULL)
+		return 0;
+	while (n < max && fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "nameserver %63s", word) == 1 && inet_aton(word, &addr[n]))
+			n++;
+	}
+	fclose(fp);
+
+	return n;
+}
+
+static void probe_log(struct probe_task *t, const char *what)
+{
+	static const char *names[] = { "dns", "tcp", "icmp" };
+
+	if (probe_debug)
+		_dprintf("probe: %s %s %s\n", names[t->kind], inet_ntoa(t->addr), what);
+}
+
+/* One readable/writable event on task t; returns 1 when its kind succeeded */
+static int task_event(struct probe_set *ps, struct probe_task *t)
+{
+	unsigned char pkt[PROBE_PKT_SIZE];
+	struct dns_addr addr[8];
+	int len, n, i, err;
+	socklen_t errlen;
+
+	switch (t->state) {
+	case TASK_DNS:
+	case TASK_RESOLVE:
+		if ((len = recv(t->fd, pkt, sizeof(pkt), 0)) <= 0)
+			return 0;
+		n = dns_parse(pkt, len, t->id, addr, ARRAY_SIZE(addr));
+		if (n < 0)
+			n = dns_parse(pkt, len, t->id + 1, addr, ARRAY_SIZE(addr));
+		if (n < 0)
+			return 0;
+
+		for (i = 0; i < n; i++) {
+			if (t->state == TASK_DNS && dns_content_match(&addr[i], ps->dns_content)) {
+				probe_log(t, "ok");
+				return 1;
+			}
+			if (t->state == TASK_RESOLVE && addr[i].family == AF_INET) {
+				/* the first answer decides the ping target */
+				close(t->fd);
+				memcpy(&t->addr, addr[i].addr, 4);
+				if (icmp_send(t, ps->ttl) < 0)
+					task_done(t);
+				return 0;
+			}
+		}
+		/* answered, but not with what we expect; other servers may */
+		if (--t->answers <= 0) {
+			probe_log(t, "no match");
+			task_done(t);
+		}
+		return 0;
+
+	case TASK_TCP:
+		err = 0;
+		errlen = sizeof(err);
+		if (getsockopt(t->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0 || err) {
+			probe_log(t, "refused");
+			task_done(t);
+			return 0;
+		}
+		probe_log(t, "ok");
+		return 1;
+
+	case TASK_ICMP:
+		if (icmp_recv(t)) {
+			probe_log(t, "ok");
+			return 1;
+		}
+		return 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Run the probes selected in ps->flags concurrently for at most
+ * ps->timeout_ms, or until ps->quorum kinds succeeded (0: wait for all).
+ * ps->ok[kind] is set to 1 (reached), 0 (failed or not finished) or -1
+ * (not run). Returns the number of kinds that succeeded.
+ */
+int run_probes(struct probe_set *ps)
+{
+	struct probe_task task[PROBE_MAX_TASKS];
+	struct pollfd pfd[PROBE_MAX_TASKS];
+	int map[PROBE_MAX_TASKS];
+	struct in_addr server[PROBE_MAX_SERVERS];
+	struct in_addr target;
+	int nserver, ntask = 0, n, i, k, wait, pending, ok = 0;
+	unsigned short id;
+	long long deadline;
+
+	probe_debug = nvram_get_int("probe_debug");
+	for (k = 0; k < PROBE_MAX; k++)
+		ps->ok[k] = (ps->flags & (1 << k)) ? 0 : -1;
+
+	nserver = probe_servers(ps->servers, server, PROBE_MAX_SERVERS);
+	id = (getpid() ^ (unsigned int) time(NULL)) & 0xfffe;
+
+	for (i = 0; i < nserver; i++) {
+		if ((ps->flags & PROBE_F_DNS) && is_valid_domainname(ps->dns_host) && *ps->dns_content) {
+			struct probe_task *t = &task[ntask++];
+
+			t->kind = PROBE_DNS;
+			t->state = TASK_DNS;
+			t->addr = server[i];
+			t->id = id;
+			t->answers = 1;
+			id += 2;
+			if ((t->fd = probe_socket(SOCK_DGRAM, 0)) < 0 || dns_send(t, ps->dns_host, 1) < 0)
+				task_done(t);
+#ifdef RTCONFIG_IPV6
+			else if (ipv6_enabled() && dns_send(t, ps->dns_host, 28) > 0)
+				t->answers++;
+#endif
+		}
+		if (ps->flags & PROBE_F_TCP) {
+			struct probe_task *t = &task[ntask++];
+
+			t->kind = PROBE_TCP;
+			t->state = TASK_TCP;
+			t->addr = server[i];
+			switch (tcp_start(t)) {
+			case 1:
+				ps->ok[PROBE_TCP] = 1;
+				/* fall through */
+			case -1:
+				task_done(t);
+			}
+		}
+	}
+
+	if ((ps->flags & PROBE_F_ICMP) && ps->icmp_target) {
+		if (inet_aton(ps->icmp_target, &target)) {
+			struct probe_task *t = &task[ntask++];
+
+			t->kind = PROBE_ICMP;
+			t->addr = target;
+			t->id = id;
+			id += 2;
+			if (icmp_send(t, ps->ttl) < 0)
+				task_done(t);
+		} else if (is_valid_domainname(ps->icmp_target)) {
+			for (i = 0; i < nserver; i++) {
+				struct probe_task *t = &task[ntask++];
+
+				t->kind = PROBE_ICMP;
+				t->state = TASK_RESOLVE;
+				t->addr = server[i];
+				t->id = id;
+				t->answers = 1;
+				if ((t->fd = probe_socket(SOCK_DGRAM, 0)) < 0 || dns_send(t, ps->icmp_target, 1) < 0)
+					task_done(t);
+			}
+			id += 2;
+		}
+	}
+
+	deadline = probe_now_ms() + ps->timeout_ms;
+	for (;;) {
+		for (k = ok = 0; k < PROBE_MAX; k++)
+			ok += (ps->ok[k] == 1);
+		if (ps->quorum > 0 && ok >= ps->quorum)
+			break;
+
+		n = 0;
+		pending = 0;
+		for (i = 0; i < ntask; i++) {
+			if (task[i].state == TASK_DONE)
+				continue;
+			if (ps->ok[task[i].kind] == 1) {
+				/* kind already reached, stop its other attempts */
+				task_done(&task[i]);
+				continue;
+			}
+			pfd[n].fd = task[i].fd;
+			pfd[n].events = (task[i].state == TASK_TCP) ? POLLOUT : POLLIN;
+			pfd[n].revents = 0;
+			map[n++] = i;
+			pending = 1;
+		}
+		if (!pending)
+			break;
+
+		if ((wait = deadline - probe_now_ms()) <= 0)
+			break;
+		if (poll(pfd, n, wait) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct probe_task *t = &task[map[i]];
+
+			if (!pfd[i].revents || t->state == TASK_DONE)
+				continue;
+			if (task_event(ps, t))
+				ps->ok[t->kind] = 1;
+			else if ((pfd[i].revents & (POLLERR | POLLHUP)) && t->state != TASK_TCP)
+				task_done(t);
+		}
+	}
+
+	for (i = 0; i < ntask; i++) {
+		if (task[i].state != TASK_DONE && ps->ok[task[i].kind] != 1)
+			probe_log(&task[i], "timeout");
+		task_done(&task[i]);
+	}
+
+	for (k = ok = 0; k < PROBE_MAX; k++)
+		ok += (ps->ok[k] == 1);
+
+	return ok;
+}
@@ -105,16 +105,21 @@ void del_EbtablesRules(void)
 	etable_flag = 0;
 }
 
-void add_EbtablesRules(void)
+static void __add_EbtablesRules(int flush)
 {
-	if(etable_flag == 1) return;
+	ebt_batch_t b;
 	char *nv, *p, *g;
+
+	if (ebt_batch_open(&b) < 0) return;
+	if (flush) ebt_batch(&b, "nat", "-F");
+
 	nv = g = strdup(nvram_safe_get("wl_ifnames"));
 	if(nv){
 		while ((p = strsep(&g, " ")) != NULL){
 			//fprintf(stderr, "%s: g=%s, p=%s\n", __FUNCTION__, g, p); //tmp test
-			eval("ebtables", "-t", "nat", "-A", "PREROUTING", "-i", p, "-j", "mark", "--mark-or", "6", "--mark-target", "ACCEPT");
-			eval("ebtables", "-t", "nat", "-A", "POSTROUTING", "-o", p, "-j", "mark", "--mark-or", "6", "--mark-target", "ACCEPT");
+			if (*p == '\0') continue;
+			ebt_batch(&b, "nat", "-A PREROUTING -i %s -j mark --mark-or 6 --mark-target ACCEPT", p);
+			ebt_batch(&b, "nat", "-A POSTROUTING -o %s -j mark --mark-or 6 --mark-target ACCEPT", p);
 		}
 		free(nv);
 	}
@@ -131,8 +136,8 @@ void add_EbtablesRules(void)
 			snprintf(mssid_enable, sizeof(mssid_enable), "%s_bss_enabled", mssid_if);
 			//fprintf(stderr, "%s: mssid_enable=%s\n", __FUNCTION__, mssid_enable); //tmp test
 			if(!strcmp(nvram_safe_get(mssid_enable), "1")){
-				eval("ebtables", "-t", "nat", "-A", "PREROUTING", "-i", mssid_if, "-j", "mark", "--mark-or", "6", "--mark-target", "ACCEPT");
-				eval("ebtables", "-t", "nat", "-A", "POSTROUTING", "-o", mssid_if, "-j", "mark", "--mark-or", "6", "--mark-target", "ACCEPT");
+				ebt_batch(&b, "nat", "-A PREROUTING -i %s -j mark --mark-or 6 --mark-target ACCEPT", mssid_if);
+				ebt_batch(&b, "nat", "-A POSTROUTING -o %s -j mark --mark-or 6 --mark-target ACCEPT", mssid_if);
 			}
 		}
 	}
@@ -165,25 +170,25 @@ void add_EbtablesRules(void)
 	{
 		if(!nvram_match("fbwifi_2g","off"))
 		{
-			eval("ebtables","-D","INPUT","-i","wl0.1","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-D","INPUT","-i","wl0.2","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-D","INPUT","-i","wl0.3","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-A","INPUT","-i",nvram_safe_get("fbwifi_2g"),"-j","mark","--set-mark","1","--mark-target", "ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl0.1 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl0.2 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl0.3 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-A INPUT -i %s -j mark --set-mark 1 --mark-target ACCEPT", nvram_safe_get("fbwifi_2g"));
 		}
 		if(!nvram_match("fbwifi_5g","off"))
 		{
-			eval("ebtables","-D","INPUT","-i","wl1.1","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-D","INPUT","-i","wl1.2","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-D","INPUT","-i","wl1.3","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-A","INPUT","-i",nvram_safe_get("fbwifi_5g"),"-j","mark","--set-mark","1","--mark-target", "ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl1.1 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl1.2 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl1.3 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-A INPUT -i %s -j mark --set-mark 1 --mark-target ACCEPT", nvram_safe_get("fbwifi_5g"));
 		}
 #ifdef RTAC3200
 		if(!nvram_match("fbwifi_5g_2","off"))
 		{
-			eval("ebtables","-D","INPUT","-i","wl2.1","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-D","INPUT","-i","wl2.2","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-D","INPUT","-i","wl2.3","-j","mark","--set-mark","1","--mark-target", "ACCEPT");
-			eval("ebtables","-A","INPUT","-i",nvram_safe_get("fbwifi_5g_2"),"-j","mark","--set-mark","1","--mark-target", "ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl2.1 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl2.2 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-D INPUT -i wl2.3 -j mark --set-mark 1 --mark-target ACCEPT");
+			ebt_batch(&b, "filter", "-A INPUT -i %s -j mark --set-mark 1 --mark-target ACCEPT", nvram_safe_get("fbwifi_5g_2"));
 		}
 #endif
 	}
@@ -191,8 +196,21 @@ void add_EbtablesRules(void)
 	}
 #endif
 
+	ebt_batch_commit(&b);
 	etable_flag = 1;
 }
+
+void add_EbtablesRules(void)
+{
+	if(etable_flag == 1) return;
+	__add_EbtablesRules(0);
+}
+
+/* Replace the nat table with a fresh rule set in one step */
+void reload_EbtablesRules(void)
+{
+	__add_EbtablesRules(1);
+}
 #endif
 
 void remove_iptables_rules(int ipv6, const char *filename, char *flush_chains, char *skip_chains)
@@ -1375,6 +1393,10 @@ static int add_bandwidth_limiter_rules(char *pcWANIF)
 	char *wl_if = NULL;
 	int  i = 0;
 	int  j = 1;
+	ebt_batch_t b;
+
+	if (ebt_batch_open(&b) < 0)
+		return -1;
 	foreach(wl, nvram_safe_get("wl_ifnames"), next) {
 		snprintf(prefix, sizeof(prefix), "wl%d_", i);
 		foreach(wlv, nvram_safe_get(strcat_r(prefix, "vifnames", tmp)), next2) {
@@ -1391,8 +1413,8 @@ static int add_bandwidth_limiter_rules(char *pcWANIF)
 				}
 
 				snprintf(mssid_mark, sizeof(mssid_mark), "%d", guest_mark);
-				eval("ebtables", "-t", "nat", "-A", "PREROUTING",  "-i", wl_if, "-j", "mark", "--set-mark", mssid_mark, "--mark-target", "ACCEPT");
-				eval("ebtables", "-t", "nat", "-A", "POSTROUTING", "-o", wl_if, "-j", "mark", "--set-mark", mssid_mark, "--mark-target", "ACCEPT");
+				ebt_batch(&b, "nat", "-A PREROUTING -i %s -j mark --set-mark %s --mark-target ACCEPT", wl_if, mssid_mark);
+				ebt_batch(&b, "nat", "-A POSTROUTING -o %s -j mark --set-mark %s --mark-target ACCEPT", wl_if, mssid_mark);
 				guest_mark++;
 			} //bss_enabled
 			j++;
@@ -1400,6 +1422,8 @@ static int add_bandwidth_limiter_rules(char *pcWANIF)
 		i++;
 	}
 
+	ebt_batch_commit(&b);
+
 	_dprintf("[BWLIT_GUEST][%s(%d)]: Create ebtables rules done.\n", __FUNCTION__, __LINE__);
 	return 0;
 }
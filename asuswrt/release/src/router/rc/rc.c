@@ -441,6 +441,7 @@ static const applets_t applets[] = {
 	{ "radio",			radio_main			},
 	{ "ots",			ots_main			},
 	{ "udhcpc",			udhcpc_wan			},
+	{ "udhcpc_server",		udhcpc_server			},
 	{ "udhcpc_lan",			udhcpc_lan			},
 	{ "zcip",			zcip_wan			},
 #ifdef RTCONFIG_IPV6
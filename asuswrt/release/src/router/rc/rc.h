@@ -685,6 +685,7 @@ extern int add_iQosRules(char *pcWANIF);
 #ifdef CONFIG_BCMWL5
 extern void del_EbtablesRules(void);
 extern void add_EbtablesRules(void);
+extern void reload_EbtablesRules(void);
 #endif
 extern void ForceDisableWLan_bw(void);
 extern int check_wl_guest_bw_enable();
@@ -698,6 +699,9 @@ extern int udhcpc_wan(int argc, char **argv);
 extern int udhcpc_lan(int argc, char **argv);
 extern int start_udhcpc(char *wan_ifname, int unit, pid_t *ppid);
 extern void stop_udhcpc(int unit);
+extern int udhcpc_server(int argc, char **argv);
+extern void start_udhcpc_server(void);
+extern void stop_udhcpc_server(void);
 extern int zcip_wan(int argc, char **argv);
 extern int start_zcip(char *wan_ifname, int unit, pid_t *ppid);
 extern void stop_zcip(int unit);
@@ -944,6 +948,8 @@ extern void start_vpnclient(int clientNum);
 extern void stop_vpnclient(int clientNum);
 extern void start_vpnserver(int serverNum);
 extern void stop_vpnserver(int serverNum);
+extern int vpnclient_unchanged(int clientNum);
+extern int vpnserver_unchanged(int serverNum);
 extern void start_vpn_eas();
 extern void stop_vpn_eas();
 extern void run_vpn_firewall_scripts();
@@ -977,6 +983,88 @@ extern void setupset(fd_set *theset, int *numfds);
 extern void waitforconnects();
 extern int tcpcheck_main(int argc, char *argv[]);
 
+// probe.c
+enum {
+	PROBE_DNS = 0,
+	PROBE_TCP,
+	PROBE_ICMP,
+	PROBE_MAX
+};
+#define PROBE_F_DNS	(1 << PROBE_DNS)	/* dns_host resolves to one of dns_content */
+#define PROBE_F_TCP	(1 << PROBE_TCP)	/* TCP connect to a DNS server port 53 */
+#define PROBE_F_ICMP	(1 << PROBE_ICMP)	/* icmp_target answers an echo */
+
+struct probe_set {
+	int flags;		/* PROBE_F_xxx to run */
+	int quorum;		/* stop after this many kinds succeed, 0 for all */
+	int timeout_ms;		/* one deadline for the whole round */
+	char *servers;		/* DNS servers, NULL or "" for resolv.conf */
+	char *dns_host;
+	char *dns_content;	/* expected addresses, "*" for any */
+	char *icmp_target;	/* address or name */
+	int ttl;		/* echo TTL, 0 for the default */
+	int ok[PROBE_MAX];	/* out: 1 reached, 0 failed, -1 not run */
+};
+extern int run_probes(struct probe_set *ps);
+
+// rtnl.c
+#define RTNL_NH_MAX	4
+enum {
+	RTNL_REPLACE = 0,
+	RTNL_DELETE
+};
+
+struct rtnl_nexthop {
+	struct in_addr gw;
+	int oif;
+	int weight;
+};
+
+struct rtnl_route {
+	int cmd;		/* RTNL_REPLACE or RTNL_DELETE */
+	unsigned int table;	/* 0 for main */
+	struct in_addr dst;
+	int dst_len;
+	struct in_addr gw;	/* 0 for an on-link route */
+	struct in_addr src;	/* preferred source, 0 for none */
+	int oif;
+	int metric;		/* kernel metric, not the route_add() one */
+	int proto;		/* 0 for RTPROT_BOOT */
+	int nh_count;		/* multipath when > 0, gw/oif are unused then */
+	struct rtnl_nexthop nh[RTNL_NH_MAX];
+	int err;		/* out: 0 or -errno */
+};
+
+struct rtnl_routes {
+	int count, max;
+	struct rtnl_route *rt;
+};
+
+struct rtnl_rule {
+	int pref;
+	unsigned int table;
+	struct in_addr src, dst;
+	int src_len, dst_len;	/* 0 for "all" */
+	unsigned int fwmark, fwmask;
+	int err;		/* out */
+};
+
+struct rtnl_rules {
+	int count, max;
+	struct rtnl_rule *rule;
+};
+
+extern struct rtnl_route *rtnl_route_new(struct rtnl_routes *l);
+extern struct rtnl_route *rtnl_route_queue(struct rtnl_routes *l, int cmd, char *ifname, int metric, char *dst, char *gateway, char *genmask);
+extern void rtnl_routes_free(struct rtnl_routes *l);
+extern struct rtnl_rule *rtnl_rule_new(struct rtnl_rules *l);
+extern void rtnl_rules_free(struct rtnl_rules *l);
+extern int rtnl_prefix(const char *str, struct in_addr *addr, int *len);
+extern int rtnl_route_batch(struct rtnl_routes *l);
+extern int rtnl_route_dump(unsigned int table, struct rtnl_routes *l);
+extern int rtnl_route_sync(unsigned int table, struct rtnl_routes *want);
+extern int rtnl_rule_sync(struct rtnl_rules *want);
+
 // readmem.c
 #ifdef BUILD_READMEM
 extern int readmem_main(int argc, char *argv[]);
@@ -1327,6 +1415,16 @@ extern int get_app_patrol_main();
 // tcode_rc.c
 extern int config_tcode(int type);
 
+// service_graph.c
+struct svc_node {
+	const char *name;
+	void (*start)(void);
+	const char *after;	/* space separated names to be started first */
+};
+extern void run_service_graph(struct svc_node *svc, int count);
+extern void boot_trace_span(const char *name, float begin, float end, int tid);
+extern void boot_trace_mark(const char *name);
+
 // hour_monitor.c
 extern int hour_monitor_main(int argc, char **argv);
 extern int hour_monitor_function_check();
@@ -579,6 +579,14 @@ void rc_ipsec_rereadall(FILE *fp)
     return;
 }
 
+void rc_ipsec_rereadsecrets(FILE *fp)
+{
+    if(NULL != fp){
+        fprintf(fp, "ipsec rereadsecrets > /dev/null 2>&1\n");
+    }
+    return;
+}
+
 void rc_ipsec_stop(FILE *fp)
 {
     if(NULL != fp){
@@ -1225,6 +1233,25 @@ void rc_ipsec_config_init()
     return;
 }
 
+/* contents of a generated file, to tell whether rewriting it changed it */
+static char *ipsec_file_snapshot(const char *path)
+{
+    char *buf = NULL;
+
+    f_read_alloc_string(path, &buf, SZ_MAX * 16);
+    return buf;
+}
+
+static int ipsec_file_changed(const char *path, char *prev)
+{
+    char *cur = ipsec_file_snapshot(path);
+    int changed = ((NULL == prev) || (NULL == cur) || (0 != strcmp(prev, cur)));
+
+    free(cur);
+    free(prev);
+    return changed;
+}
+
 static int cur_bitmap_en_scan()
 {
     uint32_t cur_bitmap_en = 0, i = 0,prof_count = 0;
@@ -1248,6 +1275,8 @@ void rc_ipsec_set(ipsec_conn_status_t conn_status, ipsec_prof_type_t prof_type)
     char interface[4];
 	int ike_isakmp_port,ike_isakmp_nat_port;
 	char *argv[3];
+    char *prev_conf, *prev_secrets;
+    int conf_changed, secrets_changed;
 
 	char lan_class[32];
 	ip2class(nvram_safe_get("lan_ipaddr"), nvram_safe_get("lan_netmask"), lan_class);
@@ -1256,9 +1285,13 @@ void rc_ipsec_set(ipsec_conn_status_t conn_status, ipsec_prof_type_t prof_type)
 	argv[1] = FILE_PATH_IPSEC_SH;
 	argv[2] = NULL;
 	
+    prev_conf = ipsec_file_snapshot("/tmp/etc/ipsec.conf");
+    prev_secrets = ipsec_file_snapshot("/tmp/etc/ipsec.secrets");
     rc_ipsec_conf_set();
     rc_ipsec_secrets_set();
     rc_strongswan_conf_set();
+    conf_changed = ipsec_file_changed("/tmp/etc/ipsec.conf", prev_conf);
+    secrets_changed = ipsec_file_changed("/tmp/etc/ipsec.secrets", prev_secrets);
 
     fp = fopen(FILE_PATH_IPSEC_SH, "w");
 #if 0
@@ -1275,9 +1308,17 @@ void rc_ipsec_set(ipsec_conn_status_t conn_status, ipsec_prof_type_t prof_type)
 		rc_ipsec_restart(fp);
 		ipsec_start_en = TRUE;
 	}
+	/* reload only replaces the conns whose ipsec.conf section changed, */
+	/* so tunnels of unchanged profiles stay up                          */
 	if(IPSEC_SET == conn_status){
-		rc_ipsec_rereadall(fp);
-		rc_ipsec_reload(fp);
+		if(conf_changed){
+			rc_ipsec_rereadall(fp);
+			rc_ipsec_reload(fp);
+		}else if(secrets_changed){
+			rc_ipsec_rereadsecrets(fp);
+		}else{
+			DBG(("ipsec_set: config unchanged, nothing to reload\n"));
+		}
 	}
 	
 	for(prof_count = PROF_CLI; prof_count < PROF_ALL; prof_count++){
@@ -37,6 +37,10 @@
 #include <ralink.h>
 #include <net/ethernet.h>
 #include <netinet/ether.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #ifdef RTCONFIG_WIRELESSREPEATER
 #include <ap_priv.h>
 #endif
@@ -51,7 +55,9 @@
 
 #define RAST_COUNT_IDLE 20
 #define RAST_COUNT_RSSI 6
+#define RAST_RSSI_HYST 5	/* dB above user_rssi before a weak sta counts as recovered */
 #define RAST_POLL_INTV_NORMAL 5
+#define RAST_POLL_IDLE 12	/* ticks between polls of a band without stations */
 #if defined(RTCONFIG_RALINK)  /* Remove dead STA from assoclist */
 #define RAST_TIMEOUT_STA 10	
 #define RAST_MTK_DATARATE 128 /* 1024=1k, 8bit=1Byte */
@@ -64,6 +70,23 @@
 #define MAX_STA_COUNT 128
 #define ETHER_ADDR_STR_LEN 18
 
+/* per-BSS station table, open addressing with linear probing */
+#define RAST_STA_BITS 8
+#define RAST_STA_SLOTS (1 << RAST_STA_BITS)	/* twice MAX_STA_COUNT */
+
+#define RAST_SLOT_FREE 0
+#define RAST_SLOT_USED 1
+#define RAST_SLOT_DEL 2
+
+#if defined(RTCONFIG_RALINK)
+/* wireless event flags of the driver's IWEVCUSTOM messages (rtmp_def.h) */
+#define RAST_IW_ASSOC_EVENT 0x0200
+#define RAST_IW_DISASSOC_EVENT 0x0201
+/* iw_event stream layout: len, cmd, then iw_point as length, flags */
+#define RAST_EV_LCP_LEN 4
+#define RAST_EV_POINT_LEN 8
+#endif
+
 #define RAST_INFO(fmt, arg...) \
 	do {	\
 		_dprintf("RAST %lu: "fmt, uptime(), ##arg); \
@@ -109,7 +132,7 @@ typedef struct rast_sta_info {
 	time_t timestamp;
 	time_t active;
 	struct ether_addr addr;
-	struct rast_sta_info *prev, *next;
+	uint8 slot;
 	float datarate;	/* Kbps */
 	time_t idle_start;
 	uint8 idle_state;
@@ -126,12 +149,19 @@ typedef struct rast_sta_info {
 #endif
 }rast_sta_info_t;
 
+typedef struct rast_sta_table {
+	int used;
+	int deleted;
+	rast_sta_info_t sta[RAST_STA_SLOTS];
+}rast_sta_table_t;
+
 typedef struct rast_bss_info {
 	char wlif_name[32];
 	char prefix[32];
 	int user_low_rssi;
 	int32 idle_rate;
-	rast_sta_info_t *assoclist[MAX_SUBIF_NUM];
+	int assoc_event;
+	rast_sta_table_t *assoclist[MAX_SUBIF_NUM];
 }rast_bss_info_t;
 
 #if defined(RTCONFIG_RALINK)
@@ -171,24 +201,15 @@ rast_bss_info_t bssinfo[MAX_IF_NUM];
 uint8 init = 1;
 uint8 wlif_count = 0;
 uint32 ticks = 0;
-static struct itimerval itv;
 int rast_dbg = 0;
-
-static void
-alarmtimer(unsigned long sec, unsigned long usec)
-{
-        itv.it_value.tv_sec  = sec;
-        itv.it_value.tv_usec = usec;
-        itv.it_interval = itv.it_value;
-        setitimer(ITIMER_REAL, &itv, NULL);
-}
+static int rast_event_fd = -1;
 
 void rast_init_bssinfo(void)
 {
 	char ifname[128], *next;
 	char usr_rssi[128];
 	int idx = 0, idxList, rate;
-	memset(bssinfo, 0, sizeof(rast_bss_info_t));
+	memset(bssinfo, 0, sizeof(bssinfo));
 	
 	rate = nvram_get_int("rast_idlrt");
 	if(rate <= 0)	rate = RAST_DFT_IDLE_RATE;
@@ -228,32 +249,100 @@ void rast_init_bssinfo(void)
 	RAST_DBG("[%s]: TotalWI[%d] \n\n", __FUNCTION__, wlif_count);
 }
 
-rast_sta_info_t *rast_add_to_assoclist(int bssidx, int vifidx, struct ether_addr *addr)
+static unsigned int rast_sta_hash(const struct ether_addr *addr)
 {
-	rast_sta_info_t *sta, *head;
+	const unsigned char *ea = (const unsigned char *)addr;
 
-	sta = bssinfo[bssidx].assoclist[vifidx];
-	while(sta) {
-		/* find sta in assoclist */
-#if (defined(RTCONFIG_RALINK) || defined(RTCONFIG_QCA))
-		if(memcmp(&(sta->addr), addr, ETHER_ADDR_STR_LEN/3) == 0) {
-#else
-		if(eacmp(&(sta->addr), addr) == 0) {
-#endif
-		
+	/* the OUI is shared by many clients, so only the NIC specific part */
+	return (((ea[3] << 16) | (ea[4] << 8) | ea[5]) * 2654435761U) >> (32 - RAST_STA_BITS);
+}
+
+/*
+ * Find addr in the table. If it is not there and free is given, *free is
+ * set to the first reusable slot on its probe sequence (NULL if full).
+ */
+static rast_sta_info_t *rast_find_sta(rast_sta_table_t *tab, const struct ether_addr *addr, rast_sta_info_t **free)
+{
+	rast_sta_info_t *sta;
+	unsigned int i, n;
+
+	if(free)	*free = NULL;
+
+	for(i = rast_sta_hash(addr), n = 0; n < RAST_STA_SLOTS; n++, i = (i + 1) & (RAST_STA_SLOTS - 1)) {
+		sta = &tab->sta[i];
+		if(sta->slot == RAST_SLOT_USED) {
+			if(memcmp(&sta->addr, addr, ETHER_ADDR_LEN) == 0)
+				return sta;
+			continue;
+		}
+		if(free && !*free)
+			*free = sta;
+		if(sta->slot == RAST_SLOT_FREE)
 			break;
+	}
+
+	return NULL;
+}
+
+/* Drop the tombstones once they make probe sequences long */
+static void rast_compact_table(rast_sta_table_t *tab)
+{
+	rast_sta_table_t *old;
+	rast_sta_info_t *slot;
+	int i;
+
+	if(tab->deleted < RAST_STA_SLOTS / 4)
+		return;
+
+	if(!(old = malloc(sizeof(rast_sta_table_t))))
+		return;
+
+	memcpy(old, tab, sizeof(rast_sta_table_t));
+	memset(tab, 0, sizeof(rast_sta_table_t));
+
+	for(i = 0; i < RAST_STA_SLOTS; i++) {
+		if(old->sta[i].slot != RAST_SLOT_USED)
+			continue;
+		rast_find_sta(tab, &old->sta[i].addr, &slot);
+		memcpy(slot, &old->sta[i], sizeof(rast_sta_info_t));
+		tab->used++;
+	}
+
+	free(old);
+}
+
+rast_sta_info_t *rast_add_to_assoclist(int bssidx, int vifidx, struct ether_addr *addr)
+{
+	rast_sta_table_t *tab;
+	rast_sta_info_t *sta, *slot;
+
+	if(!addr)
+		return NULL;
+
+	tab = bssinfo[bssidx].assoclist[vifidx];
+	if(!tab) {
+		tab = calloc(1, sizeof(rast_sta_table_t));
+		if(!tab) {
+			RAST_INFO("[%s]: Malloc failure!\n", __FUNCTION__);
+			return NULL;
 		}
-		sta = sta->next;
+		bssinfo[bssidx].assoclist[vifidx] = tab;
 	}
 
+	sta = rast_find_sta(tab, addr, &slot);
 	if(!sta) {
-		sta = malloc(sizeof(rast_sta_info_t));
-		if(!sta) {
-			RAST_INFO("[%s]: Malloc failure!\n", __FUNCTION__);
+		if(!slot || tab->used >= MAX_STA_COUNT) {
+			RAST_INFO("[%s]: Station table full!\n", __FUNCTION__);
 			return NULL;
 		}
 
+		if(slot->slot == RAST_SLOT_DEL)
+			tab->deleted--;
+		tab->used++;
+
+		sta = slot;
 		memset(sta, 0, sizeof(rast_sta_info_t));
+		sta->slot = RAST_SLOT_USED;
 		memcpy(&sta->addr, addr, sizeof(struct ether_addr));
 		sta->timestamp = uptime();
 		sta->active = uptime();
@@ -271,15 +360,6 @@ rast_sta_info_t *rast_add_to_assoclist(int bssidx, int vifidx, struct ether_addr
 		sta->datarate = 0;
 		sta->idle_state = 0;
 
-		/* insert sta in the front of assoclist */
-		head = bssinfo[bssidx].assoclist[vifidx];
-		if(head)
-			head->prev = sta;
-
-		sta->next = head;
-		sta->prev = (struct rast_sta_info *)&(bssinfo[bssidx].assoclist[vifidx]);
-		bssinfo[bssidx].assoclist[vifidx] = sta;
-
 #if defined(RTCONFIG_RALINK)
 		RAST_DBG("[%s]: Add [%s] to StaList\n", __FUNCTION__,  ether_ntoa(addr));
 #else
@@ -290,61 +370,35 @@ rast_sta_info_t *rast_add_to_assoclist(int bssidx, int vifidx, struct ether_addr
 	return sta;
 }
 
-rast_sta_info_t *rast_remove_from_assoclist(int bssidx, int vifidx, struct ether_addr *addr)
+static void rast_free_sta(rast_sta_table_t *tab, rast_sta_info_t *sta)
 {
-	bool found = FALSE;
-	rast_sta_info_t *assoclist = NULL, *prev, *head, *next_sta = NULL;
+	sta->slot = RAST_SLOT_DEL;
+	tab->used--;
+	tab->deleted++;
+}
 
-	assoclist = bssinfo[bssidx].assoclist[vifidx];
-	if(assoclist == NULL) {
-		return next_sta;
-	}
+void rast_remove_from_assoclist(int bssidx, int vifidx, struct ether_addr *addr)
+{
+	rast_sta_table_t *tab = bssinfo[bssidx].assoclist[vifidx];
+	rast_sta_info_t *sta;
 
-	/* found at 1st element, update pointer */
-#if (defined(RTCONFIG_RALINK) || defined(RTCONFIG_QCA))
-      	if(memcmp(&(assoclist->addr), addr, ETHER_ADDR_STR_LEN/3) == 0) {   
-#else
-	if(eacmp(&(assoclist->addr), addr) == 0) {   
-#endif
-		head = assoclist->next;
-		bssinfo[bssidx].assoclist[vifidx] = head;
-		if(head) {
-			head->prev = (struct rast_sta_info *)&(bssinfo[bssidx].assoclist[vifidx]);
-			next_sta = head;
-		}
-		found = TRUE;
-	}
-	else {
-		prev = assoclist;
-		assoclist = prev->next;
+	if(tab == NULL)
+		return;
 
-		while(assoclist) {
-#if (defined(RTCONFIG_RALINK) || defined(RTCONFIG_QCA))
-		       	if(memcmp(&(assoclist->addr), addr, ETHER_ADDR_STR_LEN/3) == 0) {    
-#else
-			if(eacmp(&(assoclist->addr), addr) == 0) {   
-#endif
-				head = assoclist->next;
-				prev->next = head;
-				if(head) {
-					head->prev = prev;
-					next_sta = head;
-				}
-				
-				found = TRUE;
-				break;
-			}
+	if((sta = rast_find_sta(tab, addr, NULL)) != NULL)
+		rast_free_sta(tab, sta);
+}
 
-			prev = assoclist;
-			assoclist = prev->next;
-		}
-	}
+static int rast_bss_sta_count(int bssidx)
+{
+	int vi, count = 0;
 
-	if(found) {
-		free(assoclist);
+	for(vi = 0; vi < MAX_SUBIF_NUM; vi++) {
+		if(bssinfo[bssidx].assoclist[vi])
+			count += bssinfo[bssidx].assoclist[vi]->used;
 	}
 
-	return next_sta;
+	return count;
 }
 
 void rast_deauth_sta(int bssidx, int vifidx, rast_sta_info_t *sta)
@@ -387,32 +441,63 @@ void rast_deauth_sta(int bssidx, int vifidx, rast_sta_info_t *sta)
 #endif
 }
 
+/*
+ * Hysteresis on the station RSSI: a station turns weak after RAST_COUNT_RSSI
+ * samples below low_rssi and only recovers with a sample RAST_RSSI_HYST dB
+ * above it, so a client hovering at the threshold neither gets kicked nor
+ * resets its count on every poll. Samples in between keep the count.
+ * No driver access here, so recorded RSSI traces can be replayed through it.
+ */
+static int rast_rssi_policy(rast_sta_info_t *sta, int32 rssi, int low_rssi)
+{
+	if(rssi < low_rssi) {
+		if(sta->rssi_hit_count < RAST_COUNT_RSSI)
+			sta->rssi_hit_count++;
+	}
+	else if(rssi >= low_rssi + RAST_RSSI_HYST) {
+		sta->rssi_hit_count = 0;
+	}
+
+	return sta->rssi_hit_count >= RAST_COUNT_RSSI;
+}
+
+static int32 rast_sta_rssi(rast_sta_info_t *sta)
+{
+#if defined(RTCONFIG_RALINK)
+	/* weak only when every chain is */
+	int32 rssi = sta->rssi[0];
+	int i;
+
+	for(i = 1; i < xR_MAX; i++)
+		if(sta->rssi[i] > rssi)
+			rssi = sta->rssi[i];
+
+	return rssi;
+#else
+	return sta->rssi;
+#endif
+}
+
 void rast_check_criteria(int bssidx, int vifidx)
 {
-	int idx=0;
+	int idx=0, slot;
 	int flag_rssi, flag_idle;
 	time_t now = uptime();
-	rast_sta_info_t *sta = bssinfo[bssidx].assoclist[vifidx];
+	rast_sta_table_t *tab = bssinfo[bssidx].assoclist[vifidx];
+	rast_sta_info_t *sta;
+
+	if(!tab)
+		return;
+
+	for(slot = 0; slot < RAST_STA_SLOTS; slot++) {
+		sta = &tab->sta[slot];
+		if(sta->slot != RAST_SLOT_USED)
+			continue;
 
-	while(sta) {
-		flag_rssi = 0;
 		flag_idle = 0;
 		idx++;
 
-#if defined(RTCONFIG_RALINK)
-		if( (sta->rssi[0] < bssinfo[bssidx].user_low_rssi) &&
-			(sta->rssi[1] < bssinfo[bssidx].user_low_rssi) && 
-			(sta->rssi[2] < bssinfo[bssidx].user_low_rssi)	) {
-#else
-		if(sta->rssi < bssinfo[bssidx].user_low_rssi) {
-#endif
-			sta->rssi_hit_count++;
-			if(sta->rssi_hit_count >= RAST_COUNT_RSSI)
-				flag_rssi = 1;
-		}
-#if defined(RTCONFIG_RALINK)
-		else     sta->rssi_hit_count = 0;
-#endif
+		flag_rssi = rast_rssi_policy(sta, rast_sta_rssi(sta), bssinfo[bssidx].user_low_rssi);
 
 		if(sta->datarate < bssinfo[bssidx].idle_rate) {
 			if(!sta->idle_state) {
@@ -421,9 +506,6 @@ void rast_check_criteria(int bssidx, int vifidx)
 			}
 			if((now - sta->idle_start) >= RAST_COUNT_IDLE)
 				flag_idle = 1;
-#if defined(RTCONFIG_RALINK)
-			else	flag_idle = 0;
-#endif
 		}
 		else {
 			sta->idle_state = 0;
@@ -449,11 +531,8 @@ void rast_check_criteria(int bssidx, int vifidx)
 #endif
 		if(flag_rssi & flag_idle) {
 			rast_deauth_sta(bssidx, vifidx, sta);
-			sta = rast_remove_from_assoclist(bssidx, vifidx, &sta->addr);
-			continue;	
+			rast_free_sta(tab, sta);
 		}
-		
-		sta = sta->next;
 	}
 
 	return;
@@ -503,12 +582,18 @@ void rast_retrieve_bs_data(int bssidx, int vifidx)
 void rast_timeout_sta(int bssidx, int vifidx)
 {
 	time_t now = uptime();
-	rast_sta_info_t *sta, *prev, *next, *head;
-	sta = bssinfo[bssidx].assoclist[vifidx];
-	head = NULL;
-	prev = NULL;
+	rast_sta_table_t *tab = bssinfo[bssidx].assoclist[vifidx];
+	rast_sta_info_t *sta;
+	int slot;
+
+	if(!tab)
+		return;
+
+	for(slot = 0; slot < RAST_STA_SLOTS; slot++) {
+		sta = &tab->sta[slot];
+		if(sta->slot != RAST_SLOT_USED)
+			continue;
 
-	while(sta) {
 		if(now - sta->active > RAST_TIMEOUT_STA) {
 #if defined(RTCONFIG_RALINK)
 			RAST_DBG("[%s]: Free Mac[%s], TIME[N:%lu/A:%lu]\n", __FUNCTION__, sta->mac_addr , now , sta->active);
@@ -518,21 +603,11 @@ void rast_timeout_sta(int bssidx, int vifidx)
 					now,
 					sta->active);
 #endif			
-			next = sta->next;
-			free(sta);
-			sta = next;
-			if(prev)
-				prev->next = sta;
-			continue;
+			rast_free_sta(tab, sta);
 		}
-		
-		if(head == NULL)
-			head = sta;
-
-		prev = sta;
-		sta = sta->next;
 	}
-	bssinfo[bssidx].assoclist[vifidx] = head;
+
+	rast_compact_table(tab);
 }
 
 void rast_update_sta_info(int bssidx, int vifidx)
@@ -606,6 +681,7 @@ void rast_update_sta_info(int bssidx, int vifidx)
 			}
 #endif
 		       	staInfo = rast_add_to_assoclist(bssidx, vifidx, ether_aton(ssap->sta[hdrLen].mac) );
+			if( !staInfo ) continue;
 			
 			for( getLen=0; getLen<xR_MAX; getLen++ )  
 				staInfo->rssi[getLen] = !atoi(ssap->sta[hdrLen].rssi[getLen]) ? -100 : atoi(ssap->sta[hdrLen].rssi[getLen]);
@@ -694,6 +770,7 @@ void rast_update_sta_info(int bssidx, int vifidx)
 						result->wme);
 			/* add to assoclist */
 			sta = rast_add_to_assoclist(bssidx, vifidx, ether_aton(result->addr));
+			if (!sta) continue;
 			sta->rssi = -result->rssi;
 			sta->active = uptime();
 			/* get Tx/Rx bytes of station */
@@ -758,6 +835,8 @@ void rast_update_sta_info(int bssidx, int vifidx)
 
 		/* add to assoclist */
 		sta = rast_add_to_assoclist(bssidx, vifidx, &(mac_list->ea[mcnt]));
+		if(!sta)
+			continue;
 		sta->rssi = rssi;
 		sta->active = uptime();
 	}
@@ -772,7 +851,147 @@ exit:
 	return;
 }
 
-static void rast_watchdog(int sig)
+#if defined(RTCONFIG_RALINK)
+/*
+ * Association events. The driver reports (dis)associations of every BSS
+ * on its main interface as IWEVCUSTOM wireless events, flags
+ * IW_ASSOC_EVENT_FLAG/IW_DISASSOC_EVENT_FLAG and text "... STA(mac) ...".
+ * Plain IWEVREGISTERED/IWEVEXPIRED are handled as well.
+ */
+static int rast_event_open(void)
+{
+	struct sockaddr_nl snl;
+	int fd;
+
+	if((fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE)) < 0)
+		return -1;
+
+	memset(&snl, 0, sizeof(snl));
+	snl.nl_family = AF_NETLINK;
+	snl.nl_groups = RTMGRP_LINK;
+	if(bind(fd, (struct sockaddr *)&snl, sizeof(snl)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void rast_sta_event(int ifindex, int assoc, struct ether_addr *addr)
+{
+	char ifname[IFNAMSIZ];
+	int idx, vi;
+
+	if(!if_indextoname(ifindex, ifname))
+		return;
+
+	for(idx = 0; idx < wlif_count; idx++) {
+		if(strcmp(bssinfo[idx].wlif_name, ifname))
+			continue;
+
+		RAST_DBG("[%s]: WI[%s] %s [%s]\n", __FUNCTION__, ifname,
+				assoc ? "assoc" : "disassoc", ether_ntoa(addr));
+		if(assoc) {
+			bssinfo[idx].assoc_event = 1;
+		}
+		else {
+			for(vi = 0; vi < MAX_SUBIF_NUM; vi++)
+				rast_remove_from_assoclist(idx, vi, addr);
+		}
+		break;
+	}
+}
+
+/* walk the iw_event stream of one IFLA_WIRELESS attribute */
+static void rast_wext_event(int ifindex, char *data, int len)
+{
+	unsigned short ev_len, cmd, flags, dlen;
+	char text[IW_CUSTOM_MAX + 1], *p;
+	struct ether_addr addr;
+	unsigned int m[ETHER_ADDR_LEN];
+	int i;
+
+	while(len >= RAST_EV_LCP_LEN) {
+		memcpy(&ev_len, data, sizeof(ev_len));
+		memcpy(&cmd, data + 2, sizeof(cmd));
+		if(ev_len < RAST_EV_LCP_LEN || ev_len > len)
+			break;
+
+		if((cmd == IWEVREGISTERED || cmd == IWEVEXPIRED) &&
+		   ev_len >= RAST_EV_LCP_LEN + 2 + ETHER_ADDR_LEN) {
+			/* struct sockaddr: family, then the address */
+			memcpy(&addr, data + RAST_EV_LCP_LEN + 2, ETHER_ADDR_LEN);
+			rast_sta_event(ifindex, cmd == IWEVREGISTERED, &addr);
+		}
+		else if(cmd == IWEVCUSTOM && ev_len > RAST_EV_POINT_LEN) {
+			/* struct iw_point without the pointer: length, flags */
+			memcpy(&dlen, data + RAST_EV_LCP_LEN, sizeof(dlen));
+			memcpy(&flags, data + RAST_EV_LCP_LEN + 2, sizeof(flags));
+			if(dlen > ev_len - RAST_EV_POINT_LEN)
+				dlen = ev_len - RAST_EV_POINT_LEN;
+			if(dlen > IW_CUSTOM_MAX)
+				dlen = IW_CUSTOM_MAX;
+			memcpy(text, data + RAST_EV_POINT_LEN, dlen);
+			text[dlen] = '\0';
+
+			if((flags == RAST_IW_ASSOC_EVENT || flags == RAST_IW_DISASSOC_EVENT) &&
+			   (p = strstr(text, "STA(")) != NULL &&
+			   sscanf(p + 4, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) == ETHER_ADDR_LEN) {
+				for(i = 0; i < ETHER_ADDR_LEN; i++)
+					addr.ether_addr_octet[i] = m[i];
+				rast_sta_event(ifindex, flags == RAST_IW_ASSOC_EVENT, &addr);
+			}
+		}
+
+		data += ev_len;
+		len -= ev_len;
+	}
+}
+
+static void rast_event_recv(int fd)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh;
+	struct ifinfomsg *ifi;
+	struct rtattr *rta;
+	int len, alen;
+
+	if((len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) <= 0)
+		return;
+
+	for(nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+		if(nlh->nlmsg_type != RTM_NEWLINK)
+			continue;
+
+		ifi = NLMSG_DATA(nlh);
+		alen = IFLA_PAYLOAD(nlh);
+		for(rta = IFLA_RTA(ifi); RTA_OK(rta, alen); rta = RTA_NEXT(rta, alen)) {
+			if(rta->rta_type == IFLA_WIRELESS)
+				rast_wext_event(ifi->ifi_index, RTA_DATA(rta), RTA_PAYLOAD(rta));
+		}
+	}
+}
+#endif
+
+/*
+ * With association events a band without stations is not polled until
+ * a station associates, only every RAST_POLL_IDLE ticks in case the
+ * driver has wireless events turned off.
+ */
+static int rast_bss_wanted(int idx)
+{
+	if(rast_event_fd < 0 || rast_bss_sta_count(idx))
+		return 1;
+
+	if(bssinfo[idx].assoc_event) {
+		bssinfo[idx].assoc_event = 0;
+		return 1;
+	}
+
+	return (ticks % RAST_POLL_IDLE) == 0;
+}
+
+static void rast_watchdog(void)
 {
 	int idx,vidx;
 	char prefix[32];
@@ -786,9 +1005,12 @@ static void rast_watchdog(int sig)
 		init = 0;
 	}
 
+	ticks++;
+
 	for(idx=0; idx < wlif_count; idx++) {
 #if (defined(RTCONFIG_RALINK) || defined(RTCONFIG_QCA))
 		if(!bssinfo[idx].user_low_rssi) continue;
+		if(!rast_bss_wanted(idx)) continue;
 
 		for(vidx = 0; vidx < MAX_SUBIF_NUM; vidx++) { 
 			if(vidx > 0) {
@@ -808,6 +1030,7 @@ static void rast_watchdog(int sig)
 		int val;
 
 		if(!bssinfo[idx].user_low_rssi) continue;
+		if(!rast_bss_wanted(idx)) continue;
 #ifdef RTCONFIG_PROXYSTA
 		if(psta_exist_except(idx) || psr_exist_except(idx)) continue;
 		else if(is_psta(idx) || is_psr(idx))	continue;
@@ -859,21 +1082,17 @@ static void rast_exit(int sig)
 {
 	/* free assoclist */
 	int i, vi;
-	rast_sta_info_t *assoclist, *next;
-
-	alarmtimer(0, 0);
 
 	for(i = 0; i < wlif_count; i++) {
 		for(vi = 0; vi < MAX_SUBIF_NUM; vi++) {
-			assoclist = bssinfo[i].assoclist[vi];
-			while(assoclist) {
-				next = assoclist->next;
-				free(assoclist);
-				assoclist = next;
-			}
+			free(bssinfo[i].assoclist[vi]);
+			bssinfo[i].assoclist[vi] = NULL;
 		}
 	}
 
+	if(rast_event_fd >= 0)
+		close(rast_event_fd);
+
 	RAST_INFO("ROAMAST Exit...\n");
 	remove("/var/run/roamast.pid");
 	exit(0);
@@ -883,6 +1102,9 @@ int roam_assistant_main(int argc, char *argv[])
 {
 	FILE *fp;
         sigset_t sigs_to_catch;
+	struct timeval tv;
+	fd_set rfds;
+	time_t now, next;
 
         /* write pid */
         if ((fp = fopen("/var/run/roamast.pid", "w")) != NULL)
@@ -900,19 +1122,42 @@ int roam_assistant_main(int argc, char *argv[])
 
         /* set the signal handler */
         sigemptyset(&sigs_to_catch);
-        sigaddset(&sigs_to_catch, SIGALRM);
         sigaddset(&sigs_to_catch, SIGTERM);
         sigprocmask(SIG_UNBLOCK, &sigs_to_catch, NULL);
 
-        signal(SIGALRM, rast_watchdog);
         signal(SIGTERM, rast_exit);
 
-	alarmtimer(RAST_POLL_INTV_NORMAL, 0);	
+#if defined(RTCONFIG_RALINK)
+	rast_event_fd = rast_event_open();
+	if(rast_event_fd < 0)
+		RAST_INFO("[%s]: no wireless events, polling every band\n", __FUNCTION__);
+#endif
+
 	RAST_INFO("%s \n", __FUNCTION__);
-        /* Most of time it goes to sleep */
+	next = uptime() + RAST_POLL_INTV_NORMAL;
+        /* Sleep until a wireless event or the next poll */
         while (1)
         {
-                pause();
+		now = uptime();
+		if (now >= next) {
+			rast_watchdog();
+			next = now + RAST_POLL_INTV_NORMAL;
+			continue;
+		}
+
+		tv.tv_sec = next - now;
+		tv.tv_usec = 0;
+		FD_ZERO(&rfds);
+		if (rast_event_fd >= 0)
+			FD_SET(rast_event_fd, &rfds);
+
+		if (select(rast_event_fd + 1, &rfds, NULL, NULL, &tv) <= 0)
+			continue;
+
+#if defined(RTCONFIG_RALINK)
+		if (FD_ISSET(rast_event_fd, &rfds))
+			rast_event_recv(rast_event_fd);
+#endif
         }
 
         return 0;
@@ -0,0 +1,743 @@
+/*
+	rtnl.c - batched IPv4 route and policy rule updates over rtnetlink
+
+	Route and rule lists are built in memory and sent to the kernel as
+	a few large netlink writes; every message is acknowledged separately
+	so each entry gets its own error. The sync functions compare a wanted
+	list against the kernel's current state and only send the
+	difference, so tables and rules never go through an empty window
+	the way "flush and re-add" does.
+*/
+
+#include <rc.h>
+#include <errno.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/fib_rules.h>
+
+#define RTNL_BUF_SIZE	8192
+#define RTNL_MSG_SIZE	512
+
+struct rtnl_req {
+	struct nlmsghdr n;
+	union {
+		struct rtmsg r;
+		struct fib_rule_hdr f;
+	};
+	char attr[RTNL_MSG_SIZE];
+};
+
+/* Messages queued for one write, with the error of every ack */
+struct rtnl_batch {
+	int fd;
+	unsigned int seq;
+	int len, count;
+	int *err[RTNL_BUF_SIZE / NLMSG_LENGTH(sizeof(struct rtmsg))];
+	char buf[RTNL_BUF_SIZE];
+};
+
+typedef int (*rtnl_dump_fn)(struct nlmsghdr *n, void *arg);
+
+static int rtnl_open(void)
+{
+	struct sockaddr_nl snl;
+	int fd, size = 256 * 1024;
+
+	if ((fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE)) < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	memset(&snl, 0, sizeof(snl));
+	snl.nl_family = AF_NETLINK;
+	if (bind(fd, (struct sockaddr *) &snl, sizeof(snl)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void addattr(struct nlmsghdr *n, int type, const void *data, int len)
+{
+	struct rtattr *rta = (struct rtattr *) ((char *) n + NLMSG_ALIGN(n->nlmsg_len));
+
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	memcpy(RTA_DATA(rta), data, len);
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+}
+
+static void addattr32(struct nlmsghdr *n, int type, __u32 val)
+{
+	addattr(n, type, &val, sizeof(val));
+}
+
+/* Wait for the acks of everything sent; returns the number of failures */
+static int rtnl_flush(struct rtnl_batch *b)
+{
+	struct sockaddr_nl snl;
+	struct nlmsghdr *n;
+	struct nlmsgerr *e;
+	char buf[RTNL_BUF_SIZE];
+	unsigned int first;
+	int len, pending, fails = 0, i;
+
+	if (b->count == 0)
+		return 0;
+
+	memset(&snl, 0, sizeof(snl));
+	snl.nl_family = AF_NETLINK;
+	first = b->seq - b->count;
+	pending = b->count;
+
+	if (sendto(b->fd, b->buf, b->len, 0, (struct sockaddr *) &snl, sizeof(snl)) < 0) {
+		for (i = 0; i < b->count; i++) {
+			if (b->err[i])
+				*b->err[i] = -errno;
+		}
+		fails = b->count;
+		pending = 0;
+	}
+
+	while (pending > 0) {
+		if ((len = recv(b->fd, buf, sizeof(buf), 0)) < 0) {
+			if (errno == EINTR)
+				continue;
+			fails += pending;
+			break;
+		}
+		for (n = (struct nlmsghdr *) buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+			if (n->nlmsg_type != NLMSG_ERROR || n->nlmsg_seq - first >= (unsigned int) b->count)
+				continue;
+			e = NLMSG_DATA(n);
+			i = n->nlmsg_seq - first;
+			if (b->err[i])
+				*b->err[i] = e->error;
+			if (e->error)
+				fails++;
+			pending--;
+		}
+	}
+
+	b->len = 0;
+	b->count = 0;
+
+	return fails;
+}
+
+/* Queue message n, the ack's error goes to *err */
+static int rtnl_queue(struct rtnl_batch *b, struct nlmsghdr *n, int *err)
+{
+	int fails = 0;
+
+	if (b->len + NLMSG_ALIGN(n->nlmsg_len) > RTNL_BUF_SIZE || b->count == ARRAY_SIZE(b->err))
+		fails = rtnl_flush(b);
+
+	n->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+	n->nlmsg_seq = b->seq++;
+	memcpy(b->buf + b->len, n, n->nlmsg_len);
+	b->len += NLMSG_ALIGN(n->nlmsg_len);
+	b->err[b->count++] = err;
+
+	return fails;
+}
+
+static int rtnl_batch_init(struct rtnl_batch *b)
+{
+	if ((b->fd = rtnl_open()) < 0)
+		return -1;
+	b->seq = time(NULL);
+	b->len = 0;
+	b->count = 0;
+
+	return 0;
+}
+
+static int rtnl_batch_done(struct rtnl_batch *b)
+{
+	int fails = rtnl_flush(b);
+
+	close(b->fd);
+
+	return fails;
+}
+
+/* Run an AF_INET dump of type, handing every answer to fn */
+static int rtnl_dump(int type, rtnl_dump_fn fn, void *arg)
+{
+	struct {
+		struct nlmsghdr n;
+		struct rtmsg r;
+	} req;
+	struct sockaddr_nl snl;
+	struct nlmsghdr *n;
+	char buf[RTNL_BUF_SIZE];
+	int fd, len, ret = -1;
+
+	if ((fd = rtnl_open()) < 0)
+		return -1;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = sizeof(req);
+	req.n.nlmsg_type = type;
+	req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.n.nlmsg_seq = time(NULL);
+	req.r.rtm_family = AF_INET;
+
+	memset(&snl, 0, sizeof(snl));
+	snl.nl_family = AF_NETLINK;
+	if (sendto(fd, &req, sizeof(req), 0, (struct sockaddr *) &snl, sizeof(snl)) < 0)
+		goto out;
+
+	for (;;) {
+		if ((len = recv(fd, buf, sizeof(buf), 0)) < 0) {
+			if (errno == EINTR)
+				continue;
+			goto out;
+		}
+		for (n = (struct nlmsghdr *) buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+			if (n->nlmsg_seq != req.n.nlmsg_seq)
+				continue;
+			if (n->nlmsg_type == NLMSG_DONE) {
+				ret = 0;
+				goto out;
+			}
+			if (n->nlmsg_type == NLMSG_ERROR)
+				goto out;
+			if (fn(n, arg) < 0)
+				goto out;
+		}
+	}
+
+out:
+	close(fd);
+	return ret;
+}
+
+struct rtnl_route *rtnl_route_new(struct rtnl_routes *l)
+{
+	struct rtnl_route *rt;
+
+	if (l->count == l->max) {
+		rt = realloc(l->rt, (l->max + 32) * sizeof(*rt));
+		if (rt == NULL)
+			return NULL;
+		l->rt = rt;
+		l->max += 32;
+	}
+	rt = &l->rt[l->count++];
+	memset(rt, 0, sizeof(*rt));
+
+	return rt;
+}
+
+void rtnl_routes_free(struct rtnl_routes *l)
+{
+	free(l->rt);
+	memset(l, 0, sizeof(*l));
+}
+
+struct rtnl_rule *rtnl_rule_new(struct rtnl_rules *l)
+{
+	struct rtnl_rule *rule;
+
+	if (l->count == l->max) {
+		rule = realloc(l->rule, (l->max + 16) * sizeof(*rule));
+		if (rule == NULL)
+			return NULL;
+		l->rule = rule;
+		l->max += 16;
+	}
+	rule = &l->rule[l->count++];
+	memset(rule, 0, sizeof(*rule));
+
+	return rule;
+}
+
+void rtnl_rules_free(struct rtnl_rules *l)
+{
+	free(l->rule);
+	memset(l, 0, sizeof(*l));
+}
+
+/* "a.b.c.d", "a.b.c.d/nn" or "all" */
+int rtnl_prefix(const char *str, struct in_addr *addr, int *len)
+{
+	char buf[sizeof("255.255.255.255/32")], *p;
+
+	addr->s_addr = INADDR_ANY;
+	*len = 0;
+	if (!strcmp(str, "all") || !strcmp(str, "default"))
+		return 0;
+
+	snprintf(buf, sizeof(buf), "%s", str);
+	*len = 32;
+	if ((p = strchr(buf, '/')) != NULL) {
+		*p++ = '\0';
+		*len = atoi(p);
+		if (*len < 0 || *len > 32)
+			return -1;
+	}
+
+	return inet_aton(buf, addr) ? 0 : -1;
+}
+
+/*
+ * Queue a route given the way route_add() takes it: ioctl style metric
+ * (kernel metric + 1), dotted addresses, gateway "0.0.0.0" or NULL for
+ * an on-link route.
+ */
+struct rtnl_route *rtnl_route_queue(struct rtnl_routes *l, int cmd, char *ifname, int metric,
+				    char *dst, char *gateway, char *genmask)
+{
+	struct rtnl_route *rt;
+	struct in_addr mask;
+
+	if ((rt = rtnl_route_new(l)) == NULL)
+		return NULL;
+
+	rt->cmd = cmd;
+	if (ifname && *ifname)
+		rt->oif = if_nametoindex(ifname);
+	rt->metric = (metric > 0) ? metric - 1 : 0;
+	if (dst)
+		inet_aton(dst, &rt->dst);
+	if (gateway)
+		inet_aton(gateway, &rt->gw);
+	if (genmask && inet_aton(genmask, &mask)) {
+		for (mask.s_addr = ntohl(mask.s_addr); mask.s_addr & 0x80000000; mask.s_addr <<= 1)
+			rt->dst_len++;
+	}
+	rt->dst.s_addr &= rt->dst_len ? htonl(0xffffffff << (32 - rt->dst_len)) : 0;
+
+	return rt;
+}
+
+static void rtnl_route_msg(struct rtnl_route *rt, struct rtnl_req *req)
+{
+	unsigned int table = rt->table ? : RT_TABLE_MAIN;
+	struct rtattr *mp;
+	struct rtnexthop *nh;
+	int i;
+
+	memset(req, 0, sizeof(struct nlmsghdr) + sizeof(struct rtmsg));
+	req->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+	req->r.rtm_family = AF_INET;
+	req->r.rtm_dst_len = rt->dst_len;
+	req->r.rtm_table = (table < 256) ? table : RT_TABLE_UNSPEC;
+
+	if (rt->cmd == RTNL_DELETE) {
+		req->n.nlmsg_type = RTM_DELROUTE;
+		req->r.rtm_scope = RT_SCOPE_NOWHERE;
+	} else {
+		req->n.nlmsg_type = RTM_NEWROUTE;
+		req->n.nlmsg_flags = NLM_F_CREATE | NLM_F_REPLACE;
+		req->r.rtm_protocol = rt->proto ? : RTPROT_BOOT;
+		req->r.rtm_type = RTN_UNICAST;
+		req->r.rtm_scope = (rt->gw.s_addr || rt->nh_count) ? RT_SCOPE_UNIVERSE : RT_SCOPE_LINK;
+	}
+
+	if (table >= 256)
+		addattr32(&req->n, RTA_TABLE, table);
+	if (rt->dst_len)
+		addattr(&req->n, RTA_DST, &rt->dst, 4);
+	if (rt->metric)
+		addattr32(&req->n, RTA_PRIORITY, rt->metric);
+	if (rt->src.s_addr)
+		addattr(&req->n, RTA_PREFSRC, &rt->src, 4);
+
+	if (rt->nh_count == 0) {
+		if (rt->gw.s_addr)
+			addattr(&req->n, RTA_GATEWAY, &rt->gw, 4);
+		if (rt->oif)
+			addattr32(&req->n, RTA_OIF, rt->oif);
+		return;
+	}
+
+	mp = (struct rtattr *) ((char *) &req->n + NLMSG_ALIGN(req->n.nlmsg_len));
+	mp->rta_type = RTA_MULTIPATH;
+	mp->rta_len = RTA_LENGTH(0);
+	for (i = 0; i < rt->nh_count; i++) {
+		nh = (struct rtnexthop *) ((char *) mp + RTA_ALIGN(mp->rta_len));
+		memset(nh, 0, sizeof(*nh));
+		nh->rtnh_ifindex = rt->nh[i].oif;
+		nh->rtnh_hops = rt->nh[i].weight ? rt->nh[i].weight - 1 : 0;
+		nh->rtnh_len = RTNH_LENGTH(0);
+		if (rt->nh[i].gw.s_addr) {
+			struct rtattr *rta = RTNH_DATA(nh);
+
+			rta->rta_type = RTA_GATEWAY;
+			rta->rta_len = RTA_LENGTH(4);
+			memcpy(RTA_DATA(rta), &rt->nh[i].gw, 4);
+			nh->rtnh_len += RTA_ALIGN(rta->rta_len);
+		}
+		mp->rta_len = RTA_ALIGN(mp->rta_len) + nh->rtnh_len;
+	}
+	req->n.nlmsg_len = NLMSG_ALIGN(req->n.nlmsg_len) + RTA_ALIGN(mp->rta_len);
+}
+
+/*
+ * Send every route of the list, in order, as one batch.
+ * Each entry's err is set; a delete of a missing route is not a failure.
+ * Returns the number of failed entries, -1 if netlink is unavailable.
+ */
+int rtnl_route_batch(struct rtnl_routes *l)
+{
+	struct rtnl_batch *b;
+	struct rtnl_req req;
+	int i, fails = 0;
+
+	if (l->count == 0)
+		return 0;
+	if ((b = malloc(sizeof(*b))) == NULL || rtnl_batch_init(b) < 0) {
+		free(b);
+		return -1;
+	}
+
+	for (i = 0; i < l->count; i++) {
+		rtnl_route_msg(&l->rt[i], &req);
+		rtnl_queue(b, &req.n, &l->rt[i].err);
+	}
+	rtnl_batch_done(b);
+	free(b);
+
+	for (i = 0; i < l->count; i++) {
+		struct rtnl_route *rt = &l->rt[i];
+
+		if (rt->err && !(rt->cmd == RTNL_DELETE && rt->err == -ESRCH)) {
+			_dprintf("%s: %s %s/%d table %u: %s\n", __FUNCTION__,
+				 rt->cmd == RTNL_DELETE ? "del" : "replace",
+				 inet_ntoa(rt->dst), rt->dst_len, rt->table ? : RT_TABLE_MAIN,
+				 strerror(-rt->err));
+			fails++;
+		}
+	}
+
+	return fails;
+}
+
+/* Parse one RTM_NEWROUTE of a dump; returns its table, 0 to skip it */
+static unsigned int rtnl_route_parse(struct nlmsghdr *n, struct rtnl_route *rt)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	struct rtattr *rta;
+	struct rtnexthop *nh;
+	unsigned int table = r->rtm_table;
+	int len, nlen;
+
+	if (n->nlmsg_type != RTM_NEWROUTE || r->rtm_family != AF_INET ||
+	    r->rtm_type != RTN_UNICAST || (r->rtm_flags & RTM_F_CLONED) || r->rtm_tos)
+		return 0;
+
+	memset(rt, 0, sizeof(*rt));
+	rt->dst_len = r->rtm_dst_len;
+	rt->proto = r->rtm_protocol;
+
+	len = RTM_PAYLOAD(n);
+	for (rta = RTM_RTA(r); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case RTA_TABLE:
+			table = *(__u32 *) RTA_DATA(rta);
+			break;
+		case RTA_DST:
+			memcpy(&rt->dst, RTA_DATA(rta), 4);
+			break;
+		case RTA_GATEWAY:
+			memcpy(&rt->gw, RTA_DATA(rta), 4);
+			break;
+		case RTA_PREFSRC:
+			memcpy(&rt->src, RTA_DATA(rta), 4);
+			break;
+		case RTA_OIF:
+			rt->oif = *(int *) RTA_DATA(rta);
+			break;
+		case RTA_PRIORITY:
+			rt->metric = *(__u32 *) RTA_DATA(rta);
+			break;
+		case RTA_MULTIPATH:
+			nh = RTA_DATA(rta);
+			nlen = RTA_PAYLOAD(rta);
+			while (RTNH_OK(nh, nlen) && rt->nh_count < RTNL_NH_MAX) {
+				struct rtnl_nexthop *h = &rt->nh[rt->nh_count++];
+				struct rtattr *a = RTNH_DATA(nh);
+				int alen = nh->rtnh_len - RTNH_LENGTH(0);
+
+				h->oif = nh->rtnh_ifindex;
+				h->weight = nh->rtnh_hops + 1;
+				for (; RTA_OK(a, alen); a = RTA_NEXT(a, alen)) {
+					if (a->rta_type == RTA_GATEWAY)
+						memcpy(&h->gw, RTA_DATA(a), 4);
+				}
+				nlen -= NLMSG_ALIGN(nh->rtnh_len);
+				nh = RTNH_NEXT(nh);
+			}
+			break;
+		}
+	}
+	rt->table = table;
+
+	return table;
+}
+
+struct route_dump {
+	unsigned int table;
+	struct rtnl_routes *l;
+};
+
+static int rtnl_route_dump_fn(struct nlmsghdr *n, void *arg)
+{
+	struct route_dump *d = arg;
+	struct rtnl_route rt, *p;
+
+	if (rtnl_route_parse(n, &rt) != d->table)
+		return 0;
+	if ((p = rtnl_route_new(d->l)) == NULL)
+		return -1;
+	*p = rt;
+
+	return 0;
+}
+
+/* Append the unicast routes of table to l; returns how many, -1 on error */
+int rtnl_route_dump(unsigned int table, struct rtnl_routes *l)
+{
+	struct route_dump d = { table ? : RT_TABLE_MAIN, l };
+	int count = l->count;
+
+	if (rtnl_dump(RTM_GETROUTE, rtnl_route_dump_fn, &d) < 0)
+		return -1;
+
+	return l->count - count;
+}
+
+static int rtnl_route_same_key(struct rtnl_route *a, struct rtnl_route *b)
+{
+	return a->dst.s_addr == b->dst.s_addr && a->dst_len == b->dst_len && a->metric == b->metric;
+}
+
+static int rtnl_route_same(struct rtnl_route *a, struct rtnl_route *b)
+{
+	int i;
+
+	if (!rtnl_route_same_key(a, b) || a->gw.s_addr != b->gw.s_addr || a->oif != b->oif ||
+	    a->src.s_addr != b->src.s_addr || (a->proto ? : RTPROT_BOOT) != (b->proto ? : RTPROT_BOOT) ||
+	    a->nh_count != b->nh_count)
+		return 0;
+	for (i = 0; i < a->nh_count; i++) {
+		if (a->nh[i].gw.s_addr != b->nh[i].gw.s_addr || a->nh[i].oif != b->nh[i].oif ||
+		    (a->nh[i].weight ? : 1) != (b->nh[i].weight ? : 1))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Make table hold exactly the routes of want: routes the kernel has but
+ * want lacks are deleted, changed or missing ones replaced, identical
+ * ones left alone. Returns the number of failed updates, -1 on error.
+ */
+int rtnl_route_sync(unsigned int table, struct rtnl_routes *want)
+{
+	struct rtnl_routes cur = { 0 }, diff = { 0 };
+	struct rtnl_route *rt;
+	char *keep;
+	int i, j, ret = -1;
+
+	table = table ? : RT_TABLE_MAIN;
+	if (rtnl_route_dump(table, &cur) < 0)
+		goto out;
+	if ((keep = calloc(want->count + 1, 1)) == NULL)
+		goto out;
+
+	for (i = 0; i < cur.count; i++) {
+		for (j = 0; j < want->count; j++) {
+			if (!keep[j] && rtnl_route_same(&cur.rt[i], &want->rt[j]))
+				break;
+		}
+		if (j < want->count) {
+			keep[j] = 1;
+			continue;
+		}
+		/* replaced below anyway if want has the same key */
+		for (j = 0; j < want->count; j++) {
+			if (rtnl_route_same_key(&cur.rt[i], &want->rt[j]))
+				break;
+		}
+		if (j < want->count)
+			continue;
+		if ((rt = rtnl_route_new(&diff)) == NULL)
+			break;
+		*rt = cur.rt[i];
+		rt->cmd = RTNL_DELETE;
+	}
+
+	for (j = 0; j < want->count; j++) {
+		if (keep[j])
+			continue;
+		if ((rt = rtnl_route_new(&diff)) == NULL)
+			break;
+		*rt = want->rt[j];
+		rt->cmd = RTNL_REPLACE;
+		rt->table = table;
+	}
+	free(keep);
+
+	ret = rtnl_route_batch(&diff);
+
+out:
+	rtnl_routes_free(&cur);
+	rtnl_routes_free(&diff);
+	return ret;
+}
+
+static void rtnl_rule_msg(struct rtnl_rule *rule, int type, struct rtnl_req *req)
+{
+	memset(req, 0, sizeof(struct nlmsghdr) + sizeof(struct fib_rule_hdr));
+	req->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct fib_rule_hdr));
+	req->n.nlmsg_type = type;
+	if (type == RTM_NEWRULE)
+		req->n.nlmsg_flags = NLM_F_CREATE | NLM_F_EXCL;
+	req->f.family = AF_INET;
+	req->f.action = FR_ACT_TO_TBL;
+	req->f.src_len = rule->src_len;
+	req->f.dst_len = rule->dst_len;
+	req->f.table = (rule->table < 256) ? rule->table : RT_TABLE_UNSPEC;
+
+	addattr32(&req->n, FRA_PRIORITY, rule->pref);
+	if (rule->table >= 256)
+		addattr32(&req->n, FRA_TABLE, rule->table);
+	if (rule->src_len)
+		addattr(&req->n, FRA_SRC, &rule->src, 4);
+	if (rule->dst_len)
+		addattr(&req->n, FRA_DST, &rule->dst, 4);
+	if (rule->fwmark || rule->fwmask) {
+		addattr32(&req->n, FRA_FWMARK, rule->fwmark);
+		addattr32(&req->n, FRA_FWMASK, rule->fwmask);
+	}
+}
+
+struct rule_sync {
+	struct rtnl_rules *want;
+	char *keep;
+	struct rtnl_batch *b;
+	int err;
+};
+
+static int rtnl_rule_sync_fn(struct nlmsghdr *n, void *arg)
+{
+	struct rule_sync *s = arg;
+	struct fib_rule_hdr *f = NLMSG_DATA(n);
+	struct rtnl_rule cur;
+	struct rtattr *rta;
+	int len, other = 0, i;
+
+	if (n->nlmsg_type != RTM_NEWRULE || f->family != AF_INET)
+		return 0;
+
+	memset(&cur, 0, sizeof(cur));
+	cur.table = f->table;
+	cur.src_len = f->src_len;
+	cur.dst_len = f->dst_len;
+	if (f->action != FR_ACT_TO_TBL || f->tos)
+		other = 1;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*f));
+	for (rta = (struct rtattr *) ((char *) f + NLMSG_ALIGN(sizeof(*f))); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case FRA_PRIORITY:
+			cur.pref = *(__u32 *) RTA_DATA(rta);
+			break;
+		case FRA_TABLE:
+			cur.table = *(__u32 *) RTA_DATA(rta);
+			break;
+		case FRA_SRC:
+			memcpy(&cur.src, RTA_DATA(rta), 4);
+			break;
+		case FRA_DST:
+			memcpy(&cur.dst, RTA_DATA(rta), 4);
+			break;
+		case FRA_FWMARK:
+			cur.fwmark = *(__u32 *) RTA_DATA(rta);
+			break;
+		case FRA_FWMASK:
+			cur.fwmask = *(__u32 *) RTA_DATA(rta);
+			break;
+		case FRA_IFNAME:
+		case FRA_GOTO:
+		case FRA_FLOW:
+			/* selectors we never set: not one of ours */
+			other = 1;
+			break;
+		}
+	}
+
+	/* the local table rule stays, like with "ip rule flush" */
+	if (cur.pref == 0)
+		return 0;
+
+	for (i = 0; !other && i < s->want->count; i++) {
+		struct rtnl_rule *w = &s->want->rule[i];
+
+		if (!s->keep[i] && w->pref == cur.pref && w->table == cur.table &&
+		    w->src_len == cur.src_len && w->dst_len == cur.dst_len &&
+		    (!w->src_len || w->src.s_addr == cur.src.s_addr) &&
+		    (!w->dst_len || w->dst.s_addr == cur.dst.s_addr) &&
+		    w->fwmark == cur.fwmark && w->fwmask == cur.fwmask) {
+			s->keep[i] = 1;
+			return 0;
+		}
+	}
+
+	/* delete it exactly as dumped */
+	n->nlmsg_type = RTM_DELRULE;
+	n->nlmsg_flags = 0;
+	s->err += rtnl_queue(s->b, n, NULL);
+
+	return 0;
+}
+
+/*
+ * Make the IPv4 policy rules exactly want (plus the pref 0 local rule):
+ * others are deleted, missing ones added, existing ones left in place.
+ * Returns the number of failed updates, -1 on error.
+ */
+int rtnl_rule_sync(struct rtnl_rules *want)
+{
+	struct rule_sync s;
+	struct rtnl_req req;
+	int i, fails;
+
+	memset(&s, 0, sizeof(s));
+	s.want = want;
+	if ((s.keep = calloc(want->count + 1, 1)) == NULL ||
+	    (s.b = malloc(sizeof(*s.b))) == NULL || rtnl_batch_init(s.b) < 0) {
+		free(s.keep);
+		free(s.b);
+		return -1;
+	}
+
+	if (rtnl_dump(RTM_GETRULE, rtnl_rule_sync_fn, &s) < 0) {
+		rtnl_batch_done(s.b);
+		free(s.b);
+		free(s.keep);
+		return -1;
+	}
+	/* deletions go first, a new rule may reuse a deleted one's pref */
+	fails = s.err + rtnl_flush(s.b);
+
+	for (i = 0; i < want->count; i++) {
+		if (s.keep[i])
+			continue;
+		rtnl_rule_msg(&want->rule[i], RTM_NEWRULE, &req);
+		fails += rtnl_queue(s.b, &req.n, &want->rule[i].err);
+	}
+	fails += rtnl_batch_done(s.b);
+
+	free(s.b);
+	free(s.keep);
+
+	return fails;
+}
@@ -0,0 +1,208 @@
+/*
+	service_graph.c for starting independent services concurrently
+
+	A service table lists, for every service, the services it has to wait
+	for. run_service_graph() forks each service whose dependencies are done,
+	up to a job limit, and records begin/end of every start in a boot
+	timeline (chrome://tracing JSON array format) at BOOT_TRACE.
+*/
+
+#include <rc.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+#define BOOT_TRACE		"/tmp/boot_trace.json"
+#define SVC_MAX_JOBS		3
+
+enum {
+	SVC_WAIT = 0,
+	SVC_RUN,
+	SVC_DONE
+};
+
+static void boot_trace_write(const char *name, const char *cat, char ph, float ts, float dur, int tid)
+{
+	FILE *fp;
+	int empty;
+
+	if ((fp = fopen(BOOT_TRACE, "a")) == NULL)
+		return;
+
+	/* The closing ']' is optional in this format, so events are appended */
+	fseek(fp, 0, SEEK_END);
+	empty = (ftell(fp) == 0);
+	if (empty)
+		fprintf(fp, "[\n");
+
+	if (ph == 'X')
+		fprintf(fp, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.0f,\"pid\":1,\"tid\":%d},\n",
+			name, cat, ts * 1000000, dur * 1000000, tid);
+	else
+		fprintf(fp, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.0f,\"pid\":1,\"tid\":0},\n",
+			name, cat, ts * 1000000);
+	fclose(fp);
+}
+
+/* Record a completed span of the boot timeline; times are uptime seconds */
+void boot_trace_span(const char *name, float begin, float end, int tid)
+{
+	boot_trace_write(name, "service", 'X', begin, end - begin, tid);
+}
+
+/* Record a milestone such as "lan_ready" the first time it is reached */
+void boot_trace_mark(const char *name)
+{
+	char line[256], key[64];
+	FILE *fp;
+
+	snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+	if ((fp = fopen(BOOT_TRACE, "r")) != NULL) {
+		while (fgets(line, sizeof(line), fp)) {
+			if (strstr(line, key)) {
+				fclose(fp);
+				return;
+			}
+		}
+		fclose(fp);
+	}
+
+	boot_trace_write(name, "milestone", 'i', uptime2(), 0, 0);
+}
+
+static int svc_index(struct svc_node *svc, int count, const char *name)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (!strcmp(svc[i].name, name))
+			return i;
+
+	return -1;
+}
+
+/* Unknown names (services compiled out) count as satisfied */
+static int svc_ready(struct svc_node *svc, int *state, int count, int i)
+{
+	char word[32];
+	const char *next;
+	int dep;
+
+	if (!svc[i].after)
+		return 1;
+
+	foreach (word, svc[i].after, next) {
+		if ((dep = svc_index(svc, count, word)) >= 0 && state[dep] != SVC_DONE)
+			return 0;
+	}
+
+	return 1;
+}
+
+static void svc_run_inline(struct svc_node *svc, int i)
+{
+	float begin = uptime2();
+
+	svc[i].start();
+	boot_trace_span(svc[i].name, begin, uptime2(), 0);
+}
+
+/*
+ * Start every service of the table, each one in its own child process as
+ * soon as its dependencies are done, with at most nvram boot_jobs (default
+ * SVC_MAX_JOBS) running at once. boot_jobs=1 keeps the table order and
+ * runs everything inline, as the plain sequence of start_xxx() calls did.
+ */
+void run_service_graph(struct svc_node *svc, int count)
+{
+	int state[count], slot[count];
+	pid_t pid[count];
+	float begin[count];
+	int max_jobs, running, done, i, j, status, used, reaped, waited = 0;
+	sigset_t chld, omask;
+	pid_t p;
+
+	max_jobs = nvram_get("boot_jobs") ? nvram_get_int("boot_jobs") : SVC_MAX_JOBS;
+	if (max_jobs <= 1) {
+		for (i = 0; i < count; i++)
+			svc_run_inline(svc, i);
+		return;
+	}
+
+	memset(state, 0, sizeof(state));
+
+	/* Keep handle_reap() from taking our children before waitpid() does */
+	sigemptyset(&chld);
+	sigaddset(&chld, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &chld, &omask);
+
+	running = done = 0;
+	while (done < count) {
+		for (i = 0; i < count && running < max_jobs; i++) {
+			if (state[i] != SVC_WAIT || !svc_ready(svc, state, count, i))
+				continue;
+
+			/* Lowest free trace row, so concurrent starts show side by side */
+			for (used = 1; ; used++) {
+				for (j = 0; j < count; j++)
+					if (state[j] == SVC_RUN && slot[j] == used)
+						break;
+				if (j == count)
+					break;
+			}
+
+			begin[i] = uptime2();
+			if ((pid[i] = fork()) == 0) {
+				sigprocmask(SIG_SETMASK, &omask, NULL);
+				svc[i].start();
+				_exit(0);
+			}
+			if (pid[i] < 0) {
+				_dprintf("%s: fork %s: %s\n", __FUNCTION__, svc[i].name, strerror(errno));
+				svc_run_inline(svc, i);
+				state[i] = SVC_DONE;
+				done++;
+				continue;
+			}
+			slot[i] = used;
+			state[i] = SVC_RUN;
+			running++;
+		}
+
+		if (!running) {
+			/* Dependency cycle: finish the rest in table order */
+			for (i = 0; i < count; i++) {
+				if (state[i] != SVC_WAIT)
+					continue;
+				_dprintf("%s: %s has unmet dependencies\n", __FUNCTION__, svc[i].name);
+				svc_run_inline(svc, i);
+				state[i] = SVC_DONE;
+				done++;
+			}
+			break;
+		}
+
+		/* Reap only our own children, other ones are left to handle_reap() */
+		for (i = 0, reaped = 0; i < count; i++) {
+			if (state[i] != SVC_RUN)
+				continue;
+			/* ECHILD: already reaped, with SIGCHLD ignored */
+			if ((p = waitpid(pid[i], &status, WNOHANG)) == 0 || (p < 0 && errno != ECHILD))
+				continue;
+			boot_trace_span(svc[i].name, begin[i], uptime2(), slot[i]);
+			state[i] = SVC_DONE;
+			running--;
+			done++;
+			reaped++;
+		}
+		if (!reaped) {
+			/* SIGCHLD stays pending while blocked, no exit is missed */
+			sigwaitinfo(&chld, NULL);
+			waited = 1;
+		}
+	}
+
+	/* The SIGCHLDs taken above may have been for other children too */
+	if (waited)
+		raise(SIGCHLD);
+	sigprocmask(SIG_SETMASK, &omask, NULL);
+}
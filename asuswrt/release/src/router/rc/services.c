@@ -5239,6 +5239,54 @@ stop_ptcsrv(void)
 
 #endif
 
+static void svc_infosvr(void)
+{
+	start_infosvr();
+}
+
+static void svc_lltd(void)
+{
+#if 0
+	start_lldpd();
+#else
+	start_lltd();
+#endif
+}
+
+#ifdef RTCONFIG_JFFS2USERICON
+static void svc_lltdc(void)
+{
+	start_lltdc();
+}
+#endif
+
+static void svc_networkmap(void)
+{
+	start_networkmap(1);
+}
+
+/* Services started by start_services() that do not depend on each other,
+ * except as listed, and may start concurrently. Starts that only queue a
+ * request to init when not run by it (httpd, pptpd, webdav) stay inline.
+ */
+static struct svc_node boot_services[] = {
+	{ "cifs",	start_cifs,		NULL },
+#ifdef RTCONFIG_CROND
+	{ "cron",	start_cron,		NULL },
+#endif
+	{ "infosvr",	svc_infosvr,		NULL },
+	{ "rstats",	restart_rstats,		NULL },
+};
+
+static struct svc_node lan_services[] = {
+	{ "snooper",	start_snooper,		NULL },
+	{ "lltd",	svc_lltd,		NULL },
+#ifdef RTCONFIG_JFFS2USERICON
+	{ "lltdc",	svc_lltdc,		"lltd" },
+#endif
+	{ "networkmap",	svc_networkmap,		"lltdc" },
+};
+
 int
 start_services(void)
 {
@@ -5302,14 +5350,8 @@ start_services(void)
 	/* Link-up LAN ports after DHCP server ready. */
 	start_lan_port(0);
 
-	start_cifs();
 	start_httpd();
-#ifdef RTCONFIG_CROND
-	start_cron();
-#endif
-	start_infosvr();
-
-	restart_rstats();
+	run_service_graph(boot_services, ARRAY_SIZE(boot_services));
 #ifdef RTCONFIG_DSL
 	start_spectrum(); //Ren
 #endif
@@ -5335,12 +5377,7 @@ start_services(void)
 #if defined(RTCONFIG_BCMWL6) && defined(RTCONFIG_PROXYSTA)
 	start_psta_monitor();
 #endif
-	start_snooper();
-#if 0
-	start_lldpd();
-#else
-	start_lltd();
-#endif
+	run_service_graph(lan_services, ARRAY_SIZE(lan_services));
 #ifdef RTCONFIG_TOAD
 	start_toads();
 #endif
@@ -5349,11 +5386,6 @@ start_services(void)
 //        rc_ipsec_config_init();
 #endif
 
-#ifdef RTCONFIG_JFFS2USERICON
-	start_lltdc();
-#endif
-	start_networkmap(1);
-
 #if defined(RTCONFIG_PPTPD) || defined(RTCONFIG_ACCEL_PPTPD)
 	start_pptpd();
 #endif
@@ -8515,10 +8547,16 @@ check_ddr_done:
 
 #ifdef RTCONFIG_OPENVPN
 	else if (strncmp(script, "vpnclient", 9) == 0) {
+		if ((action & RC_SERVICE_STOP) && (action & RC_SERVICE_START) &&
+		    vpnclient_unchanged(atoi(&script[9])))
+			action = 0;
 		if (action & RC_SERVICE_STOP) stop_vpnclient(atoi(&script[9]));
 		if (action & RC_SERVICE_START) start_vpnclient(atoi(&script[9]));
 	}
 	else if (strncmp(script, "vpnserver" ,9) == 0) {
+		if ((action & RC_SERVICE_STOP) && (action & RC_SERVICE_START) &&
+		    vpnserver_unchanged(atoi(&script[9])))
+			action = 0;
 		if (action & RC_SERVICE_STOP) stop_vpnserver(atoi(&script[9]));
 		if (action & RC_SERVICE_START) start_vpnserver(atoi(&script[9]));
 	}
@@ -8541,6 +8579,9 @@ check_ddr_done:
 	else if (strcmp(script, "openvpnd") == 0)
 	{
 		int openvpn_unit = nvram_get_int("vpn_server_unit");
+		if ((action & RC_SERVICE_STOP) && (action & RC_SERVICE_START) &&
+		    vpnserver_unchanged(openvpn_unit))
+			action = 0;
 		if (action & RC_SERVICE_STOP){
 			stop_vpnserver(openvpn_unit);
 		}
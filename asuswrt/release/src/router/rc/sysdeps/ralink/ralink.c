@@ -3311,48 +3311,17 @@ getSiteSurvey(int band,char* ofile)
 	char header[128];
 	struct iwreq wrq;
 	SSA *ssap;
-	int lock;
+	int size;
 	FILE *fp;
 	char ssid_str[256],tmp[256];
 	char ure_mac[18];
 	int wl_authorized = 0;
-	memset(data, 0x00, 255);
-	strcpy(data, "SiteSurvey=1");
-	wrq.u.data.length = strlen(data)+1;
-	wrq.u.data.pointer = data;
-	wrq.u.data.flags = 0;
-	
-	lock = file_lock("sitesurvey");
-	if (wl_ioctl(get_wifname(band), RTPRIV_IOCTL_SET, &wrq) < 0)
-	{
-		file_unlock(lock);
 
-		dbg("Site Survey fails\n");
+	if ((size = wl_site_survey(get_wifname(band), data, sizeof(data) - 1, WLSCAN_MAX_AGE)) < 0)
 		return 0;
-	}
-	file_unlock(lock);
-
-	dbg("Please wait");
-	sleep(1);
-	dbg(".");
-	sleep(1);
-	dbg(".");
-	sleep(1);
-	dbg(".");
-	sleep(1);
-	dbg(".\n\n");
-
-	memset(data, 0, 8192);
-	strcpy(data, "");
-	wrq.u.data.length = 8192;
+	memset(&wrq, 0, sizeof(wrq));
+	wrq.u.data.length = size;
 	wrq.u.data.pointer = data;
-	wrq.u.data.flags = 0;
-
-	if (wl_ioctl(get_wifname(band), RTPRIV_IOCTL_GSITESURVEY, &wrq) < 0)
-	{
-		dbg("errors in getting site survey result\n");
-		return 0;
-	}
 	memset(header, 0, sizeof(header));
 	//sprintf(header, "%-3s%-33s%-18s%-8s%-15s%-9s%-8s%-2s\n", "Ch", "SSID", "BSSID", "Enc", "Auth", "Siganl(%)", "W-Mode", "NT");
 	sprintf(header, "%-4s%-33s%-18s%-9s%-16s%-9s%-8s\n", "Ch", "SSID", "BSSID", "Enc", "Auth", "Siganl(%)", "W-Mode");
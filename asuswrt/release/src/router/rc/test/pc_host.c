@@ -0,0 +1,7 @@
+/* Runs pc_main() of pc.c on the host, e.g. "pc_host showrules" */
+extern int pc_main(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+	return pc_main(argc, argv);
+}
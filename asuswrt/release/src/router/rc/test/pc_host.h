@@ -0,0 +1,59 @@
+/*
+ * Stand-in for rc.h, bcmnvram.h and shutils.h, enough to build pc.c on the
+ * host. nvram variables are read from the environment.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _dprintf(fmt, args...) fprintf(stderr, fmt, ##args)
+#define DAYS_PARAM " --days "
+
+#define foreach_60(word, wordlist, next) \
+		for (next = &wordlist[strspn(wordlist, "<")], \
+				strncpy(word, next, sizeof(word)), \
+				word[strcspn(word, "<")] = '\0', \
+				word[sizeof(word) - 1] = '\0', \
+				next = strchr(next, '<'); \
+				strlen(word); \
+				next = next ? &next[strspn(next, "<")] : "", \
+				strncpy(word, next, sizeof(word)), \
+				word[strcspn(word, "<")] = '\0', \
+				word[sizeof(word) - 1] = '\0', \
+				next = strchr(next, '<'))
+
+#define foreach_62(word, wordlist, next) \
+		for (next = &wordlist[strspn(wordlist, ">")], \
+				strncpy(word, next, sizeof(word)), \
+				word[strcspn(word, ">")] = '\0', \
+				word[sizeof(word) - 1] = '\0', \
+				next = strchr(next, '>'); \
+				strlen(word); \
+				next = next ? &next[strspn(next, ">")] : "", \
+				strncpy(word, next, sizeof(word)), \
+				word[strcspn(word, ">")] = '\0', \
+				word[sizeof(word) - 1] = '\0', \
+				next = strchr(next, '>'))
+
+static inline char *nvram_safe_get(const char *name)
+{
+	char *value = getenv(name);
+
+	return value ? value : "";
+}
+
+static inline int nvram_match(const char *name, const char *match)
+{
+	return !strcmp(nvram_safe_get(name), match);
+}
+
+static inline char *strcat_r(const char *s1, const char *s2, char *buf)
+{
+	strcpy(buf, s1);
+	strcat(buf, s2);
+	return buf;
+}
+
+static inline int wan_primary_ifunit(void) { return 0; }
+static inline char *get_wan_ifname(int unit) { return "eth0"; }
+static inline void filter_setting(char *wan_if, char *wan_ip, char *lan_if, char *lan_ip, char *logaccept, char *logdrop) { }
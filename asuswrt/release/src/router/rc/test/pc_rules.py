@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""
+Check the parental control FORWARD rules of pc.c against the per-event
+rules the generator used to write, one or more per schedule event.
+
+Random device lists and schedules are fed to "pc_host showrules" through
+the environment. Both rule sets are then evaluated for every listed MAC,
+an unlisted one, and three points of every hour of the week. The verdict
+(PControls or DROP) must be the same everywhere.
+
+usage: pc_rules.py ./pc_host [seed] [rounds]
+"""
+import os
+import random
+import subprocess
+import sys
+
+DAYS = ["Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"]
+LAN_IF = "br0"
+
+
+def gen_schedules(ndev):
+    enabled, names, macs, daytime = [], [], [], []
+    for i in range(ndev):
+        enabled.append(random.choice("1110"))
+        names.append("d%d" % i)
+        macs.append("00:11:22:33:%02X:%02X" % (i // 256, i % 256))
+        events = []
+        for k in range(random.randint(1, 4)):
+            sd = random.randint(0, 6)
+            r = random.random()
+            if r < 0.1:
+                ed, sh = sd, random.randint(0, 23)
+                eh = sh
+            elif r < 0.5:
+                ed, sh, eh = sd, random.randint(0, 24), random.randint(0, 24)
+            else:
+                ed = random.choice([random.randint(sd, 6), 0])
+                sh, eh = random.randint(0, 24), random.randint(0, 24)
+            events.append("e%d<%d%d%02d%02d" % (k, sd, ed, sh, eh))
+        daytime.append("<".join(events))
+    env = {
+        "MULTIFILTER_ENABLE": ">".join(enabled),
+        "MULTIFILTER_DEVICENAME": ">".join(names),
+        "MULTIFILTER_MAC": ">".join(macs),
+        "MULTIFILTER_MACFILTER_DAYTIME": ">".join(daytime),
+        "lan_ifname": LAN_IF,
+    }
+    return env, macs
+
+
+def old_rules(env):
+    """The FORWARD rules of the per-event generator, one list per event"""
+    out = []
+    enabled = env["MULTIFILTER_ENABLE"].split(">")
+    macs = env["MULTIFILTER_MAC"].split(">")
+    daytime = env["MULTIFILTER_MACFILTER_DAYTIME"].split(">")
+    for en, mac, dt in zip(enabled, macs, daytime):
+        if en != "1":
+            continue
+        head = "-A FORWARD -i %s" % LAN_IF
+        tail = " -m mac --mac-source %s -j PControls" % mac
+        for ev in dt.split("<")[1::2]:
+            sd, ed, sh, eh = int(ev[0]), int(ev[1]), int(ev[2:4]), int(ev[4:6])
+            if sh == 24:  # the event parser moves it to the next morning
+                sd, sh = (sd + 1) % 7, 0
+            if sd == ed:
+                if sh == eh:
+                    out.append(head + tail)
+                    continue
+                r = head + " -m time"
+                if sh > 0:
+                    r += " --timestart %d:0" % sh
+                if eh < 24:
+                    r += " --timestop %d:0" % eh
+                out.append(r + " --days " + DAYS[sd] + tail)
+            elif sd < ed or ed == 0:
+                if ed == 0:
+                    ed = 7
+                r = head + " -m time"
+                if sh > 0:
+                    r += " --timestart %d:0" % sh
+                out.append(r + " --days " + DAYS[sd] + tail)
+                if ed - sd > 1:
+                    out.append(head + " -m time --days " +
+                               ",".join(DAYS[sd + 1:ed]) + tail)
+                if eh > 0:
+                    r = head + " -m time"
+                    if eh < 24:
+                        r += " --timestop %d:0" % eh
+                    # the old code indexed past Saturday here, Sunday was meant
+                    out.append(r + " --days " + DAYS[ed % 7] + tail)
+        out.append(head + " -m mac --mac-source %s -j DROP" % mac)
+    return "\n".join(out)
+
+
+def parse(text):
+    chains = {}
+    for line in text.splitlines():
+        if line.startswith(":"):
+            chains.setdefault(line[1:].split()[0], [])
+            continue
+        if not line.startswith("-A "):
+            continue
+        t = line.split()
+        rule = {"days": None, "start": 0, "stop": 24 * 3600 - 1, "mac": None, "j": None}
+        i = 2
+        while i < len(t):
+            if t[i] in ("--timestart", "--timestop"):
+                h, m = t[i + 1].split(":")
+                rule["start" if t[i] == "--timestart" else "stop"] = int(h) * 3600 + int(m) * 60
+            elif t[i] == "--days":
+                rule["days"] = t[i + 1].split(",")
+            elif t[i] == "--mac-source":
+                rule["mac"] = t[i + 1]
+            elif t[i] == "-j":
+                rule["j"] = t[i + 1]
+            else:
+                i += 1
+                continue
+            i += 2
+        chains.setdefault(t[1], []).append(rule)
+    return chains
+
+
+def verdict(chains, chain, mac, day, sec):
+    for r in chains.get(chain, []):
+        if r["mac"] and r["mac"] != mac:
+            continue
+        if r["days"] is not None and DAYS[day] not in r["days"]:
+            continue
+        s, e = r["start"], r["stop"]
+        if s <= e and not s <= sec <= e:
+            continue
+        if s > e and not (sec >= s or sec <= e):
+            continue
+        if r["j"] in ("PControls", "DROP"):
+            return r["j"]
+        v = verdict(chains, r["j"], mac, day, sec)
+        if v:
+            return v
+    return None
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__.strip())
+    random.seed(int(sys.argv[2]) if len(sys.argv) > 2 else 1)
+    rounds = int(sys.argv[3]) if len(sys.argv) > 3 else 300
+    checked = bad = 0
+    for _ in range(rounds):
+        env, macs = gen_schedules(random.randint(1, 12))
+        penv = dict(os.environ)
+        penv.update(env)
+        new = subprocess.run([sys.argv[1], "showrules"], env=penv,
+                             stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                             universal_newlines=True).stderr
+        chains = [parse(old_rules(env)), parse(new)]
+        for mac in macs + ["aa:aa:aa:aa:aa:aa"]:
+            for day in range(7):
+                for hour in range(24):
+                    for sec in (hour * 3600 + 1, hour * 3600 + 1800, hour * 3600 + 3599):
+                        checked += 1
+                        a = verdict(chains[0], "FORWARD", mac, day, sec)
+                        b = verdict(chains[1], "FORWARD", mac, day, sec)
+                        if a != b:
+                            bad += 1
+                            if bad <= 5:
+                                print("MISMATCH %s %s %02d:%02d old %s new %s: %s" %
+                                      (mac, DAYS[day], hour, sec % 3600 // 60, a, b,
+                                       env["MULTIFILTER_MACFILTER_DAYTIME"]))
+    print("pc_rules: %d checks, %d mismatches" % (checked, bad))
+    sys.exit(1 if bad else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -29,6 +29,9 @@
 #include <errno.h>
 #include <time.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <net/ethernet.h>
 
 #include <bcmnvram.h>
@@ -38,6 +41,13 @@
 /* Support for Domain Search List */
 #undef DHCP_RFC3397
 
+/* udhcpc hands its events to a server on "<script>.sock" if one listens */
+#define UDHCPC_SOCK		"/tmp/udhcpc.sock"
+#define UDHCPC_SERVER_PID	"/var/run/udhcpc_server.pid"
+#define UDHCPC_MAX_LEASES	8
+#define UDHCPC_MAX_EVENTS	8
+#define UDHCPC_MAX_VARS		256
+
 /* returns: length of hex value
  * dest size must be lagre enough to accept n bytes from
    src in hex representation plus one \0 byte */
@@ -587,6 +597,413 @@ udhcpc_wan(int argc, char **argv)
 	return 0;
 }
 
+/* Lease variables the event handlers act upon, "lease" last */
+static const char *lease_vars[] = {
+	"ip", "subnet", "router", "dns", "domain", "search", "wins",
+	"routes", "msstaticroutes", "staticroutes", "ip6rd", "opt43", "opt125",
+	"lease", NULL
+};
+#define LEASE_FIELDS	(sizeof(lease_vars) / sizeof(lease_vars[0]) - 1)
+#define LEASE_TIME	(LEASE_FIELDS - 1)
+
+/* Last lease applied to an interface by bound or renew */
+struct udhcpc_lease {
+	char ifname[IFNAMSIZ];
+	char *val[LEASE_FIELDS];
+};
+
+/* Event handled by a child, answered once it exits */
+struct udhcpc_event {
+	pid_t pid;
+	int fd;
+	struct udhcpc_lease lease;	/* to keep if the handler succeeds */
+};
+
+static struct udhcpc_lease leases[UDHCPC_MAX_LEASES];
+static struct udhcpc_event events[UDHCPC_MAX_EVENTS];
+static int server_fd = -1;
+static volatile int server_stop;
+
+static void
+lease_free(struct udhcpc_lease *lease)
+{
+	int i;
+
+	for (i = 0; i < LEASE_FIELDS; i++) {
+		free(lease->val[i]);
+		lease->val[i] = NULL;
+	}
+	lease->ifname[0] = '\0';
+}
+
+static void
+lease_copy(struct udhcpc_lease *lease, const char *ifname, char **val)
+{
+	int i;
+
+	lease_free(lease);
+	strlcpy(lease->ifname, ifname, sizeof(lease->ifname));
+	for (i = 0; i < LEASE_FIELDS; i++)
+		lease->val[i] = val[i] ? strdup(val[i]) : NULL;
+}
+
+static struct udhcpc_lease *
+lease_find(const char *ifname, int create)
+{
+	struct udhcpc_lease *lease, *unused = NULL;
+
+	for (lease = leases; lease < &leases[UDHCPC_MAX_LEASES]; lease++) {
+		if (strcmp(lease->ifname, ifname) == 0)
+			return lease;
+		if (!unused && lease->ifname[0] == '\0')
+			unused = lease;
+	}
+
+	return create ? unused : NULL;
+}
+
+/* returns: bitmask of the fields that differ */
+static unsigned int
+lease_diff(const struct udhcpc_lease *lease, char **val)
+{
+	unsigned int diff = 0;
+	int i;
+
+	for (i = 0; i < LEASE_FIELDS; i++) {
+		if (strcmp(lease->val[i] ? : "", val[i] ? : "") != 0)
+			diff |= 1 << i;
+	}
+
+	return diff;
+}
+
+/* renew of a lease that only got extended: the handler would only
+ * rewrite the lease time, do that here */
+static int
+lease_extend(char *wan_ifname, char **val)
+{
+	char tmp[100], prefix[sizeof("wanXXXXXXXXXX_")];
+	int unit, ifunit;
+	unsigned int lease;
+
+	if (!val[0] || !val[LEASE_TIME])
+		return -1;
+
+	if ((ifunit = wan_prefix(wan_ifname, prefix)) < 0)
+		return -1;
+	if ((unit = wan_ifunit(wan_ifname)) < 0)
+		snprintf(prefix, sizeof(prefix), "wan%d_x", ifunit);
+	else	snprintf(prefix, sizeof(prefix), "wan%d_", ifunit);
+
+	/* Applied lease was replaced meanwhile */
+	if (!nvram_match(strcat_r(prefix, "ipaddr", tmp), trim_r(val[0])))
+		return -1;
+
+	lease = atoi(val[LEASE_TIME]);
+	nvram_set_int(strcat_r(prefix, "lease", tmp), lease);
+	expires(wan_ifname, lease);
+
+	_dprintf("udhcpc:: %s %s extended by %u\n", __FUNCTION__, wan_ifname, lease);
+	return 0;
+}
+
+static void
+udhcpc_server_reply(int fd)
+{
+	char c = 0;
+
+	send(fd, &c, sizeof(c), MSG_NOSIGNAL);
+	close(fd);
+}
+
+/* Not handled here, udhcpc runs the script itself. A plain close would
+ * not do: once the event is sent, udhcpc takes EOF as handled.
+ */
+static void
+udhcpc_server_decline(int fd)
+{
+	char c = 1;
+
+	send(fd, &c, sizeof(c), MSG_NOSIGNAL);
+	close(fd);
+}
+
+static void
+udhcpc_server_done(pid_t pid, int status)
+{
+	struct udhcpc_event *ev;
+	struct udhcpc_lease *lease;
+
+	for (ev = events; ev < &events[UDHCPC_MAX_EVENTS]; ev++) {
+		if (ev->pid != pid)
+			continue;
+
+		if (ev->lease.ifname[0] && WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+		    (lease = lease_find(ev->lease.ifname, 1)) != NULL) {
+			lease_free(lease);
+			*lease = ev->lease;
+		} else
+			lease_free(&ev->lease);
+		memset(&ev->lease, 0, sizeof(ev->lease));
+
+		udhcpc_server_reply(ev->fd);
+		ev->pid = 0;
+		break;
+	}
+}
+
+static void
+udhcpc_server_handle(int fd)
+{
+	static char buf[16384];
+	char *env[UDHCPC_MAX_VARS], *val[LEASE_FIELDS];
+	char *event, *wan_ifname = NULL, *ptr, *end;
+	struct udhcpc_lease *lease;
+	struct udhcpc_event *ev;
+	int len, n, i, status;
+	pid_t pid;
+
+	/* Oversized message, leave it to the script */
+	len = recv(fd, buf, sizeof(buf) - 1, MSG_TRUNC);
+	if (len <= 0 || len >= (int) sizeof(buf)) {
+		udhcpc_server_decline(fd);
+		return;
+	}
+	buf[len] = '\0';
+
+	/* event\0var=value\0... */
+	event = buf;
+	memset(val, 0, sizeof(val));
+	end = buf + len;
+	n = 0;
+	for (ptr = buf + strlen(buf) + 1; ptr < end && n < UDHCPC_MAX_VARS - 1; ptr += strlen(ptr) + 1) {
+		env[n++] = ptr;
+		if (strncmp(ptr, "interface=", 10) == 0)
+			wan_ifname = ptr + 10;
+		for (i = 0; i < LEASE_FIELDS; i++) {
+			len = strlen(lease_vars[i]);
+			if (strncmp(ptr, lease_vars[i], len) == 0 && ptr[len] == '=')
+				val[i] = ptr + len + 1;
+		}
+	}
+	env[n] = NULL;
+
+	if (!wan_ifname || !*wan_ifname ||
+	    !(strstr(event, "deconfig") || strstr(event, "bound") ||
+	      strstr(event, "renew") || strstr(event, "leasefail"))) {
+		udhcpc_server_reply(fd);
+		return;
+	}
+
+	lease = lease_find(wan_ifname, 0);
+	if (lease && strstr(event, "renew") &&
+	    (lease_diff(lease, val) & ~(1 << LEASE_TIME)) == 0 &&
+	    lease_extend(wan_ifname, val) == 0) {
+		free(lease->val[LEASE_TIME]);
+		lease->val[LEASE_TIME] = val[LEASE_TIME] ? strdup(val[LEASE_TIME]) : NULL;
+		udhcpc_server_reply(fd);
+		return;
+	}
+
+	/* Anything else goes the full way, the lease is unknown until it's done */
+	if (lease)
+		lease_free(lease);
+
+	for (ev = events; ev < &events[UDHCPC_MAX_EVENTS]; ev++) {
+		if (ev->pid == 0)
+			break;
+	}
+	if (ev == &events[UDHCPC_MAX_EVENTS]) {
+		/* All busy, wait for the first one */
+		ev = &events[0];
+		status = -1;
+		while (waitpid(ev->pid, &status, 0) < 0 && errno == EINTR)
+			continue;
+		udhcpc_server_done(ev->pid, status);
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		udhcpc_server_decline(fd);
+		return;
+	}
+
+	if (pid == 0) {
+		char *argv[] = { "udhcpc", event, NULL };
+
+		close(server_fd);
+		close(fd);
+		signal(SIGTERM, SIG_DFL);
+		signal(SIGCHLD, SIG_DFL);
+		signal(SIGPIPE, SIG_DFL);
+		for (i = 0; env[i]; i++)
+			putenv(env[i]);
+
+		_exit(udhcpc_wan(2, argv));
+	}
+
+	ev->pid = pid;
+	ev->fd = fd;
+	if (strstr(event, "bound") || strstr(event, "renew"))
+		lease_copy(&ev->lease, wan_ifname, val);
+}
+
+/* Pid of a live udhcpc_server, 0 if there is none */
+static pid_t
+udhcpc_server_pid(void)
+{
+	char buf[16];
+	pid_t pid;
+
+	if (f_read_string(UDHCPC_SERVER_PID, buf, sizeof(buf)) <= 0)
+		return 0;
+	pid = atoi(buf);
+
+	return (pid > 0 && kill(pid, 0) == 0) ? pid : 0;
+}
+
+static void
+udhcpc_server_term(int sig)
+{
+	server_stop = 1;
+}
+
+static void
+udhcpc_server_chld(int sig)
+{
+	/* only to wake up poll() */
+}
+
+/*
+ * Handle udhcpc events without a fork/exec of rc per event. Renewals
+ * that only extend the lease are answered in place, all other events
+ * are run by a child with the environment udhcpc passed.
+ */
+int
+udhcpc_server(int argc, char **argv)
+{
+	struct sockaddr_un sun;
+	struct pollfd pfd;
+	struct udhcpc_event *ev;
+	int fd, pending, status;
+	pid_t pid;
+	FILE *fp;
+
+	signal(SIGHUP, SIG_IGN);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGTERM, udhcpc_server_term);
+	signal(SIGCHLD, udhcpc_server_chld);
+
+	if ((server_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0) {
+		perror("socket");
+		return errno;
+	}
+	fcntl(server_fd, F_SETFD, FD_CLOEXEC);
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strlcpy(sun.sun_path, UDHCPC_SOCK, sizeof(sun.sun_path));
+	unlink(sun.sun_path);
+	if (bind(server_fd, (struct sockaddr *) &sun, sizeof(sun)) < 0 ||
+	    listen(server_fd, UDHCPC_MAX_EVENTS) < 0) {
+		perror(sun.sun_path);
+		close(server_fd);
+		return errno;
+	}
+
+	if ((fp = fopen(UDHCPC_SERVER_PID, "w")) != NULL) {
+		fprintf(fp, "%d", getpid());
+		fclose(fp);
+	}
+
+	pfd.fd = server_fd;
+	pfd.events = POLLIN;
+	while (!server_stop) {
+		pending = 0;
+		for (ev = events; ev < &events[UDHCPC_MAX_EVENTS]; ev++)
+			pending += (ev->pid != 0);
+
+		/* SIGCHLD cuts the wait short, the timeout covers the race */
+		pfd.revents = 0;
+		poll(&pfd, 1, pending ? 1000 : -1);
+
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+			udhcpc_server_done(pid, status);
+
+		if ((pfd.revents & POLLIN) && (fd = accept(server_fd, NULL, NULL)) >= 0) {
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+			udhcpc_server_handle(fd);
+		}
+	}
+
+	/* Stop taking events, but answer the ones under way */
+	close(server_fd);
+	unlink(UDHCPC_SOCK);
+	for (ev = events; ev < &events[UDHCPC_MAX_EVENTS]; ev++) {
+		if (ev->pid == 0)
+			continue;
+		status = -1;
+		while (waitpid(ev->pid, &status, 0) < 0 && errno == EINTR)
+			continue;
+		udhcpc_server_done(ev->pid, status);
+	}
+	/* A new server may be up already */
+	if (udhcpc_server_pid() == getpid())
+		unlink(UDHCPC_SERVER_PID);
+
+	return 0;
+}
+
+void
+start_udhcpc_server(void)
+{
+	char *argv[] = { "/sbin/udhcpc_server", NULL };
+	pid_t pid;
+	int n = 10;
+
+	/* Children handling events carry the same name, go by the pidfile.
+	 * A server on its way out has given up the socket already.
+	 */
+	if (udhcpc_server_pid() > 0 && f_exists(UDHCPC_SOCK))
+		return;
+
+	_eval(argv, NULL, 0, &pid);
+
+	/* Until it listens, udhcpc events take the script path */
+	while (n-- > 0 && !f_exists(UDHCPC_SOCK))
+		usleep(100 * 1000);
+}
+
+void
+stop_udhcpc_server(void)
+{
+	pid_t pid;
+	int n = 30;
+
+	if ((pid = udhcpc_server_pid()) == 0)
+		return;
+	kill(pid, SIGTERM);
+
+	/* It gives up the socket at once, then answers the events under
+	 * way before it exits. The caller may be one of them, and must
+	 * not wait for its own parent.
+	 */
+	while (n-- > 0 && kill(pid, 0) == 0) {
+		if (getppid() == pid && !f_exists(UDHCPC_SOCK))
+			return;
+		waitpid(pid, NULL, WNOHANG);
+		usleep(100 * 1000);
+	}
+
+	if (kill(pid, 0) == 0) {
+		_dprintf("%s: udhcpc_server %d still busy, killing it\n", __FUNCTION__, pid);
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, WNOHANG);
+		unlink(UDHCPC_SOCK);
+		unlink(UDHCPC_SERVER_PID);
+	}
+}
+
 int
 start_udhcpc(char *wan_ifname, int unit, pid_t *ppid)
 {
@@ -1671,6 +1671,99 @@ _dprintf("test b. USB RESET finish.\n");
 	return (ret == MOUNT_VAL_RONLY || ret == MOUNT_VAL_RW);
 }
 
+/* The partitions of one or more disks arrive as a burst of hotplug events.
+ * Each handler bumps a shared sequence number as soon as it holds the "usb"
+ * lock, and records after (un)mounting whether the NAS applications need a
+ * restart (1) or a restart to wait for (2). Only the handler that is
+ * still the latest after the burst has been quiet for NASAPPS_DEBOUNCE
+ * seconds does the restart asked for, so a multi-partition disk costs one
+ * restart instead of one per partition, and none starts while a later
+ * partition is still being mounted.
+ */
+#define NASAPPS_SEQ		"/var/lock/usb_nasapps.seq"
+#define NASAPPS_DEBOUNCE	2
+
+static void nasapps_read(unsigned int *seq, int *pending)
+{
+	char buf[32];
+
+	*seq = 0;
+	*pending = 0;
+	if (f_read_string(NASAPPS_SEQ, buf, sizeof(buf)) > 0)
+		sscanf(buf, "%u %d", seq, pending);
+}
+
+static void nasapps_write(unsigned int seq, int pending)
+{
+	char buf[32];
+
+	snprintf(buf, sizeof(buf), "%u %d", seq, pending);
+	f_write_string(NASAPPS_SEQ, buf, 0, 0);
+}
+
+/* A new event arrived, returns its sequence number */
+static unsigned int nasapps_seq_bump(void)
+{
+	unsigned int seq;
+	int pending, lock;
+
+	lock = file_lock("usb_nasapps");
+	nasapps_read(&seq, &pending);
+	nasapps_write(++seq, pending);
+	file_unlock(lock);
+
+	return seq;
+}
+
+/* Record the restart an event asks for, any later event may act on it */
+static void nasapps_want(int nasapps)
+{
+	unsigned int seq;
+	int pending, lock;
+
+	lock = file_lock("usb_nasapps");
+	nasapps_read(&seq, &pending);
+	if (nasapps > pending)
+		nasapps_write(seq, nasapps);
+	file_unlock(lock);
+}
+
+/* Returns and clears the restart asked for if seq is still the latest
+ * event, -1 if a later one will take care of it.
+ */
+static int nasapps_take(unsigned int seq)
+{
+	unsigned int cur;
+	int pending, lock;
+
+	lock = file_lock("usb_nasapps");
+	nasapps_read(&cur, &pending);
+	if (cur == seq)
+		nasapps_write(cur, 0);
+	else
+		pending = -1;
+	file_unlock(lock);
+
+	return pending;
+}
+
+static void restart_nasapps_debounced(unsigned int seq, int nasapps)
+{
+	if (nasapps)
+		nasapps_want(nasapps);
+
+	sleep(NASAPPS_DEBOUNCE);
+	if ((nasapps = nasapps_take(seq)) < 0) {
+		_dprintf("restart_nasapps(%d): merged into a later hotplug event.\n", getpid());
+		return;
+	}
+
+	if (nasapps == 2)
+		notify_rc_and_wait("restart_nasapps");
+	else if (nasapps == 1)
+		notify_rc_after_wait("restart_nasapps");
+}
+
 /* Mount or unmount all partitions on this controller.
  * Parameter: action_add:
  * 0  = unmount
@@ -1877,7 +1970,8 @@ void hotplug_usb(void)
 	{
 		/* scsi partition */
 		char devname[64];
-		int lock, c;
+		int lock, c, nasapps = 0;
+		unsigned int seq;
 		char *d, dev[32], nv_name[32];
 
 		/* strip trail digits */
@@ -1889,6 +1983,7 @@ void hotplug_usb(void)
 
 		sprintf(devname, "/dev/%s", device);
 		lock = file_lock("usb");
+		seq = nasapps_seq_bump();
 		remove_disk_log(device);
 		if (add) {
 			if (nvram_get(nv_name) != NULL)
@@ -1900,13 +1995,15 @@ void hotplug_usb(void)
 					 * like APPLE iPOD shuffle. We can't mount it.
 					 */
 					file_unlock(lock);
+					/* It may be the latest event of its burst */
+					restart_nasapps_debounced(seq, 0);
 					return;
 				}
 				TRACE_PT(" mount to dev: %s\n", devname);
 				if (mount_partition(devname, host, NULL, device, EFH_HP_ADD)) {
 _dprintf("restart_nas_services(%d): test 5.\n", getpid());
 					//restart_nas_services(1, 1); // restart all NAS applications
-					notify_rc_and_wait("restart_nasapps");
+					nasapps = 2;
 				}
 				TRACE_PT(" end of mount\n");
 			}
@@ -1926,10 +2023,17 @@ _dprintf("restart_nas_services(%d): test 5.\n", getpid());
 			} else {
 _dprintf("restart_nas_services(%d): test 6.\n", getpid());
 				//restart_nas_services(1, 1);
-				notify_rc_after_wait("restart_nasapps");
+				nasapps = 1;
 			}
 		}
 		file_unlock(lock);
+
+		/* Outside of the "usb" lock, so the next partition can be
+		 * mounted while this event waits for the burst to settle.
+		 * Events that need no restart wait as well: being the latest,
+		 * they do the restart an earlier event asked for.
+		 */
+		restart_nasapps_debounced(seq, nasapps);
 	}
 #endif
 	else if (strncmp(interface ? : "", "8/", 2) == 0) {	/* usb storage */
@@ -2005,6 +2109,12 @@ void write_ftpd_conf()
 		fprintf(fp, "max_clients=%s\n", "10");
 	fprintf(fp, "ftp_username=anonymous\n");
 	fprintf(fp, "ftpd_banner=Welcome to ASUS %s FTP service.\n", get_productid());
+	if (nvram_get_int("ftp_ls_stream")) {
+		fprintf(fp, "ls_stream_enable=YES\n");
+		if (nvram_get_int("ftp_ls_unsorted"))
+			fprintf(fp, "ls_stream_unsorted=YES\n");
+	}
+	fprintf(fp, "ls_cache_size=%d\n", nvram_get_int("ftp_ls_cache"));
 
 	// update codepage
 	modprobe_r("nls_cp936");
@@ -54,6 +54,7 @@
 
 #include <linux/types.h>
 #include <linux/ethtool.h>
+#include <linux/rtnetlink.h>
 
 #ifdef RTCONFIG_USB
 #include <disk_io_tools.h>
@@ -140,55 +141,77 @@ _dprintf("==>%s ip: %s, prefix: %d\n", __func__, ip, prefixA);
 #define WAN0_ROUTE_TABLE 100
 #define WAN1_ROUTE_TABLE 200
 
-#define TEMP_ROUTE_FILE "/tmp/route_main"
+static void multi_rule(struct rtnl_rules *l, int pref, char *from, char *to, int table)
+{
+	struct rtnl_rule *rule;
+
+	if ((rule = rtnl_rule_new(l)) == NULL)
+		return;
 
-int copy_routes(int table){
-	char cmd[2048];
-	char *route_buf, *follow_info, line[1024];
-	int len;
+	rule->pref = pref;
+	rule->table = table;
+	if ((from && rtnl_prefix(from, &rule->src, &rule->src_len) < 0) ||
+	    (to && rtnl_prefix(to, &rule->dst, &rule->dst_len) < 0))
+		--l->count;
+}
 
-	if(table <= 0){
-		snprintf(cmd, 2048, "ip route flush table %d", WAN0_ROUTE_TABLE);
-		system(cmd);
+static struct rtnl_route *multi_route(struct rtnl_routes *l, int cmd, char *dst, char *gateway, char *ifname)
+{
+	struct rtnl_route *rt;
 
-		snprintf(cmd, 2048, "ip route flush table %d", WAN1_ROUTE_TABLE);
-		system(cmd);
+	if ((rt = rtnl_route_new(l)) == NULL)
+		return NULL;
 
-		return 0;
+	rt->cmd = cmd;
+	if (dst) {
+		inet_aton(dst, &rt->dst);
+		rt->dst_len = 32;
 	}
+	if (gateway)
+		inet_aton(gateway, &rt->gw);
+	rt->oif = if_nametoindex(ifname);
 
-	snprintf(cmd, 2048, "ip route list table main > %s", TEMP_ROUTE_FILE);
-	system(cmd);
+	return rt;
+}
 
-	route_buf = read_whole_file(TEMP_ROUTE_FILE);
-	if(route_buf == NULL || strlen(route_buf) <= 0)
-		return -1;
+#ifdef RTCONFIG_DUALWAN
+/*
+ * Copy of the main table without its default routes, like "ip route list
+ * table main", and without the route to the wan's own gateway.
+ */
+static void copy_routes(struct rtnl_routes *main_routes, struct rtnl_routes *l, char *gate_ip, char *ifname)
+{
+	struct rtnl_route *rt;
+	struct in_addr gate;
+	int i, oif;
 
-	follow_info = route_buf;
-	while(get_line_from_buffer(follow_info, line, 1024) != NULL) {
-		follow_info += strlen(line);
+	inet_aton(gate_ip, &gate);
+	oif = if_nametoindex(ifname);
 
-		if(strncmp(line, "default", 7) == 0 || isspace(line[0]))
+	for (i = 0; i < main_routes->count; i++) {
+		if (main_routes->rt[i].dst_len == 0)
 			continue;
-
-		len = strlen(line);
-		line[len-2] = 0;
-
-		snprintf(cmd, 2048, "ip route add table %d %s", table, line);
-		system(cmd);
+		if (main_routes->rt[i].dst_len == 32 &&
+		    main_routes->rt[i].dst.s_addr == gate.s_addr && main_routes->rt[i].oif == oif)
+			continue;
+		if ((rt = rtnl_route_new(l)) == NULL)
+			return;
+		*rt = main_routes->rt[i];
 	}
-
-	free(route_buf);
-
-	return 0;
 }
+#endif
 
 /*
  * the priority of routing rules:
+ * pref 90:  load-balance fwmark.
  * pref 100: user's routes.
  * pref 200: from wan's ip, from wan's DNS.
  * pref 300: ISP's routes.
  * pref 400: to wan's gateway, to wan's DNS.
+ *
+ * The rules, the per-wan tables and the main table are built as lists
+ * and synced over netlink in a few batches; only what differs from the
+ * kernel's current state is touched, so nothing is ever flushed.
  */
 int add_multi_routes(void)
 {
@@ -196,27 +219,27 @@ int add_multi_routes(void)
 	char tmp[100], prefix[] = "wanXXXXXXXXXX_";
 	char wan_proto[32];
 	char wan_ip[32], wan_gate[32];
-	char cmd[2048];
 	char wan_multi_if[WAN_UNIT_MAX][32], wan_multi_gate[WAN_UNIT_MAX][32];
+	struct rtnl_rules rules = { 0 };
+	struct rtnl_routes main_batch = { 0 };
+	struct rtnl_routes tables[2] = { { 0 }, { 0 } };
+	struct rtnl_route *rt;
 #ifdef RTCONFIG_DUALWAN
+	struct rtnl_routes main_routes = { 0 };
 	int gate_num = 0, wan_weight, table;
-	char cmd2[2048], *ptr;
 	char wan_dns[1024];
 	char wan_multi_ip[WAN_UNIT_MAX][32];
 	char word[64], *next;
 	char *nv, *nvp, *b;
+	struct rtnl_route multi;
 #endif
 	int debug = nvram_get_int("routes_debug");
-	int lock;
+	int lock, fails = 0, lost, n[4], i;
 	lock = file_lock("mt_routes");
 
-	// clean the rules of routing table and re-build them then.
-	system("ip rule flush");
-	system("ip rule add from all lookup main pref 32766");
-	system("ip rule add from all lookup default pref 32767");
-
-	// clean multi route tables and re-build them then.
-	copy_routes(0);
+	// the rules of routing table are re-built from these.
+	multi_rule(&rules, 32766, NULL, NULL, RT_TABLE_MAIN);
+	multi_rule(&rules, 32767, NULL, NULL, RT_TABLE_DEFAULT);
 
 	memset(wan_multi_if, 0, sizeof(char)*WAN_UNIT_MAX*32);
 	memset(wan_multi_gate, 0, sizeof(char)*WAN_UNIT_MAX*32);
@@ -248,6 +271,12 @@ int add_multi_routes(void)
 		strcpy(wan_multi_gate[unit], wan_gate);
 	}
 
+#ifdef RTCONFIG_DUALWAN
+	// the multi route tables start as a copy of the main one.
+	if(nvram_match("wans_mode", "lb") && gate_num > 1)
+		rtnl_route_dump(RT_TABLE_MAIN, &main_routes);
+#endif
+
 	for(unit = WAN_UNIT_FIRST; unit < WAN_UNIT_MAX; ++unit){ // Multipath
 		if(unit != wan_primary_ifunit()
 #ifdef RTCONFIG_DUALWAN
@@ -268,6 +297,8 @@ int add_multi_routes(void)
 			continue;
 
 		if(nvram_match("wans_mode", "lb") && gate_num > 1){
+			struct rtnl_routes *l;
+
 			if(strlen(wan_multi_ip[unit]) <= 0 || !strcmp(wan_multi_ip[unit], "0.0.0.0"))
 				continue;
 
@@ -275,40 +306,19 @@ int add_multi_routes(void)
 				table = WAN1_ROUTE_TABLE;
 			else
 				table = WAN0_ROUTE_TABLE;
+			l = &tables[table == WAN1_ROUTE_TABLE];
 
 			// set the rules of wan[X]'s ip and gateway for multi routing tables.
-			snprintf(cmd2, 2048, "ip rule del pref 200 from %s table %d 2>/dev/null", wan_multi_ip[unit], table);
-if(debug) printf("test 1. cmd2=%s.\n", cmd2);
-			system(cmd2);
-
-			snprintf(cmd2, 2048, "ip rule add pref 200 from %s table %d", wan_multi_ip[unit], table);
-if(debug) printf("test 2. cmd2=%s.\n", cmd2);
-			system(cmd2);
-
-			snprintf(cmd2, 2048, "ip rule del pref 400 to %s table %d 2>/dev/null", wan_multi_gate[unit], table);
-if(debug) printf("test 3. cmd2=%s.\n", cmd2);
-			system(cmd2);
-
-			snprintf(cmd2, 2048, "ip rule add pref 400 to %s table %d", wan_multi_gate[unit], table);
-if(debug) printf("test 4. cmd2=%s.\n", cmd2);
-			system(cmd2);
+			multi_rule(&rules, 200, wan_multi_ip[unit], NULL, table);
+			multi_rule(&rules, 400, NULL, wan_multi_gate[unit], table);
 
 			// set the routes for multi routing tables.
-			copy_routes(table);
-
-			snprintf(cmd2, 2048, "ip route replace %s dev %s proto kernel table %d", wan_multi_gate[unit], wan_multi_if[unit], table);
-if(debug) printf("test 5. cmd2=%s.\n", cmd2);
-			system(cmd2);
-
-			snprintf(cmd2, 2048, "ip route replace default via %s dev %s table %d", wan_multi_gate[unit], wan_multi_if[unit], table);
-if(debug) printf("test 6. cmd2=%s.\n", cmd2);
-			system(cmd2);
-
-			if(!strcmp(wan_proto, "pptp") || !strcmp(wan_proto, "l2tp")){
-				snprintf(cmd2, 2048, "ip route del %s dev %s table %d 2>/dev/null", wan_multi_gate[unit], wan_multi_if[unit], table);
-if(debug) printf("test 7. cmd2=%s.\n", cmd2);
-				system(cmd2);
+			copy_routes(&main_routes, l, wan_multi_gate[unit], wan_multi_if[unit]);
+			if(strcmp(wan_proto, "pptp") && strcmp(wan_proto, "l2tp")){
+				if((rt = multi_route(l, RTNL_REPLACE, wan_multi_gate[unit], NULL, wan_multi_if[unit])) != NULL)
+					rt->proto = RTPROT_KERNEL;
 			}
+			multi_route(l, RTNL_REPLACE, NULL, wan_multi_gate[unit], wan_multi_if[unit]);
 
 			// set the static routing rules.
 			if(nvram_match("wans_routing_enable", "1")){
@@ -332,61 +342,42 @@ if(debug) printf("test 7. cmd2=%s.\n", cmd2);
 					else // incorrect table.
 						continue;
 
-					if(rtable == table){
-						snprintf(cmd2, 2048, "ip rule del pref 100 from %s to %s table %d 2>/dev/null", rfrom, rto, rtable);
-if(debug) printf("test 8. cmd2=%s.\n", cmd2);
-						system(cmd2);
-
-						snprintf(cmd2, 2048, "ip rule add pref 100 from %s to %s table %d", rfrom, rto, rtable);
-if(debug) printf("test 9. cmd2=%s.\n", cmd2);
-						system(cmd2);
-					}
+					if(rtable == table)
+						multi_rule(&rules, 100, rfrom, rto, rtable);
 	 			}
 				free(nv);
 			}
 		}
 		else
 		{
-			snprintf(cmd, 2048, "ip route replace %s dev %s proto kernel", wan_multi_gate[unit], wan_multi_if[unit]);
-if(debug) printf("test 10. cmd=%s.\n", cmd);
-			system(cmd);
+			if((rt = multi_route(&main_batch, RTNL_REPLACE, wan_multi_gate[unit], NULL, wan_multi_if[unit])) != NULL)
+				rt->proto = RTPROT_KERNEL;
 
 			// set the default gateway.
-			snprintf(cmd, 2048, "ip route replace default via %s dev %s", wan_multi_gate[unit], wan_multi_if[unit]);
-if(debug) printf("test 11. cmd=%s.\n", cmd);
-			system(cmd);
-
-			if(!strcmp(wan_proto, "pptp") || !strcmp(wan_proto, "l2tp")){
-				snprintf(cmd, 2048, "ip route del %s dev %s 2>/dev/null", wan_multi_gate[unit], wan_multi_if[unit]);
-if(debug) printf("test 12. cmd=%s.\n", cmd);
-				system(cmd);
-			}
+			multi_route(&main_batch, RTNL_REPLACE, NULL, wan_multi_gate[unit], wan_multi_if[unit]);
+
+			if(!strcmp(wan_proto, "pptp") || !strcmp(wan_proto, "l2tp"))
+				multi_route(&main_batch, RTNL_DELETE, wan_multi_gate[unit], NULL, wan_multi_if[unit]);
 		}
 
 		if(!nvram_match("wans_mode", "lb") || gate_num <= 1)
 			break;
 #else
-		snprintf(cmd, 2048, "ip route replace %s dev %s proto kernel", wan_multi_gate[unit], wan_multi_if[unit]);
-if(debug) printf("test 10. cmd=%s.\n", cmd);
-		system(cmd);
+		if((rt = multi_route(&main_batch, RTNL_REPLACE, wan_multi_gate[unit], NULL, wan_multi_if[unit])) != NULL)
+			rt->proto = RTPROT_KERNEL;
 
 		// set the default gateway.
-		snprintf(cmd, 2048, "ip route replace default via %s dev %s", wan_multi_gate[unit], wan_multi_if[unit]);
-if(debug) printf("test 11. cmd=%s.\n", cmd);
-		system(cmd);
+		multi_route(&main_batch, RTNL_REPLACE, NULL, wan_multi_gate[unit], wan_multi_if[unit]);
 
-		if(!strcmp(wan_proto, "pptp") || !strcmp(wan_proto, "l2tp")){
-			snprintf(cmd, 2048, "ip route del %s dev %s 2>/dev/null", wan_multi_gate[unit], wan_multi_if[unit]);
-if(debug) printf("test 12. cmd=%s.\n", cmd);
-			system(cmd);
-		}
+		if(!strcmp(wan_proto, "pptp") || !strcmp(wan_proto, "l2tp"))
+			multi_route(&main_batch, RTNL_DELETE, wan_multi_gate[unit], NULL, wan_multi_if[unit]);
 #endif // RTCONFIG_DUALWAN
 	}
 
 #ifdef RTCONFIG_DUALWAN
 	// set the multi default gateway.
 	if(nvram_match("wans_mode", "lb") && gate_num > 1){
-		memset(cmd, 0, 2048);
+		memset(&multi, 0, sizeof(multi));
 		for(unit = WAN_UNIT_FIRST; unit < WAN_UNIT_MAX; ++unit){
 			snprintf(prefix, sizeof(prefix), "wan%d_", unit);
 
@@ -398,13 +389,10 @@ if(debug) printf("test 12. cmd=%s.\n", cmd);
 			// move the gateway via VPN+DHCP from the main routing table to the correct one.
 			strcpy(wan_gate, nvram_safe_get(strcat_r(prefix, "xgateway", tmp)));
 			if(strlen(wan_gate) > 0 && strcmp(wan_gate, "0.0.0.0") && strcmp(wan_gate, wan_multi_gate[unit])){
-				snprintf(cmd2, 2048, "ip route del default via %s dev %s 2>/dev/null", wan_gate, get_wanx_ifname(unit));
-if(debug) printf("test 13. cmd2=%s.\n", cmd2);
-				system(cmd2);
+				multi_route(&main_batch, RTNL_DELETE, NULL, wan_gate, get_wanx_ifname(unit));
 
-				snprintf(cmd2, 2048, "ip route replace default via %s dev %s table %d metric 1", wan_gate, get_wanx_ifname(unit), table);
-if(debug) printf("test 14. cmd2=%s.\n", cmd2);
-				system(cmd2);
+				if((rt = multi_route(&tables[table == WAN1_ROUTE_TABLE], RTNL_REPLACE, NULL, wan_gate, get_wanx_ifname(unit))) != NULL)
+					rt->metric = 1;
 			}
 
 			// set the routing rules of DNS via VPN+DHCP.
@@ -412,19 +400,8 @@ if(debug) printf("test 14. cmd2=%s.\n", cmd2);
 			if(strlen(wan_dns) > 0){
 				// set the rules for the DNS servers.
 				foreach(word, wan_dns, next) {
-					snprintf(cmd2, 2048, "ip rule del pref 200 from %s table %d 2>/dev/null", word, table);
-if(debug) printf("test 15. cmd2=%s.\n", cmd2);
-					system(cmd2);
-					snprintf(cmd2, 2048, "ip rule add pref 200 from %s table %d", word, table);
-if(debug) printf("test 16. cmd2=%s.\n", cmd2);
-					system(cmd2);
-
-					snprintf(cmd2, 2048, "ip rule del pref 400 to %s table %d 2>/dev/null", word, table);
-if(debug) printf("test 17. cmd2=%s.\n", cmd2);
-					system(cmd2);
-					snprintf(cmd2, 2048, "ip rule add pref 400 to %s table %d", word, table);
-if(debug) printf("test 18. cmd2=%s.\n", cmd2);
-					system(cmd2);
+					multi_rule(&rules, 200, word, NULL, table);
+					multi_rule(&rules, 400, NULL, word, table);
 				}
 			}
 
@@ -433,19 +410,8 @@ if(debug) printf("test 18. cmd2=%s.\n", cmd2);
 			if(strlen(wan_dns) > 0){
 				// set the rules for the DNS servers.
 				foreach(word, wan_dns, next) {
-					snprintf(cmd2, 2048, "ip rule del pref 200 from %s table %d 2>/dev/null", word, table);
-if(debug) printf("test 19. cmd2=%s.\n", cmd2);
-					system(cmd2);
-					snprintf(cmd2, 2048, "ip rule add pref 200 from %s table %d", word, table);
-if(debug) printf("test 20. cmd2=%s.\n", cmd2);
-					system(cmd2);
-
-					snprintf(cmd2, 2048, "ip rule del pref 400 to %s table %d 2>/dev/null", word, table);
-if(debug) printf("test 21. cmd2=%s.\n", cmd2);
-					system(cmd2);
-					snprintf(cmd2, 2048, "ip rule add pref 400 to %s table %d", word, table);
-if(debug) printf("test 22. cmd2=%s.\n", cmd2);
-					system(cmd2);
+					multi_rule(&rules, 200, word, NULL, table);
+					multi_rule(&rules, 400, NULL, word, table);
 				}
 			}
 
@@ -460,67 +426,124 @@ if(debug) printf("test 22. cmd2=%s.\n", cmd2);
 				++i;
 			}
 
-			if(!b)
+			if(!b){
+				free(nv);
 				continue;
+			}
 
 			wan_weight = atoi(b);
 			if(wan_weight > 0 && strlen(wan_multi_gate[unit]) > 0){
-				if(strlen(cmd) == 0)
-					strcpy(cmd, "ip route replace default");
+				if(multi.nh_count < RTNL_NH_MAX){
+					struct rtnl_nexthop *nh = &multi.nh[multi.nh_count++];
 
-				ptr = cmd+strlen(cmd);
-				sprintf(ptr, " nexthop via %s dev %s weight %d", wan_multi_gate[unit], wan_multi_if[unit], wan_weight);
+					inet_aton(wan_multi_gate[unit], &nh->gw);
+					nh->oif = if_nametoindex(wan_multi_if[unit]);
+					nh->weight = wan_weight;
+				}
 			}
 
 #if ! defined(CONFIG_BCMWL5)
 			{
 				/* set same mark as iptables balance */
-				snprintf(cmd2, sizeof(cmd2), "ip rule add fwmark 0x%x/0x%x table %d", IPTABLES_MARK_LB_SET(unit), IPTABLES_MARK_LB_MASK, table);
-				system(cmd2);
+				struct rtnl_rule *rule;
+
+				if((rule = rtnl_rule_new(&rules)) != NULL){
+					rule->pref = 90;
+					rule->table = table;
+					rule->fwmark = IPTABLES_MARK_LB_SET(unit);
+					rule->fwmask = IPTABLES_MARK_LB_MASK;
+				}
 			}
 #endif	/* ! CONFIG_BCMWL5 */
 
-			if(nv)
-				free(nv);
+			free(nv);
 		}
 
-		if(strlen(cmd) > 0){
+		if(multi.nh_count > 0){
 			for(unit = WAN_UNIT_FIRST; unit < WAN_UNIT_MAX; ++unit){
-				snprintf(cmd2, 2048, "ip route replace %s dev %s", wan_multi_gate[unit], wan_multi_if[unit]);
-if(debug) printf("test 23. cmd2=%s.\n", cmd2);
-				system(cmd2);
+				if(strlen(wan_multi_gate[unit]) > 0)
+					multi_route(&main_batch, RTNL_REPLACE, wan_multi_gate[unit], NULL, wan_multi_if[unit]);
 			}
 
-if(debug) printf("test 24. cmd=%s.\n", cmd);
-			system(cmd);
+			if((rt = rtnl_route_new(&main_batch)) != NULL)
+				*rt = multi;
 
 			for(unit = WAN_UNIT_FIRST; unit < WAN_UNIT_MAX; ++unit){
 				snprintf(prefix, sizeof(prefix), "wan%d_", unit);
 				strncpy(wan_proto, nvram_safe_get(strcat_r(prefix, "proto", tmp)), 32);
-				if(!strcmp(wan_proto, "pptp") || !strcmp(wan_proto, "l2tp")){
-					snprintf(cmd2, 2048, "ip route del %s dev %s 2>/dev/null", wan_multi_gate[unit], wan_multi_if[unit]);
-if(debug) printf("test 25. cmd2=%s.\n", cmd2);
-					system(cmd2);
-				}
+				if(strlen(wan_multi_gate[unit]) > 0 && (!strcmp(wan_proto, "pptp") || !strcmp(wan_proto, "l2tp")))
+					multi_route(&main_batch, RTNL_DELETE, wan_multi_gate[unit], NULL, wan_multi_if[unit]);
 			}
 		}
 	}
+	rtnl_routes_free(&main_routes);
 #endif
 
-if(debug) printf("test 26. route flush cache.\n");
-	system("ip route flush cache");
+	// the multi route tables are left empty unless balancing.
+	// each returns the number of failed updates, -1 without netlink.
+	n[0] = rtnl_route_sync(WAN0_ROUTE_TABLE, &tables[0]);
+	n[1] = rtnl_route_sync(WAN1_ROUTE_TABLE, &tables[1]);
+	n[2] = rtnl_route_batch(&main_batch);
+	n[3] = rtnl_rule_sync(&rules);
+	for (i = 0, lost = 0; i < 4; i++) {
+		if (n[i] < 0)
+			lost++;
+		else
+			fails += n[i];
+	}
+	if (lost)
+		logmessage("wan", "netlink failed, %d of the multi route updates not applied", lost);
+if(debug) printf("multi routes: %d rules, %d+%d table routes, %d main updates, %d failed.\n", rules.count, tables[0].count, tables[1].count, main_batch.count, fails);
+
+	rtnl_routes_free(&tables[0]);
+	rtnl_routes_free(&tables[1]);
+	rtnl_routes_free(&main_batch);
+	rtnl_rules_free(&rules);
+
+if(debug) printf("route flush cache.\n");
+	f_write_string("/proc/sys/net/ipv4/route/flush", "1", 0, 0);
 
 	logmessage("wan", "finish adding multi routes");
 	file_unlock(lock);
 	return 0;
 }
 
+/* Send the queued routes in one netlink batch. Without a netlink socket,
+ * fall back to one ioctl per route like before.
+ */
+static void
+wan_route_batch(struct rtnl_routes *l, char *ifname)
+{
+	struct rtnl_route *rt;
+	struct in_addr mask;
+	char dst[16], gw[16], netmask[16];
+	int i;
+
+	if (!l->count || rtnl_route_batch(l) >= 0)
+		return;
+
+	logmessage("wan", "netlink batch failed, %s %d routes one by one",
+		l->rt[0].cmd == RTNL_DELETE ? "deleting" : "adding", l->count);
+	for (i = 0; i < l->count; i++) {
+		rt = &l->rt[i];
+		mask.s_addr = rt->dst_len ? htonl(0xffffffff << (32 - rt->dst_len)) : 0;
+		strlcpy(dst, inet_ntoa(rt->dst), sizeof(dst));
+		strlcpy(gw, inet_ntoa(rt->gw), sizeof(gw));
+		strlcpy(netmask, inet_ntoa(mask), sizeof(netmask));
+		if (rt->cmd == RTNL_DELETE)
+			route_del(ifname, rt->metric + 1, dst, gw, netmask);
+		else
+			route_add(ifname, rt->metric + 1, dst, gw, netmask);
+	}
+}
+
 int
 add_routes(char *prefix, char *var, char *ifname)
 {
 	char word[80], *next;
 	char *ipaddr, *netmask, *gateway, *metric;
 	char tmp[100];
+	struct rtnl_routes routes = { 0 };
 
 	foreach(word, nvram_safe_get(strcat_r(prefix, var, tmp)), next) {
 
@@ -542,9 +565,13 @@ add_routes(char *prefix, char *var, char *ifname)
 		if (inet_addr_(gateway) == INADDR_ANY)
 			gateway = nvram_safe_get(strcat_r(prefix, "xgateway", tmp));
 
-		route_add(ifname, atoi(metric) + 1, ipaddr, gateway, netmask);
+		rtnl_route_queue(&routes, RTNL_REPLACE, ifname, atoi(metric) + 1, ipaddr, gateway, netmask);
 	}
 
+	/* all of them in one go, VPN split tunnels push hundreds */
+	wan_route_batch(&routes, ifname);
+	rtnl_routes_free(&routes);
+
 	return 0;
 }
 
@@ -557,6 +584,7 @@ add_dhcp_routes(char *prefix, char *ifname, int metric)
 	char netmask[] = "255.255.255.255";
 	struct in_addr mask;
 	int netsize;
+	struct rtnl_routes list = { 0 };
 
 	if (nvram_get_int("dr_enable_x") == 0)
 		return;
@@ -567,7 +595,7 @@ add_dhcp_routes(char *prefix, char *ifname, int metric)
 		ipaddr  = strsep(&tmp, "/");
 		gateway = strsep(&tmp, " ");
 		if (gateway && inet_addr(ipaddr) != INADDR_ANY)
-			route_add(ifname, metric + 1, ipaddr, gateway, netmask);
+			rtnl_route_queue(&list, RTNL_REPLACE, ifname, metric + 1, ipaddr, gateway, netmask);
 	}
 	free(routes);
 
@@ -580,7 +608,7 @@ add_dhcp_routes(char *prefix, char *ifname, int metric)
 		if (gateway && netsize > 0 && netsize <= 32 && inet_addr(ipaddr) != INADDR_ANY) {
 			mask.s_addr = htonl(0xffffffff << (32 - netsize));
 			strcpy(netmask, inet_ntoa(mask));
-			route_add(ifname, metric + 1, ipaddr, gateway, netmask);
+			rtnl_route_queue(&list, RTNL_REPLACE, ifname, metric + 1, ipaddr, gateway, netmask);
 		}
 	}
 	free(routes);
@@ -594,10 +622,13 @@ add_dhcp_routes(char *prefix, char *ifname, int metric)
 		if (gateway && netsize > 0 && netsize <= 32 && inet_addr(ipaddr) != INADDR_ANY) {
 			mask.s_addr = htonl(0xffffffff << (32 - netsize));
 			strcpy(netmask, inet_ntoa(mask));
-			route_add(ifname, metric + 1, ipaddr, gateway, netmask);
+			rtnl_route_queue(&list, RTNL_REPLACE, ifname, metric + 1, ipaddr, gateway, netmask);
 		}
 	}
 	free(routes);
+
+	wan_route_batch(&list, ifname);
+	rtnl_routes_free(&list);
 }
 
 int
@@ -606,6 +637,7 @@ del_routes(char *prefix, char *var, char *ifname)
 	char word[80], *next;
 	char *ipaddr, *netmask, *gateway, *metric;
 	char tmp[100];
+	struct rtnl_routes routes = { 0 };
 
 	foreach(word, nvram_safe_get(strcat_r(prefix, var, tmp)), next) {
 		_dprintf("%s: %s\n", __FUNCTION__, word);
@@ -627,9 +659,12 @@ del_routes(char *prefix, char *var, char *ifname)
 		if (inet_addr_(gateway) == INADDR_ANY) 	// oleg patch
 			gateway = nvram_safe_get("wan0_xgateway");
 
-		route_del(ifname, atoi(metric) + 1, ipaddr, gateway, netmask);
+		rtnl_route_queue(&routes, RTNL_DELETE, ifname, atoi(metric) + 1, ipaddr, gateway, netmask);
 	}
 
+	wan_route_batch(&routes, ifname);
+	rtnl_routes_free(&routes);
+
 	return 0;
 }
 
@@ -2853,6 +2888,8 @@ wan_up(char *wan_ifname)	// oleg patch, replace
 	}
 #endif
 
+	boot_trace_mark("wan_ready");
+
 _dprintf("%s(%s): done.\n", __FUNCTION__, wan_ifname);
 }
 
@@ -3210,6 +3247,7 @@ start_wan(void)
 #endif
 	symlink("/sbin/rc", "/tmp/udhcpc");
 	symlink("/sbin/rc", "/tmp/zcip");
+	start_udhcpc_server();
 #ifdef RTCONFIG_EAPOL
 	symlink("/sbin/rc", "/tmp/wpa_cli");
 #endif
@@ -3298,6 +3336,7 @@ stop_wan(void)
 #ifdef RTCONFIG_EAPOL
 	unlink("/tmp/wpa_cli");
 #endif
+	stop_udhcpc_server();
 	unlink("/tmp/udhcpc");
 	unlink("/tmp/zcip");
 	unlink("/tmp/ppp/ip-up");
@@ -227,6 +227,38 @@ int update_wan_leds(int wan_unit)
 }
 #endif	/* RTCONFIG_LANWAN_LED */
 
+#if defined(RTCONFIG_WIRELESSREPEATER) || defined(RTCONFIG_REDIRECT_DNAME)
+/* Flush broute and filter, and optionally block LAN DNS queries from being
+ * bridged, with one table replace each instead of an ebtables run per rule */
+static void ebt_flush_bridge(int dns_redirect)
+{
+	ebt_batch_t b;
+
+	if (ebt_batch_open(&b) < 0)
+		return;
+	ebt_batch(&b, "broute", "-F");
+	if (dns_redirect)
+		ebt_batch(&b, "broute", "-I BROUTING -p ipv4 --ip-proto udp --ip-dport 53 -j redirect --redirect-target DROP");
+	ebt_batch(&b, "filter", "-F");
+	ebt_batch_commit(&b);
+}
+#endif
+
+#ifdef RTCONFIG_RESTRICT_GUI
+/* Mark bridged traffic from the LAN ports for the GUI access restriction */
+static void ebt_restrict_gui(ebt_batch_t *b, const char *cmd, const char *target)
+{
+	char word[PATH_MAX], *next_word;
+
+	foreach(word, nvram_safe_get("lan_ifnames"), next_word){
+		if(!strncmp(word, "vlan", 4))
+			continue;
+
+		ebt_batch(b, "broute", "%s BROUTING -i %s -j mark --mark-set %s --mark-target %s", cmd, word, BIT_RES_GUI, target);
+	}
+}
+#endif
+
 static void safe_leave(int signo){
 	csprintf("\n## wanduck.safeexit ##\n");
 	signal(SIGTERM, SIG_IGN);
@@ -252,8 +284,7 @@ static void safe_leave(int signo){
 
 #ifdef RTCONFIG_WIRELESSREPEATER
 	if(sw_mode == SW_MODE_REPEATER){
-		eval("ebtables", "-t", "broute", "-F");
-		eval("ebtables", "-t", "filter", "-F");
+		ebt_flush_bridge(0);
 		f_write_string("/proc/net/dnsmqctrl", "", 0, 0);
 	}
 #endif
@@ -490,6 +521,41 @@ static void wan_led_control(int sig) {
 #endif
 }
 
+/* Fill ps with the probes of flags that are configured for wan_unit */
+static void wan_probe_init(struct probe_set *ps, int wan_unit, int flags)
+{
+	char prefix[sizeof("wanXXXXXXXXXX_")], tmp[100];
+	int timeout = 0;
+
+	memset(ps, 0, sizeof(*ps));
+	snprintf(prefix, sizeof(prefix), "wan%d_", wan_unit);
+	ps->servers = nvram_safe_get(strcat_r(prefix, "dns", tmp));
+
+	ps->dns_host = nvram_safe_get("dns_probe_host");
+	ps->dns_content = nvram_safe_get("dns_probe_content");
+	if (!is_valid_domainname(ps->dns_host) || *ps->dns_content == '\0')
+		flags &= ~PROBE_F_DNS;
+	else if (flags & PROBE_F_DNS)
+		timeout = nvram_get_int("dns_probe_timeout") ? : 2;
+
+	if ((flags & PROBE_F_TCP) && timeout < TCPCHECK_TIMEOUT)
+		timeout = TCPCHECK_TIMEOUT;
+
+#ifdef RTCONFIG_DUALWAN
+	ps->icmp_target = wandog_target;
+	ps->ttl = nvram_get_int("ttl_spoof_enable") ? 0 : 128;
+	if (!is_valid_domainname(wandog_target))
+		flags &= ~PROBE_F_ICMP;
+	else if ((flags & PROBE_F_ICMP) && timeout < 2)
+		timeout = 2;
+#else
+	flags &= ~PROBE_F_ICMP;
+#endif
+
+	ps->flags = flags;
+	ps->timeout_ms = timeout * 1000;
+}
+
 /* Return values:
     -1: ping target is disabled
      0: ping target has failed
@@ -497,39 +563,12 @@ static void wan_led_control(int sig) {
 */
 int do_ping_detect(int wan_unit)
 {
-#ifdef RTCONFIG_DUALWAN
-	FILE *fp;
-	char cmd[512];
-	int count;
-	int debug = nvram_get_int("ping_debug");
-
-	/* Check for valid domain to avoid shell escaping */
-	if (!is_valid_domainname(wandog_target))
-		return -1;
-	if (debug)
-		_dprintf("%s: %s %s\n", __FUNCTION__, "check", wandog_target);
+	struct probe_set ps;
 
-	snprintf(cmd, sizeof(cmd), "ping -c1 -w2 -s32 %s -Mdont '%s'",
-		 nvram_get_int("ttl_spoof_enable") ? "" : "-t128", wandog_target);
-	if ((fp = popen(cmd, "r")) != NULL) {
-		while (fgets(cmd, sizeof(cmd), fp) != NULL) {
-			if (sscanf(cmd, "%*s %*s transmitted, %d %*s received", &count) == 1 && count) {
-				fclose(fp);
-				if (debug)
-					_dprintf("%s: %s %s\n", __FUNCTION__, wandog_target, "ok");
-				return 1;
-			}
-		}
-		fclose(fp);
-	}
+	wan_probe_init(&ps, wan_unit, PROBE_F_ICMP);
+	run_probes(&ps);
 
-	if (debug)
-		_dprintf("%s: %s %s\n", __FUNCTION__, wandog_target, "fail");
-	//logmessage("WAN Connection", "ping target failed");
-	return 0;
-#else /* RTCONFIG_DUALWAN */
-	return -1;
-#endif
+	return ps.ok[PROBE_ICMP];
 }
 
 #ifdef DETECT_INTERNET_MORE
@@ -590,70 +629,16 @@ int get_packets_of_net_dev(const char *net_dev, unsigned long *rx_packets, unsig
 	return got_packets;
 }
 
-char *organize_tcpcheck_cmd(char *dns_list, char *cmd, int size){
-	char buf[256], *next;
-
-	if(cmd == NULL || size <= 0)
-		return NULL;
-
-	memset(cmd, 0, size);
-
-	sprintf(cmd, "/sbin/tcpcheck %d", TCPCHECK_TIMEOUT);
-
-	foreach(buf, dns_list, next){
-		sprintf(cmd, "%s %s:53", cmd, buf);
-	}
-
-	sprintf(cmd, "%s >>%s", cmd, DETECT_FILE);
-
-	return cmd;
-}
-
 int do_tcp_dns_detect(int wan_unit){
-	FILE *fp = NULL;
-	char line[80], cmd[PATH_MAX];
-	char prefix_wan[8], nvram_name[16], wan_dns[256];
-
-	if(remove(DETECT_FILE) < 0)
-	{
-		logmessage("%s: cannot remove DETECT_FILE.\n", __FUNCTION__);
-		return 0;
-	}
-
-	memset(prefix_wan, 0, 8);
-	sprintf(prefix_wan, "wan%d_", wan_unit);
+	struct probe_set ps;
 
-	memset(wan_dns, 0, 256);
-	strcpy(wan_dns, nvram_safe_get(strcat_r(prefix_wan, "dns", nvram_name)));
+	wan_probe_init(&ps, wan_unit, PROBE_F_TCP);
+	run_probes(&ps);
 
-	if(organize_tcpcheck_cmd(wan_dns, cmd, PATH_MAX) == NULL){
-		csprintf("wanduck: No tcpcheck cmd.\n");
-		return 0;
-	}
-	system(cmd);
-
-	if((fp = fopen(DETECT_FILE, "r")) == NULL){
-		_dprintf("wanduck: No file: %s.\n", DETECT_FILE);
-		return 0;
-	}
-
-	fcntl(fileno(fp), F_SETFL, fcntl(fileno(fp), F_GETFL) | O_NONBLOCK);
-
-	while(fgets(line, sizeof(line), fp) != NULL){
-		if(strstr(line, "alive")){
-			fclose(fp);
-			return 1;
-		}
-	}
-	fclose(fp);
-
-	return 0;
+	return ps.ok[PROBE_TCP] > 0;
 }
 #endif // DETECT_INTERNET_MORE
 
-#include <sys/wait.h>
-#include <resolv.h>
-
 /* Return values:
     -1: dns probe is disabled
      0: dns probe has failed
@@ -661,112 +646,19 @@ int do_tcp_dns_detect(int wan_unit){
 */
 int do_dns_detect(int wan_unit)
 {
-	struct addrinfo hints, *res, *ai;
-	union {
-		struct in_addr in;
-		struct in6_addr in6;
-	} *addr, target;
-	sigset_t set, sigmask;
-	sighandler_t chld;
-	char word[64], *next, *host, *content;
-	int timeout, size, ret, sig, status;
-	int debug = nvram_get_int("dns_probe_debug");
-	pid_t pid;
+	struct probe_set ps;
 
-	host = nvram_safe_get("dns_probe_host");
-	content = nvram_safe_get("dns_probe_content");
-	if (debug)
-		_dprintf("%s: %s %s %s\n", __FUNCTION__, "check", host, content);
-
-	/* Check for valid domain to avoid shell escaping */
-	if (!is_valid_domainname(host) || *content == '\0')
-		return -1;
-
-	memset(&hints, 0, sizeof(hints));
-#ifdef RTCONFIG_IPV6
-	hints.ai_family = ipv6_enabled() ? AF_UNSPEC : AF_INET;
-#else
-	hints.ai_family = AF_INET;
-#endif
-	hints.ai_socktype = SOCK_STREAM;
-	timeout = nvram_get_int("dns_probe_timeout") ? : 2;
-
-	/* block SIGCHLD */
-	sigemptyset(&set);
-	sigaddset(&set, SIGCHLD);
-	sigprocmask(SIG_BLOCK, &set, &sigmask);
-	chld = signal(SIGCHLD, SIG_DFL);
-
-	switch ((pid = fork())) {
-	case -1:
-		ret = -1;
-		goto error;
-	case 0:
-		/* child */
-		break;
-	default:
-		/* parent */
-		do {
-			ret = waitpid(pid, &status, 0);
-		} while (ret < 0 && errno == EINTR);
-		ret = (ret > 0 && WIFEXITED(status)) ? WEXITSTATUS(status) : 0;
-	error:
-		/* restore SIGCHLD */
-		signal(SIGCHLD, chld);
-		sigprocmask(SIG_SETMASK, &sigmask, NULL);
-		chld_reap(0);
-
-		if (debug)
-			_dprintf("%s: %s %s\n", __FUNCTION__, host, ret ? "ok" : "fail");
-		//if (ret == 0)
-		//	logmessage("WAN Connection", "DNS probe failed");
-		return ret;
-	}
-
-	for (sig = 0; sig < (_NSIG - 1); sig++)
-		signal(sig, SIG_DFL);
-	sigemptyset(&set);
-	sigprocmask(SIG_SETMASK, &set, NULL);
-
-	alarm(timeout);
-
-	res_init();
-	if (getaddrinfo(host, NULL, &hints, &res) == 0) {
-		for (ai = res; ai; ai = ai->ai_next) {
-			if (ai->ai_family == AF_INET) {
-				addr = (void *)&((struct sockaddr_in *)ai->ai_addr)->sin_addr;
-				size = sizeof(addr->in);
-#ifdef RTCONFIG_IPV6
-			} else if (ai->ai_family == AF_INET6) {
-				addr = (void *)&((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr;
-				size = sizeof(addr->in6);
-#endif
-			} else
-				continue;
-
-			if (debug) {
-				inet_ntop(ai->ai_family, addr, word, sizeof(word));
-				_dprintf("%s: %s %s %s\n", __FUNCTION__, "resolve", host, word);
-			}
-
-			foreach(word, content, next) {
-				if ((strcmp(word, "*") == 0) ||
-				    (inet_pton(ai->ai_family, word, &target) > 0 && memcmp(addr, &target, size) == 0)) {
-					freeaddrinfo(res);
-					exit(1);
-				}
-			}
-		}
-	}
+	wan_probe_init(&ps, wan_unit, PROBE_F_DNS);
+	run_probes(&ps);
 
-	exit(0);
+	return ps.ok[PROBE_DNS];
 }
 
-int delay_dns_response(int wan_unit)
+/* Hold a DNS probe failure back for dns_delay_round rounds */
+int delay_dns_response(int ret)
 {
 	static int last = -1;
 	static int fail = 0;
-	int ret = do_dns_detect(wan_unit);
 	int delay_round = nvram_get_int("dns_delay_round");
 	int debug = nvram_get_int("dns_probe_debug");
 
@@ -794,14 +686,26 @@ int detect_internet(int wan_unit)
 	char wan_ifname[16];
 	unsigned long rx_packets, tx_packets;
 #endif
+	struct probe_set ps;
+	int flags = PROBE_F_DNS;
 	int link_internet;
 	int dns_ret;
 
 #ifdef DETECT_INTERNET_MORE
 	snprintf(wan_ifname, 16, "%s", get_wan_ifname(wan_unit));
+	if(!isFirstUse)
+		flags |= PROBE_F_TCP | PROBE_F_ICMP;
+#endif
+#ifdef RTCONFIG_DUALWAN
+	if((!strcmp(dualwan_mode, "fo") || !strcmp(dualwan_mode, "fb"))
+			&& wandog_enable == 1 && !isFirstUse)
+		flags |= PROBE_F_ICMP;
 #endif
 
-	dns_ret = delay_dns_response(wan_unit);
+	/* all probes of this round share one deadline */
+	wan_probe_init(&ps, wan_unit, flags);
+	run_probes(&ps);
+	dns_ret = delay_dns_response(ps.ok[PROBE_DNS]);
 
 	if(
 #ifdef RTCONFIG_DUALWAN
@@ -812,12 +716,12 @@ int detect_internet(int wan_unit)
 #ifdef DETECT_INTERNET_MORE
 	else if(!get_packets_of_net_dev(wan_ifname, &rx_packets, &tx_packets) || rx_packets <= RX_THRESHOLD)
 		link_internet = DISCONN;
-	else if(!isFirstUse && (!dns_ret && !do_tcp_dns_detect(wan_unit) && !do_ping_detect(wan_unit)))
+	else if(!isFirstUse && (!dns_ret && ps.ok[PROBE_TCP] <= 0 && !ps.ok[PROBE_ICMP]))
 		link_internet = DISCONN;
 #endif
 #ifdef RTCONFIG_DUALWAN
 	else if((!strcmp(dualwan_mode, "fo") || !strcmp(dualwan_mode, "fb"))
-			&& wandog_enable == 1 && !isFirstUse && !do_ping_detect(wan_unit))
+			&& wandog_enable == 1 && !isFirstUse && !ps.ok[PROBE_ICMP])
 		link_internet = DISCONN;
 #endif
 	else if(!dns_ret)
@@ -2605,17 +2509,14 @@ _dprintf("wanduck(%d)(first detect start): state %d, state_old %d, changed %d, w
 #ifdef RTCONFIG_REDIRECT_DNAME
 			if(cross_state == DISCONN){
 				csprintf("\n# AP mode: Enable direct rule(DISCONN)\n");
-				eval("ebtables", "-t", "broute", "-F");
-				eval("ebtables", "-t", "filter", "-F");
+				ebt_flush_bridge(0);
 				redirect_setting();
 				eval("iptables-restore", "/tmp/redirect_rules");
 				// nat_rules = NAT_STATE_REDIRECT;
 			}
 			else if(cross_state == CONNED){
 				csprintf("\n# AP mode: Disable direct rule(CONNED)\n");
-				eval("ebtables", "-t", "broute", "-F");
-				eval("ebtables", "-t", "filter", "-F");
-				eval("ebtables", "-t", "broute", "-I", "BROUTING", "-p", "ipv4", "--ip-proto", "udp", "--ip-dport", "53", "-j", "redirect", "--redirect-target", "DROP");
+				ebt_flush_bridge(1);
 				redirect_nat_setting();
 				eval("iptables-restore", NAT_RULES);
 				// nat_rules = NAT_STATE_NORMAL;
@@ -2626,13 +2527,11 @@ _dprintf("wanduck(%d)(first detect start): state %d, state_old %d, changed %d, w
 #ifdef RTCONFIG_RESTRICT_GUI
 			if(cross_state == CONNED){
 				if(nvram_get_int("fw_restrict_gui")){
-					char word[PATH_MAX], *next_word;
-
-					foreach(word, nvram_safe_get("lan_ifnames"), next_word){
-						if(!strncmp(word, "vlan", 4))
-							continue;
+					ebt_batch_t b;
 
-						eval("ebtables", "-t", "broute", "-I", "BROUTING", "-i", word, "-j", "mark", "--mark-set", BIT_RES_GUI, "--mark-target", "CONTINUE");
+					if(ebt_batch_open(&b) == 0){
+						ebt_restrict_gui(&b, "-I", "CONTINUE");
+						ebt_batch_commit(&b);
 					}
 
 					repeater_filter_setting(0);
@@ -3461,9 +3360,7 @@ _dprintf("nat_rule: start_nat_rules 5.\n");
 #endif
 #ifdef RTCONFIG_WIRELESSREPEATER
 		if(sw_mode == SW_MODE_REPEATER){
-#ifdef RTCONFIG_RESTRICT_GUI
-			char word[PATH_MAX], *next_word;
-#endif
+			ebt_batch_t b;
 
 			if(!got_notify)
 				; // do nothing.
@@ -3477,23 +3374,22 @@ _dprintf("nat_rule: start_nat_rules 5.\n");
 						csprintf("\n# mode(%d): Enable direct rule(isFirstUse)\n", sw_mode);
 					rule_setup = 1;
 
-					eval("ebtables", "-t", "broute", "-F");
-					eval("ebtables", "-t", "filter", "-F");
-					// Drop the DHCP server from PAP.
-					eval("ebtables", "-t", "filter", "-A", "FORWARD", "-i", nvram_safe_get(wlc_nvname("ifname")), "-j", "DROP");
+					if(ebt_batch_open(&b) == 0){
+						ebt_batch(&b, "broute", "-F");
+#ifdef RTCONFIG_RESTRICT_GUI
+						if(nvram_get_int("fw_restrict_gui"))
+							ebt_restrict_gui(&b, "-A", "ACCEPT");
+#endif
+						ebt_batch(&b, "filter", "-F");
+						// Drop the DHCP server from PAP.
+						ebt_batch(&b, "filter", "-A FORWARD -i %s -j DROP", nvram_safe_get(wlc_nvname("ifname")));
+						ebt_batch_commit(&b);
+					}
 					f_write_string("/proc/net/dnsmqctrl", "", 0, 0);
 
 #ifdef RTCONFIG_RESTRICT_GUI
-					if(nvram_get_int("fw_restrict_gui")){
-						foreach(word, nvram_safe_get("lan_ifnames"), next_word){
-							if(!strncmp(word, "vlan", 4))
-								continue;
-
-							eval("ebtables", "-t", "broute", "-A", "BROUTING", "-i", word, "-j", "mark", "--mark-set", BIT_RES_GUI, "--mark-target", "ACCEPT");
-						}
-
+					if(nvram_get_int("fw_restrict_gui"))
 						repeater_filter_setting(0);
-					}
 #endif
 _dprintf("nat_rule: stop_nat_rules 6.\n");
 					nat_state = stop_nat_rules();
@@ -3506,28 +3402,27 @@ _dprintf("nat_rule: stop_nat_rules 6.\n");
 				{
 					csprintf("\n# mode(%d): Disable direct rule(CONNED)\n", sw_mode);
 					rule_setup = 0;
-					eval("ebtables", "-t", "broute", "-F");
-					eval("ebtables", "-t", "filter", "-F");
-
+					if(ebt_batch_open(&b) == 0){
+						ebt_batch(&b, "broute", "-F");
 #ifdef RTCONFIG_RESTRICT_GUI
-					if(nvram_get_int("fw_restrict_gui")){
-						foreach(word, nvram_safe_get("lan_ifnames"), next_word){
-							if(!strncmp(word, "vlan", 4))
-								continue;
-
-							eval("ebtables", "-t", "broute", "-A", "BROUTING", "-i", word, "-j", "mark", "--mark-set", BIT_RES_GUI, "--mark-target", "CONTINUE");
-						}
+						if(nvram_get_int("fw_restrict_gui"))
+							ebt_restrict_gui(&b, "-A", "CONTINUE");
+#endif
+						ebt_batch(&b, "broute", "-A BROUTING -d 00:E0:11:22:33:44 -j redirect --redirect-target DROP");
+#ifdef RTCONFIG_REDIRECT_DNAME
+						ebt_batch(&b, "broute", "-A BROUTING -p ipv4 --ip-proto udp --ip-dport 53 -j redirect --redirect-target DROP");
+#endif
+						ebt_batch(&b, "filter", "-F");
+						ebt_batch_commit(&b);
+					}
 
+#ifdef RTCONFIG_RESTRICT_GUI
+					if(nvram_get_int("fw_restrict_gui"))
 						repeater_filter_setting(1);
-					}
 #endif
 
-					eval("ebtables", "-t", "broute", "-A", "BROUTING", "-d", "00:E0:11:22:33:44", "-j", "redirect", "--redirect-target", "DROP");
 					sprintf(domain_mapping, "%x %s", inet_addr(nvram_safe_get("lan_ipaddr")), DUT_DOMAIN_NAME);
 					f_write_string("/proc/net/dnsmqctrl", domain_mapping, 0, 0);
-#ifdef RTCONFIG_REDIRECT_DNAME
-					eval("ebtables", "-t", "broute", "-A", "BROUTING", "-p", "ipv4", "--ip-proto", "udp", "--ip-dport", "53", "-j", "redirect", "--redirect-target", "DROP");
-#endif
 _dprintf("nat_rule: start_nat_rules 6.\n");
 					nat_state = start_nat_rules();
 				}
@@ -3541,17 +3436,14 @@ _dprintf("nat_rule: start_nat_rules 6.\n");
 #ifdef RTCONFIG_REDIRECT_DNAME
 			if (conn_changed_state[current_wan_unit] == C2D) {
 				csprintf("\n# AP mode: Enable direct rule(C2D)\n");
-				eval("ebtables", "-t", "broute", "-F");
-				eval("ebtables", "-t", "filter", "-F");
+				ebt_flush_bridge(0);
 				redirect_setting();
 				eval("iptables-restore", "/tmp/redirect_rules");
 				// nat_rules = NAT_STATE_REDIRECT;
 			}
 			else if (conn_changed_state[current_wan_unit] == D2C) {
 				csprintf("\n# AP mode: Disable direct rule(D2C)\n");
-				eval("ebtables", "-t", "broute", "-F");
-				eval("ebtables", "-t", "filter", "-F");
-				eval("ebtables", "-t", "broute", "-I", "BROUTING", "-p", "ipv4", "--ip-proto", "udp", "--ip-dport", "53", "-j", "redirect", "--redirect-target", "DROP");
+				ebt_flush_bridge(1);
 				redirect_nat_setting();
 				eval("iptables-restore", NAT_RULES);
 				// nat_rules = NAT_STATE_NORMAL;
@@ -3563,13 +3455,11 @@ _dprintf("nat_rule: start_nat_rules 6.\n");
 #ifdef RTCONFIG_RESTRICT_GUI
 			if(conn_changed_state[current_wan_unit] == D2C){
 				if(nvram_get_int("fw_restrict_gui")){
-					char word[PATH_MAX], *next_word;
-
-					foreach(word, nvram_safe_get("lan_ifnames"), next_word){
-						if(!strncmp(word, "vlan", 4))
-							continue;
+					ebt_batch_t b;
 
-						eval("ebtables", "-t", "broute", "-I", "BROUTING", "-i", word, "-j", "mark", "--mark-set", BIT_RES_GUI, "--mark-target", "CONTINUE");
+					if(ebt_batch_open(&b) == 0){
+						ebt_restrict_gui(&b, "-I", "CONTINUE");
+						ebt_batch_commit(&b);
 					}
 
 					repeater_filter_setting(0);
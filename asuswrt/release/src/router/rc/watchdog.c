@@ -42,6 +42,7 @@
 #include <qca.h>
 #endif
 #include <shared.h>
+#include <syslog_ring.h>
 
 #include <syslog.h>
 #include <bcmnvram.h>
@@ -2722,6 +2723,75 @@ void qtn_module_check(void)
 
 //#if defined(RTCONFIG_JFFS2LOG) && defined(RTCONFIG_JFFS2)
 #if defined(RTCONFIG_JFFS2LOG) && (defined(RTCONFIG_JFFS2)||defined(RTCONFIG_BRCM_NAND_JFFS2))
+#define SYSLOG_COMMIT_STATE	"/tmp/.syslog_commit"
+
+struct syslog_commit {
+	FILE *fp;
+	unsigned int seq;
+};
+
+static int syslog_commit_rec(struct syslog_rec *rec, void *arg)
+{
+	struct syslog_commit *sc = arg;
+
+	if (fwrite(rec->text, rec->len, 1, sc->fp) != 1)
+		return 1;
+	sc->seq = rec->seq;
+
+	return 0;
+}
+
+/*
+ * Append only the records syslogd logged since the last commit to
+ * /jffs/syslog.log, rotating it like syslogd rotates its own file.
+ * Returns -1 when syslogd keeps no log ring or /jffs has no log yet.
+ */
+static int syslog_ring_commit(void)
+{
+	static unsigned int stamp, seq;
+	unsigned int cur_stamp, first, last;
+	struct syslog_commit sc;
+	struct stat st;
+	char buf[32];
+	int ret;
+
+	if (syslog_ring_info(&cur_stamp, &first, &last) < 0)
+		return -1;
+
+	/* pick up where a previous watchdog left off */
+	if (!stamp && f_read_string(SYSLOG_COMMIT_STATE, buf, sizeof(buf)) > 0)
+		sscanf(buf, "%u %u", &stamp, &seq);
+
+	/* a new syslogd starts from the files start_syslogd() seeded */
+	if (cur_stamp != stamp) {
+		stamp = cur_stamp;
+		seq = 0;
+	}
+	if (last == seq)
+		return 0;
+
+	if (stat("/jffs/syslog.log", &st) == -1) {
+		/* the caller copies the files whole */
+		seq = last;
+		ret = -1;
+	} else {
+		if (st.st_size >= (nvram_get_int("log_size") ? : 200) * 1024)
+			rename("/jffs/syslog.log", "/jffs/syslog.log-1");
+		if ((sc.fp = fopen("/jffs/syslog.log", "a")) == NULL)
+			return 0;
+		sc.seq = seq;
+		syslog_ring_read(seq, SYSLOG_ANY_FAC, SYSLOG_ANY_PRI, 0, syslog_commit_rec, &sc);
+		fclose(sc.fp);
+		seq = sc.seq;
+		ret = 0;
+	}
+
+	snprintf(buf, sizeof(buf), "%u %u", stamp, seq);
+	f_write_string(SYSLOG_COMMIT_STATE, buf, 0, 0);
+
+	return ret;
+}
+
 void syslog_commit_check(void)
 {
 	struct stat tmp_log_stat, jffs_log_stat;
@@ -2732,6 +2802,11 @@ void syslog_commit_check(void)
 		return;
 
 	if (++log_commit_count >= LOG_COMMIT_PERIOD) {
+		if (syslog_ring_commit() == 0) {
+			log_commit_count = 0;
+			return;
+		}
+
 		jffs_stat = stat("/jffs/syslog.log", &jffs_log_stat);
 		if ( jffs_stat == -1) {
 			eval("cp", "/tmp/syslog.log", "/tmp/syslog.log-1", "/jffs");
@@ -20,9 +20,12 @@ static char const RCSID[] =
 #include "md5.h"
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #define PULL_UINT16(buf, cursor, val) \
 do { \
@@ -39,6 +42,28 @@ do { \
 
 #define GET_AVP_LEN(x) ((((x)[0] & 3) * 256) + (x)[1])
 
+/* Datagrams fetched per recvmmsg call, and calls per readable event */
+#define RECV_BATCH 16
+#define RECV_ROUNDS 4
+
+/* Same layout as the kernel's struct mmsghdr */
+struct dgram_mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+/* Datagrams read off the wire and not handled yet */
+static struct {
+    int fd;			/* Socket they came from */
+    int count;			/* Datagrams in the batch */
+    int next;			/* Next one to handle */
+    int len[RECV_BATCH];
+    struct sockaddr_in from[RECV_BATCH];
+    unsigned char buf[RECV_BATCH][MAX_PACKET_LEN+EXTRA_HEADER_ROOM];
+} RecvQ = { -1, 0, 0 };
+
+static int NoRecvmmsg = 0;
+
 static int dgram_add_random_vector_avp(l2tp_dgram *dgram);
 
 static void dgram_do_hide(uint16_t type,
@@ -291,6 +316,80 @@ l2tp_dgram_free(l2tp_dgram *dgram)
     dgram_free_list = dgram;
 }
 
+/**********************************************************************
+* %FUNCTION: dgram_recv_batch
+* %ARGUMENTS:
+*  fd   -- socket to read from
+* %RETURNS:
+*  Number of datagrams read into RecvQ; <= 0 on error or EAGAIN.
+* %DESCRIPTION:
+*  Refills the receive queue with a single recvmmsg call, or with
+*  recvfrom if the kernel does not have recvmmsg.
+***********************************************************************/
+static int
+dgram_recv_batch(int fd)
+{
+    socklen_t len = sizeof(struct sockaddr_in);
+    int i, r = -1;
+
+    RecvQ.fd = fd;
+    RecvQ.count = 0;
+    RecvQ.next = 0;
+
+#ifdef __NR_recvmmsg
+    if (!NoRecvmmsg) {
+	struct dgram_mmsghdr msgs[RECV_BATCH];
+	struct iovec iov[RECV_BATCH];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i=0; i<RECV_BATCH; i++) {
+	    /* EXTRA_HEADER_ROOM bytes for other headers like PPPoE, etc. */
+	    iov[i].iov_base = RecvQ.buf[i] + EXTRA_HEADER_ROOM;
+	    iov[i].iov_len = MAX_PACKET_LEN;
+	    msgs[i].msg_hdr.msg_name = &RecvQ.from[i];
+	    msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	    msgs[i].msg_hdr.msg_iov = &iov[i];
+	    msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	r = syscall(__NR_recvmmsg, fd, msgs, RECV_BATCH, 0, NULL);
+	if (r < 0 && errno == ENOSYS) {
+	    NoRecvmmsg = 1;
+	} else {
+	    for (i=0; i<r; i++) {
+		RecvQ.len[i] = msgs[i].msg_len;
+	    }
+	}
+    }
+#else
+    NoRecvmmsg = 1;
+#endif
+
+    if (NoRecvmmsg) {
+	r = recvfrom(fd, RecvQ.buf[0] + EXTRA_HEADER_ROOM, MAX_PACKET_LEN, 0,
+		     (struct sockaddr *) &RecvQ.from[0], &len);
+	if (r > 0) {
+	    RecvQ.len[0] = r;
+	    r = 1;
+	}
+    }
+
+    if (r > 0) RecvQ.count = r;
+    return r;
+}
+
+/**********************************************************************
+* %FUNCTION: dgram_pending
+* %ARGUMENTS:
+*  fd   -- socket
+* %RETURNS:
+*  Non-zero if datagrams read from fd are still waiting to be taken.
+***********************************************************************/
+int
+l2tp_dgram_pending(int fd)
+{
+    return RecvQ.fd == fd && RecvQ.next < RecvQ.count;
+}
+
 /**********************************************************************
 * %FUNCTION: dgram_take_from_wire
 * %ARGUMENTS:
@@ -300,18 +399,17 @@ l2tp_dgram_free(l2tp_dgram *dgram)
 *  NULL on error, allocated datagram otherwise.
 * %DESCRIPTION:
 *  Reads an L2TP datagram off the wire and puts it in dgram.  Adjusts
-*  header fields to host byte order.  Keeps reading in a loop unless
-*  we hit a control frame or EAGAIN.  This is more efficient than
-*  returning to select loop each time if there's lots of traffic.
+*  header fields to host byte order.  Data frames are read in batches
+*  and handed straight to the session; we keep going until we hit a
+*  control frame or EAGAIN.  This is more efficient than returning to
+*  select loop each time if there's lots of traffic.  Datagrams after
+*  a control frame stay queued: call again while dgram_pending().
 ***********************************************************************/
 l2tp_dgram *
 l2tp_dgram_take_from_wire(int fd, struct sockaddr_in *from)
 {
-    /* EXTRA_HEADER_ROOM bytes for other headers like PPPoE, etc. */
-
-    unsigned char inbuf[MAX_PACKET_LEN+EXTRA_HEADER_ROOM];
     unsigned char *buf;
-    socklen_t len = sizeof(struct sockaddr_in);
+    int slot;
     int cursor;
     l2tp_dgram *dgram;
     unsigned char *payload;
@@ -325,24 +423,33 @@ l2tp_dgram_take_from_wire(int fd, struct sockaddr_in *from)
     unsigned char *msg;
     int r;
 
-    /* Limit iterations before bailing back to select look.  Otherwise,
-       we have a nice DoS possibility */
-    int iters = 5;
+    /* Limit reads before bailing back to select loop.  Otherwise,
+       we have a nice DoS possibility.  Only read more if we did not
+       start with queued datagrams, so callers draining the queue
+       after a control frame do not keep us here. */
+    int iters = RECV_ROUNDS;
 
     uint16_t off;
     int framelen;
 
-    /* Active part of buffer */
-    buf = inbuf + EXTRA_HEADER_ROOM;
+    if (RecvQ.fd != fd) {
+	RecvQ.fd = fd;
+	RecvQ.count = RecvQ.next = 0;
+    }
+    if (RecvQ.next < RecvQ.count) iters = 0;
 
     while(1) {
-	if (--iters <= 0) return NULL;
-	framelen = -1;
-	r = recvfrom(fd, buf, MAX_PACKET_LEN, 0,
-		     (struct sockaddr *) from, &len);
-	if (r <= 0) {
-	    return NULL;
+	if (RecvQ.next >= RecvQ.count) {
+	    if (--iters < 0) return NULL;
+	    if (dgram_recv_batch(fd) <= 0) return NULL;
 	}
+	slot = RecvQ.next++;
+	/* Active part of buffer */
+	buf = RecvQ.buf[slot] + EXTRA_HEADER_ROOM;
+	r = RecvQ.len[slot];
+	*from = RecvQ.from[slot];
+	if (r < 6) continue;
+	framelen = -1;
 
 	/* Check version; drop frame if not L2TP (ver = 2) */
 	if ((buf[1] & VERSION_MASK) != 2) continue;
@@ -21,6 +21,7 @@ static char const RCSID[] =
 #include <signal.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <linux/if.h>
 #include <linux/if_ether.h>
@@ -151,7 +152,9 @@ handle_lns_opts(EventSelector *es,
 * %RETURNS:
 *  Nothing
 * %DESCRIPTION:
-*  Shoots the frame to PPP's pty
+*  Shoots the frame to PPP's pty.  The framing bytes go into the
+*  header room in front of buf, so each frame is a single write: the
+*  pty hands every write to pppd's sync line discipline as one frame.
 ***********************************************************************/
 static void
 handle_frame(l2tp_session *ses,
@@ -159,7 +162,6 @@ handle_frame(l2tp_session *ses,
 	     size_t len)
 {
     struct slave *sl = ses->private;
-    int n;
 
     if (!sl) return;
     if (kernel_mode) {
@@ -172,10 +174,12 @@ handle_frame(l2tp_session *ses,
     *--buf = 0xFF;
     len += 2;
 
-    /* TODO: Add error checking */
     if (sl->fd < 0) {
         l2tp_set_errmsg("Attempt to write %d bytes to non existent fd.", len);
-    } else n = write(sl->fd, buf, len);
+    } else if (write(sl->fd, buf, len) < 0 && errno != EAGAIN) {
+	/* A full pty just drops the frame, like a congested link */
+	l2tp_set_errmsg("Unable to write frame to pppd: %s", strerror(errno));
+    }
 }
 
 /**********************************************************************
@@ -502,6 +506,37 @@ establish_session(l2tp_session *ses)
     _exit(1);
 }
 
+/**********************************************************************
+* %FUNCTION: kernel_mode_supported
+* %ARGUMENTS:
+*  None
+* %RETURNS:
+*  1 if the kernel can carry the data plane (PPPoL2TP), 0 otherwise.
+* %DESCRIPTION:
+*  Checks once for PPPoL2TP support.  Without it, kernel-mode is turned
+*  off and frames go through pppd's pty instead.
+***********************************************************************/
+static int
+kernel_mode_supported(void)
+{
+    static int supported = -1;
+    int fd;
+
+    if (supported < 0) {
+	fd = socket(AF_PPPOX, SOCK_DGRAM, PX_PROTO_OL2TP);
+	if (fd >= 0) {
+	    close(fd);
+	    supported = 1;
+	} else {
+	    supported = (errno != EAFNOSUPPORT && errno != EPROTONOSUPPORT);
+	}
+	if (!supported) {
+	    l2tp_set_errmsg("No PPPoL2TP support in kernel, using pty for data");
+	}
+    }
+    return supported;
+}
+
 static int establish_tunnel(l2tp_tunnel *tunnel)
 {
     EventSelector *es = tunnel->es;
@@ -515,6 +550,10 @@ static int establish_tunnel(l2tp_tunnel *tunnel)
 
     if (!kernel_mode)
 	return 0;
+    if (!kernel_mode_supported()) {
+	kernel_mode = 0;
+	return 0;
+    }
 
     tunnel->private = NULL;
     tun = malloc(sizeof(struct master));
@@ -410,6 +410,7 @@ l2tp_dgram *l2tp_dgram_new(size_t len);
 l2tp_dgram *l2tp_dgram_new_control(uint16_t msg_type, uint16_t tid, uint16_t sid);
 void l2tp_dgram_free(l2tp_dgram *dgram);
 l2tp_dgram *l2tp_dgram_take_from_wire(int fd, struct sockaddr_in *from);
+int l2tp_dgram_pending(int fd);
 int l2tp_dgram_send_to_wire(l2tp_dgram const *dgram,
 		       struct sockaddr_in const *to);
 int l2tp_dgram_send_ppp_frame(l2tp_session *ses, unsigned char const *buf,
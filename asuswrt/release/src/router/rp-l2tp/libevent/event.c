@@ -19,11 +19,21 @@ static char const RCSID[] =
 
 #include "event.h"
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+/* Ready descriptors fetched per epoll_wait call */
+#define EPOLL_MAX_EVENTS 32
 
 static void DestroySelector(EventSelector *es);
 static void DestroyHandler(EventHandler *eh);
 static void DoPendingChanges(EventSelector *es);
+static void EpollDisable(EventSelector *es);
+static void EpollUpdate(EventSelector *es, int fd, unsigned int flags, int add);
+static int EpollWait(EventSelector *es, struct timeval *tm,
+		     struct epoll_event *events);
 
 /**********************************************************************
 * %FUNCTION: Event_CreateSelector
@@ -32,7 +42,8 @@ static void DoPendingChanges(EventSelector *es);
 * %RETURNS:
 *  A newly-allocated EventSelector, or NULL if out of memory.
 * %DESCRIPTION:
-*  Creates a new EventSelector.
+*  Creates a new EventSelector.  It waits with epoll, falling back to
+*  select if the kernel does not support it.
 ***********************************************************************/
 EventSelector *
 Event_CreateSelector(void)
@@ -43,6 +54,10 @@ Event_CreateSelector(void)
     es->nestLevel = 0;
     es->destroyPending = 0;
     es->opsPending = 0;
+    es->fds = NULL;
+    es->nfds = 0;
+    es->epfd = epoll_create(EPOLL_MAX_EVENTS);
+    if (es->epfd >= 0) fcntl(es->epfd, F_SETFD, FD_CLOEXEC);
     EVENT_DEBUG(("CreateSelector() -> %p\n", (void *) es));
     return es;
 }
@@ -75,13 +90,16 @@ Event_DestroySelector(EventSelector *es)
 * %RETURNS:
 *  0 if OK, non-zero on error.  errno is set appropriately.
 * %DESCRIPTION:
-*  Handles a single event (uses select() to wait for an event.)
+*  Handles a single event (uses epoll_wait() or select() to wait for
+*  an event.)
 ***********************************************************************/
 int
 Event_HandleEvent(EventSelector *es)
 {
     fd_set readfds, writefds;
     fd_set *rd, *wr;
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    EventFdState *st;
     unsigned int flags;
 
     struct timeval abs_timeout, now;
@@ -96,6 +114,8 @@ Event_HandleEvent(EventSelector *es)
     int foundWriteEvent = 0;
     int maxfd = -1;
     int pastDue;
+    int i, nready = 0;
+    int useEpoll = (es->epfd >= 0);
 
     EVENT_DEBUG(("Enter Event_HandleEvent(es=%p)\n", (void *) es));
 
@@ -108,12 +128,12 @@ Event_HandleEvent(EventSelector *es)
 	if (eh->flags & EVENT_FLAG_DELETED) continue;
 	if (eh->flags & EVENT_FLAG_READABLE) {
 	    foundReadEvent = 1;
-	    FD_SET(eh->fd, &readfds);
+	    if (!useEpoll) FD_SET(eh->fd, &readfds);
 	    if (eh->fd > maxfd) maxfd = eh->fd;
 	}
 	if (eh->flags & EVENT_FLAG_WRITEABLE) {
 	    foundWriteEvent = 1;
-	    FD_SET(eh->fd, &writefds);
+	    if (!useEpoll) FD_SET(eh->fd, &writefds);
 	    if (eh->fd > maxfd) maxfd = eh->fd;
 	}
 	if (eh->flags & EVENT_TIMER_BITS) {
@@ -161,7 +181,11 @@ Event_HandleEvent(EventSelector *es)
 
     if (foundReadEvent || foundWriteEvent || foundTimeoutEvent) {
 	for(;;) {
-	    r = select(maxfd+1, rd, wr, NULL, tm);
+	    if (useEpoll) {
+		r = nready = EpollWait(es, tm, events);
+	    } else {
+		r = select(maxfd+1, rd, wr, NULL, tm);
+	    }
 	    if (r < 0) {
 		if (errno == EINTR) continue;
 	    }
@@ -181,13 +205,27 @@ Event_HandleEvent(EventSelector *es)
 	    if (eh->flags & EVENT_FLAG_DELETED) continue;
 
 	    flags = 0;
-	    if ((eh->flags & EVENT_FLAG_READABLE) &&
-		FD_ISSET(eh->fd, &readfds)) {
-		flags |= EVENT_FLAG_READABLE;
-	    }
-	    if ((eh->flags & EVENT_FLAG_WRITEABLE) &&
-		FD_ISSET(eh->fd, &writefds)) {
-		flags |= EVENT_FLAG_WRITEABLE;
+	    if (useEpoll) {
+		if (eh->fd >= 0 && eh->fd < es->nfds) {
+		    st = &es->fds[eh->fd];
+		    if ((eh->flags & EVENT_FLAG_READABLE) &&
+			(st->revents & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+			flags |= EVENT_FLAG_READABLE;
+		    }
+		    if ((eh->flags & EVENT_FLAG_WRITEABLE) &&
+			(st->revents & (EPOLLOUT | EPOLLERR))) {
+			flags |= EVENT_FLAG_WRITEABLE;
+		    }
+		}
+	    } else {
+		if ((eh->flags & EVENT_FLAG_READABLE) &&
+		    FD_ISSET(eh->fd, &readfds)) {
+		    flags |= EVENT_FLAG_READABLE;
+		}
+		if ((eh->flags & EVENT_FLAG_WRITEABLE) &&
+		    FD_ISSET(eh->fd, &writefds)) {
+		    flags |= EVENT_FLAG_WRITEABLE;
+		}
 	    }
 	    if (eh->flags & EVENT_TIMER_BITS) {
 		pastDue = (eh->tmout.tv_sec < now.tv_sec ||
@@ -211,6 +249,13 @@ Event_HandleEvent(EventSelector *es)
 	}
     }
 
+    /* Forget what epoll reported; it is level-triggered */
+    for (i=0; i<nready; i++) {
+	if (events[i].data.fd < es->nfds) {
+	    es->fds[events[i].data.fd].revents = 0;
+	}
+    }
+
     es->nestLevel--;
 
     if (!es->nestLevel && es->opsPending) {
@@ -261,6 +306,7 @@ Event_AddHandler(EventSelector *es,
     /* Add immediately.  This is safe even if we are in a handler. */
     eh->next = es->handlers;
     es->handlers = eh;
+    EpollUpdate(es, fd, flags, 1);
 
     EVENT_DEBUG(("Event_AddHandler(es=%p, fd=%d, flags=%u) -> %p\n", es, fd, flags, eh));
     return eh;
@@ -333,6 +379,7 @@ Event_AddHandlerWithTimeout(EventSelector *es,
     /* Add immediately.  This is safe even if we are in a handler. */
     eh->next = es->handlers;
     es->handlers = eh;
+    EpollUpdate(es, fd, flags, 1);
 
     EVENT_DEBUG(("Event_AddHandlerWithTimeout(es=%p, fd=%d, flags=%u, t=%d/%d) -> %p\n", es, fd, flags, t.tv_sec, t.tv_usec, eh));
     return eh;
@@ -410,6 +457,9 @@ Event_DelHandler(EventSelector *es,
     EVENT_DEBUG(("Event_DelHandler(es=%p, eh=%p)\n", es, eh));
     for (cur=es->handlers, prev=NULL; cur; prev=cur, cur=cur->next) {
 	if (cur == eh) {
+	    if (!(eh->flags & EVENT_FLAG_DELETED)) {
+		EpollUpdate(es, eh->fd, eh->flags, 0);
+	    }
 	    if (es->nestLevel) {
 		eh->flags |= EVENT_FLAG_DELETED;
 		es->opsPending = 1;
@@ -446,9 +496,122 @@ DestroySelector(EventSelector *es)
 	DestroyHandler(cur);
     }
 
+    if (es->epfd >= 0) close(es->epfd);
+    free(es->fds);
     free(es);
 }
 
+/**********************************************************************
+* %FUNCTION: EpollDisable
+* %ARGUMENTS:
+*  es -- an event selector
+* %RETURNS:
+*  Nothing
+* %DESCRIPTION:
+*  Gives up on epoll (e.g. for a descriptor it cannot watch); the
+*  selector uses select from the next Event_HandleEvent on.
+***********************************************************************/
+static void
+EpollDisable(EventSelector *es)
+{
+    EVENT_DEBUG(("EpollDisable(es=%p) errno=%d\n", es, errno));
+    close(es->epfd);
+    es->epfd = -1;
+}
+
+/**********************************************************************
+* %FUNCTION: EpollUpdate
+* %ARGUMENTS:
+*  es -- an event selector
+*  fd -- descriptor of a handler being added or deleted
+*  flags -- the handler's flags
+*  add -- non-zero if the handler is added, zero if deleted
+* %RETURNS:
+*  Nothing
+* %DESCRIPTION:
+*  Several handlers may watch the same descriptor, so the epoll set
+*  gets the union of what they wait for.  A descriptor may have been
+*  closed and reused behind our back, hence MOD falls back to ADD and
+*  errors from DEL are ignored.
+***********************************************************************/
+static void
+EpollUpdate(EventSelector *es, int fd, unsigned int flags, int add)
+{
+    EventFdState *st;
+    struct epoll_event ev;
+    int n;
+
+    if (es->epfd < 0 || fd < 0 ||
+	!(flags & (EVENT_FLAG_READABLE | EVENT_FLAG_WRITEABLE))) {
+	return;
+    }
+
+    if (fd >= es->nfds) {
+	n = fd + 16;
+	st = realloc(es->fds, n * sizeof(EventFdState));
+	if (!st) {
+	    EpollDisable(es);
+	    return;
+	}
+	memset(st + es->nfds, 0, (n - es->nfds) * sizeof(EventFdState));
+	es->fds = st;
+	es->nfds = n;
+    }
+    st = &es->fds[fd];
+
+    if (add) {
+	if (flags & EVENT_FLAG_READABLE) st->nread++;
+	if (flags & EVENT_FLAG_WRITEABLE) st->nwrite++;
+    } else {
+	if ((flags & EVENT_FLAG_READABLE) && st->nread) st->nread--;
+	if ((flags & EVENT_FLAG_WRITEABLE) && st->nwrite) st->nwrite--;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (st->nread ? EPOLLIN : 0) | (st->nwrite ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+    if (!ev.events) {
+	epoll_ctl(es->epfd, EPOLL_CTL_DEL, fd, &ev);
+	st->revents = 0;
+	return;
+    }
+    if (epoll_ctl(es->epfd, EPOLL_CTL_MOD, fd, &ev) < 0 &&
+	(errno != ENOENT || epoll_ctl(es->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)) {
+	EpollDisable(es);
+    }
+}
+
+/**********************************************************************
+* %FUNCTION: EpollWait
+* %ARGUMENTS:
+*  es -- an event selector
+*  tm -- relative timeout, or NULL to wait forever
+*  events -- array of EPOLL_MAX_EVENTS entries to fill
+* %RETURNS:
+*  Whatever epoll_wait returns
+* %DESCRIPTION:
+*  Waits for events and records them in es->fds.
+***********************************************************************/
+static int
+EpollWait(EventSelector *es, struct timeval *tm, struct epoll_event *events)
+{
+    int msec = -1;
+    int i, r;
+
+    if (tm) {
+	/* Round up, so we do not wake before a timer is due */
+	msec = tm->tv_sec * 1000 + (tm->tv_usec + 999) / 1000;
+    }
+
+    r = epoll_wait(es->epfd, events, EPOLL_MAX_EVENTS, msec);
+    for (i=0; i<r; i++) {
+	if (events[i].data.fd < es->nfds) {
+	    es->fds[events[i].data.fd].revents = events[i].events;
+	}
+    }
+    return r;
+}
+
 /**********************************************************************
 * %FUNCTION: DestroyHandler
 * %ARGUMENTS:
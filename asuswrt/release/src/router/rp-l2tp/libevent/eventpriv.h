@@ -33,12 +33,22 @@ typedef struct EventHandler_t {
     void *data;			/* Extra data to pass to callback          */
 } EventHandler;
 
+/* Per-descriptor epoll state */
+typedef struct EventFdState_t {
+    unsigned short nread;	/* Handlers waiting for readability        */
+    unsigned short nwrite;	/* Handlers waiting for writability        */
+    unsigned int revents;	/* Events reported by the last epoll_wait  */
+} EventFdState;
+
 /* Selector structure */
 typedef struct EventSelector_t {
     EventHandler *handlers;	/* Linked list of EventHandlers            */
     int nestLevel;		/* Event-handling nesting level            */
     int opsPending;		/* True if operations are pending          */
     int destroyPending;		/* If true, a destroy is pending           */
+    int epfd;			/* epoll descriptor; -1 to use select      */
+    EventFdState *fds;		/* epoll state, indexed by descriptor      */
+    int nfds;			/* Number of entries in fds                */
 } EventSelector;
 
 /* Private flags */
@@ -102,7 +102,8 @@ l2tp_network_init(EventSelector *es)
 * %RETURNS:
 *  Nothing
 * %DESCRIPTION:
-*  Called when a packet arrives on the UDP socket.
+*  Called when a packet arrives on the UDP socket.  Handles every
+*  datagram of the batch read, including those after a control frame.
 ***********************************************************************/
 void
 network_readable(EventSelector *es,
@@ -112,10 +113,13 @@ network_readable(EventSelector *es,
 {
     l2tp_dgram *dgram;
     struct sockaddr_in from;
-    dgram = l2tp_dgram_take_from_wire(fd, &from);
-    if (!dgram) return;
 
-    /* It's a control packet if we get here */
-    l2tp_tunnel_handle_received_control_datagram(dgram, es, &from);
-    l2tp_dgram_free(dgram);
+    do {
+	dgram = l2tp_dgram_take_from_wire(fd, &from);
+	if (!dgram) continue;
+
+	/* It's a control packet if we get here */
+	l2tp_tunnel_handle_received_control_datagram(dgram, es, &from);
+	l2tp_dgram_free(dgram);
+    } while (l2tp_dgram_pending(fd));
 }
@@ -3,6 +3,7 @@
 #include <epivers.h>
 #include <typedefs.h>
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <bcmnvram.h>
 #include <wlioctl.h>
@@ -1745,6 +1746,9 @@ struct nvram_tuple router_defaults[] = {
 	{ "computer_name", "" },
 	{ "st_samba_workgroup", "WORKGROUP" },
 	{ "ftp_lang", "EN" },
+	{ "ftp_ls_stream", "1" }, // 0: build and sort listings in memory, 1: stream them
+	{ "ftp_ls_unsorted", "0" }, // 1: stream listings in directory order
+	{ "ftp_ls_cache", "0" }, // bytes of listings cached per session, 0: off
 
 //#ifdef RTCONFIG_WEBDAV
 	{ "enable_webdav", "0" }, // 0: Disable, 1: enable
@@ -5015,6 +5019,57 @@ fix_name(const char *name, char *fixed_name)
 	strcpy(fixed_name, name);
 }
 
+/* router_defaults[] sorted by name, built on the first lookup */
+static struct nvram_tuple **defaults_index = NULL;
+static int defaults_count = 0;
+
+static int
+defaults_cmp(const void *a, const void *b)
+{
+	const struct nvram_tuple *x = *(const struct nvram_tuple **) a;
+	const struct nvram_tuple *y = *(const struct nvram_tuple **) b;
+	int r = strcmp(x->name, y->name);
+
+	/* Keep table order among duplicated names: the first entry wins */
+	return r ? : (x < y ? -1 : (x > y));
+}
+
+static char *
+router_defaults_find(const char *name)
+{
+	int lo, hi, mid, idx;
+
+	if (!defaults_index) {
+		for (idx = 0; router_defaults[idx].name != NULL; idx++);
+		defaults_index = malloc(idx * sizeof(*defaults_index));
+		if (!defaults_index) {
+			for (idx = 0; router_defaults[idx].name != NULL; idx++)
+				if (strcmp(router_defaults[idx].name, name) == 0)
+					return router_defaults[idx].value;
+			return NULL;
+		}
+		defaults_count = idx;
+		for (idx = 0; idx < defaults_count; idx++)
+			defaults_index[idx] = &router_defaults[idx];
+		qsort(defaults_index, defaults_count, sizeof(*defaults_index), defaults_cmp);
+	}
+
+	/* Leftmost match */
+	lo = 0;
+	hi = defaults_count - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (strcmp(defaults_index[mid]->name, name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	if (lo < defaults_count && strcmp(defaults_index[lo]->name, name) == 0)
+		return defaults_index[lo]->value;
+
+	return NULL;
+}
+
 extern char *tcode_default_get(const char *name);
 
 /*
@@ -5028,7 +5083,6 @@ extern char *tcode_default_get(const char *name);
 char *
 nvram_default_get(const char *name)
 {
-	int idx;
 	char fixed_name[NVRAM_MAX_VALUE_LEN];
 
 	fix_name(name, fixed_name);
@@ -5048,6 +5102,8 @@ nvram_default_get(const char *name)
 #endif /* __CONFIG_HSPOT__ */
 #endif
 	if (!strcmp(nvram_safe_get("devicemode"), "1")) {
+		int idx;
+
 		for (idx = 0; router_defaults_override_type1[idx].name != NULL; idx++) {
 			if (strcmp(router_defaults_override_type1[idx].name, fixed_name) == 0) {
 				return router_defaults_override_type1[idx].value;
@@ -5065,20 +5121,14 @@ nvram_default_get(const char *name)
 #endif
 
 	/* check name wlx_xxx first */
-	if ((strncmp(name, "wl", 2) == 0) && isdigit(name[2]) && (name[3] == '_'))
-	for (idx = 0; router_defaults[idx].name != NULL; idx++) {
-		if (strcmp(router_defaults[idx].name, name) == 0) {
-			return router_defaults[idx].value;
-		}
-	}
-
-	for (idx = 0; router_defaults[idx].name != NULL; idx++) {
-		if (strcmp(router_defaults[idx].name, fixed_name) == 0) {
-			return router_defaults[idx].value;
+	if ((strncmp(name, "wl", 2) == 0) && isdigit(name[2]) && (name[3] == '_')) {
+		char *value = router_defaults_find(name);
+		if (value) {
+			return value;
 		}
 	}
 
-	return NULL;
+	return router_defaults_find(fixed_name);
 }
 
 /* validate/restore all per-interface related variables */
@@ -0,0 +1,104 @@
+/*
+ * Batched ebtables programming.
+ *
+ * Rules are staged in a file in ebtables-restore format and handed to
+ * "ebtables-restore --noflush" in one go. It applies every command of a
+ * table to a userspace copy of the rules already loaded and hands it back
+ * to the kernel with a single replace.
+ * Bridged traffic never sees a half-flushed table, and a whole ruleset
+ * costs one fork instead of one per rule.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdarg.h>
+
+#include "shutils.h"
+#include "shared.h"
+
+#define EBT_RESTORE	"/usr/sbin/ebtables-restore"
+
+int ebt_batch_open(ebt_batch_t *b)
+{
+	snprintf(b->path, sizeof(b->path), "/tmp/ebt_batch.%d", getpid());
+	b->table[0] = '\0';
+	if ((b->fp = fopen(b->path, "w")) == NULL) {
+		_dprintf("%s: %s\n", __FUNCTION__, b->path);
+		return -1;
+	}
+	return 0;
+}
+
+/* Stage one ebtables command (without -t) for the given table */
+void ebt_batch(ebt_batch_t *b, const char *table, const char *fmt, ...)
+{
+	va_list args;
+
+	if (!b->fp)
+		return;
+
+	if (strcmp(b->table, table)) {
+		strlcpy(b->table, table, sizeof(b->table));
+		fprintf(b->fp, "*%s\n", table);
+	}
+
+	va_start(args, fmt);
+	vfprintf(b->fp, fmt, args);
+	va_end(args);
+	fputc('\n', b->fp);
+}
+
+/* Without ebtables-restore, run the staged commands one by one */
+static void ebt_batch_eval(const char *path)
+{
+	char line[256], table[16], *argv[32], *p;
+	int argc;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return;
+
+	table[0] = '\0';
+	while (fgets(line, sizeof(line), fp)) {
+		if ((p = strchr(line, '\n')) != NULL)
+			*p = '\0';
+		if (*line == '*') {
+			strlcpy(table, line + 1, sizeof(table));
+			continue;
+		}
+
+		argc = 0;
+		argv[argc++] = "ebtables";
+		argv[argc++] = "-t";
+		argv[argc++] = table;
+		for (p = strtok(line, " "); p && argc < (int) ARRAY_SIZE(argv) - 1; p = strtok(NULL, " "))
+			argv[argc++] = p;
+		argv[argc] = NULL;
+		_eval(argv, NULL, 0, NULL);
+	}
+	fclose(fp);
+}
+
+int ebt_batch_commit(ebt_batch_t *b)
+{
+	int ret = 0;
+
+	if (!b->fp)
+		return -1;
+	fclose(b->fp);
+	b->fp = NULL;
+
+	if (b->table[0]) {
+		if (!f_exists(EBT_RESTORE))
+			ebt_batch_eval(b->path);
+		else if ((ret = eval(EBT_RESTORE, "--noflush", b->path)) != 0) {
+			logmessage("ebtables", "ebtables-restore failed, running rules one by one");
+			ebt_batch_eval(b->path);
+		}
+	}
+
+	unlink(b->path);
+	return ret;
+}
@@ -941,6 +941,16 @@ extern void ascii_to_char(const char *output, const char *input);
 extern const char *find_word(const char *buffer, const char *word);
 extern int remove_word(char *buffer, const char *word);
 
+// ebtables.c
+typedef struct ebt_batch {
+	FILE *fp;
+	char path[32];
+	char table[8];
+} ebt_batch_t;
+extern int ebt_batch_open(ebt_batch_t *b);
+extern void ebt_batch(ebt_batch_t *b, const char *table, const char *fmt, ...);
+extern int ebt_batch_commit(ebt_batch_t *b);
+
 // file.c
 extern int check_if_file_exist(const char *file);
 extern int check_if_dir_exist(const char *file);
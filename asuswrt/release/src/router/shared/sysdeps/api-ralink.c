@@ -270,6 +270,86 @@ int wl_ioctl(const char *ifname, int cmd, struct iwreq *pwrq)
 	return ret;
 }
 
+/*
+ * Site survey of ifname into data, shared by every caller (web UI, wlcscan,
+ * ...). A result younger than max_age seconds is served from /tmp instead of
+ * triggering a new scan, and the scan itself is serialized by a lock, so
+ * callers that arrive while a survey is running wait for it and get its
+ * result rather than restarting it. Up to len bytes are returned, data must
+ * have room for one more, the terminating NUL. Returns the result length,
+ * -1 on error.
+ */
+int wl_site_survey(const char *ifname, char *data, int len, int max_age)
+{
+	struct iwreq wrq;
+	char path[64];
+	long stamp;
+	int lock, commit_lock, fd, n = -1;
+
+	if (len <= 0)
+		return -1;
+
+	snprintf(path, sizeof(path), "/tmp/wlscan_%s", ifname);
+	lock = file_lock("wlscan");
+
+	if ((fd = open(path, O_RDONLY)) >= 0) {
+		memset(data, 0, len + 1);
+		if (read(fd, &stamp, sizeof(stamp)) == sizeof(stamp) &&
+		    uptime() - stamp < max_age)
+			n = read(fd, data, len);
+		close(fd);
+		if (n > 0)
+			goto out;
+		n = -1;
+	}
+
+	memset(data, 0, len + 1);
+	strcpy(data, "SiteSurvey=1");
+	wrq.u.data.length = strlen(data) + 1;
+	wrq.u.data.pointer = data;
+	wrq.u.data.flags = 0;
+	/* never start a survey in the middle of an nvram commit */
+	commit_lock = file_lock("nvramcommit");
+	if (wl_ioctl(ifname, RTPRIV_IOCTL_SET, &wrq) < 0) {
+		file_unlock(commit_lock);
+		dbg("Site Survey fails\n");
+		goto out;
+	}
+	file_unlock(commit_lock);
+
+	dbg("Please wait");
+	sleep(1);
+	dbg(".");
+	sleep(1);
+	dbg(".");
+	sleep(1);
+	dbg(".");
+	sleep(1);
+	dbg(".\n\n");
+
+	memset(data, 0, len);
+	wrq.u.data.length = len;
+	wrq.u.data.pointer = data;
+	wrq.u.data.flags = 0;
+	if (wl_ioctl(ifname, RTPRIV_IOCTL_GSITESURVEY, &wrq) < 0) {
+		dbg("errors in getting site survey result\n");
+		goto out;
+	}
+	n = (wrq.u.data.length < len) ? wrq.u.data.length : len;
+	data[n] = '\0';
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) >= 0) {
+		stamp = uptime();
+		if (write(fd, &stamp, sizeof(stamp)) != sizeof(stamp) ||
+		    write(fd, data, n) != n)
+			unlink(path);
+		close(fd);
+	}
+out:
+	file_unlock(lock);
+	return n;
+}
+
 unsigned int get_radio_status(char *ifname)
 {
 	struct iwreq wrq;
@@ -442,4 +442,7 @@ int ra_gpio_write_bit(int idx, int value);
 
 extern int wl_ioctl(const char *ifname, int cmd, struct iwreq *pwrq);
 
+#define WLSCAN_MAX_AGE	10
+extern int wl_site_survey(const char *ifname, char *data, int len, int max_age);
+
 #endif
@@ -0,0 +1,159 @@
+/*
+ * Reader side of the syslogd indexed log ring, see syslog_ring.h.
+ *
+ * syslogd is the only writer and never waits for readers. A record is
+ * copied out first and checked afterwards: it is only handed on if its
+ * slot still carries the same seq and its text was not overrun while
+ * we were copying it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "syslog_ring.h"
+
+static struct logidx_ds *ring_attach(void)
+{
+	static struct logidx_ds *li = NULL;
+	static int shmid = -1;
+	int id;
+
+	/* syslogd creates a new segment each time it starts */
+	id = shmget(SYSLOG_RING_KEY, 0, 0);
+	if (id != shmid) {
+		if (li)
+			shmdt(li);
+		li = NULL;
+		shmid = -1;
+		if (id != -1) {
+			li = shmat(id, NULL, 0);
+			if (li == (void *) -1)
+				li = NULL;
+			else
+				shmid = id;
+		}
+	}
+
+	if (li == NULL || li->magic != SYSLOG_RING_MAGIC || li->nrec == 0)
+		return NULL;
+
+	return li;
+}
+
+static void ring_range(struct logidx_ds *li, unsigned int *first, unsigned int *last)
+{
+	unsigned int seq = li->seq;
+
+	*first = (seq >= li->nrec) ? seq - li->nrec + 1 : 1;
+	if (*first <= li->clear_seq)
+		*first = li->clear_seq + 1;
+	*last = seq;
+}
+
+/*
+ * Range of records currently readable.
+ * Returns 0 and fills stamp/first/last, or -1 if syslogd keeps no ring.
+ * first > last means the ring is empty.
+ */
+int syslog_ring_info(unsigned int *stamp, unsigned int *first, unsigned int *last)
+{
+	struct logidx_ds *li;
+	unsigned int lo, hi;
+
+	if ((li = ring_attach()) == NULL)
+		return -1;
+
+	ring_range(li, &lo, &hi);
+	if (stamp)
+		*stamp = li->stamp;
+	if (first)
+		*first = lo;
+	if (last)
+		*last = hi;
+
+	return 0;
+}
+
+/* Copy record seq out of the ring; 0 when it is gone */
+static int ring_get(struct logidx_ds *li, unsigned int seq, struct syslog_rec *rec)
+{
+	struct logidx_rec r, *slot = &li->rec[seq % li->nrec];
+	const char *data = (const char *) &li->rec[li->nrec];
+	unsigned int k;
+
+	r = *slot;
+	__sync_synchronize();
+	if (r.seq != seq || r.len == 0 || r.len >= sizeof(rec->text) || r.off >= li->size)
+		return 0;
+
+	k = li->size - r.off;
+	if (k >= r.len) {
+		memcpy(rec->text, data + r.off, r.len);
+	} else {
+		memcpy(rec->text, data + r.off, k);
+		memcpy(rec->text + k, data, r.len - k);
+	}
+
+	__sync_synchronize();
+	if (slot->seq != seq || (uint32_t) (li->wpos - r.pos) > li->size)
+		return 0;
+
+	rec->text[r.len] = '\0';
+	rec->seq = seq;
+	rec->time = r.time;
+	rec->fac = r.fac;
+	rec->pri = r.pri;
+	rec->len = r.len;
+
+	return 1;
+}
+
+/*
+ * Hand the records after seq 'from' to fn, oldest first, skipping those
+ * that do not match fac (SYSLOG_ANY_FAC for all) or are less important
+ * than maxpri. Stops after max records (0: no limit) or when fn returns
+ * non-zero. Returns the number of records passed, or -1 without a ring.
+ */
+int syslog_ring_read(unsigned int from, int fac, int maxpri, int max,
+		     int (*fn)(struct syslog_rec *rec, void *arg), void *arg)
+{
+	struct logidx_ds *li;
+	struct syslog_rec rec;
+	unsigned int seq, first, last;
+	int n = 0;
+
+	if ((li = ring_attach()) == NULL)
+		return -1;
+	ring_range(li, &first, &last);
+
+	seq = (from >= first) ? from + 1 : first;
+	for (; seq <= last; seq++) {
+		if (!ring_get(li, seq, &rec))
+			continue;
+		if (fac != SYSLOG_ANY_FAC && rec.fac != fac)
+			continue;
+		if (rec.pri > maxpri)
+			continue;
+
+		n++;
+		if (fn(&rec, arg) || (max > 0 && n >= max))
+			break;
+	}
+
+	return n;
+}
+
+/* Hide everything logged so far, as the log files get removed */
+int syslog_ring_clear(void)
+{
+	struct logidx_ds *li;
+
+	if ((li = ring_attach()) == NULL)
+		return -1;
+
+	li->clear_seq = li->seq;
+
+	return 0;
+}
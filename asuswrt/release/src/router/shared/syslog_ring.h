@@ -0,0 +1,58 @@
+#ifndef __SYSLOG_RING_H__
+#define __SYSLOG_RING_H__
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Indexed log ring kept by busybox syslogd next to the log file
+ * (CONFIG_FEATURE_IPC_SYSLOG_INDEX). The layout must be in sync with
+ * busybox/sysklogd/syslogd.c.
+ */
+
+#define SYSLOG_RING_KEY		0x414e4548	/* "HENA" */
+#define SYSLOG_RING_MAGIC	0x4c494458	/* "LIDX" */
+
+struct logidx_rec {
+	uint32_t seq;		/* record number, 0 while the slot is rewritten */
+	uint32_t time;
+	uint32_t pos;		/* wpos when the text was stored */
+	uint32_t off;		/* offset of the text in data[] */
+	uint16_t len;		/* text length including the '\n' */
+	uint8_t fac;		/* LOG_FAC(pri) */
+	uint8_t pri;		/* LOG_PRI(pri) */
+};
+
+struct logidx_ds {
+	uint32_t magic;
+	uint32_t stamp;		/* creation time, tells syslogd restarts apart */
+	uint32_t nrec;		/* slots in rec[] */
+	uint32_t size;		/* bytes in data[] */
+	uint32_t seq;		/* last record stored */
+	uint32_t wpos;		/* bytes stored so far */
+	uint32_t clear_seq;	/* records up to this one are hidden */
+	uint32_t reserved;
+	struct logidx_rec rec[0];
+};
+
+#define SYSLOG_REC_MAX		1024
+
+struct syslog_rec {
+	unsigned int seq;
+	time_t time;
+	int fac;		/* LOG_FAC() of the message */
+	int pri;		/* LOG_PRI() of the message */
+	int len;
+	char text[SYSLOG_REC_MAX];	/* the log file line, '\n' included */
+};
+
+/* Filters for syslog_ring_read() */
+#define SYSLOG_ANY_FAC		-1
+#define SYSLOG_ANY_PRI		7	/* LOG_DEBUG */
+
+extern int syslog_ring_info(unsigned int *stamp, unsigned int *first, unsigned int *last);
+extern int syslog_ring_read(unsigned int from, int fac, int maxpri, int max,
+			    int (*fn)(struct syslog_rec *rec, void *arg), void *arg);
+extern int syslog_ring_clear(void);
+
+#endif
@@ -65,8 +65,37 @@ static int transfer_dir_internal(
 static int write_dir_list(struct vsf_session* p_sess,
                           struct mystr_list* p_dir_list,
                           enum EVSFRWTarget target);
+static int write_dir_line(const struct mystr* p_line_str, void* p_private);
+static int get_dir_cache_key(struct mystr* p_key_str,
+                             const struct mystr* p_base_dir_str,
+                             const struct mystr* p_option_str,
+                             const struct mystr* p_filter_str,
+                             int is_verbose);
+static const struct mystr* find_dir_cache(const struct mystr* p_key_str);
+static void add_dir_cache(const struct mystr* p_key_str,
+                          const struct mystr* p_data_str);
 static unsigned int get_chunk_size();
 
+/* State of a listing being streamed out by write_dir_line() */
+struct dir_writer
+{
+  struct vsf_session* p_sess;
+  enum EVSFRWTarget target;
+  struct mystr buf_str;
+  /* Copy of everything sent, for the listing cache; 0 if not wanted */
+  struct mystr* p_cache_str;
+};
+
+#define VSFTP_DIR_CACHE_ENTRIES 4
+
+static struct dir_cache_entry
+{
+  struct mystr key_str;
+  struct mystr data_str;
+  unsigned long last_use;
+} s_dir_cache[VSFTP_DIR_CACHE_ENTRIES];
+static unsigned long s_dir_cache_clock;
+
 void
 vsf_ftpdataio_dispose_transfer_fd(struct vsf_session* p_sess)
 {
@@ -301,6 +330,9 @@ transfer_dir_internal(struct vsf_session* p_sess, int is_control,
   struct mystr_list dir_list = INIT_STRLIST;
   struct mystr_list subdir_list = INIT_STRLIST;
   struct mystr dir_prefix_str = INIT_MYSTR;
+  struct mystr cache_key_str = INIT_MYSTR;
+  struct mystr cache_data_str = INIT_MYSTR;
+  struct mystr* p_cache_str = 0;
   struct mystr_list* p_subdir_list = 0;
   struct str_locate_result loc_result = str_locate_char(p_option_str, 'R');
   int failed = 0;
@@ -317,8 +349,46 @@ transfer_dir_internal(struct vsf_session* p_sess, int is_control,
 // 2007.05 James {
   char *session_user = (char *)str_getbuf(&p_sess->user_str);
 
-  vsf_ls_populate_dir_list(session_user, &dir_list, p_subdir_list, p_dir, p_base_dir_str,
-                           p_option_str, p_filter_str, is_verbose);
+  /* A plain listing may be served from, or go into, the listing cache */
+  if (p_subdir_list == 0 && tunable_ls_cache_size > 0 &&
+      get_dir_cache_key(&cache_key_str, p_base_dir_str, p_option_str,
+                        p_filter_str, is_verbose))
+  {
+    const struct mystr* p_cached_str = find_dir_cache(&cache_key_str);
+    if (p_cached_str != 0)
+    {
+      failed = (ftp_write_str(p_sess, p_cached_str, target) != 0);
+      str_free(&cache_key_str);
+      return failed ? -1 : 0;
+    }
+    p_cache_str = &cache_data_str;
+  }
+  if (p_subdir_list == 0 && tunable_ls_stream_enable &&
+      vsf_ls_can_stream(p_option_str))
+  {
+    /* Lines go out as they are built; dir_list stays empty */
+    struct dir_writer writer;
+    vsf_sysutil_memclr(&writer, sizeof(writer));
+    writer.p_sess = p_sess;
+    writer.target = target;
+    writer.p_cache_str = p_cache_str;
+    str_reserve(&writer.buf_str, VSFTP_DIR_BUFSIZE);
+    failed = vsf_ls_stream_dir_list(session_user, p_dir, p_base_dir_str,
+                                    p_option_str, p_filter_str, is_verbose,
+                                    write_dir_line, &writer);
+    if (!failed && !str_isempty(&writer.buf_str))
+    {
+      failed = (ftp_write_str(p_sess, &writer.buf_str, target) != 0);
+    }
+    str_free(&writer.buf_str);
+    p_cache_str = writer.p_cache_str;
+  }
+  else
+  {
+    vsf_ls_populate_dir_list(session_user, &dir_list, p_subdir_list, p_dir,
+                             p_base_dir_str, p_option_str, p_filter_str,
+                             is_verbose);
+  }
 // 2007.05 James }
 
   if (p_subdir_list)
@@ -336,6 +406,26 @@ transfer_dir_internal(struct vsf_session* p_sess, int is_control,
   {
     failed = write_dir_list(p_sess, &dir_list, target);
   }
+  if (!failed && p_cache_str != 0)
+  {
+    unsigned int dir_index_max = str_list_get_length(&dir_list);
+    unsigned int dir_index;
+    for (dir_index = 0; dir_index < dir_index_max && p_cache_str; dir_index++)
+    {
+      const struct mystr* p_line_str = str_list_get_pstr(&dir_list, dir_index);
+      if (str_getlen(p_cache_str) + str_getlen(p_line_str) >
+            tunable_ls_cache_size)
+      {
+        p_cache_str = 0;
+        break;
+      }
+      str_append_str(p_cache_str, p_line_str);
+    }
+    if (p_cache_str != 0)
+    {
+      add_dir_cache(&cache_key_str, p_cache_str);
+    }
+  }
   /* Recurse into the subdirectories if required... */
   if (!failed)
   {
@@ -383,6 +473,8 @@ transfer_dir_internal(struct vsf_session* p_sess, int is_control,
   str_list_free(&dir_list);
   str_list_free(&subdir_list);
   str_free(&dir_prefix_str);
+  str_free(&cache_key_str);
+  str_free(&cache_data_str);
   if (!failed)
   {
     return 0;
@@ -393,6 +485,149 @@ transfer_dir_internal(struct vsf_session* p_sess, int is_control,
   }
 }
 
+/* vsf_ls_stream_dir_list() callback: coalesce lines into few writes, like
+ * write_dir_list() does, and keep a copy for the cache while it fits.
+ */
+static int
+write_dir_line(const struct mystr* p_line_str, void* p_private)
+{
+  struct dir_writer* p_writer = (struct dir_writer*) p_private;
+  if (str_getlen(&p_writer->buf_str) + str_getlen(p_line_str) >
+        VSFTP_DIR_BUFSIZE)
+  {
+    if (ftp_write_str(p_writer->p_sess, &p_writer->buf_str,
+                      p_writer->target) != 0)
+    {
+      return 1;
+    }
+    str_empty(&p_writer->buf_str);
+  }
+  str_append_str(&p_writer->buf_str, p_line_str);
+  if (p_writer->p_cache_str != 0)
+  {
+    if (str_getlen(p_writer->p_cache_str) + str_getlen(p_line_str) >
+          tunable_ls_cache_size)
+    {
+      p_writer->p_cache_str = 0;
+    }
+    else
+    {
+      str_append_str(p_writer->p_cache_str, p_line_str);
+    }
+  }
+  return 0;
+}
+
+/* Build the listing cache key. Returns 0 if the listing is not to be cached:
+ * the directory can't be stat()ed, or was changed so recently that a change
+ * within the same second would not show in its mtime.
+ */
+static int
+get_dir_cache_key(struct mystr* p_key_str, const struct mystr* p_base_dir_str,
+                  const struct mystr* p_option_str,
+                  const struct mystr* p_filter_str, int is_verbose)
+{
+  static struct vsf_sysutil_statbuf* s_p_statbuf;
+  long mtime;
+  if (vsf_sysutil_retval_is_error(str_stat(p_base_dir_str, &s_p_statbuf)))
+  {
+    return 0;
+  }
+  mtime = vsf_sysutil_statbuf_get_mtime(s_p_statbuf);
+  vsf_sysutil_update_cached_time();
+  if (mtime >= vsf_sysutil_get_cached_time_sec() - 1)
+  {
+    return 0;
+  }
+  str_getcwd(p_key_str);
+  str_append_char(p_key_str, '\n');
+  str_append_str(p_key_str, p_base_dir_str);
+  str_append_char(p_key_str, '\n');
+  str_append_str(p_key_str, p_option_str);
+  str_append_char(p_key_str, '\n');
+  str_append_str(p_key_str, p_filter_str);
+  str_append_char(p_key_str, '\n');
+  str_append_char(p_key_str, is_verbose ? 'l' : 'n');
+  str_append_text(p_key_str, vsf_sysutil_statbuf_get_sortkey_mtime(s_p_statbuf));
+  return 1;
+}
+
+static const struct mystr*
+find_dir_cache(const struct mystr* p_key_str)
+{
+  int i;
+  for (i = 0; i < VSFTP_DIR_CACHE_ENTRIES; i++)
+  {
+    if (!str_isempty(&s_dir_cache[i].key_str) &&
+        str_equal(&s_dir_cache[i].key_str, p_key_str))
+    {
+      s_dir_cache[i].last_use = ++s_dir_cache_clock;
+      return &s_dir_cache[i].data_str;
+    }
+  }
+  return 0;
+}
+
+static void
+add_dir_cache(const struct mystr* p_key_str, const struct mystr* p_data_str)
+{
+  unsigned int total = str_getlen(p_data_str);
+  int i, oldest;
+  /* Evict the least recently used entries until the new one fits */
+  while (1)
+  {
+    unsigned int used = 0;
+    oldest = -1;
+    for (i = 0; i < VSFTP_DIR_CACHE_ENTRIES; i++)
+    {
+      if (str_isempty(&s_dir_cache[i].key_str))
+      {
+        continue;
+      }
+      used += str_getlen(&s_dir_cache[i].data_str);
+      if (oldest == -1 ||
+          s_dir_cache[i].last_use < s_dir_cache[oldest].last_use)
+      {
+        oldest = i;
+      }
+    }
+    if (oldest == -1 || used + total <= tunable_ls_cache_size)
+    {
+      break;
+    }
+    str_free(&s_dir_cache[oldest].key_str);
+    str_free(&s_dir_cache[oldest].data_str);
+  }
+  /* Take a free slot, or the least recently used one */
+  oldest = 0;
+  for (i = 0; i < VSFTP_DIR_CACHE_ENTRIES; i++)
+  {
+    if (str_isempty(&s_dir_cache[i].key_str))
+    {
+      oldest = i;
+      break;
+    }
+    if (s_dir_cache[i].last_use < s_dir_cache[oldest].last_use)
+    {
+      oldest = i;
+    }
+  }
+  str_copy(&s_dir_cache[oldest].key_str, p_key_str);
+  str_copy(&s_dir_cache[oldest].data_str, p_data_str);
+  s_dir_cache[oldest].last_use = ++s_dir_cache_clock;
+}
+
+void
+vsf_ftpdataio_flush_dir_cache(void)
+{
+  int i;
+  for (i = 0; i < VSFTP_DIR_CACHE_ENTRIES; i++)
+  {
+    str_free(&s_dir_cache[i].key_str);
+    str_free(&s_dir_cache[i].data_str);
+  }
+}
+
 /* XXX - really, this should be refactored into a "buffered writer" object */
 static int
 write_dir_list(struct vsf_session* p_sess, struct mystr_list* p_dir_list,
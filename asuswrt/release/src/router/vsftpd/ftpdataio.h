@@ -111,5 +111,13 @@ int vsf_ftpdataio_transfer_dir(struct vsf_session* p_sess, int is_control,
                                const struct mystr* p_filter_str,
                                int is_verbose);
 
+/* vsf_ftpdataio_flush_dir_cache()
+ * PURPOSE
+ * Drop all cached directory listings. For commands that change files in
+ * ways the directory mtime in the cache key does not show, such as
+ * writing to an existing file or changing its mode.
+ */
+void vsf_ftpdataio_flush_dir_cache(void);
+
 #endif /* VSF_FTPDATAIO_H */
 
@@ -39,6 +39,51 @@ static void build_dir_line(struct mystr* p_str,
                            const struct mystr* p_filename_str,
                            const struct vsf_sysutil_statbuf* p_stat);
 
+struct ls_options
+{
+  int a_option;
+  int r_option;
+  int t_option;
+  int F_option;
+  int is_verbose;
+  int do_stat;
+  struct mystr base_dir_str;
+};
+
+/* Names of a directory kept for sorting: all of them in one block, each
+ * NUL terminated, plus the offset of each one.
+ */
+struct ls_names
+{
+  char* p_buf;
+  unsigned int buf_len;
+  unsigned int buf_alloc;
+  unsigned int* p_offsets;
+  unsigned int num;
+  unsigned int num_alloc;
+};
+
+static void parse_ls_options(struct ls_options* p_opts,
+                             const struct mystr* p_base_dir_str,
+                             const struct mystr* p_option_str,
+                             const struct mystr* p_filter_str,
+                             int is_verbose, int want_subdirs);
+static int next_listed_name(const char* session_user,
+                            struct mystr* p_filename_str,
+                            const struct mystr* p_base_dir_str,
+                            struct vsf_sysutil_dir* p_dir,
+                            const struct ls_options* p_opts);
+static int build_entry(struct mystr* p_line_str,
+                       struct vsf_sysutil_statbuf** p_statbuf,
+                       const struct mystr* p_filename_str,
+                       const struct ls_options* p_opts);
+static void names_add(struct ls_names* p_names,
+                      const struct mystr* p_filename_str);
+static int names_compare(const void* p1, const void* p2);
+
+static const char* s_p_names_buf;
+static struct mystr s_null_str;
+
 void
 vsf_ls_populate_dir_list(const char* session_user,	// James
                          struct mystr_list* p_list,
@@ -50,53 +95,183 @@ vsf_ls_populate_dir_list(const char* session_user,	// James
                          int is_verbose)
 {
   struct mystr dirline_str = INIT_MYSTR;
-  struct mystr normalised_base_dir_str = INIT_MYSTR;
+  struct ls_options opts;
+  parse_ls_options(&opts, p_base_dir_str, p_option_str, p_filter_str,
+                   is_verbose, p_subdir_list != 0);
+
+	while (1){
+		static struct mystr s_next_filename_str;
+		static struct vsf_sysutil_statbuf* s_p_statbuf;
+
+		if (!next_listed_name(session_user, &s_next_filename_str, p_base_dir_str,
+		                      p_dir, &opts)){
+			break;
+		}
+		if (!build_entry(&dirline_str, &s_p_statbuf, &s_next_filename_str, &opts)){
+			continue;
+		}
+
+		/* Add filename into our sorted list - sorting by filename or time. Also,
+		 * if we are required to, maintain a distinct list of direct
+		 * subdirectories.
+		 */
+		static struct mystr s_temp_str;
+		const struct mystr* p_sort_str = 0;
+		const struct mystr* p_sort_subdir_str = 0;
+		if (!opts.t_option){
+			p_sort_str = &s_next_filename_str;
+		}
+		else{
+			str_alloc_text(&s_temp_str, vsf_sysutil_statbuf_get_sortkey_mtime(s_p_statbuf));
+			p_sort_str = &s_temp_str;
+			p_sort_subdir_str = &s_temp_str;
+		}
+
+		str_list_add(p_list, &dirline_str, p_sort_str);
+		if (p_subdir_list != 0 && vsf_sysutil_statbuf_is_dir(s_p_statbuf)){
+			str_list_add(p_subdir_list, &s_next_filename_str, p_sort_subdir_str);
+		}
+	} /* END: while(1) */
+
+	str_list_sort(p_list, opts.r_option);
+	if (p_subdir_list != 0){
+		str_list_sort(p_subdir_list, opts.r_option);
+	}
+
+	str_free(&dirline_str);
+	str_free(&opts.base_dir_str);
+}
+
+int
+vsf_ls_can_stream(const struct mystr* p_option_str)
+{
+  struct str_locate_result loc_result = str_locate_char(p_option_str, 't');
+  return !loc_result.found;
+}
+
+int
+vsf_ls_stream_dir_list(const char* session_user,
+                       struct vsf_sysutil_dir* p_dir,
+                       const struct mystr* p_base_dir_str,
+                       const struct mystr* p_option_str,
+                       const struct mystr* p_filter_str,
+                       int is_verbose,
+                       vsf_ls_line_func p_line_func,
+                       void* p_arg)
+{
+  static struct mystr s_next_filename_str;
+  static struct vsf_sysutil_statbuf* s_p_statbuf;
+  struct mystr dirline_str = INIT_MYSTR;
+  struct ls_names names;
+  struct ls_options opts;
+  unsigned int i;
+  int retval = 0;
+  parse_ls_options(&opts, p_base_dir_str, p_option_str, p_filter_str,
+                   is_verbose, 0);
+  if (opts.t_option)
+  {
+    bug("time sorted listing in vsf_ls_stream_dir_list");
+  }
+  if (tunable_ls_stream_unsorted)
+  {
+    /* Directory order: every line goes out as soon as it is built */
+    while (retval == 0 &&
+           next_listed_name(session_user, &s_next_filename_str,
+                            p_base_dir_str, p_dir, &opts))
+    {
+      if (build_entry(&dirline_str, &s_p_statbuf, &s_next_filename_str, &opts))
+      {
+        retval = (*p_line_func)(&dirline_str, p_arg);
+      }
+    }
+    str_free(&dirline_str);
+    str_free(&opts.base_dir_str);
+    return retval;
+  }
+  /* Sorted by name: only the names are collected, the lstat() and the
+   * formatting are done while writing out
+   */
+  vsf_sysutil_memclr(&names, sizeof(names));
+  while (next_listed_name(session_user, &s_next_filename_str, p_base_dir_str,
+                          p_dir, &opts))
+  {
+    names_add(&names, &s_next_filename_str);
+  }
+  if (names.num > 0)
+  {
+    s_p_names_buf = names.p_buf;
+    vsf_sysutil_qsort(names.p_offsets, names.num, sizeof(names.p_offsets[0]),
+                      names_compare);
+  }
+  for (i = 0; i < names.num && retval == 0; i++)
+  {
+    unsigned int indexx = opts.r_option ? names.num - 1 - i : i;
+    str_alloc_text(&s_next_filename_str, names.p_buf + names.p_offsets[indexx]);
+    if (build_entry(&dirline_str, &s_p_statbuf, &s_next_filename_str, &opts))
+    {
+      retval = (*p_line_func)(&dirline_str, p_arg);
+    }
+  }
+  if (names.p_buf)
+  {
+    vsf_sysutil_free(names.p_buf);
+    vsf_sysutil_free(names.p_offsets);
+  }
+  str_free(&dirline_str);
+  str_free(&opts.base_dir_str);
+  return retval;
+}
+
+static void
+parse_ls_options(struct ls_options* p_opts, const struct mystr* p_base_dir_str,
+                 const struct mystr* p_option_str,
+                 const struct mystr* p_filter_str, int is_verbose,
+                 int want_subdirs)
+{
   struct str_locate_result loc_result;
-  int a_option;
-  int r_option;
-  int t_option;
-  int F_option;
-  int do_stat = 0;
+  p_opts->base_dir_str = s_null_str;
   loc_result = str_locate_char(p_option_str, 'a');
-  a_option = loc_result.found;
+  p_opts->a_option = loc_result.found;
   loc_result = str_locate_char(p_option_str, 'r');
-  r_option = loc_result.found;
+  p_opts->r_option = loc_result.found;
   loc_result = str_locate_char(p_option_str, 't');
-  t_option = loc_result.found;
+  p_opts->t_option = loc_result.found;
   loc_result = str_locate_char(p_option_str, 'F');
-  F_option = loc_result.found;
+  p_opts->F_option = loc_result.found;
   loc_result = str_locate_char(p_option_str, 'l');
   if (loc_result.found)
   {
     is_verbose = 1;
   }
+  p_opts->is_verbose = is_verbose;
   /* Invert "reverse" arg for "-t", the time sorting */
-  if (t_option)
+  if (p_opts->t_option)
   {
-    r_option = !r_option;
+    p_opts->r_option = !p_opts->r_option;
   }
-  if (is_verbose || t_option || F_option || p_subdir_list != 0)
+  p_opts->do_stat = 0;
+  if (is_verbose || p_opts->t_option || p_opts->F_option || want_subdirs)
   {
-    do_stat = 1;
+    p_opts->do_stat = 1;
   }
   /* If the filter starts with a . then implicitly enable -a */
   if (!str_isempty(p_filter_str) && str_get_char_at(p_filter_str, 0) == '.')
   {
-    a_option = 1;
+    p_opts->a_option = 1;
   }
   /* "Normalise" the incoming base directory string by making sure it
    * ends in a '/' if it is nonempty
    */
   if (!str_equal_text(p_base_dir_str, "."))
   {
-    str_copy(&normalised_base_dir_str, p_base_dir_str);
+    str_copy(&p_opts->base_dir_str, p_base_dir_str);
   }
-  if (!str_isempty(&normalised_base_dir_str))
+  if (!str_isempty(&p_opts->base_dir_str))
   {
-    unsigned int len = str_getlen(&normalised_base_dir_str);
-    if (str_get_char_at(&normalised_base_dir_str, len - 1) != '/')
+    unsigned int len = str_getlen(&p_opts->base_dir_str);
+    if (str_get_char_at(&p_opts->base_dir_str, len - 1) != '/')
     {
-      str_append_char(&normalised_base_dir_str, '/');
+      str_append_char(&p_opts->base_dir_str, '/');
     }
   }
   /* If we're going to need to do time comparisions, cache the local time */
@@ -104,66 +279,86 @@ vsf_ls_populate_dir_list(const char* session_user,	// James
   {
     vsf_sysutil_update_cached_time();
   }
-	
+}
+
+/* Read the next directory entry that is to be listed at all.
+ * Returns 0 at the end of the directory.
+ */
+static int
+next_listed_name(const char* session_user, struct mystr* p_filename_str,
+                 const struct mystr* p_base_dir_str,
+                 struct vsf_sysutil_dir* p_dir,
+                 const struct ls_options* p_opts)
+{
 	while (1){
 		int len;
-		static struct mystr s_next_filename_str;
-		static struct mystr s_next_path_and_filename_str;
-		static struct vsf_sysutil_statbuf* s_p_statbuf;
 // 2007.05 James {
-		str_next_dirent(session_user, str_getbuf(p_base_dir_str), &s_next_filename_str, p_dir);
-		if(!strcmp(str_getbuf(&s_next_filename_str), DENIED_DIR))
+		str_next_dirent(session_user, str_getbuf(p_base_dir_str), p_filename_str, p_dir);
+		if(!strcmp(str_getbuf(p_filename_str), DENIED_DIR))
 			continue;
 // 2007.05 James }
 
-		if (str_isempty(&s_next_filename_str)){
-			break;
+		if (str_isempty(p_filename_str)){
+			return 0;
 		}
-		len = str_getlen(&s_next_filename_str);
-		if (len > 0 && str_get_char_at(&s_next_filename_str, 0) == '.'){
-			if (!a_option && !tunable_force_dot_files){
+		len = str_getlen(p_filename_str);
+		if (len > 0 && str_get_char_at(p_filename_str, 0) == '.'){
+			if (!p_opts->a_option && !tunable_force_dot_files){
 				continue;
 			}
-			if (!a_option &&
-					((len == 2 && str_get_char_at(&s_next_filename_str, 1) == '.') ||
+			if (!p_opts->a_option &&
+					((len == 2 && str_get_char_at(p_filename_str, 1) == '.') ||
 					len == 1)){
 				continue;
 			}
 		}
 
 		/* Don't show hidden directory entries */
-		if (!vsf_access_check_file_visible(&s_next_filename_str)){
+		if (!vsf_access_check_file_visible(p_filename_str)){
 			continue;
 		}
 #if 0
 		/* If we have an ls option which is a filter, apply it */
 		if (!str_isempty(p_filter_str)){
-			if (!vsf_filename_passes_filter(&s_next_filename_str, p_filter_str)){
+			if (!vsf_filename_passes_filter(p_filename_str, p_filter_str)){
 				continue;
 			}
 		}
 #endif
+		return 1;
+	}
+}
+
+/* Format the listing line of one entry into p_line_str.
+ * Returns 0 if the entry went away in the meantime.
+ */
+static int
+build_entry(struct mystr* p_line_str, struct vsf_sysutil_statbuf** p_statbuf,
+            const struct mystr* p_filename_str,
+            const struct ls_options* p_opts)
+{
+		static struct mystr s_next_path_and_filename_str;
 		/* Calculate the full path (relative to CWD) for lstat() and
 		 * output purposes
 		 */
-		str_copy(&s_next_path_and_filename_str, &normalised_base_dir_str);
-		str_append_str(&s_next_path_and_filename_str, &s_next_filename_str);
-		if (do_stat){
+		str_copy(&s_next_path_and_filename_str, &p_opts->base_dir_str);
+		str_append_str(&s_next_path_and_filename_str, p_filename_str);
+		if (p_opts->do_stat){
 			/* lstat() the file. Of course there's a race condition - the
 			 * directory entry may have gone away whilst we read it, so
 		 	* ignore failure to stat
 		 	*/
-			int retval = str_lstat(&s_next_path_and_filename_str, &s_p_statbuf);
+			int retval = str_lstat(&s_next_path_and_filename_str, p_statbuf);
 			if (vsf_sysutil_retval_is_error(retval)){
-				continue;
+				return 0;
 			}
 		}
 		
-		if (is_verbose){
+		if (p_opts->is_verbose){
 			static struct mystr s_final_file_str;
 			/* If it's a damn symlink, we need to append the target */
-			str_copy(&s_final_file_str, &s_next_filename_str);
-			if (vsf_sysutil_statbuf_is_symlink(s_p_statbuf)){
+			str_copy(&s_final_file_str, p_filename_str);
+			if (vsf_sysutil_statbuf_is_symlink(*p_statbuf)){
 				static struct mystr s_temp_str;
 				int retval = str_readlink(&s_temp_str, &s_next_path_and_filename_str);
 				if (retval == 0 && !str_isempty(&s_temp_str)){
@@ -171,61 +366,61 @@ vsf_ls_populate_dir_list(const char* session_user,	// James
 					str_append_str(&s_final_file_str, &s_temp_str);
 				}
 			}
-			if (F_option && vsf_sysutil_statbuf_is_dir(s_p_statbuf)){
+			if (p_opts->F_option && vsf_sysutil_statbuf_is_dir(*p_statbuf)){
 				str_append_char(&s_final_file_str, '/');
 			}
 			
-			build_dir_line(&dirline_str, &s_final_file_str, s_p_statbuf);
+			build_dir_line(p_line_str, &s_final_file_str, *p_statbuf);
 		}
 		else{
 			/* Just emit the filenames - note, we prepend the directory for NLST
 			 * but not for LIST
 			 */
-			str_copy(&dirline_str, &s_next_path_and_filename_str);
-			if (F_option){
-				if (vsf_sysutil_statbuf_is_dir(s_p_statbuf)){
-					str_append_char(&dirline_str, '/');
+			str_copy(p_line_str, &s_next_path_and_filename_str);
+			if (p_opts->F_option){
+				if (vsf_sysutil_statbuf_is_dir(*p_statbuf)){
+					str_append_char(p_line_str, '/');
 				}
-				else if (vsf_sysutil_statbuf_is_symlink(s_p_statbuf)){
-					str_append_char(&dirline_str, '@');
+				else if (vsf_sysutil_statbuf_is_symlink(*p_statbuf)){
+					str_append_char(p_line_str, '@');
 				}
 			}
-			str_append_text(&dirline_str, "\r\n");
+			str_append_text(p_line_str, "\r\n");
 			
-			char *ptr = strstr(str_getbuf(&dirline_str), POOL_MOUNT_ROOT);
+			char *ptr = strstr(str_getbuf(p_line_str), POOL_MOUNT_ROOT);
 			if(ptr != NULL)
-				str_alloc_text(&dirline_str, ptr+strlen(POOL_MOUNT_ROOT));
-		}
-		
-		/* Add filename into our sorted list - sorting by filename or time. Also,
-		 * if we are required to, maintain a distinct list of direct
-		 * subdirectories.
-		 */
-		static struct mystr s_temp_str;
-		const struct mystr* p_sort_str = 0;
-		const struct mystr* p_sort_subdir_str = 0;
-		if (!t_option){
-			p_sort_str = &s_next_filename_str;
+				str_alloc_text(p_line_str, ptr+strlen(POOL_MOUNT_ROOT));
 		}
-		else{
-			str_alloc_text(&s_temp_str, vsf_sysutil_statbuf_get_sortkey_mtime(s_p_statbuf));
-			p_sort_str = &s_temp_str;
-			p_sort_subdir_str = &s_temp_str;
-		}
-		
-		str_list_add(p_list, &dirline_str, p_sort_str);
-		if (p_subdir_list != 0 && vsf_sysutil_statbuf_is_dir(s_p_statbuf)){
-			str_list_add(p_subdir_list, &s_next_filename_str, p_sort_subdir_str);
-		}
-	} /* END: while(1) */
-	
-	str_list_sort(p_list, r_option);
-	if (p_subdir_list != 0){
-		str_list_sort(p_subdir_list, r_option);
-	}
-	
-	str_free(&dirline_str);
-	str_free(&normalised_base_dir_str);
+		return 1;
+}
+
+static void
+names_add(struct ls_names* p_names, const struct mystr* p_filename_str)
+{
+  unsigned int len = str_getlen(p_filename_str) + 1;
+  if (p_names->buf_len + len > p_names->buf_alloc)
+  {
+    p_names->buf_alloc = (p_names->buf_alloc + len) * 2;
+    p_names->p_buf = vsf_sysutil_realloc(p_names->p_buf, p_names->buf_alloc);
+  }
+  if (p_names->num == p_names->num_alloc)
+  {
+    p_names->num_alloc = p_names->num_alloc * 2 + 64;
+    p_names->p_offsets = vsf_sysutil_realloc(
+      p_names->p_offsets, p_names->num_alloc * sizeof(p_names->p_offsets[0]));
+  }
+  vsf_sysutil_memcpy(p_names->p_buf + p_names->buf_len,
+                     str_getbuf(p_filename_str), len);
+  p_names->p_offsets[p_names->num++] = p_names->buf_len;
+  p_names->buf_len += len;
+}
+
+/* Same order as str_list_sort() on the names */
+static int
+names_compare(const void* p1, const void* p2)
+{
+  return vsf_sysutil_strcmp(s_p_names_buf + *(const unsigned int*) p1,
+                            s_p_names_buf + *(const unsigned int*) p2);
 }
 
 int
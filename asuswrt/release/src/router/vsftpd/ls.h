@@ -44,6 +44,40 @@ void vsf_ls_populate_dir_list(const char* session_user,	// James
                               const struct mystr* p_filter_str,
                               int is_verbose);
 
+/* vsf_ls_can_stream()
+ * PURPOSE
+ * Determine whether a listing with the given LIST/NLST options can be sent
+ * by vsf_ls_stream_dir_list(). Time sorted ("-t") listings can not.
+ * RETURNS
+ * Returns 1 if it can, 0 otherwise.
+ */
+int vsf_ls_can_stream(const struct mystr* p_option_str);
+
+/* vsf_ls_stream_dir_list()
+ * PURPOSE
+ * Produce the same lines as vsf_ls_populate_dir_list(), but hand each one
+ * to p_line_func as soon as it is built instead of collecting them. For a
+ * name sorted listing only the file names are held in memory; with
+ * tunable_ls_stream_unsorted nothing is, the lines follow directory order.
+ * Subdirectories are not reported.
+ * PARAMETERS
+ * As vsf_ls_populate_dir_list(), plus
+ * p_line_func    - called with every formatted line
+ * p_arg          - passed on to p_line_func
+ * RETURNS
+ * Returns 0, or the first non-zero value returned by p_line_func, which
+ * stops the listing.
+ */
+typedef int (*vsf_ls_line_func)(const struct mystr* p_line_str, void* p_arg);
+int vsf_ls_stream_dir_list(const char* session_user,
+                           struct vsf_sysutil_dir* p_dir,
+                           const struct mystr* p_base_dir_str,
+                           const struct mystr* p_option_str,
+                           const struct mystr* p_filter_str,
+                           int is_verbose,
+                           vsf_ls_line_func p_line_func,
+                           void* p_arg);
+
 /* vsf_filename_passes_filter()
  * PURPOSE
  * Determine whether the given filename is matched by the given filter string.
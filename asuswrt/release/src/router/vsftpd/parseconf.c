@@ -90,6 +90,8 @@ parseconf_bool_array[] =
   { "tcp_wrappers", &tunable_tcp_wrappers },
   { "use_sendfile", &tunable_use_sendfile },
   { "force_dot_files", &tunable_force_dot_files },
+  { "ls_stream_enable", &tunable_ls_stream_enable },
+  { "ls_stream_unsorted", &tunable_ls_stream_unsorted },
   { "listen_ipv6", &tunable_listen_ipv6 },
   { "dual_log_enable", &tunable_dual_log_enable },
   { "syslog_enable", &tunable_syslog_enable },
@@ -142,6 +144,7 @@ parseconf_uint_array[] =
   { "file_open_mode", &tunable_file_open_mode },
   { "max_per_ip", &tunable_max_per_ip },
   { "trans_chunk_size", &tunable_trans_chunk_size },
+  { "ls_cache_size", &tunable_ls_cache_size },
   { 0, 0 }
 };
 
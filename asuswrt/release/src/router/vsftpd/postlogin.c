@@ -1357,6 +1357,8 @@ handle_upload_common(struct vsf_session* p_sess, int is_append, int is_unique)
   {
     return;
   }
+  /* Writing to an existing file leaves its directory's mtime alone */
+  vsf_ftpdataio_flush_dir_cache();
   resolve_tilde(&p_sess->full_path, p_sess);
   p_filename = &p_sess->full_path;
   if (is_unique)
@@ -1989,6 +1991,7 @@ handle_site_chmod(struct vsf_session* p_sess, struct mystr* p_arg_str)
     vsf_cmdio_write(p_sess, FTP_BADCMD, "SITE CHMOD needs 2 arguments.");
     return;
   }
+  vsf_ftpdataio_flush_dir_cache();
   resolve_tilde(&s_chmod_file_str, p_sess);
   vsf_log_start_entry(p_sess, kVSFLogEntryChmod);
   str_copy(&p_sess->log_str, &s_chmod_file_str);
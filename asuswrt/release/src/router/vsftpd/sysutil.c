@@ -1510,6 +1510,13 @@ vsf_sysutil_statbuf_is_readable_other(
   return 0;
 }
 
+long
+vsf_sysutil_statbuf_get_mtime(const struct vsf_sysutil_statbuf* p_statbuf)
+{
+  const struct stat* p_stat = (const struct stat*) p_statbuf;
+  return (long) p_stat->st_mtime;
+}
+
 const char*
 vsf_sysutil_statbuf_get_sortkey_mtime(
   const struct vsf_sysutil_statbuf* p_statbuf)
@@ -149,6 +149,8 @@ int vsf_sysutil_statbuf_get_uid(const struct vsf_sysutil_statbuf* p_stat);
 int vsf_sysutil_statbuf_get_gid(const struct vsf_sysutil_statbuf* p_stat);
 int vsf_sysutil_statbuf_is_readable_other(
   const struct vsf_sysutil_statbuf* p_stat);
+long vsf_sysutil_statbuf_get_mtime(
+  const struct vsf_sysutil_statbuf* p_stat);
 const char* vsf_sysutil_statbuf_get_sortkey_mtime(
   const struct vsf_sysutil_statbuf* p_stat);
 
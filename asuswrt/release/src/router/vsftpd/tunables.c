@@ -62,6 +62,8 @@ int tunable_no_anon_password = 0;
 int tunable_tcp_wrappers = 0;
 int tunable_use_sendfile = 1;
 int tunable_force_dot_files = 0;
+int tunable_ls_stream_enable = 0;
+int tunable_ls_stream_unsorted = 0;
 int tunable_listen_ipv6 = 0;
 int tunable_dual_log_enable = 0;
 int tunable_syslog_enable = 0;
@@ -112,6 +114,7 @@ unsigned int tunable_max_clients = 0;
 unsigned int tunable_file_open_mode = 0666;
 unsigned int tunable_max_per_ip = 0;
 unsigned int tunable_trans_chunk_size = 0;
+unsigned int tunable_ls_cache_size = 0;
 
 const char* tunable_secure_chroot_dir = "/tmp";	//Yen
 const char* tunable_ftp_username = "ftp";
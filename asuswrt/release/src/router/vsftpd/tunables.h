@@ -58,6 +58,8 @@ extern int tunable_no_anon_password;          /* Do not ask for anon pword */
 extern int tunable_tcp_wrappers;              /* Standalone: do tcp wrappers */
 extern int tunable_use_sendfile;              /* Use sendfile() if we can */
 extern int tunable_force_dot_files;           /* Show dotfiles without -a */
+extern int tunable_ls_stream_enable;          /* Send listings as they are read */
+extern int tunable_ls_stream_unsorted;        /* ... in directory order */
 extern int tunable_listen_ipv6;               /* Standalone with IPv6 listen */
 extern int tunable_dual_log_enable;           /* Log vsftpd.log AND xferlog */
 extern int tunable_syslog_enable;             /* Use syslog not vsftpd.log */
@@ -102,6 +104,7 @@ extern unsigned int tunable_max_clients;
 extern unsigned int tunable_file_open_mode;
 extern unsigned int tunable_max_per_ip;
 extern unsigned int tunable_trans_chunk_size;
+extern unsigned int tunable_ls_cache_size;
 
 /* String defines */
 extern const char* tunable_secure_chroot_dir;
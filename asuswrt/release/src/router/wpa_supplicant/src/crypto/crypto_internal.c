@@ -23,6 +23,9 @@
 #include "tls/rsa.h"
 #include "tls/bignum.h"
 #include "tls/asn1.h"
+#ifdef CONFIG_GMP
+#include <gmp.h>
+#endif /* CONFIG_GMP */
 
 
 #ifdef CONFIG_CRYPTO_INTERNAL
@@ -795,6 +798,51 @@ void crypto_global_deinit(void)
 
 #if defined(EAP_FAST) || defined(CONFIG_WPS)
 
+#ifdef CONFIG_GMP
+/*
+ * The 1536-bit DH of WPS is by far the most expensive operation of an
+ * exchange; GMP's assembly-backed mpz_powm() is much faster on the router
+ * CPUs than the portable LibTomMath code.
+ */
+int crypto_mod_exp(const u8 *base, size_t base_len,
+		   const u8 *power, size_t power_len,
+		   const u8 *modulus, size_t modulus_len,
+		   u8 *result, size_t *result_len)
+{
+	mpz_t bn_base, bn_exp, bn_modulus, bn_result;
+	size_t len;
+	int ret = -1;
+
+	mpz_init(bn_base);
+	mpz_init(bn_exp);
+	mpz_init(bn_modulus);
+	mpz_init(bn_result);
+
+	mpz_import(bn_base, base_len, 1, 1, 0, 0, base);
+	mpz_import(bn_exp, power_len, 1, 1, 0, 0, power);
+	mpz_import(bn_modulus, modulus_len, 1, 1, 0, 0, modulus);
+	if (mpz_sgn(bn_modulus) == 0)
+		goto error;
+
+	mpz_powm(bn_result, bn_base, bn_exp, bn_modulus);
+
+	len = (mpz_sizeinbase(bn_result, 2) + 7) / 8;
+	if (len > *result_len)
+		goto error;
+	mpz_export(result, &len, 1, 1, 0, 0, bn_result);
+	*result_len = len;
+	ret = 0;
+
+error:
+	mpz_clear(bn_base);
+	mpz_clear(bn_exp);
+	mpz_clear(bn_modulus);
+	mpz_clear(bn_result);
+	return ret;
+}
+
+#else /* CONFIG_GMP */
+
 int crypto_mod_exp(const u8 *base, size_t base_len,
 		   const u8 *power, size_t power_len,
 		   const u8 *modulus, size_t modulus_len,
@@ -830,6 +878,8 @@ error:
 	return ret;
 }
 
+#endif /* CONFIG_GMP */
+
 #endif /* EAP_FAST || CONFIG_WPS */
 
 
@@ -301,12 +301,20 @@ int tls_prf(const u8 *secret, size_t secret_len, const char *label,
 
 #ifndef CONFIG_NO_PBKDF2
 
+#ifdef INTERNAL_SHA1
+static void pbkdf2_sha1_iter(const u8 *key, size_t key_len, int iterations,
+			     u8 *u, u8 *digest);
+#endif /* INTERNAL_SHA1 */
+
 static void pbkdf2_sha1_f(const char *passphrase, const char *ssid,
 			  size_t ssid_len, int iterations, unsigned int count,
 			  u8 *digest)
 {
-	unsigned char tmp[SHA1_MAC_LEN], tmp2[SHA1_MAC_LEN];
+	unsigned char tmp[SHA1_MAC_LEN];
+#ifndef INTERNAL_SHA1
+	unsigned char tmp2[SHA1_MAC_LEN];
 	int i, j;
+#endif /* INTERNAL_SHA1 */
 	unsigned char count_buf[4];
 	const u8 *addr[2];
 	size_t len[2];
@@ -330,6 +338,10 @@ static void pbkdf2_sha1_f(const char *passphrase, const char *ssid,
 	hmac_sha1_vector((u8 *) passphrase, passphrase_len, 2, addr, len, tmp);
 	os_memcpy(digest, tmp, SHA1_MAC_LEN);
 
+#ifdef INTERNAL_SHA1
+	pbkdf2_sha1_iter((u8 *) passphrase, passphrase_len, iterations - 1,
+			 tmp, digest);
+#else /* INTERNAL_SHA1 */
 	for (i = 1; i < iterations; i++) {
 		hmac_sha1((u8 *) passphrase, passphrase_len, tmp, SHA1_MAC_LEN,
 			  tmp2);
@@ -337,6 +349,7 @@ static void pbkdf2_sha1_f(const char *passphrase, const char *ssid,
 		for (j = 0; j < SHA1_MAC_LEN; j++)
 			digest[j] ^= tmp2[j];
 	}
+#endif /* INTERNAL_SHA1 */
 }
 
 
@@ -469,6 +482,71 @@ int fips186_2_prf(const u8 *seed, size_t seed_len, u8 *x, size_t xlen)
 #endif /* CONFIG_NO_FIPS186_2_PRF */
 
 
+#ifndef CONFIG_NO_PBKDF2
+/*
+ * HMAC-SHA1 of a 20-byte message always hashes exactly one padded block
+ * after the key block, so the states after key ^ ipad and key ^ opad are
+ * computed once and each PBKDF2 round costs two SHA1Transform() calls
+ * instead of four full hashes with their key setup.
+ */
+static void pbkdf2_sha1_iter(const u8 *key, size_t key_len, int iterations,
+			     u8 *u, u8 *digest)
+{
+	u32 istate[5], ostate[5], state[5];
+	u8 pad[64], block[64], tk[SHA1_MAC_LEN];
+	int i, j;
+
+	if (key_len > 64) {
+		sha1_vector(1, &key, &key_len, tk);
+		key = tk;
+		key_len = SHA1_MAC_LEN;
+	}
+
+	os_memset(pad, 0x36, sizeof(pad));
+	for (i = 0; i < (int) key_len; i++)
+		pad[i] ^= key[i];
+	istate[0] = 0x67452301;
+	istate[1] = 0xEFCDAB89;
+	istate[2] = 0x98BADCFE;
+	istate[3] = 0x10325476;
+	istate[4] = 0xC3D2E1F0;
+	os_memcpy(ostate, istate, sizeof(ostate));
+	SHA1Transform(istate, pad);
+	for (i = 0; i < 64; i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+	SHA1Transform(ostate, pad);
+
+	/* 20-byte message, 0x80, zeros, bit length of key block + message */
+	os_memset(block, 0, sizeof(block));
+	block[SHA1_MAC_LEN] = 0x80;
+	block[62] = ((64 + SHA1_MAC_LEN) * 8) >> 8;
+	block[63] = ((64 + SHA1_MAC_LEN) * 8) & 0xff;
+	os_memcpy(block, u, SHA1_MAC_LEN);
+
+	while (iterations-- > 0) {
+		os_memcpy(state, istate, sizeof(state));
+		SHA1Transform(state, block);
+		for (j = 0; j < 5; j++)
+			WPA_PUT_BE32(block + 4 * j, state[j]);
+
+		os_memcpy(state, ostate, sizeof(state));
+		SHA1Transform(state, block);
+		for (j = 0; j < 5; j++)
+			WPA_PUT_BE32(block + 4 * j, state[j]);
+
+		for (j = 0; j < SHA1_MAC_LEN; j++)
+			digest[j] ^= block[j];
+	}
+
+	os_memset(pad, 0, sizeof(pad));
+	os_memset(istate, 0, sizeof(istate));
+	os_memset(ostate, 0, sizeof(ostate));
+	os_memset(state, 0, sizeof(state));
+	os_memset(block, 0, sizeof(block));
+}
+#endif /* CONFIG_NO_PBKDF2 */
+
+
 /* ===== start - public domain SHA1 implementation ===== */
 
 /*
@@ -1829,6 +1829,58 @@ char * wpa_config_get_no_key(struct wpa_ssid *ssid, const char *var)
 #endif /* NO_CONFIG_WRITE */
 
 
+#ifndef CONFIG_NO_PBKDF2
+/*
+ * Recently derived PSKs, so that reconfiguration, WPS credentials and
+ * ctrl_iface updates of an unchanged (SSID, passphrase) pair do not pay
+ * for another 4096-iteration PBKDF2 run.
+ */
+#define PSK_CACHE_SIZE 4
+
+static struct psk_cache_entry {
+	u8 ssid[MAX_SSID_LEN];
+	size_t ssid_len;
+	char passphrase[64];
+	u8 psk[PMK_LEN];
+} psk_cache[PSK_CACHE_SIZE];
+static unsigned int psk_cache_next;
+
+
+static int psk_cache_get(const struct wpa_ssid *ssid, u8 *psk)
+{
+	int i;
+
+	for (i = 0; i < PSK_CACHE_SIZE; i++) {
+		struct psk_cache_entry *e = &psk_cache[i];
+		if (e->ssid_len == ssid->ssid_len && e->passphrase[0] &&
+		    os_memcmp(e->ssid, ssid->ssid, ssid->ssid_len) == 0 &&
+		    os_strcmp(e->passphrase, ssid->passphrase) == 0) {
+			os_memcpy(psk, e->psk, PMK_LEN);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+
+static void psk_cache_add(const struct wpa_ssid *ssid, const u8 *psk)
+{
+	struct psk_cache_entry *e;
+
+	if (ssid->ssid_len > MAX_SSID_LEN ||
+	    os_strlen(ssid->passphrase) >= sizeof(e->passphrase))
+		return;
+
+	e = &psk_cache[psk_cache_next++ % PSK_CACHE_SIZE];
+	os_memcpy(e->ssid, ssid->ssid, ssid->ssid_len);
+	e->ssid_len = ssid->ssid_len;
+	os_strlcpy(e->passphrase, ssid->passphrase, sizeof(e->passphrase));
+	os_memcpy(e->psk, psk, PMK_LEN);
+}
+#endif /* CONFIG_NO_PBKDF2 */
+
+
 /**
  * wpa_config_update_psk - Update WPA PSK based on passphrase and SSID
  * @ssid: Pointer to network configuration data
@@ -1839,9 +1891,12 @@ char * wpa_config_get_no_key(struct wpa_ssid *ssid, const char *var)
 void wpa_config_update_psk(struct wpa_ssid *ssid)
 {
 #ifndef CONFIG_NO_PBKDF2
-	pbkdf2_sha1(ssid->passphrase,
-		    (char *) ssid->ssid, ssid->ssid_len, 4096,
-		    ssid->psk, PMK_LEN);
+	if (psk_cache_get(ssid, ssid->psk) < 0) {
+		pbkdf2_sha1(ssid->passphrase,
+			    (char *) ssid->ssid, ssid->ssid_len, 4096,
+			    ssid->psk, PMK_LEN);
+		psk_cache_add(ssid, ssid->psk);
+	}
 	wpa_hexdump_key(MSG_MSGDUMP, "PSK (from passphrase)",
 			ssid->psk, PMK_LEN);
 	ssid->psk_set = 1;
@@ -291,6 +291,26 @@ static struct passphrase_test passphrase_tests[] =
 (sizeof(passphrase_tests) / sizeof(passphrase_tests[0]))
 
 
+static void test_pbkdf2_speed(void)
+{
+	struct timeval start, end;
+	double secs;
+	u8 psk[32];
+	int i, n = 20;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		pbkdf2_sha1("password", "IEEE", 4, 4096, psk, 32);
+	gettimeofday(&end, NULL);
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_usec - start.tv_usec) / 1000000.0;
+	if (secs > 0)
+		printf("PBKDF2-SHA1 (4096 iterations): %.1f derivations/s\n",
+		       n / secs);
+}
+
+
 int main(int argc, char *argv[])
 {
 	u8 res[512];
@@ -343,5 +363,7 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	test_pbkdf2_speed();
+
 	return ret;
 }